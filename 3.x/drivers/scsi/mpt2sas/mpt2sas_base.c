@@ -83,6 +83,11 @@ static int msix_disable = -1;
 module_param(msix_disable, int, 0);
 MODULE_PARM_DESC(msix_disable, " disable msix routed interrupts (default=0)");
 
+static int poll_queues;
+module_param(poll_queues, int, 0);
+MODULE_PARM_DESC(poll_queues, " reply queues serviced by a polling kthread"
+	" instead of an interrupt, used by LUNs with io_poll set (default=0)");
+
 static int mpt2sas_fwfault_debug;
 MODULE_PARM_DESC(mpt2sas_fwfault_debug, " enable detection of firmware fault "
 	"and halt firmware - (default=0)");
@@ -1272,8 +1277,14 @@ _base_free_irq(struct MPT2SAS_ADAPTER *ioc)
 	if (list_empty(&ioc->reply_queue_list))
 		return;
 
+	ioc->nr_poll_reply_q = 0;
 	list_for_each_entry_safe(reply_q, next, &ioc->reply_queue_list, list) {
 		list_del(&reply_q->list);
+		if (reply_q->poll_task) {
+			kthread_stop(reply_q->poll_task);
+			reply_q->poll_task = NULL;
+			enable_irq(reply_q->vector);
+		}
 		synchronize_irq(reply_q->vector);
 		free_irq(reply_q->vector, reply_q);
 		kfree(reply_q);
@@ -1304,6 +1315,8 @@ _base_request_irq(struct MPT2SAS_ADAPTER *ioc, u8 index, u32 vector)
 	reply_q->msix_index = index;
 	reply_q->vector = vector;
 	atomic_set(&reply_q->busy, 0);
+	atomic_set(&reply_q->pending, 0);
+	init_waitqueue_head(&reply_q->poll_wq);
 	if (ioc->msix_enable)
 		snprintf(reply_q->name, MPT_NAME_LENGTH, "%s%d-msix%d",
 		    MPT2SAS_DRIVER_NAME, ioc->id, index);
@@ -1339,9 +1352,25 @@ _base_assign_reply_queues(struct MPT2SAS_ADAPTER *ioc)
 	struct adapter_reply_queue *reply_q;
 	int cpu_id;
 	int cpu_grouping, loop, grouping, grouping_mod;
+	int irq_queues;
 
-	if (!_base_is_controller_msix_enabled(ioc))
+	ioc->poll_queues = 0;
+	if (!_base_is_controller_msix_enabled(ioc)) {
+		if (poll_queues > 0)
+			printk(MPT2SAS_WARN_FMT
+			    "poll_queues requires msix, ignored\n", ioc->name);
 		return;
+	}
+
+	/* keep one interrupt driven queue for events and internal IO */
+	if (poll_queues > 0) {
+		if (ioc->reply_queue_count < 2)
+			printk(MPT2SAS_WARN_FMT "poll_queues needs two or more"
+			    " reply queues, ignored\n", ioc->name);
+		else
+			ioc->poll_queues = min_t(int, min(poll_queues,
+			    MPT2SAS_MAX_POLL_QUEUES), ioc->reply_queue_count - 1);
+	}
 
 	memset(ioc->cpu_msix_table, 0, ioc->cpu_msix_table_sz);
 	/* when there are more cpus than available msix vectors,
@@ -1383,6 +1412,77 @@ _base_assign_reply_queues(struct MPT2SAS_ADAPTER *ioc)
 			}
 		}
 	}
+
+	/* polled queues only see IO from LUNs with io_poll set */
+	if (ioc->poll_queues) {
+		irq_queues = ioc->reply_queue_count - ioc->poll_queues;
+		for_each_online_cpu(cpu_id)
+			ioc->cpu_msix_table[cpu_id] %= irq_queues;
+	}
+}
+
+/**
+ * _base_poll_thread - service a polled reply queue
+ * @arg: the reply queue
+ *
+ * Runs the interrupt handler in a loop while SCSI IO is outstanding on
+ * the queue, sleeps otherwise.  The queue's interrupt stays disabled.
+ */
+static int
+_base_poll_thread(void *arg)
+{
+	struct adapter_reply_queue *reply_q = arg;
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(reply_q->poll_wq,
+		    atomic_read(&reply_q->pending) || kthread_should_stop());
+		if (_base_interrupt(reply_q->vector, reply_q) == IRQ_NONE)
+			cpu_relax();
+		cond_resched();
+	}
+	return 0;
+}
+
+/**
+ * _base_start_poll_queues - start the reply queue pollers
+ * @ioc: per adapter object
+ *
+ * The last ioc->poll_queues reply queues get a kthread in place of
+ * their interrupt.  They are torn down with the reply queues in
+ * _base_free_irq.
+ */
+static void
+_base_start_poll_queues(struct MPT2SAS_ADAPTER *ioc)
+{
+	struct adapter_reply_queue *reply_q;
+	struct task_struct *task;
+	int first = ioc->reply_queue_count - ioc->poll_queues;
+	int n = 0;
+
+	if (!ioc->poll_queues || ioc->nr_poll_reply_q)
+		return;
+
+	list_for_each_entry(reply_q, &ioc->reply_queue_list, list) {
+		if (reply_q->msix_index < first)
+			continue;
+		task = kthread_create_on_node(_base_poll_thread, reply_q,
+		    dev_to_node(&ioc->pdev->dev), "%s%d_poll%d",
+		    MPT2SAS_DRIVER_NAME, ioc->id, reply_q->msix_index);
+		if (IS_ERR(task)) {
+			printk(MPT2SAS_WARN_FMT
+			    "failed to start poller for reply queue %d\n",
+			    ioc->name, reply_q->msix_index);
+			break;
+		}
+		disable_irq(reply_q->vector);
+		reply_q->poll_task = task;
+		ioc->poll_reply_q[n++] = reply_q;
+		wake_up_process(task);
+	}
+	ioc->nr_poll_reply_q = n;
+	if (n)
+		printk(MPT2SAS_INFO_FMT "%d reply queue(s) polled\n",
+		    ioc->name, n);
 }
 
 /**
@@ -1669,26 +1769,43 @@ u16
 mpt2sas_base_get_smid_scsiio(struct MPT2SAS_ADAPTER *ioc, u8 cb_idx,
     struct scsi_cmnd *scmd)
 {
-	unsigned long flags;
 	struct scsiio_tracker *request;
-	u16 smid;
+	unsigned int start, bit;
+	int wrapped = 0;
 
-	spin_lock_irqsave(&ioc->scsi_lookup_lock, flags);
-	if (list_empty(&ioc->free_list)) {
-		spin_unlock_irqrestore(&ioc->scsi_lookup_lock, flags);
-		printk(MPT2SAS_ERR_FMT "%s: smid not available\n",
-		    ioc->name, __func__);
-		return 0;
+	/*
+	 * Lockless: claim a clear bit in scsiio_bitmap, starting where this
+	 * cpu last left off so cpus mostly stay in their own cache lines.
+	 */
+	start = this_cpu_read(*ioc->scsiio_smid_hint);
+	if (start >= ioc->scsiio_depth)
+		start = 0;
+	bit = start;
+	for (;;) {
+		bit = find_next_zero_bit(ioc->scsiio_bitmap,
+		    ioc->scsiio_depth, bit);
+		if (wrapped && bit >= start)
+			bit = ioc->scsiio_depth;
+		if (bit >= ioc->scsiio_depth) {
+			if (wrapped || !start) {
+				printk(MPT2SAS_ERR_FMT "%s: smid not available\n",
+				    ioc->name, __func__);
+				return 0;
+			}
+			wrapped = 1;
+			bit = 0;
+			continue;
+		}
+		if (!test_and_set_bit_lock(bit, ioc->scsiio_bitmap))
+			break;
+		bit++;
 	}
+	this_cpu_write(*ioc->scsiio_smid_hint, bit + 1);
 
-	request = list_entry(ioc->free_list.next,
-	    struct scsiio_tracker, tracker_list);
+	request = &ioc->scsi_lookup[bit];
 	request->scmd = scmd;
 	request->cb_idx = cb_idx;
-	smid = request->smid;
-	list_del(&request->tracker_list);
-	spin_unlock_irqrestore(&ioc->scsi_lookup_lock, flags);
-	return smid;
+	return request->smid;
 }
 
 /**
@@ -1722,7 +1839,7 @@ mpt2sas_base_get_smid_hpr(struct MPT2SAS_ADAPTER *ioc, u8 cb_idx)
 
 
 /**
- * mpt2sas_base_free_smid - put smid back on free_list
+ * mpt2sas_base_free_smid - release a smid
  * @ioc: per adapter object
  * @smid: system request message index
  *
@@ -1733,38 +1850,49 @@ mpt2sas_base_free_smid(struct MPT2SAS_ADAPTER *ioc, u16 smid)
 {
 	unsigned long flags;
 	int i;
-	struct chain_tracker *chain_req, *next;
+	u8 recovery;
+	struct scsiio_tracker *st;
 
-	spin_lock_irqsave(&ioc->scsi_lookup_lock, flags);
 	if (smid < ioc->hi_priority_smid) {
-		/* scsiio queue */
+		/* scsiio queue, ours until the bitmap bit is cleared */
 		i = smid - 1;
-		if (!list_empty(&ioc->scsi_lookup[i].chain_list)) {
-			list_for_each_entry_safe(chain_req, next,
-			    &ioc->scsi_lookup[i].chain_list, tracker_list) {
-				list_del_init(&chain_req->tracker_list);
-				list_add_tail(&chain_req->tracker_list,
-				    &ioc->free_chain_list);
-			}
+		st = &ioc->scsi_lookup[i];
+		if (!list_empty(&st->chain_list)) {
+			spin_lock_irqsave(&ioc->scsi_lookup_lock, flags);
+			list_splice_tail_init(&st->chain_list,
+			    &ioc->free_chain_list);
+			spin_unlock_irqrestore(&ioc->scsi_lookup_lock, flags);
+		}
+		if (st->poll_q) {
+			atomic_dec(&st->poll_q->pending);
+			st->poll_q = NULL;
 		}
-		ioc->scsi_lookup[i].cb_idx = 0xFF;
-		ioc->scsi_lookup[i].scmd = NULL;
-		ioc->scsi_lookup[i].direct_io = 0;
-		list_add_tail(&ioc->scsi_lookup[i].tracker_list,
-		    &ioc->free_list);
-		spin_unlock_irqrestore(&ioc->scsi_lookup_lock, flags);
-
 		/*
 		 * See _wait_for_commands_to_complete() call with regards
-		 * to this code.
+		 * to this code.  During a reset the tracker is released and
+		 * pending_io_count dropped under scsi_lookup_lock, which the
+		 * count of outstanding commands is taken under.
 		 */
-		if (ioc->shost_recovery && ioc->pending_io_count) {
-			if (ioc->pending_io_count == 1)
-				wake_up(&ioc->reset_wq);
-			ioc->pending_io_count--;
+		recovery = ioc->shost_recovery;
+		if (unlikely(recovery))
+			spin_lock_irqsave(&ioc->scsi_lookup_lock, flags);
+		st->cb_idx = 0xFF;
+		st->scmd = NULL;
+		st->direct_io = 0;
+		clear_bit_unlock(i, ioc->scsiio_bitmap);
+		if (unlikely(recovery)) {
+			if (ioc->pending_io_count) {
+				if (ioc->pending_io_count == 1)
+					wake_up(&ioc->reset_wq);
+				ioc->pending_io_count--;
+			}
+			spin_unlock_irqrestore(&ioc->scsi_lookup_lock, flags);
 		}
 		return;
-	} else if (smid < ioc->internal_smid) {
+	}
+
+	spin_lock_irqsave(&ioc->scsi_lookup_lock, flags);
+	if (smid < ioc->internal_smid) {
 		/* hi-priority */
 		i = smid - ioc->hi_priority_smid;
 		ioc->hpr_lookup[i].cb_idx = 0xFF;
@@ -1817,6 +1945,40 @@ _base_get_msix_index(struct MPT2SAS_ADAPTER *ioc)
 	return ioc->cpu_msix_table[raw_smp_processor_id()];
 }
 
+/**
+ * _base_get_msix_index_scsiio - reply queue for a SCSI IO
+ * @ioc: per adapter object
+ * @smid: system request message index
+ *
+ * IO to a LUN with io_poll set is steered to a polled reply queue, whose
+ * poller is woken when the queue goes busy.  A WarpDrive direct IO that
+ * is resent to the volume keeps its queue.
+ */
+static inline u8
+_base_get_msix_index_scsiio(struct MPT2SAS_ADAPTER *ioc, u16 smid)
+{
+	struct scsiio_tracker *st = &ioc->scsi_lookup[smid - 1];
+	struct MPT2SAS_DEVICE *sas_device_priv_data;
+	struct adapter_reply_queue *reply_q;
+	u8 nr_poll_reply_q;
+
+	if (st->poll_q)
+		return st->poll_q->msix_index;
+	/* _base_free_irq() may clear it under us, read it once */
+	nr_poll_reply_q = ACCESS_ONCE(ioc->nr_poll_reply_q);
+	if (!nr_poll_reply_q || !st->scmd)
+		return _base_get_msix_index(ioc);
+	sas_device_priv_data = st->scmd->device->hostdata;
+	if (!sas_device_priv_data || !sas_device_priv_data->io_poll)
+		return _base_get_msix_index(ioc);
+
+	reply_q = ioc->poll_reply_q[raw_smp_processor_id() % nr_poll_reply_q];
+	st->poll_q = reply_q;
+	if (atomic_inc_return(&reply_q->pending) == 1)
+		wake_up(&reply_q->poll_wq);
+	return reply_q->msix_index;
+}
+
 /**
  * mpt2sas_base_put_smid_scsi_io - send SCSI_IO request to firmware
  * @ioc: per adapter object
@@ -1833,7 +1995,7 @@ mpt2sas_base_put_smid_scsi_io(struct MPT2SAS_ADAPTER *ioc, u16 smid, u16 handle)
 
 
 	descriptor.SCSIIO.RequestFlags = MPI2_REQ_DESCRIPT_FLAGS_SCSI_IO;
-	descriptor.SCSIIO.MSIxIndex =  _base_get_msix_index(ioc);
+	descriptor.SCSIIO.MSIxIndex = _base_get_msix_index_scsiio(ioc, smid);
 	descriptor.SCSIIO.SMID = cpu_to_le16(smid);
 	descriptor.SCSIIO.DevHandle = cpu_to_le16(handle);
 	descriptor.SCSIIO.LMID = 0;
@@ -2403,6 +2565,10 @@ _base_release_memory_pools(struct MPT2SAS_ADAPTER *ioc)
 		free_pages((ulong)ioc->scsi_lookup, ioc->scsi_lookup_pages);
 		ioc->scsi_lookup = NULL;
 	}
+	kfree(ioc->scsiio_bitmap);
+	ioc->scsiio_bitmap = NULL;
+	free_percpu(ioc->scsiio_smid_hint);
+	ioc->scsiio_smid_hint = NULL;
 	kfree(ioc->hpr_lookup);
 	kfree(ioc->internal_lookup);
 	if (ioc->chain_lookup) {
@@ -2607,6 +2773,19 @@ _base_allocate_memory_pools(struct MPT2SAS_ADAPTER *ioc,  int sleep_flag)
 	    "depth(%d)\n", ioc->name, ioc->request,
 	    ioc->scsiio_depth));
 
+	ioc->scsiio_bitmap = kcalloc(BITS_TO_LONGS(ioc->scsiio_depth),
+	    sizeof(unsigned long), GFP_KERNEL);
+	ioc->scsiio_smid_hint = alloc_percpu(unsigned int);
+	if (!ioc->scsiio_bitmap || !ioc->scsiio_smid_hint) {
+		printk(MPT2SAS_ERR_FMT "scsiio_bitmap: allocation failed\n",
+		    ioc->name);
+		goto out;
+	}
+	/* spread the cpus' starting points over the smids */
+	for_each_possible_cpu(i)
+		*per_cpu_ptr(ioc->scsiio_smid_hint, i) =
+		    (i * ioc->scsiio_depth) / nr_cpu_ids;
+
 	ioc->chain_depth = min_t(u32, ioc->chain_depth, MAX_CHAIN_DEPTH);
 	sz = ioc->chain_depth * sizeof(struct chain_tracker);
 	ioc->chain_pages = get_order(sz);
@@ -4093,9 +4272,9 @@ _base_make_ioc_operational(struct MPT2SAS_ADAPTER *ioc, int sleep_flag)
 		kfree(delayed_tr);
 	}
 
-	/* initialize the scsi lookup free list */
+	/* initialize the scsi lookup, every smid free */
 	spin_lock_irqsave(&ioc->scsi_lookup_lock, flags);
-	INIT_LIST_HEAD(&ioc->free_list);
+	bitmap_zero(ioc->scsiio_bitmap, ioc->scsiio_depth);
 	smid = 1;
 	for (i = 0; i < ioc->scsiio_depth; i++, smid++) {
 		INIT_LIST_HEAD(&ioc->scsi_lookup[i].chain_list);
@@ -4103,8 +4282,7 @@ _base_make_ioc_operational(struct MPT2SAS_ADAPTER *ioc, int sleep_flag)
 		ioc->scsi_lookup[i].smid = smid;
 		ioc->scsi_lookup[i].scmd = NULL;
 		ioc->scsi_lookup[i].direct_io = 0;
-		list_add_tail(&ioc->scsi_lookup[i].tracker_list,
-		    &ioc->free_list);
+		ioc->scsi_lookup[i].poll_q = NULL;
 	}
 
 	/* hi-priority queue */
@@ -4144,6 +4322,7 @@ _base_make_ioc_operational(struct MPT2SAS_ADAPTER *ioc, int sleep_flag)
 	/* initialize reply queues */
 	if (ioc->is_driver_loading)
 		_base_assign_reply_queues(ioc);
+	_base_start_poll_queues(ioc);
 
 	/* initialize Reply Post Free Queue */
 	reply_post_free = (long)ioc->reply_post_free;
@@ -100,6 +100,7 @@
 #define MPT2SAS_SATA_QUEUE_DEPTH	32
 #define MPT2SAS_SAS_QUEUE_DEPTH		254
 #define MPT2SAS_RAID_QUEUE_DEPTH	128
+#define MPT2SAS_MAX_POLL_QUEUES		8
 
 #define MPT_NAME_LENGTH			32	/* generic length of strings */
 #define MPT_STRING_LENGTH		64
@@ -267,6 +268,7 @@ struct MPT2SAS_TARGET {
  * @configured_lun: lun is configured
  * @block: device is in SDEV_BLOCK state
  * @tlr_snoop_check: flag used in determining whether to disable TLR
+ * @io_poll: complete IO on a polled reply queue (latency sensitive LUN)
  */
 
 /* OEM Identifiers */
@@ -313,6 +315,7 @@ struct MPT2SAS_DEVICE {
 	u8	configured_lun;
 	u8	block;
 	u8	tlr_snoop_check;
+	u8	io_poll;
 };
 
 #define MPT2_CMD_NOT_USED	0x8000	/* free */
@@ -532,7 +535,9 @@ struct chain_tracker {
  * @cb_idx: callback index
  * @direct_io: To indicate whether I/O is direct (WARPDRIVE)
  * @chain_list: list of chains associated to this IO
- * @tracker_list: list of free request (ioc->free_list)
+ * @poll_q: polled reply queue the request was posted to, if any
+ *
+ * Owned by whoever holds the smid's bit in ioc->scsiio_bitmap.
  */
 struct scsiio_tracker {
 	u16	smid;
@@ -540,7 +545,7 @@ struct scsiio_tracker {
 	u8	cb_idx;
 	u8	direct_io;
 	struct list_head chain_list;
-	struct list_head tracker_list;
+	struct adapter_reply_queue *poll_q;
 };
 
 /**
@@ -577,6 +582,9 @@ typedef void (*MPT_ADD_SGE)(void *paddr, u32 flags_length, dma_addr_t dma_addr);
  * @reply_post_free: reply post base virt address
  * @name: the name registered to request_irq()
  * @busy: isr is actively processing replies on another cpu
+ * @pending: SCSI IOs outstanding on a polled queue
+ * @poll_task: kthread servicing the queue instead of its interrupt
+ * @poll_wq: where @poll_task sleeps while nothing is pending
  * @list: this list
 */
 struct adapter_reply_queue {
@@ -587,6 +595,9 @@ struct adapter_reply_queue {
 	Mpi2ReplyDescriptorsUnion_t *reply_post_free;
 	char			name[MPT_NAME_LENGTH];
 	atomic_t		busy;
+	atomic_t		pending;
+	struct task_struct	*poll_task;
+	wait_queue_head_t	poll_wq;
 	struct list_head	list;
 };
 
@@ -744,7 +755,8 @@ typedef void (*MPT2SAS_FLUSH_RUNNING_CMDS)(struct MPT2SAS_ADAPTER *ioc);
  * @request_dma_sz:
  * @scsi_lookup: firmware request tracker list
  * @scsi_lookup_lock:
- * @free_list: free list of request
+ * @scsiio_bitmap: smids in use, bit n is smid n + 1
+ * @scsiio_smid_hint: per cpu position to start the next smid search at
  * @chain: pool of chains
  * @pending_io_count:
  * @reset_wq:
@@ -784,6 +796,9 @@ typedef void (*MPT2SAS_FLUSH_RUNNING_CMDS)(struct MPT2SAS_ADAPTER *ioc);
  * @reply_post_free_dma:
  * @reply_queue_count: number of reply queue's
  * @reply_queue_list: link list contaning the reply queue info
+ * @poll_queues: reply queues set aside for polling, the highest msix indexes
+ * @nr_poll_reply_q: entries of @poll_reply_q with a running poller
+ * @poll_reply_q: the polled reply queues
  * @reply_post_host_index: head index in the pool where FW completes IO
  * @delayed_tr_list: target reset link list
  * @delayed_tr_volume_list: volume target reset link list
@@ -920,7 +935,8 @@ struct MPT2SAS_ADAPTER {
 	struct scsiio_tracker *scsi_lookup;
 	ulong		scsi_lookup_pages;
 	spinlock_t 	scsi_lookup_lock;
-	struct list_head free_list;
+	unsigned long	*scsiio_bitmap;
+	unsigned int __percpu *scsiio_smid_hint;
 	int		pending_io_count;
 	wait_queue_head_t reset_wq;
 
@@ -978,6 +994,9 @@ struct MPT2SAS_ADAPTER {
 	struct dma_pool *reply_post_free_dma_pool;
 	u8		reply_queue_count;
 	struct list_head reply_queue_list;
+	u8		poll_queues;
+	u8		nr_poll_reply_q;
+	struct adapter_reply_queue *poll_reply_q[MPT2SAS_MAX_POLL_QUEUES];
 
 	struct list_head delayed_tr_list;
 	struct list_head delayed_tr_volume_list;
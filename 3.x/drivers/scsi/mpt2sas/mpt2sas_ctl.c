@@ -3005,9 +3005,50 @@ _ctl_device_handle_show(struct device *dev, struct device_attribute *attr,
 }
 static DEVICE_ATTR(sas_device_handle, S_IRUGO, _ctl_device_handle_show, NULL);
 
+/**
+ * _ctl_device_io_poll_show - show/store io_poll
+ * @cdev - pointer to embedded class device
+ * @buf - the buffer returned
+ *
+ * When set, IO to this LUN completes on a polled reply queue (see the
+ * poll_queues module parameter) instead of by interrupt.
+ *
+ * A sysfs 'read/write' sdev attribute.
+ */
+static ssize_t
+_ctl_device_io_poll_show(struct device *dev, struct device_attribute *attr,
+    char *buf)
+{
+	struct scsi_device *sdev = to_scsi_device(dev);
+	struct MPT2SAS_DEVICE *sas_device_priv_data = sdev->hostdata;
+
+	return snprintf(buf, PAGE_SIZE, "%d\n", sas_device_priv_data->io_poll);
+}
+static ssize_t
+_ctl_device_io_poll_store(struct device *dev, struct device_attribute *attr,
+    const char *buf, size_t count)
+{
+	struct scsi_device *sdev = to_scsi_device(dev);
+	struct MPT2SAS_DEVICE *sas_device_priv_data = sdev->hostdata;
+	struct MPT2SAS_ADAPTER *ioc = shost_priv(sdev->host);
+	int val = 0;
+
+	if (sscanf(buf, "%d", &val) != 1)
+		return -EINVAL;
+
+	sas_device_priv_data->io_poll = val ? 1 : 0;
+	if (val && !ioc->nr_poll_reply_q)
+		sdev_printk(KERN_INFO, sdev,
+		    "io_poll set, but no reply queue is polled\n");
+	return strlen(buf);
+}
+static DEVICE_ATTR(io_poll, S_IRUGO | S_IWUSR, _ctl_device_io_poll_show,
+    _ctl_device_io_poll_store);
+
 struct device_attribute *mpt2sas_dev_attrs[] = {
 	&dev_attr_sas_address,
 	&dev_attr_sas_device_handle,
+	&dev_attr_io_poll,
 	NULL,
 };
 
@@ -892,20 +892,13 @@ _scsih_scsi_lookup_get(struct MPT2SAS_ADAPTER *ioc, u16 smid)
  * @smid: system request message index
  *
  * Returns the smid stored scmd pointer.
- * Then will derefrence the stored scmd pointer.
+ * Then will derefrence the stored scmd pointer.  The exchange makes sure
+ * only one of the completion and the flush paths gets the scmd.
  */
 static inline struct scsi_cmnd *
 _scsih_scsi_lookup_get_clear(struct MPT2SAS_ADAPTER *ioc, u16 smid)
 {
-	unsigned long flags;
-	struct scsi_cmnd *scmd;
-
-	spin_lock_irqsave(&ioc->scsi_lookup_lock, flags);
-	scmd = ioc->scsi_lookup[smid - 1].scmd;
-	ioc->scsi_lookup[smid - 1].scmd = NULL;
-	spin_unlock_irqrestore(&ioc->scsi_lookup_lock, flags);
-
-	return scmd;
+	return xchg(&ioc->scsi_lookup[smid - 1].scmd, NULL);
 }
 
 /**
@@ -3945,9 +3938,10 @@ static inline bool ata_12_16_cmd(struct scsi_cmnd *scmd)
 
 /**
  * _scsih_qcmd - main scsi request entry point
+ * @shost: SCSI host pointer
  * @scmd: pointer to scsi command object
- * @done: function pointer to be invoked on completion
  *
+ * Called without the host lock; the smid allocation is lockless.
  * The callback index is set inside `ioc->scsi_io_cb_idx`.
  *
  * Returns 0 on success.  If there's a failure, return either:
@@ -3955,9 +3949,9 @@ static inline bool ata_12_16_cmd(struct scsi_cmnd *scmd)
  * SCSI_MLQUEUE_HOST_BUSY if the entire host queue is full
  */
 static int
-_scsih_qcmd_lck(struct scsi_cmnd *scmd, void (*done)(struct scsi_cmnd *))
+_scsih_qcmd(struct Scsi_Host *shost, struct scsi_cmnd *scmd)
 {
-	struct MPT2SAS_ADAPTER *ioc = shost_priv(scmd->device->host);
+	struct MPT2SAS_ADAPTER *ioc = shost_priv(shost);
 	struct MPT2SAS_DEVICE *sas_device_priv_data;
 	struct MPT2SAS_TARGET *sas_target_priv_data;
 	struct _raid_device *raid_device;
@@ -3972,7 +3966,6 @@ _scsih_qcmd_lck(struct scsi_cmnd *scmd, void (*done)(struct scsi_cmnd *))
 	if (ata_12_16_cmd(scmd))
 		scsi_internal_device_block(scmd->device);
 
-	scmd->scsi_done = done;
 	sas_device_priv_data = scmd->device->hostdata;
 	if (!sas_device_priv_data || !sas_device_priv_data->sas_target) {
 		scmd->result = DID_NO_CONNECT << 16;
@@ -4092,8 +4085,6 @@ _scsih_qcmd_lck(struct scsi_cmnd *scmd, void (*done)(struct scsi_cmnd *))
 	return SCSI_MLQUEUE_HOST_BUSY;
 }
 
-static DEF_SCSI_QCMD(_scsih_qcmd)
-
 /**
  * _scsih_normalize_sense - normalize descriptor and fixed format sense data
  * @sense_buffer: sense data returned by target
@@ -283,6 +283,8 @@
 #include <linux/blkdev.h>
 #include <linux/times.h>
 
+#include <scsi/scsi_cmnd.h>
+
 #include <asm/uaccess.h>
 
 /* used to tell the module to turn on full debugging messages */
@@ -295,12 +297,15 @@ static bool lockdoor = 1;
 static bool check_media_type;
 /* automatically restart mrw format */
 static bool mrw_format_restart = 1;
+/* READ CD requests kept in flight by a single CDDA read */
+static int cdda_depth = 4;
 module_param(debug, bool, 0);
 module_param(autoclose, bool, 0);
 module_param(autoeject, bool, 0);
 module_param(lockdoor, bool, 0);
 module_param(check_media_type, bool, 0);
 module_param(mrw_format_restart, bool, 0);
+module_param(cdda_depth, int, 0);
 
 static DEFINE_MUTEX(cdrom_mutex);
 
@@ -2155,75 +2160,153 @@ static int cdrom_read_cdda_old(struct cdrom_device_info *cdi, __u8 __user *ubuf,
 	return ret;
 }
 
+#define CDDA_MAX_DEPTH	16
+
+/*
+ * One READ CD of a pipelined CDDA read.  The sense buffer has to live
+ * here, blk_execute_rq() would otherwise have provided it on its stack.
+ */
+struct cdda_req {
+	struct request *rq;
+	struct bio *bio;
+	struct completion wait;
+	int error;
+	unsigned char sense[SCSI_SENSE_BUFFERSIZE];
+};
+
+static void cdrom_cdda_end_io(struct request *rq, int error)
+{
+	struct cdda_req *creq = rq->end_io_data;
+
+	creq->error = rq->errors ? -EIO : error;
+	complete(&creq->wait);
+}
+
+static int cdrom_cdda_submit(struct cdrom_device_info *cdi,
+			     struct cdda_req *creq, __u8 __user *ubuf,
+			     int lba, int nr)
+{
+	struct request_queue *q = cdi->disk->queue;
+	struct request *rq;
+	int ret;
+
+	rq = blk_get_request(q, READ, GFP_KERNEL);
+	if (IS_ERR(rq))
+		return PTR_ERR(rq);
+	blk_rq_set_block_pc(rq);
+
+	ret = blk_rq_map_user(q, rq, NULL, ubuf, nr * CD_FRAMESIZE_RAW,
+			      GFP_KERNEL);
+	if (ret) {
+		blk_put_request(rq);
+		return ret;
+	}
+
+	rq->cmd[0] = GPCMD_READ_CD;
+	rq->cmd[1] = 1 << 2;
+	rq->cmd[2] = (lba >> 24) & 0xff;
+	rq->cmd[3] = (lba >> 16) & 0xff;
+	rq->cmd[4] = (lba >>  8) & 0xff;
+	rq->cmd[5] = lba & 0xff;
+	rq->cmd[6] = (nr >> 16) & 0xff;
+	rq->cmd[7] = (nr >>  8) & 0xff;
+	rq->cmd[8] = nr & 0xff;
+	rq->cmd[9] = 0xf8;
+
+	rq->cmd_len = 12;
+	rq->timeout = 60 * HZ;
+	memset(creq->sense, 0, sizeof(creq->sense));
+	rq->sense = creq->sense;
+	rq->sense_len = 0;
+	rq->end_io_data = creq;
+
+	creq->rq = rq;
+	creq->bio = rq->bio;
+	creq->error = 0;
+	init_completion(&creq->wait);
+
+	blk_execute_rq_nowait(q, cdi->disk, rq, 0, cdrom_cdda_end_io);
+	return 0;
+}
+
+static int cdrom_cdda_reap(struct cdrom_device_info *cdi,
+			   struct cdda_req *creq)
+{
+	int ret = 0;
+
+	wait_for_completion_io(&creq->wait);
+
+	if (creq->error) {
+		struct request_sense *s = (struct request_sense *)creq->sense;
+
+		ret = -EIO;
+		/* the first failure is the one the fallback logic wants */
+		if (!cdi->last_sense)
+			cdi->last_sense = s->sense_key;
+	}
+
+	if (blk_rq_unmap_user(creq->bio))
+		ret = -EFAULT;
+	blk_put_request(creq->rq);
+
+	return ret;
+}
+
+/*
+ * Read nframes of audio straight into the user buffer.  The range is cut
+ * into READ CD requests as large as the queue allows (single frames once
+ * we've dropped to CDDA_BPC_SINGLE), and up to cdda_depth of them are
+ * queued at once, so the next command is already waiting when the drive
+ * finishes the previous one.  On error nothing new is issued, the ones
+ * in flight are drained, and the first error is returned.
+ */
 static int cdrom_read_cdda_bpc(struct cdrom_device_info *cdi, __u8 __user *ubuf,
 			       int lba, int nframes)
 {
 	struct request_queue *q = cdi->disk->queue;
-	struct request *rq;
-	struct bio *bio;
-	unsigned int len;
-	int nr, ret = 0;
+	struct cdda_req *creqs;
+	unsigned int head = 0, tail = 0;
+	int depth, max_nr, nr, err, ret = 0;
 
 	if (!q)
 		return -ENXIO;
 
 	cdi->last_sense = 0;
 
-	while (nframes) {
-		nr = nframes;
-		if (cdi->cdda_method == CDDA_BPC_SINGLE)
-			nr = 1;
-		if (nr * CD_FRAMESIZE_RAW > (queue_max_sectors(q) << 9))
-			nr = (queue_max_sectors(q) << 9) / CD_FRAMESIZE_RAW;
-
-		len = nr * CD_FRAMESIZE_RAW;
+	max_nr = (queue_max_sectors(q) << 9) / CD_FRAMESIZE_RAW;
+	if (cdi->cdda_method == CDDA_BPC_SINGLE || !max_nr)
+		max_nr = 1;
 
-		rq = blk_get_request(q, READ, GFP_KERNEL);
-		if (IS_ERR(rq)) {
-			ret = PTR_ERR(rq);
-			break;
-		}
-		blk_rq_set_block_pc(rq);
+	depth = clamp(cdda_depth, 1, CDDA_MAX_DEPTH);
+	depth = min(depth, DIV_ROUND_UP(nframes, max_nr));
 
-		ret = blk_rq_map_user(q, rq, NULL, ubuf, len, GFP_KERNEL);
-		if (ret) {
-			blk_put_request(rq);
-			break;
-		}
+	creqs = kcalloc(depth, sizeof(*creqs), GFP_KERNEL);
+	if (!creqs)
+		return -ENOMEM;
 
-		rq->cmd[0] = GPCMD_READ_CD;
-		rq->cmd[1] = 1 << 2;
-		rq->cmd[2] = (lba >> 24) & 0xff;
-		rq->cmd[3] = (lba >> 16) & 0xff;
-		rq->cmd[4] = (lba >>  8) & 0xff;
-		rq->cmd[5] = lba & 0xff;
-		rq->cmd[6] = (nr >> 16) & 0xff;
-		rq->cmd[7] = (nr >>  8) & 0xff;
-		rq->cmd[8] = nr & 0xff;
-		rq->cmd[9] = 0xf8;
-
-		rq->cmd_len = 12;
-		rq->timeout = 60 * HZ;
-		bio = rq->bio;
-
-		if (blk_execute_rq(q, cdi->disk, rq, 0)) {
-			struct request_sense *s = rq->sense;
-			ret = -EIO;
-			cdi->last_sense = s->sense_key;
+	for (;;) {
+		while (!ret && nframes && head - tail < depth) {
+			nr = min(nframes, max_nr);
+			ret = cdrom_cdda_submit(cdi, &creqs[head % depth],
+						ubuf, lba, nr);
+			if (ret)
+				break;
+
+			head++;
+			nframes -= nr;
+			lba += nr;
+			ubuf += nr * CD_FRAMESIZE_RAW;
 		}
 
-		if (blk_rq_unmap_user(bio))
-			ret = -EFAULT;
-		blk_put_request(rq);
-
-		if (ret)
+		if (tail == head)
 			break;
 
-		nframes -= nr;
-		lba += nr;
-		ubuf += len;
+		err = cdrom_cdda_reap(cdi, &creqs[tail++ % depth]);
+		if (err && !ret)
+			ret = err;
 	}
 
+	kfree(creqs);
 	return ret;
 }
 
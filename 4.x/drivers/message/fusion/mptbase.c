@@ -943,6 +943,95 @@ mpt_get_msg_frame(u8 cb_idx, MPT_ADAPTER *ioc)
 	return mf;
 }
 
+/*=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=*/
+/**
+ *	mpt_get_tagged_msg_frame - Obtain the MPT request frame owned by a tag
+ *	@cb_idx: Handle of registered MPT protocol driver
+ *	@ioc: Pointer to MPT adapter structure
+ *	@tag: Block layer tag of the request being issued
+ *
+ *	Once mpt_reserve_tag_frames() has carved frames out of the FreeQ,
+ *	each block layer tag maps 1:1 onto one of them, so SCSI I/O gets its
+ *	frame without touching FreeQlock.  Falls back to the FreeQ when no
+ *	frames are reserved (legacy request path) or @tag is out of range.
+ *
+ *	Returns pointer to a MPT request frame or %NULL if none are available
+ *	or IOC is not active.
+ */
+MPT_FRAME_HDR*
+mpt_get_tagged_msg_frame(u8 cb_idx, MPT_ADAPTER *ioc, int tag)
+{
+	MPT_FRAME_HDR *mf;
+	u16	 req_idx;	/* Request index */
+
+	if (tag < 0 || tag >= ioc->tag_frames)
+		return mpt_get_msg_frame(cb_idx, ioc);
+
+	/* If interrupts are not attached, do not return a request frame */
+	if (!ioc->active)
+		return NULL;
+
+	req_idx = MPT_TAG_FRAME_BASE(ioc) + tag;
+	mf = MPT_INDEX_2_MFPTR(ioc, req_idx);
+	mf->u.frame.linkage.arg1 = 0;
+	mf->u.frame.hwhdr.msgctxu.fld.cb_idx = cb_idx;	/* byte */
+	mf->u.frame.hwhdr.msgctxu.fld.req_idx = cpu_to_le16(req_idx);
+	mf->u.frame.hwhdr.msgctxu.fld.rsvd = 0;
+	/* Default, will be changed if necessary in SG generation */
+	ioc->RequestNB[req_idx] = ioc->NB_for_64_byte_frame;
+
+	dmfprintk(ioc, printk(MYIOC_s_DEBUG_FMT "mpt_get_tagged_msg_frame(%d,%d), tag=%d got mf=%p\n",
+	    ioc->name, cb_idx, ioc->id, tag, mf));
+	return mf;
+}
+
+/*=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=*/
+/**
+ *	mpt_reserve_tag_frames - Dedicate request frames to block layer tags
+ *	@ioc: Pointer to MPT adapter structure
+ *	@count: Number of tags (the host's can_queue)
+ *
+ *	Removes the top @count request frames from the FreeQ for use by
+ *	mpt_get_tagged_msg_frame().  Only valid when the SCSI host runs on
+ *	blk-mq, where every command carries a unique tag below can_queue.
+ *	Nothing happens if any of those frames is currently outstanding or
+ *	fewer than ten frames would be left for internal requests.
+ *
+ *	Returns 0 on success, -EBUSY otherwise.
+ */
+int
+mpt_reserve_tag_frames(MPT_ADAPTER *ioc, int count)
+{
+	MPT_FRAME_HDR *mf, *next;
+	unsigned long flags;
+	int base = ioc->req_depth - count;
+	int nfree = 0;
+
+	/* keep a few frames for task management, config and ioctl requests */
+	if (count <= 0 || base < 10)
+		return -EINVAL;
+
+	spin_lock_irqsave(&ioc->FreeQlock, flags);
+	list_for_each_entry(mf, &ioc->FreeQ, u.frame.linkage.list)
+		if (MFPTR_2_MPT_INDEX(ioc, mf) >= base)
+			nfree++;
+
+	if (ioc->tag_frames || nfree != count) {
+		spin_unlock_irqrestore(&ioc->FreeQlock, flags);
+		return -EBUSY;
+	}
+
+	list_for_each_entry_safe(mf, next, &ioc->FreeQ, u.frame.linkage.list)
+		if (MFPTR_2_MPT_INDEX(ioc, mf) >= base)
+			list_del(&mf->u.frame.linkage.list);
+	ioc->tag_frames = count;
+	spin_unlock_irqrestore(&ioc->FreeQlock, flags);
+
+	dinitprintk(ioc, printk(MYIOC_s_DEBUG_FMT "reserved %d request frames for tags\n",
+	    ioc->name, count));
+	return 0;
+}
+
 /*=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=*/
 /**
  *	mpt_put_msg_frame - Send a protocol-specific MPT request frame to an IOC
@@ -1018,13 +1107,17 @@ mpt_put_msg_frame_hi_pri(u8 cb_idx, MPT_ADAPTER *ioc, MPT_FRAME_HDR *mf)
  *	@mf: Pointer to MPT request frame
  *
  *	This routine places a MPT request frame back on the MPT adapter's
- *	FreeQ.
+ *	FreeQ.  Frames owned by block layer tags are left alone: the tag is
+ *	already back with the block layer and the frame may be in use again.
  */
 void
 mpt_free_msg_frame(MPT_ADAPTER *ioc, MPT_FRAME_HDR *mf)
 {
 	unsigned long flags;
 
+	if (MFPTR_2_MPT_INDEX(ioc, mf) >= MPT_TAG_FRAME_BASE(ioc))
+		return;
+
 	/*  Put Request back on FreeQ!  */
 	spin_lock_irqsave(&ioc->FreeQlock, flags);
 	if (cpu_to_le32(mf->u.frame.linkage.arg1) == 0xdeadbeaf)
@@ -4533,7 +4626,7 @@ PrimeIocFifos(MPT_ADAPTER *ioc)
 
 		spin_lock_irqsave(&ioc->FreeQlock, flags);
 		INIT_LIST_HEAD(&ioc->FreeQ);
-		for (i = 0; i < ioc->req_depth; i++) {
+		for (i = 0; i < MPT_TAG_FRAME_BASE(ioc); i++) {
 			mf = (MPT_FRAME_HDR *) mem;
 
 			/*  Queue REQUESTs *internally*!  */
@@ -8467,6 +8560,8 @@ EXPORT_SYMBOL(mpt_get_msg_frame);
 EXPORT_SYMBOL(mpt_put_msg_frame);
 EXPORT_SYMBOL(mpt_put_msg_frame_hi_pri);
 EXPORT_SYMBOL(mpt_free_msg_frame);
+EXPORT_SYMBOL(mpt_get_tagged_msg_frame);
+EXPORT_SYMBOL(mpt_reserve_tag_frames);
 EXPORT_SYMBOL(mpt_send_handshake_request);
 EXPORT_SYMBOL(mpt_verify_adapter);
 EXPORT_SYMBOL(mpt_GetIocState);
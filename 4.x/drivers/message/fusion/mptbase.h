@@ -661,6 +661,7 @@ typedef struct _MPT_ADAPTER
 	int			 req_sz;	/* Request frame size (bytes) */
 	spinlock_t		 FreeQlock;
 	struct list_head	 FreeQ;
+	int			 tag_frames;	/* top frames owned by blk-mq tags */
 		/* Pool of SCSI sense buffers for commands coming from
 		 * the SCSI mid-layer.  We have one 256 byte sense buffer
 		 * for each REQ entry.
@@ -776,7 +777,6 @@ typedef struct _MPT_ADAPTER
 	unsigned long		  timeouts;
 
 	struct scsi_cmnd	**ScsiLookup;
-	spinlock_t		  scsi_lookup_lock;
 	u64			dma_mask;
 	u32			  broadcast_aen_busy;
 	char			 reset_work_q_name[MPT_KOBJ_NAME_LEN];
@@ -844,6 +844,10 @@ typedef struct _mpt_sge {
 #define MFPTR_2_MPT_INDEX(ioc,mf) \
 	(int)( ((u8*)mf - (u8*)(ioc)->req_frames) / (ioc)->req_sz )
 
+/* First request frame index handed out by block layer tag, not FreeQ */
+#define MPT_TAG_FRAME_BASE(ioc) \
+	((ioc)->req_depth - (ioc)->tag_frames)
+
 #define MPT_INDEX_2_RFPTR(ioc,idx) \
 	(MPT_FRAME_HDR*)( (u8*)(ioc)->reply_frames + (ioc)->req_sz * (idx) )
 
@@ -924,6 +928,8 @@ extern int	 mpt_device_driver_register(struct mpt_pci_driver * dd_cbfunc, u8 cb_
 extern void	 mpt_device_driver_deregister(u8 cb_idx);
 extern MPT_FRAME_HDR	*mpt_get_msg_frame(u8 cb_idx, MPT_ADAPTER *ioc);
 extern void	 mpt_free_msg_frame(MPT_ADAPTER *ioc, MPT_FRAME_HDR *mf);
+extern MPT_FRAME_HDR	*mpt_get_tagged_msg_frame(u8 cb_idx, MPT_ADAPTER *ioc, int tag);
+extern int	 mpt_reserve_tag_frames(MPT_ADAPTER *ioc, int count);
 extern void	 mpt_put_msg_frame(u8 cb_idx, MPT_ADAPTER *ioc, MPT_FRAME_HDR *mf);
 extern void	 mpt_put_msg_frame_hi_pri(u8 cb_idx, MPT_ADAPTER *ioc, MPT_FRAME_HDR *mf);
 
@@ -5277,7 +5277,6 @@ mptsas_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 		spin_unlock_irqrestore(&ioc->FreeQlock, flags);
 		goto out_mptsas_probe;
 	}
-	spin_lock_init(&ioc->scsi_lookup_lock);
 
 	dprintk(ioc, printk(MYIOC_s_DEBUG_FMT "ScsiLookup @ %p\n",
 		 ioc->name, ioc->ScsiLookup));
@@ -5296,6 +5295,11 @@ mptsas_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 		    ioc, MPI_SAS_OP_CLEAR_ALL_PERSISTENT);
 	}
 
+	/* Let blk-mq tags index request frames directly (mptscsih_qcmd) */
+	if (shost_use_blk_mq(sh) && mpt_reserve_tag_frames(ioc, sh->can_queue))
+		dprintk(ioc, printk(MYIOC_s_DEBUG_FMT
+		    "using FreeQ for SCSI request frames\n", ioc->name));
+
 	error = scsi_add_host(sh, &ioc->pcidev->dev);
 	if (error) {
 		dprintk(ioc, printk(MYIOC_s_ERR_FMT
@@ -1081,11 +1081,9 @@ mptscsih_search_running_cmds(MPT_SCSI_HOST *hd, VirtDevice *vdevice)
 	struct scsi_cmnd *sc;
 	struct scsi_lun  lun;
 	MPT_ADAPTER *ioc = hd->ioc;
-	unsigned long	flags;
 
-	spin_lock_irqsave(&ioc->scsi_lookup_lock, flags);
 	for (ii = 0; ii < ioc->req_depth; ii++) {
-		if ((sc = ioc->ScsiLookup[ii]) != NULL) {
+		if ((sc = READ_ONCE(ioc->ScsiLookup[ii])) != NULL) {
 
 			mf = (SCSIIORequest_t *)MPT_INDEX_2_MFPTR(ioc, ii);
 			if (mf == NULL)
@@ -1106,8 +1104,9 @@ mptscsih_search_running_cmds(MPT_SCSI_HOST *hd, VirtDevice *vdevice)
 
 			if ((unsigned char *)mf != sc->host_scribble)
 				continue;
-			ioc->ScsiLookup[ii] = NULL;
-			spin_unlock_irqrestore(&ioc->scsi_lookup_lock, flags);
+			/* lost a race with the completion path */
+			if (cmpxchg(&ioc->ScsiLookup[ii], sc, NULL) != sc)
+				continue;
 			mptscsih_freeChainBuffers(ioc, ii);
 			mpt_free_msg_frame(ioc, (MPT_FRAME_HDR *)mf);
 			scsi_dma_unmap(sc);
@@ -1119,10 +1118,8 @@ mptscsih_search_running_cmds(MPT_SCSI_HOST *hd, VirtDevice *vdevice)
 			   vdevice->vtarget->channel, vdevice->vtarget->id,
 			   sc, mf, ii));
 			sc->scsi_done(sc);
-			spin_lock_irqsave(&ioc->scsi_lookup_lock, flags);
 		}
 	}
-	spin_unlock_irqrestore(&ioc->scsi_lookup_lock, flags);
 	return;
 }
 
@@ -1336,7 +1333,9 @@ mptscsih_qcmd(struct scsi_cmnd *SCpnt)
 	/*
 	 *  Put together a MPT SCSI request...
 	 */
-	if ((mf = mpt_get_msg_frame(ioc->DoneCtx, ioc)) == NULL) {
+	mf = mpt_get_tagged_msg_frame(ioc->DoneCtx, ioc,
+	    SCpnt->request ? SCpnt->request->tag : -1);
+	if (mf == NULL) {
 		dprintk(ioc, printk(MYIOC_s_WARN_FMT "QueueCmd, no msg frames!!\n",
 				ioc->name));
 		return SCSI_MLQUEUE_HOST_BUSY;
@@ -2471,14 +2470,7 @@ mptscsih_copy_sense_data(struct scsi_cmnd *sc, MPT_SCSI_HOST *hd, MPT_FRAME_HDR
 struct scsi_cmnd *
 mptscsih_get_scsi_lookup(MPT_ADAPTER *ioc, int i)
 {
-	unsigned long	flags;
-	struct scsi_cmnd *scmd;
-
-	spin_lock_irqsave(&ioc->scsi_lookup_lock, flags);
-	scmd = ioc->ScsiLookup[i];
-	spin_unlock_irqrestore(&ioc->scsi_lookup_lock, flags);
-
-	return scmd;
+	return READ_ONCE(ioc->ScsiLookup[i]);
 }
 EXPORT_SYMBOL(mptscsih_get_scsi_lookup);
 
@@ -2487,21 +2479,15 @@ EXPORT_SYMBOL(mptscsih_get_scsi_lookup);
  * @ioc: Pointer to MPT_ADAPTER structure
  * @i: index into the array
  *
- * Returns the scsi_cmd pointer
+ * Returns the scsi_cmd pointer.  Each slot is owned by exactly one
+ * request frame, so a single atomic exchange is enough to make sure only
+ * one of the completion, flush and abort paths claims the command.
  *
  **/
 static struct scsi_cmnd *
 mptscsih_getclear_scsi_lookup(MPT_ADAPTER *ioc, int i)
 {
-	unsigned long	flags;
-	struct scsi_cmnd *scmd;
-
-	spin_lock_irqsave(&ioc->scsi_lookup_lock, flags);
-	scmd = ioc->ScsiLookup[i];
-	ioc->ScsiLookup[i] = NULL;
-	spin_unlock_irqrestore(&ioc->scsi_lookup_lock, flags);
-
-	return scmd;
+	return xchg(&ioc->ScsiLookup[i], NULL);
 }
 
 /**
@@ -2515,35 +2501,33 @@ mptscsih_getclear_scsi_lookup(MPT_ADAPTER *ioc, int i)
 static void
 mptscsih_set_scsi_lookup(MPT_ADAPTER *ioc, int i, struct scsi_cmnd *scmd)
 {
-	unsigned long	flags;
-
-	spin_lock_irqsave(&ioc->scsi_lookup_lock, flags);
-	ioc->ScsiLookup[i] = scmd;
-	spin_unlock_irqrestore(&ioc->scsi_lookup_lock, flags);
+	/* the frame is ours until posted, so no one else can see the slot */
+	WRITE_ONCE(ioc->ScsiLookup[i], scmd);
 }
 
 /**
- * SCPNT_TO_LOOKUP_IDX - searches for a given scmd in the ScsiLookup[] array list
+ * SCPNT_TO_LOOKUP_IDX - finds the ScsiLookup[] index of a given scmd
  * @ioc: Pointer to MPT_ADAPTER structure
  * @sc: scsi_cmnd pointer
+ *
+ * host_scribble holds the request frame while the command is outstanding
+ * and the frame position is the lookup index, so this is O(1).  The slot
+ * is checked to still point at @sc in case the command completed.
  */
 static int
 SCPNT_TO_LOOKUP_IDX(MPT_ADAPTER *ioc, struct scsi_cmnd *sc)
 {
-	unsigned long	flags;
-	int i, index=-1;
+	MPT_FRAME_HDR *mf = (MPT_FRAME_HDR *)READ_ONCE(sc->host_scribble);
+	int i;
 
-	spin_lock_irqsave(&ioc->scsi_lookup_lock, flags);
-	for (i = 0; i < ioc->req_depth; i++) {
-		if (ioc->ScsiLookup[i] == sc) {
-			index = i;
-			goto out;
-		}
-	}
+	if (!mf)
+		return -1;
 
- out:
-	spin_unlock_irqrestore(&ioc->scsi_lookup_lock, flags);
-	return index;
+	i = MFPTR_2_MPT_INDEX(ioc, mf);
+	if (i < 0 || i >= ioc->req_depth)
+		return -1;
+
+	return mptscsih_get_scsi_lookup(ioc, i) == sc ? i : -1;
 }
 
 /*=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=*/
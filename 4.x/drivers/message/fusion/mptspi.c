@@ -1504,7 +1504,6 @@ mptspi_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 		error = -ENOMEM;
 		goto out_mptspi_probe;
 	}
-	spin_lock_init(&ioc->scsi_lookup_lock);
 
 	dprintk(ioc, printk(MYIOC_s_DEBUG_FMT "ScsiLookup @ %p\n",
 		 ioc->name, ioc->ScsiLookup));
@@ -1524,6 +1523,11 @@ mptspi_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 	if (ioc->spi_data.sdp0length != 0)
 		sh->transportt = mptspi_transport_template;
 
+	/* Let blk-mq tags index request frames directly (mptscsih_qcmd) */
+	if (shost_use_blk_mq(sh) && mpt_reserve_tag_frames(ioc, sh->can_queue))
+		dprintk(ioc, printk(MYIOC_s_DEBUG_FMT
+		    "using FreeQ for SCSI request frames\n", ioc->name));
+
 	error = scsi_add_host (sh, &ioc->pcidev->dev);
 	if(error) {
 		dprintk(ioc, printk(MYIOC_s_ERR_FMT
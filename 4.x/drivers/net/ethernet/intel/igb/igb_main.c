@@ -3679,6 +3679,36 @@ void igb_configure_rx_ring(struct igb_adapter *adapter,
 	wr32(E1000_RXDCTL(reg_idx), rxdctl);
 }
 
+/**
+ *  igb_set_rx_buffer_len - pick the Rx buffer layout for a ring
+ *  @adapter: board private structure
+ *  @rx_ring: receive ring to be configured
+ *
+ *  Frames that fit in a single buffer together with the skb headroom
+ *  and shared info are wrapped in place with build_skb(); anything
+ *  larger, or a device with the legacy-rx private flag set, keeps
+ *  copying the header into a freshly allocated skb.
+ **/
+static void igb_set_rx_buffer_len(struct igb_adapter *adapter,
+				  struct igb_ring *rx_ring)
+{
+	clear_ring_build_skb_enabled(rx_ring);
+
+	if (adapter->flags & IGB_FLAG_RX_LEGACY)
+		return;
+
+	/* rx-all sets RCTL.SBP, bad frames may be longer than max_frame_size
+	 * and spill past the tailroom build_skb needs
+	 */
+	if (adapter->netdev->features & NETIF_F_RXALL)
+		return;
+
+	if (adapter->max_frame_size > IGB_MAX_FRAME_BUILD_SKB)
+		return;
+
+	set_ring_build_skb_enabled(rx_ring);
+}
+
 /**
  *  igb_configure_rx - Configure receive Unit after Reset
  *  @adapter: board private structure
@@ -3699,8 +3729,12 @@ static void igb_configure_rx(struct igb_adapter *adapter)
 	/* Setup the HW Rx Head and Tail Descriptor Pointers and
 	 * the Base and Length of the Rx Descriptor Ring
 	 */
-	for (i = 0; i < adapter->num_rx_queues; i++)
-		igb_configure_rx_ring(adapter, adapter->rx_ring[i]);
+	for (i = 0; i < adapter->num_rx_queues; i++) {
+		struct igb_ring *rx_ring = adapter->rx_ring[i];
+
+		igb_set_rx_buffer_len(adapter, rx_ring);
+		igb_configure_rx_ring(adapter, rx_ring);
+	}
 }
 
 /**
@@ -6661,16 +6695,18 @@ static bool igb_add_rx_frag(struct igb_ring *rx_ring,
 			    struct sk_buff *skb)
 {
 	struct page *page = rx_buffer->page;
-	unsigned char *va = page_address(page) + rx_buffer->page_offset;
+	unsigned char *va = page_address(page) + rx_buffer->page_offset +
+			    igb_rx_offset(rx_ring);
 	unsigned int size = le16_to_cpu(rx_desc->wb.upper.length);
 #if (PAGE_SIZE < 8192)
 	unsigned int truesize = IGB_RX_BUFSZ;
 #else
-	unsigned int truesize = SKB_DATA_ALIGN(size);
+	unsigned int truesize = SKB_DATA_ALIGN(igb_rx_offset(rx_ring) + size);
 #endif
 	unsigned int pull_len;
 
-	if (unlikely(skb_is_nonlinear(skb)))
+	/* the head of a build_skb frame already lives in the skb */
+	if (unlikely(skb_is_nonlinear(skb)) || ring_uses_build_skb(rx_ring))
 		goto add_tail_frag;
 
 	if (unlikely(igb_test_staterr(rx_desc, E1000_RXDADV_STAT_TSIP))) {
@@ -6710,12 +6746,50 @@ add_tail_frag:
 	return igb_can_reuse_rx_page(rx_buffer, page, truesize);
 }
 
+/**
+ *  igb_build_skb - wrap an Rx buffer in an sk_buff without copying
+ *  @rx_ring: rx descriptor ring the buffer belongs to
+ *  @rx_buffer: buffer containing the start of the frame
+ *  @rx_desc: descriptor containing length of buffer written by hardware
+ *  @truesize: amount of the page given over to the skb
+ *
+ *  The headroom reserved by igb_rx_offset() in front of the frame and the
+ *  tail of the buffer become the skb head, so the stack sees the whole
+ *  frame in the linear area without a header copy.
+ **/
+static struct sk_buff *igb_build_skb(struct igb_ring *rx_ring,
+				     struct igb_rx_buffer *rx_buffer,
+				     union e1000_adv_rx_desc *rx_desc,
+				     unsigned int truesize)
+{
+	void *va = page_address(rx_buffer->page) + rx_buffer->page_offset;
+	unsigned int size = le16_to_cpu(rx_desc->wb.upper.length);
+	struct sk_buff *skb;
+
+	skb = build_skb(va, truesize);
+	if (unlikely(!skb))
+		return NULL;
+
+	/* update pointers within the skb to store the data */
+	skb_reserve(skb, IGB_SKB_PAD);
+	__skb_put(skb, size);
+
+	/* pull timestamp out of packet data */
+	if (unlikely(igb_test_staterr(rx_desc, E1000_RXDADV_STAT_TSIP))) {
+		igb_ptp_rx_pktstamp(rx_ring->q_vector, skb->data, skb);
+		__skb_pull(skb, IGB_TS_HDR_LEN);
+	}
+
+	return skb;
+}
+
 static struct sk_buff *igb_fetch_rx_buffer(struct igb_ring *rx_ring,
 					   union e1000_adv_rx_desc *rx_desc,
 					   struct sk_buff *skb)
 {
 	struct igb_rx_buffer *rx_buffer;
 	struct page *page;
+	bool reuse;
 
 	rx_buffer = &rx_ring->rx_buffer_info[rx_ring->next_to_clean];
 	page = rx_buffer->page;
@@ -6723,7 +6797,8 @@ static struct sk_buff *igb_fetch_rx_buffer(struct igb_ring *rx_ring,
 
 	if (likely(!skb)) {
 		void *page_addr = page_address(page) +
-				  rx_buffer->page_offset;
+				  rx_buffer->page_offset +
+				  igb_rx_offset(rx_ring);
 
 		/* prefetch first cache line of first page */
 		prefetch(page_addr);
@@ -6731,6 +6806,10 @@ static struct sk_buff *igb_fetch_rx_buffer(struct igb_ring *rx_ring,
 		prefetch(page_addr + L1_CACHE_BYTES);
 #endif
 
+		/* build_skb wraps the buffer once it has been synced */
+		if (ring_uses_build_skb(rx_ring))
+			goto sync_buffer;
+
 		/* allocate a skb to store the frags */
 		skb = napi_alloc_skb(&rx_ring->q_vector->napi, IGB_RX_HDR_LEN);
 		if (unlikely(!skb)) {
@@ -6745,6 +6824,7 @@ static struct sk_buff *igb_fetch_rx_buffer(struct igb_ring *rx_ring,
 		prefetchw(skb->data);
 	}
 
+sync_buffer:
 	/* we are reusing so sync this buffer for CPU use */
 	dma_sync_single_range_for_cpu(rx_ring->dev,
 				      rx_buffer->dma,
@@ -6752,8 +6832,30 @@ static struct sk_buff *igb_fetch_rx_buffer(struct igb_ring *rx_ring,
 				      IGB_RX_BUFSZ,
 				      DMA_FROM_DEVICE);
 
-	/* pull page into skb */
-	if (igb_add_rx_frag(rx_ring, rx_buffer, rx_desc, skb)) {
+	if (!skb) {
+#if (PAGE_SIZE < 8192)
+		unsigned int truesize = IGB_RX_BUFSZ;
+#else
+		unsigned int truesize =
+			SKB_DATA_ALIGN(IGB_SKB_PAD +
+				       le16_to_cpu(rx_desc->wb.upper.length)) +
+			SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
+#endif
+
+		skb = igb_build_skb(rx_ring, rx_buffer, rx_desc, truesize);
+		if (unlikely(!skb)) {
+			rx_ring->rx_stats.alloc_failed++;
+			return NULL;
+		}
+
+		/* the page reference now belongs to the skb head */
+		reuse = igb_can_reuse_rx_page(rx_buffer, page, truesize);
+	} else {
+		/* pull page into skb */
+		reuse = igb_add_rx_frag(rx_ring, rx_buffer, rx_desc, skb);
+	}
+
+	if (reuse) {
 		/* hand second half of page back to the ring */
 		igb_reuse_rx_page(rx_ring, rx_buffer);
 	} else {
@@ -7061,7 +7163,8 @@ void igb_alloc_rx_buffers(struct igb_ring *rx_ring, u16 cleaned_count)
 		/* Refresh the desc even if buffer_addrs didn't change
 		 * because each write-back erases this info.
 		 */
-		rx_desc->read.pkt_addr = cpu_to_le64(bi->dma + bi->page_offset);
+		rx_desc->read.pkt_addr = cpu_to_le64(bi->dma + bi->page_offset +
+						     igb_rx_offset(rx_ring));
 
 		rx_desc++;
 		bi++;
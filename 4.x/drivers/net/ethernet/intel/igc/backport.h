@@ -219,4 +219,40 @@ static inline void __page_frag_cache_drain(struct page *page, unsigned int count
 		// else
 			__free_pages(page, order);
 	}
-}
\ No newline at end of file
+}
+/* The taprio and cbs qdiscs and their offload hooks postdate this
+ * kernel.  Keep the offload descriptors with their upstream layout so the
+ * TSN code reads the same as upstream; igc_tsn.c fills them from sysfs.
+ */
+enum tc_taprio_sched_cmd {
+	TC_TAPRIO_CMD_SET_GATES = 0x00,
+	TC_TAPRIO_CMD_SET_AND_HOLD = 0x01,
+	TC_TAPRIO_CMD_SET_AND_RELEASE = 0x02,
+};
+
+struct tc_taprio_sched_entry {
+	u8 command; /* TC_TAPRIO_CMD_* */
+
+	/* The gate_mask in the offloading side refers to traffic classes */
+	u32 gate_mask;
+	u32 interval;
+};
+
+struct tc_taprio_qopt_offload {
+	u8 enable;
+	ktime_t base_time;
+	u64 cycle_time;
+	u64 cycle_time_extension;
+
+	size_t num_entries;
+	struct tc_taprio_sched_entry entries[0];
+};
+
+struct tc_cbs_qopt_offload {
+	u8 enable;
+	s32 queue;
+	s32 hicredit;
+	s32 locredit;
+	s32 idleslope;
+	s32 sendslope;
+};
@@ -40,6 +40,16 @@ struct igc_tx_queue_stats {
 	u64 restart_queue2;
 };
 
+/* What the Tx scheduler would have done with each frame, as evaluated in
+ * software when the TSN software fallback is enabled.
+ */
+struct igc_tsn_sw_stats {
+	u64 in_window;		/* taprio gate open when queued */
+	u64 gate_closed;	/* taprio gate closed, frame would wait */
+	u64 gate_wait_ns;	/* total time until the gate next opens */
+	u64 cbs_throttled;	/* credit negative, shaper would hold */
+};
+
 struct igc_rx_queue_stats {
 	u64 packets;
 	u64 bytes;
@@ -91,6 +101,13 @@ struct igc_ring {
 	u32 start_time;
 	u32 end_time;
 
+	/* CBS parameters */
+	bool cbs_enable;                /* indicates if CBS is enabled */
+	s32 idleslope;                  /* idleSlope in kbps */
+	s32 sendslope;                  /* sendSlope in kbps */
+	s32 hicredit;                   /* hiCredit in bytes */
+	s32 locredit;                   /* loCredit in bytes */
+
 	/* everything past this point are written often */
 	u16 next_to_clean;
 	u16 next_to_use;
@@ -102,6 +119,10 @@ struct igc_ring {
 			struct igc_tx_queue_stats tx_stats;
 			struct u64_stats_sync tx_syncp;
 			struct u64_stats_sync tx_syncp2;
+			/* software TSN fallback, under tx_syncp2 */
+			struct igc_tsn_sw_stats tsn_sw_stats;
+			s64 tsn_sw_credit;	/* CBS credit in bytes */
+			ktime_t tsn_sw_last;	/* last CBS credit update */
 		};
 		/* RX */
 		struct {
@@ -265,6 +286,7 @@ extern char igc_driver_version[];
 #define IGC_FLAG_VLAN_PROMISC		BIT(15)
 #define IGC_FLAG_RX_LEGACY		BIT(16)
 #define IGC_FLAG_TSN_QBV_ENABLED	BIT(17)
+#define IGC_FLAG_TSN_SW_FALLBACK	BIT(18)
 
 #define IGC_FLAG_RSS_FIELD_IPV4_UDP	BIT(6)
 #define IGC_FLAG_RSS_FIELD_IPV6_UDP	BIT(7)
@@ -500,7 +522,8 @@ enum igc_ring_flags_t {
 	IGC_RING_FLAG_RX_SCTP_CSUM,
 	IGC_RING_FLAG_RX_LB_VLAN_BSWAP,
 	IGC_RING_FLAG_TX_CTX_IDX,
-	IGC_RING_FLAG_TX_DETECT_HANG
+	IGC_RING_FLAG_TX_DETECT_HANG,
+	IGC_RING_FLAG_TX_TSN_SW
 };
 
 #define ring_uses_large_buffer(ring) \
@@ -8,6 +8,7 @@
 
 #include "igc.h"
 #include "igc_diag.h"
+#include "igc_tsn.h"
 #include "backport.h"
 #include "backport_overflow.h"
 
@@ -131,6 +132,8 @@ static const char igc_gstrings_test[][ETH_GSTRING_LEN] = {
 static const char igc_priv_flags_strings[][ETH_GSTRING_LEN] = {
 #define IGC_PRIV_FLAGS_LEGACY_RX	BIT(0)
 	"legacy-rx",
+#define IGC_PRIV_FLAGS_TSN_SW_FALLBACK	BIT(1)
+	"tsn-sw-fallback",
 };
 
 #define IGC_PRIV_FLAGS_STR_LEN ARRAY_SIZE(igc_priv_flags_strings)
@@ -1544,14 +1547,26 @@ static u32 igc_ethtool_get_priv_flags(struct net_device *netdev)
 	if (adapter->flags & IGC_FLAG_RX_LEGACY)
 		priv_flags |= IGC_PRIV_FLAGS_LEGACY_RX;
 
+	if (adapter->flags & IGC_FLAG_TSN_SW_FALLBACK)
+		priv_flags |= IGC_PRIV_FLAGS_TSN_SW_FALLBACK;
+
 	return priv_flags;
 }
 
 static int igc_ethtool_set_priv_flags(struct net_device *netdev, u32 priv_flags)
 {
 	struct igc_adapter *adapter = netdev_priv(netdev);
-	unsigned int flags = adapter->flags;
+	bool sw_fallback = priv_flags & IGC_PRIV_FLAGS_TSN_SW_FALLBACK;
+	unsigned int flags;
+
+	/* Moving the Tx schedule between hardware and software needs no
+	 * reset beyond what the TSN code does itself.  That also updates
+	 * the TSN bits in adapter->flags, so do it before copying them.
+	 */
+	if (sw_fallback != !!(adapter->flags & IGC_FLAG_TSN_SW_FALLBACK))
+		igc_tsn_set_sw_fallback(adapter, sw_fallback);
 
+	flags = adapter->flags;
 	flags &= ~IGC_FLAG_RX_LEGACY;
 	if (priv_flags & IGC_PRIV_FLAGS_LEGACY_RX)
 		flags |= IGC_FLAG_RX_LEGACY;
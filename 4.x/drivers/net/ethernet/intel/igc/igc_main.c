@@ -1371,6 +1371,9 @@ static netdev_tx_t igc_xmit_frame_ring(struct sk_buff *skb,
 	first->tx_flags = tx_flags;
 	first->protocol = protocol;
 
+	if (test_bit(IGC_RING_FLAG_TX_TSN_SW, &tx_ring->flags))
+		igc_tsn_sw_xmit(tx_ring, skb);
+
 	tso = igc_tso(tx_ring, first, &hdr_len);
 	if (tso < 0)
 		goto out_drop;
@@ -4668,179 +4671,6 @@ static int igc_ioctl(struct net_device *netdev, struct ifreq *ifr, int cmd)
 	}
 }
 
-static int igc_save_launchtime_params(struct igc_adapter *adapter, int queue,
-				      bool enable)
-{
-	struct igc_ring *ring;
-	int i;
-
-	if (queue < 0 || queue >= adapter->num_tx_queues)
-		return -EINVAL;
-
-	ring = adapter->tx_ring[queue];
-	ring->launchtime_enable = enable;
-
-	if (adapter->base_time.tv64)
-		return 0;
-
-	adapter->cycle_time.tv64 = NSEC_PER_SEC;
-
-	for (i = 0; i < adapter->num_tx_queues; i++) {
-		ring = adapter->tx_ring[i];
-		ring->start_time = 0;
-		ring->end_time = NSEC_PER_SEC;
-	}
-
-	return 0;
-}
-
-static bool is_base_time_past(ktime_t base_time, const struct timespec64 *now)
-{
-	struct timespec64 b;
-
-	b = ktime_to_timespec64(base_time);
-
-	return timespec64_compare(now, &b) > 0;
-}
-
-// static bool validate_schedule(struct igc_adapter *adapter,
-// 			      const struct tc_taprio_qopt_offload *qopt)
-// {
-// 	int queue_uses[IGC_MAX_TX_QUEUES] = { };
-// 	struct timespec64 now;
-// 	size_t n;
-
-// 	if (qopt->cycle_time_extension)
-// 		return false;
-
-// 	igc_ptp_read(adapter, &now);
-
-// 	/* If we program the controller's BASET registers with a time
-// 	 * in the future, it will hold all the packets until that
-// 	 * time, causing a lot of TX Hangs, so to avoid that, we
-// 	 * reject schedules that would start in the future.
-// 	 */
-// 	if (!is_base_time_past(qopt->base_time, &now))
-// 		return false;
-
-// 	for (n = 0; n < qopt->num_entries; n++) {
-// 		const struct tc_taprio_sched_entry *e;
-// 		int i;
-
-// 		e = &qopt->entries[n];
-
-// 		/* i225 only supports "global" frame preemption
-// 		 * settings.
-// 		 */
-// 		if (e->command != TC_TAPRIO_CMD_SET_GATES)
-// 			return false;
-
-// 		for (i = 0; i < IGC_MAX_TX_QUEUES; i++) {
-// 			if (e->gate_mask & BIT(i))
-// 				queue_uses[i]++;
-
-// 			if (queue_uses[i] > 1)
-// 				return false;
-// 		}
-// 	}
-
-// 	return true;
-// }
-
-// static int igc_tsn_enable_launchtime(struct igc_adapter *adapter,
-// 				     struct tc_etf_qopt_offload *qopt)
-// {
-// 	struct igc_hw *hw = &adapter->hw;
-// 	int err;
-
-// 	if (hw->mac.type != igc_i225)
-// 		return -EOPNOTSUPP;
-
-// 	err = igc_save_launchtime_params(adapter, qopt->queue, qopt->enable);
-// 	if (err)
-// 		return err;
-
-// 	return igc_tsn_offload_apply(adapter);
-// }
-
-// static int igc_save_qbv_schedule(struct igc_adapter *adapter,
-// 				 struct tc_taprio_qopt_offload *qopt)
-// {
-// 	u32 start_time = 0, end_time = 0;
-// 	size_t n;
-
-// 	if (!qopt->enable) {
-// 		adapter->base_time = 0;
-// 		return 0;
-// 	}
-
-// 	if (adapter->base_time)
-// 		return -EALREADY;
-
-// 	if (!validate_schedule(adapter, qopt))
-// 		return -EINVAL;
-
-// 	adapter->cycle_time = qopt->cycle_time;
-// 	adapter->base_time = qopt->base_time;
-
-// 	/* FIXME: be a little smarter about cases when the gate for a
-// 	 * queue stays open for more than one entry.
-// 	 */
-// 	for (n = 0; n < qopt->num_entries; n++) {
-// 		struct tc_taprio_sched_entry *e = &qopt->entries[n];
-// 		int i;
-
-// 		end_time += e->interval;
-
-// 		for (i = 0; i < IGC_MAX_TX_QUEUES; i++) {
-// 			struct igc_ring *ring = adapter->tx_ring[i];
-
-// 			if (!(e->gate_mask & BIT(i)))
-// 				continue;
-
-// 			ring->start_time = start_time;
-// 			ring->end_time = end_time;
-// 		}
-
-// 		start_time += e->interval;
-// 	}
-
-// 	return 0;
-// }
-
-// static int igc_tsn_enable_qbv_scheduling(struct igc_adapter *adapter,
-// 					 struct tc_taprio_qopt_offload *qopt)
-// {
-// 	struct igc_hw *hw = &adapter->hw;
-// 	int err;
-
-// 	if (hw->mac.type != igc_i225)
-// 		return -EOPNOTSUPP;
-
-// 	err = igc_save_qbv_schedule(adapter, qopt);
-// 	if (err)
-// 		return err;
-
-// 	return igc_tsn_offload_apply(adapter);
-// }
-
-// static int igc_setup_tc(struct net_device *dev, enum tc_setup_type type,
-// 			void *type_data)
-// {
-// 	struct igc_adapter *adapter = netdev_priv(dev);
-
-// 	switch (type) {
-// 	case TC_SETUP_QDISC_TAPRIO:
-// 		return igc_tsn_enable_qbv_scheduling(adapter, type_data);
-
-// 	case TC_SETUP_QDISC_ETF:
-// 		return igc_tsn_enable_launchtime(adapter, type_data);
-
-// 	default:
-// 		return -EOPNOTSUPP;
-// 	}
-// }
-
 static const struct net_device_ops igc_netdev_ops = {
 	.ndo_open		= igc_open,
 	.ndo_stop		= igc_close,
@@ -4853,7 +4683,6 @@ static const struct net_device_ops igc_netdev_ops = {
 	.ndo_set_features	= igc_set_features,
 	.ndo_features_check	= igc_features_check,
 	.ndo_do_ioctl		= igc_ioctl,
-	// .ndo_setup_tc		= igc_setup_tc,
 };
 
 /* PCIe configuration access */
@@ -5158,6 +4987,9 @@ static int igc_probe(struct pci_dev *pdev,
 	 */
 	igc_get_hw_control(adapter);
 
+	/* taprio/cbs offload requests, see igc_tsn.c */
+	netdev->sysfs_groups[0] = &igc_tsn_attr_group;
+
 	strncpy(netdev->name, "eth%d", IFNAMSIZ);
 	err = register_netdev(netdev);
 	if (err)
@@ -1,8 +1,22 @@
 // SPDX-License-Identifier: GPL-2.0
 /* Copyright (c)  2019 Intel Corporation */
 
+#include <linux/rtnetlink.h>
+
 #include "igc.h"
 #include "igc_tsn.h"
+#include "backport.h"
+
+/* SYSTIM read for the Tx scheduler, serialized against the PTP code */
+static void igc_tsn_read_systim(struct igc_adapter *adapter,
+				struct timespec64 *ts)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&adapter->tmreg_lock, flags);
+	igc_ptp_read(adapter, ts);
+	spin_unlock_irqrestore(&adapter->tmreg_lock, flags);
+}
 
 static bool is_any_launchtime(struct igc_adapter *adapter)
 {
@@ -18,6 +32,26 @@ static bool is_any_launchtime(struct igc_adapter *adapter)
 	return false;
 }
 
+static bool is_cbs_enabled(struct igc_adapter *adapter)
+{
+	int i;
+
+	for (i = 0; i < adapter->num_tx_queues; i++) {
+		struct igc_ring *ring = adapter->tx_ring[i];
+
+		if (ring->cbs_enable)
+			return true;
+	}
+
+	return false;
+}
+
+static bool is_any_tsn_enabled(struct igc_adapter *adapter)
+{
+	return adapter->base_time.tv64 || is_any_launchtime(adapter) ||
+	       is_cbs_enabled(adapter);
+}
+
 /* Returns the TSN specific registers to their default values after
  * TSN offloading is disabled.
  */
@@ -30,8 +64,6 @@ static int igc_tsn_disable_offload(struct igc_adapter *adapter)
 	if (!(adapter->flags & IGC_FLAG_TSN_QBV_ENABLED))
 		return 0;
 
-	adapter->cycle_time.tv64 = 0;
-
 	wr32(IGC_TXPBS, I225_TXPBSIZE_DEFAULT);
 	wr32(IGC_DTXMXPKTSZ, IGC_DTXMXPKTSZ_DEFAULT);
 
@@ -41,15 +73,17 @@ static int igc_tsn_disable_offload(struct igc_adapter *adapter)
 	wr32(IGC_TQAVCTRL, tqavctrl);
 
 	for (i = 0; i < adapter->num_tx_queues; i++) {
-		struct igc_ring *ring = adapter->tx_ring[i];
-
-		ring->start_time = 0;
-		ring->end_time = 0;
-		ring->launchtime_enable = false;
+		u32 tqavcc;
 
 		wr32(IGC_TXQCTL(i), 0);
 		wr32(IGC_STQT(i), 0);
 		wr32(IGC_ENDQT(i), NSEC_PER_SEC);
+
+		tqavcc = rd32(IGC_TQAVCC(i));
+		tqavcc &= ~(IGC_TQAVCC_IDLESLOPE_MASK |
+			    IGC_TQAVCC_KEEP_CREDITS);
+		wr32(IGC_TQAVCC(i), tqavcc);
+		wr32(IGC_TQAVHC(i), 0);
 	}
 
 	wr32(IGC_QBVCYCLET_S, NSEC_PER_SEC);
@@ -60,17 +94,19 @@ static int igc_tsn_disable_offload(struct igc_adapter *adapter)
 	return 0;
 }
 
+/* Programs the whole Tx scheduler from the saved taprio and CBS
+ * parameters.  Called again on every change and after every reset, as
+ * the registers do not survive the latter.
+ */
 static int igc_tsn_enable_offload(struct igc_adapter *adapter)
 {
 	struct igc_hw *hw = &adapter->hw;
 	u32 tqavctrl, baset_l, baset_h;
-	u32 sec, nsec, cycle;
+	struct timespec64 now;
 	ktime_t base_time, systim;
+	u32 cycle;
 	int i;
 
-	if (adapter->flags & IGC_FLAG_TSN_QBV_ENABLED)
-		return 0;
-
 	cycle = adapter->cycle_time.tv64;
 	base_time = adapter->base_time;
 
@@ -88,6 +124,7 @@ static int igc_tsn_enable_offload(struct igc_adapter *adapter)
 	for (i = 0; i < adapter->num_tx_queues; i++) {
 		struct igc_ring *ring = adapter->tx_ring[i];
 		u32 txqctl = 0;
+		u32 tqavcc;
 
 		wr32(IGC_STQT(i), ring->start_time);
 		wr32(IGC_ENDQT(i), ring->end_time);
@@ -105,13 +142,51 @@ static int igc_tsn_enable_offload(struct igc_adapter *adapter)
 		if (ring->launchtime_enable)
 			txqctl |= IGC_TXQCTL_QUEUE_MODE_LAUNCHT;
 
+		if (ring->cbs_enable) {
+			u32 cbs_value;
+
+			if (i == 0)
+				txqctl |= IGC_TXQCTL_QAV_SEL_CBS0;
+			else
+				txqctl |= IGC_TXQCTL_QAV_SEL_CBS1;
+
+			/* The i225 datasheet (7.5.2.7) has TQAVCC.idleSlope
+			 * as link-speed / 100Mbps * 0x7736 * BW * 0.2 / 2.5,
+			 * with BW = idleslope / (link-speed * 1000).  The
+			 * link speed cancels out, leaving
+			 *
+			 *     value = idleslope * 61036 / 2500000
+			 *
+			 * i.e. one unit is ~40.96 kbps.  Round up so the
+			 * queue never gets less bandwidth than requested.
+			 */
+			cbs_value = DIV_ROUND_UP_ULL(ring->idleslope * 61036ULL,
+						     2500000);
+
+			tqavcc = rd32(IGC_TQAVCC(i));
+			tqavcc &= ~IGC_TQAVCC_IDLESLOPE_MASK;
+			tqavcc |= cbs_value | IGC_TQAVCC_KEEP_CREDITS;
+			wr32(IGC_TQAVCC(i), tqavcc);
+
+			wr32(IGC_TQAVHC(i),
+			     0x80000000 + ring->hicredit * 0x7735);
+		} else {
+			/* Disable any CBS for the queue */
+			txqctl &= ~IGC_TXQCTL_QAV_SEL_MASK;
+
+			/* Set idleSlope and hiCredit to zero. */
+			tqavcc = rd32(IGC_TQAVCC(i));
+			tqavcc &= ~(IGC_TQAVCC_IDLESLOPE_MASK |
+				    IGC_TQAVCC_KEEP_CREDITS);
+			wr32(IGC_TQAVCC(i), tqavcc);
+			wr32(IGC_TQAVHC(i), 0);
+		}
+
 		wr32(IGC_TXQCTL(i), txqctl);
 	}
 
-	nsec = rd32(IGC_SYSTIML);
-	sec = rd32(IGC_SYSTIMH);
-
-	systim = ktime_set(sec, nsec);
+	igc_tsn_read_systim(adapter, &now);
+	systim = timespec64_to_ktime(now);
 
 	if (ktime_compare(systim, base_time) > 0) {
 		s64 n;
@@ -131,14 +206,50 @@ static int igc_tsn_enable_offload(struct igc_adapter *adapter)
 	return 0;
 }
 
+/* In software fallback mode the hardware scheduler stays off and each
+ * Tx ring instead runs igc_tsn_sw_xmit() on the frames it queues.  That
+ * runs under the Tx queue lock, so the ring state is switched under it
+ * too.
+ */
+static void igc_tsn_sw_apply(struct igc_adapter *adapter, bool enable)
+{
+	int i;
+
+	for (i = 0; i < adapter->num_tx_queues; i++) {
+		struct igc_ring *ring = adapter->tx_ring[i];
+		struct netdev_queue *txq = txring_txq(ring);
+
+		__netif_tx_lock_bh(txq);
+
+		if (!enable) {
+			clear_bit(IGC_RING_FLAG_TX_TSN_SW, &ring->flags);
+		} else if (!test_bit(IGC_RING_FLAG_TX_TSN_SW, &ring->flags)) {
+			u64_stats_update_begin(&ring->tx_syncp2);
+			memset(&ring->tsn_sw_stats, 0,
+			       sizeof(ring->tsn_sw_stats));
+			ring->tsn_sw_credit = 0;
+			ring->tsn_sw_last = ktime_set(0, 0);
+			u64_stats_update_end(&ring->tx_syncp2);
+
+			set_bit(IGC_RING_FLAG_TX_TSN_SW, &ring->flags);
+		}
+
+		__netif_tx_unlock_bh(txq);
+	}
+}
+
 int igc_tsn_offload_apply(struct igc_adapter *adapter)
 {
-	bool is_any_enabled = adapter->base_time.tv64 || is_any_launchtime(adapter);
+	bool is_any_enabled = is_any_tsn_enabled(adapter);
+	bool sw_fallback = adapter->flags & IGC_FLAG_TSN_SW_FALLBACK;
+
+	igc_tsn_sw_apply(adapter, sw_fallback && is_any_enabled);
 
-	if (!(adapter->flags & IGC_FLAG_TSN_QBV_ENABLED) && !is_any_enabled)
+	if (!(adapter->flags & IGC_FLAG_TSN_QBV_ENABLED) &&
+	    (!is_any_enabled || sw_fallback))
 		return 0;
 
-	if (!is_any_enabled) {
+	if (!is_any_enabled || sw_fallback) {
 		int err = igc_tsn_disable_offload(adapter);
 
 		if (err < 0)
@@ -156,3 +267,541 @@ int igc_tsn_offload_apply(struct igc_adapter *adapter)
 
 	return igc_tsn_enable_offload(adapter);
 }
+
+/**
+ * igc_tsn_set_sw_fallback - Move the Tx schedule between hardware and software
+ * @adapter: board private structure
+ * @enable: true to evaluate the schedule in software
+ *
+ * A taprio base time is a PHC time for the hardware and a CLOCK_TAI time
+ * for the software fallback, so a saved schedule is dropped on the switch.
+ * CBS settings are kept.
+ */
+void igc_tsn_set_sw_fallback(struct igc_adapter *adapter, bool enable)
+{
+	int i;
+
+	if (enable)
+		adapter->flags |= IGC_FLAG_TSN_SW_FALLBACK;
+	else
+		adapter->flags &= ~IGC_FLAG_TSN_SW_FALLBACK;
+
+	if (adapter->base_time.tv64) {
+		netdev_info(adapter->netdev,
+			    "taprio schedule dropped, base time clock changed\n");
+		adapter->base_time.tv64 = 0;
+		adapter->cycle_time.tv64 = NSEC_PER_SEC;
+		for (i = 0; i < adapter->num_tx_queues; i++) {
+			adapter->tx_ring[i]->start_time = 0;
+			adapter->tx_ring[i]->end_time = NSEC_PER_SEC;
+		}
+	}
+
+	igc_tsn_offload_apply(adapter);
+}
+
+/**
+ * igc_tsn_sw_xmit - Evaluate the Tx schedule for a frame in software
+ * @ring: Tx ring the frame is queued on
+ * @skb: frame being transmitted
+ *
+ * Runs the taprio gate and CBS credit checks against the
+ * system TAI clock and records what the hardware scheduler would have done.
+ * The frame itself is sent right away.  Called with the Tx queue lock held.
+ */
+void igc_tsn_sw_xmit(struct igc_ring *ring, struct sk_buff *skb)
+{
+	struct igc_adapter *adapter = netdev_priv(ring->netdev);
+	struct igc_tsn_sw_stats *stats = &ring->tsn_sw_stats;
+	ktime_t now = ktime_get_clocktai();
+	u64 cycle = adapter->cycle_time.tv64;
+
+	u64_stats_update_begin(&ring->tx_syncp2);
+
+	if (adapter->base_time.tv64 && cycle) {
+		s64 offset = ktime_to_ns(ktime_sub(now, adapter->base_time));
+		u64 pos;
+
+		if (offset < 0) {
+			/* schedule has not started yet */
+			stats->gate_closed++;
+			stats->gate_wait_ns += -offset + ring->start_time;
+		} else {
+			div64_u64_rem(offset, cycle, &pos);
+
+			if (pos >= ring->start_time && pos < ring->end_time) {
+				stats->in_window++;
+			} else {
+				stats->gate_closed++;
+				if (pos < ring->start_time)
+					stats->gate_wait_ns +=
+						ring->start_time - pos;
+				else
+					stats->gate_wait_ns +=
+						cycle - pos + ring->start_time;
+			}
+		}
+	}
+
+	if (ring->cbs_enable) {
+		s64 port_rate = (s64)adapter->link_speed * 1000;
+		s64 credit = ring->tsn_sw_credit;
+
+		/* credits grow at idleSlope while frames wait, up to
+		 * hiCredit; idleSlope is in kbps and credits in bytes
+		 */
+		if (ring->tsn_sw_last.tv64) {
+			s64 elapsed = ktime_to_ns(ktime_sub(now,
+							    ring->tsn_sw_last));
+
+			elapsed = min_t(s64, elapsed, NSEC_PER_SEC);
+			credit += div64_s64((s64)ring->idleslope * elapsed,
+					    8 * NSEC_PER_MSEC);
+			credit = min_t(s64, credit, ring->hicredit);
+		}
+
+		/* the shaper would hold the frame until credit is back to
+		 * zero, so carry on from there
+		 */
+		if (credit < 0) {
+			stats->cbs_throttled++;
+			credit = 0;
+		}
+
+		/* and drain at sendSlope for the frame's time on the wire */
+		if (port_rate)
+			credit += div64_s64((s64)skb->len * ring->sendslope,
+					    port_rate);
+		credit = max_t(s64, credit, ring->locredit);
+
+		ring->tsn_sw_credit = credit;
+		ring->tsn_sw_last = now;
+	}
+
+	u64_stats_update_end(&ring->tx_syncp2);
+}
+
+static bool is_base_time_past(ktime_t base_time, const struct timespec64 *now)
+{
+	struct timespec64 b;
+
+	b = ktime_to_timespec64(base_time);
+
+	return timespec64_compare(now, &b) > 0;
+}
+
+static bool validate_schedule(struct igc_adapter *adapter,
+			      const struct tc_taprio_qopt_offload *qopt)
+{
+	int queue_uses[IGC_MAX_TX_QUEUES] = { };
+	struct timespec64 now;
+	u64 total = 0;
+	size_t n;
+
+	if (qopt->cycle_time_extension)
+		return false;
+
+	if (!qopt->cycle_time || qopt->cycle_time > U32_MAX)
+		return false;
+
+	/* If we program the controller's BASET registers with a time
+	 * in the future, it will hold all the packets until that
+	 * time, causing a lot of TX Hangs, so to avoid that, we
+	 * reject schedules that would start in the future.  The
+	 * software fallback has no such restriction.
+	 */
+	if (!(adapter->flags & IGC_FLAG_TSN_SW_FALLBACK)) {
+		igc_tsn_read_systim(adapter, &now);
+
+		if (!is_base_time_past(qopt->base_time, &now))
+			return false;
+	}
+
+	for (n = 0; n < qopt->num_entries; n++) {
+		const struct tc_taprio_sched_entry *e;
+		int i;
+
+		e = &qopt->entries[n];
+
+		/* i225 only supports "global" frame preemption
+		 * settings.
+		 */
+		if (e->command != TC_TAPRIO_CMD_SET_GATES)
+			return false;
+
+		for (i = 0; i < IGC_MAX_TX_QUEUES; i++) {
+			if (e->gate_mask & BIT(i))
+				queue_uses[i]++;
+
+			if (queue_uses[i] > 1)
+				return false;
+		}
+
+		/* the gate windows have to fit in one cycle */
+		total += e->interval;
+		if (total > qopt->cycle_time)
+			return false;
+	}
+
+	return true;
+}
+
+static int igc_save_qbv_schedule(struct igc_adapter *adapter,
+				 struct tc_taprio_qopt_offload *qopt)
+{
+	u32 start_time = 0, end_time = 0;
+	size_t n;
+	int i;
+
+	if (!qopt->enable) {
+		adapter->base_time.tv64 = 0;
+
+		/* leave the gates open for any remaining CBS queues */
+		adapter->cycle_time.tv64 = NSEC_PER_SEC;
+		for (i = 0; i < adapter->num_tx_queues; i++) {
+			adapter->tx_ring[i]->start_time = 0;
+			adapter->tx_ring[i]->end_time = NSEC_PER_SEC;
+		}
+		return 0;
+	}
+
+	if (adapter->base_time.tv64)
+		return -EALREADY;
+
+	if (!validate_schedule(adapter, qopt))
+		return -EINVAL;
+
+	adapter->cycle_time = ns_to_ktime(qopt->cycle_time);
+	adapter->base_time = qopt->base_time;
+
+	/* FIXME: be a little smarter about cases when the gate for a
+	 * queue stays open for more than one entry.
+	 */
+	for (n = 0; n < qopt->num_entries; n++) {
+		struct tc_taprio_sched_entry *e = &qopt->entries[n];
+
+		end_time += e->interval;
+
+		for (i = 0; i < adapter->num_tx_queues; i++) {
+			struct igc_ring *ring = adapter->tx_ring[i];
+
+			if (!(e->gate_mask & BIT(i)))
+				continue;
+
+			ring->start_time = start_time;
+			ring->end_time = end_time;
+		}
+
+		start_time += e->interval;
+	}
+
+	return 0;
+}
+
+static int igc_save_cbs_params(struct igc_adapter *adapter, int queue,
+			       bool enable, int idleslope, int sendslope,
+			       int hicredit, int locredit)
+{
+	bool cbs_status[IGC_MAX_SR_QUEUES] = { false };
+	struct net_device *netdev = adapter->netdev;
+	struct igc_ring *ring;
+	int i;
+
+	/* i225 has two sets of credit-based shaper logic.
+	 * Supporting it only on the top two priority queues
+	 */
+	if (queue < 0 || queue > 1)
+		return -EINVAL;
+
+	ring = adapter->tx_ring[queue];
+
+	for (i = 0; i < IGC_MAX_SR_QUEUES; i++)
+		if (adapter->tx_ring[i])
+			cbs_status[i] = adapter->tx_ring[i]->cbs_enable;
+
+	/* CBS should be enabled on the highest priority queue first in order
+	 * for the CBS algorithm to operate as intended.
+	 */
+	if (enable) {
+		if (queue == 1 && !cbs_status[0]) {
+			netdev_err(netdev,
+				   "Enabling CBS on queue1 before queue0\n");
+			return -EINVAL;
+		}
+	} else {
+		if (queue == 0 && cbs_status[1]) {
+			netdev_err(netdev,
+				   "Disabling CBS on queue0 before queue1\n");
+			return -EINVAL;
+		}
+	}
+
+	ring->cbs_enable = enable;
+	ring->idleslope = idleslope;
+	ring->sendslope = sendslope;
+	ring->hicredit = hicredit;
+	ring->locredit = locredit;
+
+	if (adapter->base_time.tv64)
+		return 0;
+
+	/* no taprio schedule, keep every gate open */
+	adapter->cycle_time.tv64 = NSEC_PER_SEC;
+
+	for (i = 0; i < adapter->num_tx_queues; i++) {
+		ring = adapter->tx_ring[i];
+		ring->start_time = 0;
+		ring->end_time = NSEC_PER_SEC;
+	}
+
+	return 0;
+}
+
+static bool igc_tsn_supported(struct igc_adapter *adapter)
+{
+	return adapter->hw.mac.type == igc_i225 ||
+	       (adapter->flags & IGC_FLAG_TSN_SW_FALLBACK);
+}
+
+int igc_tsn_enable_qbv_scheduling(struct igc_adapter *adapter,
+				  struct tc_taprio_qopt_offload *qopt)
+{
+	int err;
+
+	if (!igc_tsn_supported(adapter))
+		return -EOPNOTSUPP;
+
+	err = igc_save_qbv_schedule(adapter, qopt);
+	if (err)
+		return err;
+
+	return igc_tsn_offload_apply(adapter);
+}
+
+int igc_tsn_enable_cbs(struct igc_adapter *adapter,
+		       struct tc_cbs_qopt_offload *qopt)
+{
+	int err;
+
+	if (!igc_tsn_supported(adapter))
+		return -EOPNOTSUPP;
+
+	if (qopt->queue < 0 || qopt->queue > 1)
+		return -EINVAL;
+
+	err = igc_save_cbs_params(adapter, qopt->queue, qopt->enable,
+				  qopt->idleslope, qopt->sendslope,
+				  qopt->hicredit, qopt->locredit);
+	if (err)
+		return err;
+
+	return igc_tsn_offload_apply(adapter);
+}
+
+/* sysfs front end
+ *
+ * This kernel has neither the taprio and cbs qdiscs nor the ndo_setup_tc
+ * offload hook, so the offload requests are written to
+ * /sys/class/net/<dev>/tsn/ instead, with the parameters tc would pass:
+ *
+ *   taprio:  "<base_time> <cycle_time> <gate_mask>:<interval> ..." | "off"
+ *   cbs:     "<queue> <idleslope> <sendslope> <hicredit> <locredit>"
+ *            | "<queue> off"
+ *
+ * Times are in nanoseconds of the PHC (of CLOCK_TAI with the software
+ * fallback), slopes in kbps and credits in bytes.
+ */
+static ssize_t taprio_show(struct device *dev, struct device_attribute *attr,
+			   char *buf)
+{
+	struct igc_adapter *adapter = netdev_priv(to_net_dev(dev));
+	ssize_t len;
+	int i;
+
+	if (!adapter->base_time.tv64)
+		return sprintf(buf, "off\n");
+
+	len = sprintf(buf, "base_time %lld cycle_time %lld\n",
+		      ktime_to_ns(adapter->base_time),
+		      ktime_to_ns(adapter->cycle_time));
+	for (i = 0; i < adapter->num_tx_queues; i++)
+		len += sprintf(buf + len, "queue %d start %u end %u\n", i,
+			       adapter->tx_ring[i]->start_time,
+			       adapter->tx_ring[i]->end_time);
+
+	return len;
+}
+
+static ssize_t taprio_store(struct device *dev, struct device_attribute *attr,
+			    const char *buf, size_t count)
+{
+	struct igc_adapter *adapter = netdev_priv(to_net_dev(dev));
+	struct tc_taprio_qopt_offload *qopt;
+	char *args, *p, *tok;
+	size_t num_entries = 0;
+	s64 base_time;
+	int err;
+
+	args = kstrndup(buf, count, GFP_KERNEL);
+	if (!args)
+		return -ENOMEM;
+
+	p = strim(args);
+	for (tok = p; (tok = strchr(tok, ':')); tok++)
+		num_entries++;
+
+	qopt = kzalloc(sizeof(*qopt) + num_entries * sizeof(qopt->entries[0]),
+		       GFP_KERNEL);
+	if (!qopt) {
+		err = -ENOMEM;
+		goto out_free_args;
+	}
+
+	if (!strcmp(p, "off")) {
+		qopt->enable = 0;
+	} else {
+		size_t n = 0;
+
+		err = -EINVAL;
+		tok = strsep(&p, " \t");
+		if (!tok || kstrtos64(tok, 0, &base_time) || base_time <= 0)
+			goto out_free;
+		qopt->base_time = ns_to_ktime(base_time);
+
+		tok = strsep(&p, " \t");
+		if (!tok || kstrtou64(tok, 0, &qopt->cycle_time))
+			goto out_free;
+
+		while ((tok = strsep(&p, " \t"))) {
+			struct tc_taprio_sched_entry *e;
+			char *interval;
+
+			if (!*tok)
+				continue;
+
+			interval = strchr(tok, ':');
+			if (!interval || n >= num_entries)
+				goto out_free;
+			*interval++ = '\0';
+
+			e = &qopt->entries[n++];
+			e->command = TC_TAPRIO_CMD_SET_GATES;
+			if (kstrtou32(tok, 0, &e->gate_mask) ||
+			    kstrtou32(interval, 0, &e->interval))
+				goto out_free;
+		}
+
+		if (!n)
+			goto out_free;
+
+		qopt->enable = 1;
+		qopt->num_entries = n;
+	}
+
+	if (!rtnl_trylock()) {
+		err = restart_syscall();
+		goto out_free;
+	}
+	err = igc_tsn_enable_qbv_scheduling(adapter, qopt);
+	rtnl_unlock();
+
+out_free:
+	kfree(qopt);
+out_free_args:
+	kfree(args);
+
+	return err ? err : count;
+}
+static DEVICE_ATTR_RW(taprio);
+
+static ssize_t cbs_show(struct device *dev, struct device_attribute *attr,
+			char *buf)
+{
+	struct igc_adapter *adapter = netdev_priv(to_net_dev(dev));
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < IGC_MAX_SR_QUEUES && i < adapter->num_tx_queues; i++) {
+		struct igc_ring *ring = adapter->tx_ring[i];
+
+		if (!ring->cbs_enable) {
+			len += sprintf(buf + len, "queue %d off\n", i);
+			continue;
+		}
+
+		len += sprintf(buf + len,
+			       "queue %d idleslope %d sendslope %d hicredit %d locredit %d\n",
+			       i, ring->idleslope, ring->sendslope,
+			       ring->hicredit, ring->locredit);
+	}
+
+	return len;
+}
+
+static ssize_t cbs_store(struct device *dev, struct device_attribute *attr,
+			 const char *buf, size_t count)
+{
+	struct igc_adapter *adapter = netdev_priv(to_net_dev(dev));
+	struct tc_cbs_qopt_offload qopt = { };
+	char mode[4];
+	int err;
+
+	if (sscanf(buf, "%d %d %d %d %d", &qopt.queue, &qopt.idleslope,
+		   &qopt.sendslope, &qopt.hicredit, &qopt.locredit) == 5)
+		qopt.enable = 1;
+	else if (sscanf(buf, "%d %3s", &qopt.queue, mode) != 2 ||
+		 strcmp(mode, "off"))
+		return -EINVAL;
+
+	if (qopt.enable &&
+	    (qopt.idleslope <= 0 || qopt.sendslope >= 0 ||
+	     qopt.hicredit < 0 || qopt.locredit > 0))
+		return -EINVAL;
+
+	if (!rtnl_trylock())
+		return restart_syscall();
+	err = igc_tsn_enable_cbs(adapter, &qopt);
+	rtnl_unlock();
+
+	return err ? err : count;
+}
+static DEVICE_ATTR_RW(cbs);
+
+static ssize_t sw_stats_show(struct device *dev, struct device_attribute *attr,
+			     char *buf)
+{
+	struct igc_adapter *adapter = netdev_priv(to_net_dev(dev));
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < adapter->num_tx_queues; i++) {
+		struct igc_ring *ring = adapter->tx_ring[i];
+		struct igc_tsn_sw_stats stats;
+		unsigned int start;
+
+		do {
+			start = u64_stats_fetch_begin_irq(&ring->tx_syncp2);
+			stats = ring->tsn_sw_stats;
+		} while (u64_stats_fetch_retry_irq(&ring->tx_syncp2, start));
+
+		len += sprintf(buf + len,
+			       "queue %d in_window %llu gate_closed %llu gate_wait_ns %llu cbs_throttled %llu\n",
+			       i, stats.in_window, stats.gate_closed,
+			       stats.gate_wait_ns, stats.cbs_throttled);
+	}
+
+	return len;
+}
+static DEVICE_ATTR_RO(sw_stats);
+
+static struct attribute *igc_tsn_attrs[] = {
+	&dev_attr_taprio.attr,
+	&dev_attr_cbs.attr,
+	&dev_attr_sw_stats.attr,
+	NULL,
+};
+
+const struct attribute_group igc_tsn_attr_group = {
+	.name = "tsn",
+	.attrs = igc_tsn_attrs,
+};
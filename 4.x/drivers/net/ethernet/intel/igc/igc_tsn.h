@@ -4,6 +4,17 @@
 #ifndef _IGC_TSN_H_
 #define _IGC_TSN_H_
 
+struct tc_taprio_qopt_offload;
+struct tc_cbs_qopt_offload;
+
+extern const struct attribute_group igc_tsn_attr_group;
+
 int igc_tsn_offload_apply(struct igc_adapter *adapter);
+void igc_tsn_set_sw_fallback(struct igc_adapter *adapter, bool enable);
+int igc_tsn_enable_qbv_scheduling(struct igc_adapter *adapter,
+				  struct tc_taprio_qopt_offload *qopt);
+int igc_tsn_enable_cbs(struct igc_adapter *adapter,
+		       struct tc_cbs_qopt_offload *qopt);
+void igc_tsn_sw_xmit(struct igc_ring *ring, struct sk_buff *skb);
 
-#endif /* _IGC_BASE_H */
+#endif /* _IGC_TSN_H_ */
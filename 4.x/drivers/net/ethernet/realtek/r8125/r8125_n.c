@@ -77,6 +77,10 @@
 #include <linux/mdio.h>
 #endif
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,13,0)
+#include <net/busy_poll.h>
+#endif
+
 #include <asm/io.h>
 #include <asm/irq.h>
 
@@ -379,6 +383,9 @@ static bool rtl8125_clear_phy_mcu_patch_request(struct rtl8125_private *tp);
 #ifdef CONFIG_R8125_NAPI
 static int rtl8125_poll(napi_ptr napi, napi_budget budget);
 #endif
+#ifdef ENABLE_R8125_BUSY_POLL
+static int rtl8125_busy_poll(struct napi_struct *napi);
+#endif
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,20)
 static void rtl8125_reset_task(void *_data);
@@ -13540,6 +13547,9 @@ static const struct net_device_ops rtl8125_netdev_ops = {
 #ifdef CONFIG_NET_POLL_CONTROLLER
         .ndo_poll_controller    = rtl8125_netpoll,
 #endif
+#ifdef ENABLE_R8125_BUSY_POLL
+        .ndo_busy_poll          = rtl8125_busy_poll,
+#endif
 };
 #endif
 
@@ -13746,10 +13756,43 @@ static void rtl8125_del_napi(struct rtl8125_private *tp)
 #if LINUX_VERSION_CODE > KERNEL_VERSION(2,6,0)
         int i;
 
-        for (i = 0; i < tp->irq_nvecs; i++)
+        for (i = 0; i < tp->irq_nvecs; i++) {
+                RTL_NAPI_HASH_DEL(&tp->r8125napi[i].napi);
                 RTL_NAPI_DEL((&tp->r8125napi[i]));
+        }
+#ifdef ENABLE_R8125_BUSY_POLL
+        /* wait for busy pollers still walking the napi hash */
+        synchronize_net();
 #endif
+#endif
+}
+
+#ifdef ENABLE_R8125_BUSY_POLL
+/*
+ * Called by the socket layer with bottom halves disabled.  Borrow the
+ * queue's NAPI context for a short poll; the regular poll routine
+ * completes NAPI and re-arms the interrupt, so only a full budget needs
+ * handing back to softirq.
+ */
+static int rtl8125_busy_poll(struct napi_struct *napi)
+{
+        struct r8125_napi *r8125napi = RTL_GET_PRIV(napi, struct r8125_napi);
+        struct rtl8125_private *tp = r8125napi->priv;
+        int work_done;
+
+        if (!netif_carrier_ok(tp->dev))
+                return LL_FLUSH_FAILED;
+
+        if (!RTL_NETIF_RX_SCHEDULE_PREP(tp->dev, napi))
+                return LL_FLUSH_BUSY;
+
+        work_done = napi->poll(napi, R8125_BUSY_POLL_BUDGET);
+        if (work_done >= R8125_BUSY_POLL_BUDGET)
+                __RTL_NETIF_RX_SCHEDULE(tp->dev, napi);
+
+        return work_done;
 }
+#endif //ENABLE_R8125_BUSY_POLL
 #endif //CONFIG_R8125_NAPI
 
 static void rtl8125_init_napi(struct rtl8125_private *tp)
@@ -13774,6 +13817,7 @@ static void rtl8125_init_napi(struct rtl8125_private *tp)
                 }
 
                 RTL_NAPI_CONFIG(tp->dev, r8125napi, poll, R8125_NAPI_WEIGHT);
+                RTL_NAPI_HASH_ADD(&r8125napi->napi);
 #endif
 
                 r8125napi->priv = tp;
@@ -16379,6 +16423,7 @@ rtl8125_rx_skb(struct rtl8125_private *tp,
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,29)
         netif_receive_skb(skb);
 #else
+        RTL_SKB_MARK_NAPI_ID(skb, &tp->r8125napi[ring_index].napi);
         napi_gro_receive(&tp->r8125napi[ring_index].napi, skb);
 #endif
 #else
@@ -571,6 +571,28 @@ typedef int napi_budget;
 #define RTL_NAPI_DEL(priv)   netif_napi_del(&priv->napi)
 #endif //LINUX_VERSION_CODE < KERNEL_VERSION(2,6,27)
 
+#if defined(CONFIG_R8168_NAPI) && defined(CONFIG_NET_RX_BUSY_POLL)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,13,0)
+#define RTL_SKB_MARK_NAPI_ID(skb, napi)     skb_mark_napi_id(skb, napi)
+#endif
+/* From 4.5 on netif_napi_add() hashes every NAPI and the core busy polls
+ * it directly; before that the driver registers ndo_busy_poll itself. */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,13,0) && LINUX_VERSION_CODE < KERNEL_VERSION(4,5,0)
+#define ENABLE_R8168_BUSY_POLL
+#define R8168_BUSY_POLL_BUDGET    4
+#define RTL_NAPI_HASH_ADD(napi)     napi_hash_add(napi)
+#define RTL_NAPI_HASH_DEL(napi)     napi_hash_del(napi)
+#endif
+#endif //CONFIG_R8168_NAPI && CONFIG_NET_RX_BUSY_POLL
+
+#ifndef RTL_SKB_MARK_NAPI_ID
+#define RTL_SKB_MARK_NAPI_ID(skb, napi)
+#endif
+#ifndef RTL_NAPI_HASH_ADD
+#define RTL_NAPI_HASH_ADD(napi)
+#define RTL_NAPI_HASH_DEL(napi)
+#endif
+
 /*****************************************************************************/
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,9)
 #ifdef __CHECKER__
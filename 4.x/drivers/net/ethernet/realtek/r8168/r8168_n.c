@@ -74,6 +74,10 @@
 #include <linux/mdio.h>
 #endif
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,13,0)
+#include <net/busy_poll.h>
+#endif
+
 #include <asm/io.h>
 #include <asm/irq.h>
 
@@ -468,6 +472,9 @@ static int rtl8168_clear_phy_mcu_patch_request(struct rtl8168_private *tp);
 #ifdef CONFIG_R8168_NAPI
 static int rtl8168_poll(napi_ptr napi, napi_budget budget);
 #endif
+#ifdef ENABLE_R8168_BUSY_POLL
+static int rtl8168_busy_poll(struct napi_struct *napi);
+#endif
 
 #if ((LINUX_VERSION_CODE < KERNEL_VERSION(4,7,0) && \
      LINUX_VERSION_CODE >= KERNEL_VERSION(4,6,00)))
@@ -25776,6 +25783,9 @@ static const struct net_device_ops rtl8168_netdev_ops = {
 #ifdef CONFIG_NET_POLL_CONTROLLER
         .ndo_poll_controller    = rtl8168_netpoll,
 #endif
+#ifdef ENABLE_R8168_BUSY_POLL
+        .ndo_busy_poll          = rtl8168_busy_poll,
+#endif
 };
 #endif
 
@@ -25827,6 +25837,7 @@ rtl8168_init_one(struct pci_dev *pdev,
 
 #ifdef CONFIG_R8168_NAPI
         RTL_NAPI_CONFIG(dev, tp, rtl8168_poll, R8168_NAPI_WEIGHT);
+        RTL_NAPI_HASH_ADD(&tp->napi);
 #endif
 
 #ifdef CONFIG_R8168_VLAN
@@ -25960,7 +25971,11 @@ err_out:
                 tp->tally_vaddr = NULL;
         }
 #ifdef  CONFIG_R8168_NAPI
+        RTL_NAPI_HASH_DEL(&tp->napi);
         RTL_NAPI_DEL(tp);
+#ifdef ENABLE_R8168_BUSY_POLL
+        synchronize_net();
+#endif
 #endif
         rtl8168_disable_msi(pdev, tp);
         rtl8168_release_board(pdev, dev, ioaddr);
@@ -25978,6 +25993,7 @@ rtl8168_remove_one(struct pci_dev *pdev)
         assert(tp != NULL);
 
 #ifdef  CONFIG_R8168_NAPI
+        RTL_NAPI_HASH_DEL(&tp->napi);
         RTL_NAPI_DEL(tp);
 #endif
         if (tp->DASH)
@@ -28370,6 +28386,7 @@ rtl8168_rx_skb(struct rtl8168_private *tp,
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,29)
         netif_receive_skb(skb);
 #else
+        RTL_SKB_MARK_NAPI_ID(skb, &tp->napi);
         napi_gro_receive(&tp->napi, skb);
 #endif
 #else
@@ -28721,6 +28738,32 @@ static int rtl8168_poll(napi_ptr napi, napi_budget budget)
 
         return RTL_NAPI_RETURN_VALUE;
 }
+
+#ifdef ENABLE_R8168_BUSY_POLL
+/*
+ * Called by the socket layer with bottom halves disabled.  Borrow the
+ * NAPI context for a short poll; rtl8168_poll() completes NAPI and
+ * re-arms the interrupt, so only a full budget needs handing back to
+ * softirq.
+ */
+static int rtl8168_busy_poll(struct napi_struct *napi)
+{
+        struct rtl8168_private *tp = RTL_GET_PRIV(napi, struct rtl8168_private);
+        int work_done;
+
+        if (!netif_carrier_ok(tp->dev))
+                return LL_FLUSH_FAILED;
+
+        if (!RTL_NETIF_RX_SCHEDULE_PREP(tp->dev, napi))
+                return LL_FLUSH_BUSY;
+
+        work_done = rtl8168_poll(napi, R8168_BUSY_POLL_BUDGET);
+        if (work_done >= R8168_BUSY_POLL_BUDGET)
+                __RTL_NETIF_RX_SCHEDULE(tp->dev, napi);
+
+        return work_done;
+}
+#endif //ENABLE_R8168_BUSY_POLL
 #endif//CONFIG_R8168_NAPI
 
 static void rtl8168_sleep_rx_enable(struct net_device *dev)
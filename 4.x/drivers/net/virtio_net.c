@@ -27,6 +27,7 @@
 #include <linux/slab.h>
 #include <linux/cpu.h>
 #include <linux/average.h>
+#include <linux/ip.h>
 #include <net/busy_poll.h>
 
 static int napi_weight = NAPI_POLL_WEIGHT;
@@ -60,6 +61,9 @@ DECLARE_EWMA(pkt_len, 1, 64)
 
 #define VIRTNET_DRIVER_VERSION "1.0.0"
 
+/* Number of ethtool ntuple rule locations for the early receive filter. */
+#define VIRTNET_MAX_RX_FILTERS 64
+
 struct virtnet_stats {
 	struct u64_stats_sync tx_syncp;
 	struct u64_stats_sync rx_syncp;
@@ -68,6 +72,21 @@ struct virtnet_stats {
 
 	u64 rx_bytes;
 	u64 rx_packets;
+	u64 rx_filtered;
+};
+
+/*
+ * Early receive filter.  The 4.4 core has no XDP hook, so junk traffic is
+ * dropped with ethtool ntuple rules ("action -1") that are matched against
+ * the raw frame in the receive buffer, before any skb is built for it.
+ * Rules are only changed under rtnl; readers run in NAPI context under
+ * RCU-bh and see either the old or the new table.
+ */
+struct virtnet_rx_filters {
+	struct rcu_head rcu;
+	unsigned int count;
+	DECLARE_BITMAP(used, VIRTNET_MAX_RX_FILTERS);
+	struct ethtool_rx_flow_spec rule[VIRTNET_MAX_RX_FILTERS];
 };
 
 /* Internal representation of a send virtqueue */
@@ -137,6 +156,9 @@ struct virtnet_info {
 	/* Active statistics */
 	struct virtnet_stats __percpu *stats;
 
+	/* Early receive drop rules, NULL if none are installed */
+	struct virtnet_rx_filters __rcu *rx_filters;
+
 	/* Work struct for refilling if we run low on memory. */
 	struct delayed_work refill;
 
@@ -443,6 +465,159 @@ err_buf:
 	return NULL;
 }
 
+static bool virtnet_rx_filter_match(const struct ethtool_rx_flow_spec *fs,
+				    const u8 *data, unsigned int len)
+{
+	const struct ethhdr *eth = (const struct ethhdr *)data;
+	const struct iphdr *iph;
+	const __be32 *l4;
+	unsigned int ihl;
+	u8 proto;
+
+	if (fs->flow_type == ETHER_FLOW) {
+		const struct ethhdr *v = &fs->h_u.ether_spec;
+		const struct ethhdr *m = &fs->m_u.ether_spec;
+		int i;
+
+		for (i = 0; i < ETH_ALEN; i++)
+			if (((eth->h_dest[i] ^ v->h_dest[i]) & m->h_dest[i]) ||
+			    ((eth->h_source[i] ^ v->h_source[i]) &
+			     m->h_source[i]))
+				return false;
+		return !((eth->h_proto ^ v->h_proto) & m->h_proto);
+	}
+
+	if (eth->h_proto != htons(ETH_P_IP) ||
+	    len < ETH_HLEN + sizeof(struct iphdr))
+		return false;
+	iph = (const struct iphdr *)(data + ETH_HLEN);
+	ihl = iph->ihl * 4;
+	if (iph->version != 4 || ihl < sizeof(struct iphdr))
+		return false;
+	/* Ports and L4 bytes only exist in the first fragment. */
+	l4 = NULL;
+	if (len >= ETH_HLEN + ihl + sizeof(*l4) &&
+	    !(iph->frag_off & htons(IP_OFFSET)))
+		l4 = (const __be32 *)((const u8 *)iph + ihl);
+
+	switch (fs->flow_type) {
+	case TCP_V4_FLOW:
+	case UDP_V4_FLOW: {
+		const struct ethtool_tcpip4_spec *v = &fs->h_u.tcp_ip4_spec;
+		const struct ethtool_tcpip4_spec *m = &fs->m_u.tcp_ip4_spec;
+		const __be16 *ports = (const __be16 *)l4;
+
+		proto = fs->flow_type == TCP_V4_FLOW ? IPPROTO_TCP :
+						       IPPROTO_UDP;
+		if (iph->protocol != proto ||
+		    ((iph->saddr ^ v->ip4src) & m->ip4src) ||
+		    ((iph->daddr ^ v->ip4dst) & m->ip4dst) ||
+		    ((iph->tos ^ v->tos) & m->tos))
+			return false;
+		if (!m->psrc && !m->pdst)
+			return true;
+		return ports &&
+		       !((ports[0] ^ v->psrc) & m->psrc) &&
+		       !((ports[1] ^ v->pdst) & m->pdst);
+	}
+	case IPV4_USER_FLOW: {
+		const struct ethtool_usrip4_spec *v = &fs->h_u.usr_ip4_spec;
+		const struct ethtool_usrip4_spec *m = &fs->m_u.usr_ip4_spec;
+
+		if (((iph->saddr ^ v->ip4src) & m->ip4src) ||
+		    ((iph->daddr ^ v->ip4dst) & m->ip4dst) ||
+		    ((iph->tos ^ v->tos) & m->tos) ||
+		    ((iph->protocol ^ v->proto) & m->proto))
+			return false;
+		if (!m->l4_4_bytes)
+			return true;
+		return l4 && !((*l4 ^ v->l4_4_bytes) & m->l4_4_bytes);
+	}
+	}
+
+	return false;
+}
+
+/*
+ * Run the early receive filter on a just-completed buffer.  Returns true if
+ * the frame matched a drop rule, in which case the buffer (and, for
+ * mergeable buffers, the rest of the chain) has already been released.
+ */
+static bool virtnet_rx_filter_drop(struct virtnet_info *vi,
+				   struct receive_queue *rq,
+				   void *buf, unsigned int len)
+{
+	struct virtnet_stats *stats = this_cpu_ptr(vi->stats);
+	struct virtnet_rx_filters *filters;
+	unsigned int loc, max_len;
+	bool drop = false;
+	u8 *data;
+
+	rcu_read_lock_bh();
+	filters = rcu_dereference_bh(vi->rx_filters);
+	if (!filters)
+		goto out;
+
+	len -= vi->hdr_len;
+	if (vi->mergeable_rx_bufs) {
+		data = mergeable_ctx_to_buf_address((unsigned long)buf);
+		max_len = mergeable_ctx_to_buf_truesize((unsigned long)buf);
+		data += sizeof(struct virtio_net_hdr_mrg_rxbuf);
+		max_len -= sizeof(struct virtio_net_hdr_mrg_rxbuf);
+	} else if (vi->big_packets) {
+		data = page_address(buf) + sizeof(struct padded_vnet_hdr);
+		max_len = PAGE_SIZE - sizeof(struct padded_vnet_hdr);
+	} else {
+		data = ((struct sk_buff *)buf)->data;
+		max_len = GOOD_PACKET_LEN;
+	}
+	len = min(len, max_len);
+
+	for_each_set_bit(loc, filters->used, VIRTNET_MAX_RX_FILTERS) {
+		if (virtnet_rx_filter_match(&filters->rule[loc], data, len)) {
+			drop = true;
+			break;
+		}
+	}
+out:
+	rcu_read_unlock_bh();
+
+	if (!drop)
+		return false;
+
+	if (vi->mergeable_rx_bufs) {
+		struct virtio_net_hdr_mrg_rxbuf *hdr;
+		u16 num_buf;
+
+		hdr = (struct virtio_net_hdr_mrg_rxbuf *)(data - sizeof(*hdr));
+		num_buf = virtio16_to_cpu(vi->vdev, hdr->num_buffers);
+
+		put_page(virt_to_head_page(hdr));
+		while (--num_buf) {
+			unsigned long ctx;
+
+			ctx = (unsigned long)virtqueue_get_buf(rq->vq, &len);
+			if (unlikely(!ctx)) {
+				pr_debug("%s: rx error: %d buffers missing\n",
+					 vi->dev->name, num_buf);
+				vi->dev->stats.rx_length_errors++;
+				break;
+			}
+			put_page(virt_to_head_page(
+					mergeable_ctx_to_buf_address(ctx)));
+		}
+	} else if (vi->big_packets) {
+		give_pages(rq, buf);
+	} else {
+		dev_kfree_skb(buf);
+	}
+
+	u64_stats_update_begin(&stats->rx_syncp);
+	stats->rx_filtered++;
+	u64_stats_update_end(&stats->rx_syncp);
+	return true;
+}
+
 static void receive_buf(struct virtnet_info *vi, struct receive_queue *rq,
 			void *buf, unsigned int len)
 {
@@ -466,6 +641,10 @@ static void receive_buf(struct virtnet_info *vi, struct receive_queue *rq,
 		return;
 	}
 
+	if (rcu_access_pointer(vi->rx_filters) &&
+	    virtnet_rx_filter_drop(vi, rq, buf, len))
+		return;
+
 	if (vi->mergeable_rx_bufs)
 		skb = receive_mergeable(dev, vi, rq, (unsigned long)buf, len);
 	else if (vi->big_packets)
@@ -1080,7 +1259,7 @@ static struct rtnl_link_stats64 *virtnet_stats(struct net_device *dev,
 
 	for_each_possible_cpu(cpu) {
 		struct virtnet_stats *stats = per_cpu_ptr(vi->stats, cpu);
-		u64 tpackets, tbytes, rpackets, rbytes;
+		u64 tpackets, tbytes, rpackets, rbytes, rfiltered;
 
 		do {
 			start = u64_stats_fetch_begin_irq(&stats->tx_syncp);
@@ -1092,17 +1271,19 @@ static struct rtnl_link_stats64 *virtnet_stats(struct net_device *dev,
 			start = u64_stats_fetch_begin_irq(&stats->rx_syncp);
 			rpackets = stats->rx_packets;
 			rbytes   = stats->rx_bytes;
+			rfiltered = stats->rx_filtered;
 		} while (u64_stats_fetch_retry_irq(&stats->rx_syncp, start));
 
 		tot->rx_packets += rpackets;
 		tot->tx_packets += tpackets;
 		tot->rx_bytes   += rbytes;
 		tot->tx_bytes   += tbytes;
+		tot->rx_dropped += rfiltered;
 	}
 
 	tot->tx_dropped = dev->stats.tx_dropped;
 	tot->tx_fifo_errors = dev->stats.tx_fifo_errors;
-	tot->rx_dropped = dev->stats.rx_dropped;
+	tot->rx_dropped += dev->stats.rx_dropped;
 	tot->rx_length_errors = dev->stats.rx_length_errors;
 	tot->rx_frame_errors = dev->stats.rx_frame_errors;
 
@@ -1396,6 +1577,121 @@ static void virtnet_get_channels(struct net_device *dev,
 	channels->other_count = 0;
 }
 
+static int virtnet_get_rxnfc(struct net_device *dev,
+			     struct ethtool_rxnfc *info, u32 *rule_locs)
+{
+	struct virtnet_info *vi = netdev_priv(dev);
+	struct virtnet_rx_filters *filters = rtnl_dereference(vi->rx_filters);
+	unsigned int loc, cnt = 0;
+
+	switch (info->cmd) {
+	case ETHTOOL_GRXRINGS:
+		info->data = vi->curr_queue_pairs;
+		return 0;
+	case ETHTOOL_GRXCLSRLCNT:
+		info->rule_cnt = filters ? filters->count : 0;
+		info->data = VIRTNET_MAX_RX_FILTERS;
+		return 0;
+	case ETHTOOL_GRXCLSRULE:
+		loc = info->fs.location;
+		if (!filters || loc >= VIRTNET_MAX_RX_FILTERS ||
+		    !test_bit(loc, filters->used))
+			return -ENOENT;
+		info->fs = filters->rule[loc];
+		return 0;
+	case ETHTOOL_GRXCLSRLALL:
+		if (filters) {
+			for_each_set_bit(loc, filters->used,
+					 VIRTNET_MAX_RX_FILTERS) {
+				if (cnt == info->rule_cnt)
+					return -EMSGSIZE;
+				rule_locs[cnt++] = loc;
+			}
+		}
+		info->data = VIRTNET_MAX_RX_FILTERS;
+		info->rule_cnt = cnt;
+		return 0;
+	}
+
+	return -EOPNOTSUPP;
+}
+
+static int virtnet_check_rx_filter(const struct ethtool_rx_flow_spec *fs)
+{
+	if (fs->location >= VIRTNET_MAX_RX_FILTERS)
+		return -EINVAL;
+
+	/* Without a hardware classifier the only useful action is drop. */
+	if (fs->ring_cookie != RX_CLS_FLOW_DISC)
+		return -EINVAL;
+
+	switch (fs->flow_type) {
+	case ETHER_FLOW:
+	case TCP_V4_FLOW:
+	case UDP_V4_FLOW:
+		return 0;
+	case IPV4_USER_FLOW:
+		if (fs->h_u.usr_ip4_spec.ip_ver != ETH_RX_NFC_IP4)
+			return -EINVAL;
+		return 0;
+	}
+
+	/* FLOW_EXT / FLOW_MAC_EXT matching is not supported. */
+	return -EINVAL;
+}
+
+static int virtnet_set_rxnfc(struct net_device *dev,
+			     struct ethtool_rxnfc *info)
+{
+	struct virtnet_info *vi = netdev_priv(dev);
+	struct virtnet_rx_filters *old, *new;
+	unsigned int loc = info->fs.location;
+	int err;
+
+	switch (info->cmd) {
+	case ETHTOOL_SRXCLSRLINS:
+		err = virtnet_check_rx_filter(&info->fs);
+		if (err)
+			return err;
+		break;
+	case ETHTOOL_SRXCLSRLDEL:
+		if (loc >= VIRTNET_MAX_RX_FILTERS)
+			return -EINVAL;
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	old = rtnl_dereference(vi->rx_filters);
+	if (info->cmd == ETHTOOL_SRXCLSRLDEL &&
+	    (!old || !test_bit(loc, old->used)))
+		return -ENOENT;
+
+	new = old ? kmemdup(old, sizeof(*new), GFP_KERNEL) :
+		    kzalloc(sizeof(*new), GFP_KERNEL);
+	if (!new)
+		return -ENOMEM;
+
+	if (info->cmd == ETHTOOL_SRXCLSRLINS) {
+		if (!__test_and_set_bit(loc, new->used))
+			new->count++;
+		new->rule[loc] = info->fs;
+	} else {
+		__clear_bit(loc, new->used);
+		new->count--;
+	}
+
+	if (!new->count) {
+		kfree(new);
+		new = NULL;
+	}
+	rcu_assign_pointer(vi->rx_filters, new);
+	if (old)
+		kfree_rcu(old, rcu);
+
+	return 0;
+}
+
 static const struct ethtool_ops virtnet_ethtool_ops = {
 	.get_drvinfo = virtnet_get_drvinfo,
 	.get_link = ethtool_op_get_link,
@@ -1403,6 +1699,8 @@ static const struct ethtool_ops virtnet_ethtool_ops = {
 	.set_channels = virtnet_set_channels,
 	.get_channels = virtnet_get_channels,
 	.get_ts_info = ethtool_op_get_ts_info,
+	.get_rxnfc = virtnet_get_rxnfc,
+	.set_rxnfc = virtnet_set_rxnfc,
 };
 
 #define MIN_MTU 68
@@ -1968,6 +2266,8 @@ static void virtnet_remove(struct virtio_device *vdev)
 
 	remove_vq_common(vi);
 
+	/* unregister_netdev() waited for any NAPI readers. */
+	kfree(rcu_dereference_protected(vi->rx_filters, true));
 	free_percpu(vi->stats);
 	free_netdev(vi->dev);
 }
@@ -25,6 +25,7 @@
  */
 
 #include <linux/module.h>
+#include <net/busy_poll.h>
 #include <net/ip6_checksum.h>
 
 #include "vmxnet3_int.h"
@@ -1448,6 +1449,7 @@ not_lro:
 			if (unlikely(rcd->ts))
 				__vlan_hwaccel_put_tag(skb, htons(ETH_P_8021Q), rcd->tci);
 
+			skb_mark_napi_id(skb, &rq->napi);
 			if (adapter->netdev->features & NETIF_F_LRO)
 				netif_receive_skb(skb);
 			else
@@ -1787,6 +1789,48 @@ vmxnet3_poll_rx_only(struct napi_struct *napi, int budget)
 	return rxd_done;
 }
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+/*
+ * Socket busy polling. Runs the queue's regular NAPI poll with a small
+ * budget; that poll completes NAPI and re-arms the vector once the ring is
+ * drained. Anything left over is handed to the softirq.
+ *
+ * must be called with local_bh_disable()d
+ */
+static int
+vmxnet3_busy_poll(struct napi_struct *napi)
+{
+	struct vmxnet3_rx_queue *rq = container_of(napi,
+						struct vmxnet3_rx_queue, napi);
+	int rxd_done;
+
+	if (!netif_carrier_ok(rq->adapter->netdev))
+		return LL_FLUSH_FAILED;
+
+	if (!napi_schedule_prep(napi))
+		return LL_FLUSH_BUSY;
+
+	rxd_done = napi->poll(napi, VMXNET3_BUSY_POLL_BUDGET);
+	if (rxd_done >= VMXNET3_BUSY_POLL_BUDGET)
+		__napi_schedule(napi);
+
+	return rxd_done;
+}
+#endif	/* CONFIG_NET_RX_BUSY_POLL */
+
+/*
+ * netif_napi_del() leaves busy poll NAPI ids hashed on this kernel, drop
+ * them before the adapter is freed. Callers provide the RCU grace period.
+ */
+static void
+vmxnet3_napi_hash_del(struct vmxnet3_adapter *adapter)
+{
+	int i;
+
+	for (i = 0; i < VMXNET3_DEVICE_MAX_RX_QUEUES; i++)
+		napi_hash_del(&adapter->rx_queue[i].napi);
+}
+
 
 #ifdef CONFIG_PCI_MSI
 
@@ -3070,6 +3114,9 @@ vmxnet3_probe_device(struct pci_dev *pdev,
 		.ndo_vlan_rx_kill_vid = vmxnet3_vlan_rx_kill_vid,
 #ifdef CONFIG_NET_POLL_CONTROLLER
 		.ndo_poll_controller = vmxnet3_netpoll,
+#endif
+#ifdef CONFIG_NET_RX_BUSY_POLL
+		.ndo_busy_poll = vmxnet3_busy_poll,
 #endif
 	};
 	int err;
@@ -3244,10 +3291,12 @@ vmxnet3_probe_device(struct pci_dev *pdev,
 			netif_napi_add(adapter->netdev,
 				       &adapter->rx_queue[i].napi,
 				       vmxnet3_poll_rx_only, 64);
+			napi_hash_add(&adapter->rx_queue[i].napi);
 		}
 	} else {
 		netif_napi_add(adapter->netdev, &adapter->rx_queue[0].napi,
 			       vmxnet3_poll, 64);
+		napi_hash_add(&adapter->rx_queue[0].napi);
 	}
 
 	netif_set_real_num_tx_queues(adapter->netdev, adapter->num_tx_queues);
@@ -3265,6 +3314,8 @@ vmxnet3_probe_device(struct pci_dev *pdev,
 	return 0;
 
 err_register:
+	vmxnet3_napi_hash_del(adapter);
+	synchronize_net();
 	vmxnet3_free_intr_resources(adapter);
 err_ver:
 	vmxnet3_free_pci_resources(adapter);
@@ -3311,6 +3362,8 @@ vmxnet3_remove_device(struct pci_dev *pdev)
 
 	cancel_work_sync(&adapter->work);
 
+	/* unregister_netdev() waits out the RCU grace period for us */
+	vmxnet3_napi_hash_del(adapter);
 	unregister_netdev(netdev);
 
 	vmxnet3_free_intr_resources(adapter);
@@ -381,6 +381,9 @@ struct vmxnet3_adapter {
 	readl((adapter)->hw_addr1 + (reg))
 
 #define VMXNET3_WAKE_QUEUE_THRESHOLD(tq)  (5)
+/* rx descriptors handled per busy poll attempt */
+#define VMXNET3_BUSY_POLL_BUDGET 4
+
 #define VMXNET3_RX_ALLOC_THRESHOLD(rq, ring_idx, adapter) \
 	((rq)->rx_ring[ring_idx].size >> 3)
 
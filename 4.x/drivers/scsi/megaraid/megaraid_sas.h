@@ -1692,6 +1692,11 @@ struct megasas_aen_event {
 struct megasas_irq_context {
 	struct megasas_instance *instance;
 	u32 MSIxIndex;
+	u32 os_irq;
+	unsigned int cpu;		/* CPU this vector is hinted to */
+	struct blk_iopoll iopoll;
+	bool iopoll_scheduled;		/* irq line masked, iopoll owns queue */
+	atomic_t in_used;		/* reply queue is being drained */
 };
 
 struct MR_DRV_SYSTEM_INFO {
@@ -1813,6 +1818,7 @@ struct megasas_instance {
 	unsigned int msix_vectors;
 	struct msix_entry msixentry[MEGASAS_MAX_MSIX_QUEUES];
 	struct megasas_irq_context irq_context[MEGASAS_MAX_MSIX_QUEUES];
+	unsigned int *reply_map;	/* CPU to reply queue */
 	u64 map_id;
 	u64 pd_seq_map_id;
 	struct megasas_cmd *map_update_cmd;
@@ -2052,5 +2058,6 @@ void megasas_return_mfi_mpt_pthr(struct megasas_instance *instance,
 	struct megasas_cmd *cmd_mfi, struct megasas_cmd_fusion *cmd_fusion);
 int megasas_cmd_type(struct scsi_cmnd *cmd);
 void megasas_setup_jbod_map(struct megasas_instance *instance);
+int megasas_iopoll(struct blk_iopoll *iop, int budget);
 
 #endif				/*LSI_MEGARAID_SAS_H */
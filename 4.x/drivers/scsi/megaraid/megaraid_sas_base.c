@@ -48,6 +48,8 @@
 #include <linux/blkdev.h>
 #include <linux/mutex.h>
 #include <linux/poll.h>
+#include <linux/blk-iopoll.h>
+#include <linux/reciprocal_div.h>
 
 #include <scsi/scsi.h>
 #include <scsi/scsi_cmnd.h>
@@ -2852,6 +2854,60 @@ megasas_page_size_show(struct device *cdev,
 	return snprintf(buf, PAGE_SIZE, "%ld\n", (unsigned long)PAGE_SIZE - 1);
 }
 
+/* Sum one of the per-LD IO counters kept by the fusion build path */
+static u64
+megasas_sum_ld_io_stat(struct megasas_instance *instance, size_t offset)
+{
+	struct fusion_context *fusion = instance->ctrl_context;
+	u64 sum = 0;
+	int i;
+
+	if (!fusion)
+		return 0;
+	for (i = 0; i < MAX_LOGICAL_DRIVES_EXT; i++)
+		sum += *(u64 *)((u8 *)&fusion->stream_detect_by_ld[i] + offset);
+	return sum;
+}
+
+static ssize_t
+megasas_stream_hits_show(struct device *cdev,
+	struct device_attribute *attr, char *buf)
+{
+	struct Scsi_Host *shost = class_to_shost(cdev);
+	struct megasas_instance *instance =
+		(struct megasas_instance *) shost->hostdata;
+
+	return snprintf(buf, PAGE_SIZE, "%llu\n",
+		megasas_sum_ld_io_stat(instance,
+			offsetof(struct LD_STREAM_DETECT, stream_hits)));
+}
+
+static ssize_t
+megasas_fp_io_count_show(struct device *cdev,
+	struct device_attribute *attr, char *buf)
+{
+	struct Scsi_Host *shost = class_to_shost(cdev);
+	struct megasas_instance *instance =
+		(struct megasas_instance *) shost->hostdata;
+
+	return snprintf(buf, PAGE_SIZE, "%llu\n",
+		megasas_sum_ld_io_stat(instance,
+			offsetof(struct LD_STREAM_DETECT, fp_ios)));
+}
+
+static ssize_t
+megasas_ld_io_count_show(struct device *cdev,
+	struct device_attribute *attr, char *buf)
+{
+	struct Scsi_Host *shost = class_to_shost(cdev);
+	struct megasas_instance *instance =
+		(struct megasas_instance *) shost->hostdata;
+
+	return snprintf(buf, PAGE_SIZE, "%llu\n",
+		megasas_sum_ld_io_stat(instance,
+			offsetof(struct LD_STREAM_DETECT, ld_ios)));
+}
+
 static DEVICE_ATTR(fw_crash_buffer, S_IRUGO | S_IWUSR,
 	megasas_fw_crash_buffer_show, megasas_fw_crash_buffer_store);
 static DEVICE_ATTR(fw_crash_buffer_size, S_IRUGO,
@@ -2860,12 +2916,21 @@ static DEVICE_ATTR(fw_crash_state, S_IRUGO | S_IWUSR,
 	megasas_fw_crash_state_show, megasas_fw_crash_state_store);
 static DEVICE_ATTR(page_size, S_IRUGO,
 	megasas_page_size_show, NULL);
+static DEVICE_ATTR(stream_hits, S_IRUGO,
+	megasas_stream_hits_show, NULL);
+static DEVICE_ATTR(fp_io_count, S_IRUGO,
+	megasas_fp_io_count_show, NULL);
+static DEVICE_ATTR(ld_io_count, S_IRUGO,
+	megasas_ld_io_count_show, NULL);
 
 struct device_attribute *megaraid_host_attrs[] = {
 	&dev_attr_fw_crash_buffer_size,
 	&dev_attr_fw_crash_buffer,
 	&dev_attr_fw_crash_state,
 	&dev_attr_page_size,
+	&dev_attr_stream_hits,
+	&dev_attr_fp_io_count,
+	&dev_attr_ld_io_count,
 	NULL,
 };
 
@@ -4489,6 +4554,49 @@ fail_alloc_cmds:
 	return 1;
 }
 
+/*
+ * megasas_setup_reply_map -		map each CPU to a reply queue
+ * @instance:				Adapter soft state
+ *
+ * With affinity hints, MSI-x vector i is pinned to the i-th online CPU,
+ * so that CPU completes on vector i.  CPUs without a vector of their own
+ * pick one pinned to their NUMA node, spread by CPU number, and fall back
+ * to round robin.  Replaces the plain "CPU modulo vectors" choice, which
+ * piled unrelated CPUs onto one vector.
+ */
+static void
+megasas_setup_reply_map(struct megasas_instance *instance)
+{
+	unsigned int count, queue, cpu, i;
+
+	count = instance->msix_vectors ? instance->msix_vectors : 1;
+	for_each_possible_cpu(cpu)
+		instance->reply_map[cpu] = cpu % count;
+
+	if (!instance->msix_vectors || !smp_affinity_enable)
+		return;
+
+	/* More vectors than online CPUs leaves the tail unpinned */
+	for (queue = 0; queue < count; queue++)
+		if (instance->irq_context[queue].cpu < nr_cpu_ids)
+			instance->reply_map[instance->irq_context[queue].cpu] =
+				queue;
+
+	for_each_possible_cpu(cpu) {
+		if (instance->irq_context[instance->reply_map[cpu]].cpu == cpu)
+			continue;
+		for (i = 0; i < count; i++) {
+			queue = (cpu + i) % count;
+			if (instance->irq_context[queue].cpu < nr_cpu_ids &&
+			    cpu_to_node(instance->irq_context[queue].cpu) ==
+			    cpu_to_node(cpu)) {
+				instance->reply_map[cpu] = queue;
+				break;
+			}
+		}
+	}
+}
+
 /*
  * megasas_setup_irqs_msix -		register legacy interrupts.
  * @instance:				Adapter soft state
@@ -4505,6 +4613,7 @@ megasas_setup_irqs_ioapic(struct megasas_instance *instance)
 	pdev = instance->pdev;
 	instance->irq_context[0].instance = instance;
 	instance->irq_context[0].MSIxIndex = 0;
+	instance->irq_context[0].os_irq = pdev->irq;
 	if (request_irq(pdev->irq, instance->instancet->service_isr,
 		IRQF_SHARED, "megasas", &instance->irq_context[0])) {
 		dev_err(&instance->pdev->dev,
@@ -4512,6 +4621,7 @@ megasas_setup_irqs_ioapic(struct megasas_instance *instance)
 				__func__, __LINE__);
 		return -1;
 	}
+	megasas_setup_reply_map(instance);
 	return 0;
 }
 
@@ -4537,11 +4647,19 @@ megasas_setup_irqs_msix(struct megasas_instance *instance, u8 is_probe)
 	for (i = 0; i < instance->msix_vectors; i++) {
 		instance->irq_context[i].instance = instance;
 		instance->irq_context[i].MSIxIndex = i;
+		instance->irq_context[i].os_irq = instance->msixentry[i].vector;
+		instance->irq_context[i].iopoll_scheduled = false;
+		atomic_set(&instance->irq_context[i].in_used, 0);
+		blk_iopoll_init(&instance->irq_context[i].iopoll,
+				THRESHOLD_REPLY_COUNT, megasas_iopoll);
+		blk_iopoll_enable(&instance->irq_context[i].iopoll);
 		if (request_irq(instance->msixentry[i].vector,
 			instance->instancet->service_isr, 0, "megasas",
 			&instance->irq_context[i])) {
 			dev_err(&instance->pdev->dev,
 				"Failed to register IRQ for vector %d.\n", i);
+			for (j = 0; j <= i; j++)
+				blk_iopoll_disable(&instance->irq_context[j].iopoll);
 			for (j = 0; j < i; j++) {
 				if (smp_affinity_enable)
 					irq_set_affinity_hint(
@@ -4556,6 +4674,7 @@ megasas_setup_irqs_msix(struct megasas_instance *instance, u8 is_probe)
 			else
 				return -1;
 		}
+		instance->irq_context[i].cpu = cpu;
 		if (smp_affinity_enable) {
 			if (irq_set_affinity_hint(instance->msixentry[i].vector,
 				get_cpu_mask(cpu)))
@@ -4565,6 +4684,7 @@ megasas_setup_irqs_msix(struct megasas_instance *instance, u8 is_probe)
 			cpu = cpumask_next(cpu, cpu_online_mask);
 		}
 	}
+	megasas_setup_reply_map(instance);
 	return 0;
 }
 
@@ -4577,9 +4697,17 @@ static void
 megasas_destroy_irqs(struct megasas_instance *instance) {
 
 	int i;
+	struct megasas_irq_context *irq_ctx;
 
 	if (instance->msix_vectors)
 		for (i = 0; i < instance->msix_vectors; i++) {
+			irq_ctx = &instance->irq_context[i];
+			blk_iopoll_disable(&irq_ctx->iopoll);
+			/* iopoll was stopped with the vector still masked */
+			if (irq_ctx->iopoll_scheduled) {
+				irq_ctx->iopoll_scheduled = false;
+				enable_irq(irq_ctx->os_irq);
+			}
 			if (smp_affinity_enable)
 				irq_set_affinity_hint(
 					instance->msixentry[i].vector, NULL);
@@ -4795,6 +4923,11 @@ static int megasas_init_fw(struct megasas_instance *instance)
 		"current msix/online cpus\t: (%d/%d)\n",
 		instance->msix_vectors, (unsigned int)num_online_cpus());
 
+	instance->reply_map = kcalloc(nr_cpu_ids, sizeof(unsigned int),
+				      GFP_KERNEL);
+	if (!instance->reply_map)
+		goto fail_setup_irqs;
+
 	tasklet_init(&instance->isr_tasklet, instance->instancet->tasklet,
 		(unsigned long)instance);
 
@@ -4953,6 +5086,8 @@ fail_get_pd_list:
 fail_init_adapter:
 	megasas_destroy_irqs(instance);
 fail_setup_irqs:
+	kfree(instance->reply_map);
+	instance->reply_map = NULL;
 	if (instance->msix_vectors)
 		pci_disable_msix(instance->pdev);
 	instance->msix_vectors = 0;
@@ -5594,6 +5729,7 @@ fail_io_attach:
 		megasas_release_mfi(instance);
 	if (instance->msix_vectors)
 		pci_disable_msix(instance->pdev);
+	kfree(instance->reply_map);
 fail_init_mfi:
 fail_alloc_dma_buf:
 	if (instance->evt_detail)
@@ -5969,6 +6105,7 @@ static void megasas_detach_one(struct pci_dev *pdev)
 	}
 
 	kfree(instance->ctrl_info);
+	kfree(instance->reply_map);
 
 	if (instance->evt_detail)
 		pci_free_consistent(pdev, sizeof(struct megasas_evt_detail),
@@ -47,6 +47,9 @@
 #include <linux/compat.h>
 #include <linux/blkdev.h>
 #include <linux/poll.h>
+#include <linux/blk-iopoll.h>
+#include <linux/reciprocal_div.h>
+#include <linux/seqlock.h>
 
 #include <scsi/scsi.h>
 #include <scsi/scsi_cmnd.h>
@@ -90,6 +93,8 @@ static u8 mr_spanset_get_phy_params(struct megasas_instance *instance, u32 ld,
 	struct RAID_CONTEXT *pRAID_Context, struct MR_DRV_RAID_MAP_ALL *map);
 static u64 get_row_from_strip(struct megasas_instance *instance, u32 ld,
 	u64 strip, struct MR_DRV_RAID_MAP_ALL *map);
+static void mr_update_fast_div(struct MR_DRV_RAID_MAP_ALL *map,
+	PLD_SPAN_INFO ldSpanInfo, struct LD_FAST_DIV *ldFastDiv);
 
 u32 mega_mod64(u64 dividend, u32 divisor)
 {
@@ -123,6 +128,133 @@ u64 mega_div64_32(uint64_t dividend, uint32_t divisor)
 	return d;
 }
 
+/*
+ * Divide with a precomputed divisor.  Returns false if @fd cannot handle
+ * @dividend (a reciprocal only covers 32-bit dividends).
+ */
+static inline bool __mr_fast_div(u64 dividend, u32 divisor,
+	const struct MR_FAST_DIV *fd, u64 *quotient, u32 *remainder)
+{
+	if (fd->shift != MR_FAST_DIV_NOT_POW2) {
+		*quotient = dividend >> fd->shift;
+		*remainder = (u32)dividend & (divisor - 1);
+		return true;
+	}
+	if (dividend > U32_MAX)
+		return false;
+	*quotient = reciprocal_divide((u32)dividend, fd->recip);
+	*remainder = (u32)dividend - (u32)*quotient * divisor;
+	return true;
+}
+
+/**
+ * @param dividend    : Dividend
+ * @param divisor    : Divisor, as read from the current RAID map
+ * @param fd         : Precomputed divisor table entry
+ * @param remainder  : Remainder
+ *
+ * @return quotient
+ **/
+static u64 mr_div_rem(u64 dividend, u32 divisor,
+	const struct MR_FAST_DIV *fd, u32 *remainder)
+{
+	struct MR_FAST_DIV snap;
+	unsigned int seq;
+	u64 d;
+
+	if (likely(divisor)) {
+		/*
+		 * Use a snapshot of the entry, and only if no map update
+		 * rewrote it meanwhile; never spin in the IO path, a racing
+		 * update just sends this IO through do_div().
+		 */
+		seq = raw_read_seqcount(&fd->seq);
+		snap.divisor = fd->divisor;
+		snap.shift = fd->shift;
+		snap.recip = fd->recip;
+		if (!(seq & 1) && !read_seqcount_retry(&fd->seq, seq) &&
+		    snap.divisor == divisor &&
+		    __mr_fast_div(dividend, divisor, &snap, &d, remainder))
+			return d;
+	}
+
+	if (!divisor)
+		printk(KERN_ERR "megasas : DIVISOR is zero in div fn\n");
+	d = dividend;
+	*remainder = do_div(d, divisor);
+	return d;
+}
+
+static inline u32 mr_mod(u64 dividend, u32 divisor,
+	const struct MR_FAST_DIV *fd)
+{
+	u32 remainder;
+
+	mr_div_rem(dividend, divisor, fd, &remainder);
+	return remainder;
+}
+
+/*
+ * Check a freshly computed divisor against do_div() over values around
+ * the divisor and the 32-bit boundary before the IO path may use it.
+ */
+static bool mr_fast_div_selftest(const struct MR_FAST_DIV *fd, u32 divisor)
+{
+	const u64 samples[] = {
+		0, 1, divisor - 1, divisor, (u64)divisor + 1,
+		2 * (u64)divisor - 1, 0x9e3779b9, U32_MAX - divisor, U32_MAX,
+		(1ULL << 40) + divisor - 1,
+	};
+	u64 q, expect_q;
+	u32 rem, expect_rem;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(samples); i++) {
+		if (!__mr_fast_div(samples[i], divisor, fd, &q, &rem))
+			continue;
+		expect_q = samples[i];
+		expect_rem = do_div(expect_q, divisor);
+		if (q != expect_q || rem != expect_rem) {
+			printk(KERN_ERR "megasas: fast divide by %u failed "
+			       "for %llu, using do_div\n", divisor,
+			       (unsigned long long)samples[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Publish @divisor in @fd.  The new entry is built and checked aside and
+ * then copied in under fd->seq, so mr_div_rem() either sees all of it or
+ * notices the rewrite and takes the slow path.  Map updates, the only
+ * writers, are serialized by the caller of MR_ValidateMapInfo().
+ */
+static void mr_fast_div_set(struct MR_FAST_DIV *fd, u32 divisor)
+{
+	struct MR_FAST_DIV new = { .divisor = divisor };
+
+	if (fd->divisor == divisor)
+		return;
+
+	if (divisor) {
+		if (is_power_of_2(divisor)) {
+			new.shift = ilog2(divisor);
+		} else {
+			new.shift = MR_FAST_DIV_NOT_POW2;
+			new.recip = reciprocal_value(divisor);
+		}
+		if (!mr_fast_div_selftest(&new, divisor))
+			new.divisor = 0;
+	}
+
+	raw_write_seqcount_begin(&fd->seq);
+	fd->shift = new.shift;
+	fd->recip = new.recip;
+	fd->divisor = new.divisor;
+	raw_write_seqcount_end(&fd->seq);
+}
+
 struct MR_LD_RAID *MR_LdRaidGet(u32 ld, struct MR_DRV_RAID_MAP_ALL *map)
 {
 	return &map->raidMap.ldSpanMap[ld].ldRaid;
@@ -298,6 +430,8 @@ u8 MR_ValidateMapInfo(struct megasas_instance *instance)
 	if (instance->UnevenSpanSupport)
 		mr_update_span_set(drv_map, ldSpanInfo);
 
+	mr_update_fast_div(drv_map, ldSpanInfo, fusion->ld_fast_div);
+
 	mr_update_load_balance_params(drv_map, lbInfo);
 
 	num_lds = le16_to_cpu(drv_map->raidMap.ldCount);
@@ -312,13 +446,16 @@ u8 MR_ValidateMapInfo(struct megasas_instance *instance)
 	return 1;
 }
 
-u32 MR_GetSpanBlock(u32 ld, u64 row, u64 *span_blk,
-		    struct MR_DRV_RAID_MAP_ALL *map)
+u32 MR_GetSpanBlock(struct megasas_instance *instance, u32 ld, u64 row,
+		    u64 *span_blk, struct MR_DRV_RAID_MAP_ALL *map)
 {
+	struct fusion_context *fusion = instance->ctrl_context;
+	struct LD_FAST_DIV *fdiv = &fusion->ld_fast_div[ld];
 	struct MR_SPAN_BLOCK_INFO *pSpanBlock = MR_LdSpanInfoGet(ld, map);
 	struct MR_QUAD_ELEMENT    *quad;
 	struct MR_LD_RAID         *raid = MR_LdRaidGet(ld, map);
-	u32                span, j;
+	u32                span, j, rem;
+	u64                blk;
 
 	for (span = 0; span < raid->spanDepth; span++, pSpanBlock++) {
 
@@ -327,14 +464,13 @@ u32 MR_GetSpanBlock(u32 ld, u64 row, u64 *span_blk,
 
 			if (le32_to_cpu(quad->diff) == 0)
 				return SPAN_INVALID;
-			if (le64_to_cpu(quad->logStart) <= row && row <=
-				le64_to_cpu(quad->logEnd) && (mega_mod64(row - le64_to_cpu(quad->logStart),
-				le32_to_cpu(quad->diff))) == 0) {
+			if (le64_to_cpu(quad->logStart) > row ||
+				row > le64_to_cpu(quad->logEnd))
+				continue;
+			blk = mr_div_rem(row - le64_to_cpu(quad->logStart),
+				le32_to_cpu(quad->diff), &fdiv->quad_diff[j], &rem);
+			if (rem == 0) {
 				if (span_blk != NULL) {
-					u64  blk, debugBlk;
-					blk =  mega_div64_32((row-le64_to_cpu(quad->logStart)), le32_to_cpu(quad->diff));
-					debugBlk = blk;
-
 					blk = (blk + le64_to_cpu(quad->offsetInSpan)) << raid->stripeShift;
 					*span_blk = blk;
 				}
@@ -455,8 +591,10 @@ u32 mr_spanset_get_span_block(struct megasas_instance *instance,
 	struct MR_LD_RAID         *raid = MR_LdRaidGet(ld, map);
 	LD_SPAN_SET *span_set;
 	struct MR_QUAD_ELEMENT    *quad;
-	u32    span, info;
+	u32    span, info, rem;
+	u64    blk;
 	PLD_SPAN_INFO ldSpanInfo = fusion->log_to_span;
+	struct LD_FAST_DIV *fdiv = &fusion->ld_fast_div[ld];
 
 	for (info = 0; info < MAX_QUAD_DEPTH; info++) {
 		span_set = &(ldSpanInfo[ld].span_set[info]);
@@ -475,15 +613,14 @@ u32 mr_spanset_get_span_block(struct megasas_instance *instance,
 					block_span_info.quad[info];
 				if (le32_to_cpu(quad->diff) == 0)
 					return SPAN_INVALID;
-				if (le64_to_cpu(quad->logStart) <= row  &&
-					row <= le64_to_cpu(quad->logEnd)  &&
-					(mega_mod64(row - le64_to_cpu(quad->logStart),
-						le32_to_cpu(quad->diff))) == 0) {
+				if (le64_to_cpu(quad->logStart) > row ||
+					row > le64_to_cpu(quad->logEnd))
+					continue;
+				blk = mr_div_rem(row - le64_to_cpu(quad->logStart),
+					le32_to_cpu(quad->diff),
+					&fdiv->quad_diff[info], &rem);
+				if (rem == 0) {
 					if (span_blk != NULL) {
-						u64  blk;
-						blk = mega_div64_32
-						    ((row - le64_to_cpu(quad->logStart)),
-						    le32_to_cpu(quad->diff));
 						blk = (blk + le64_to_cpu(quad->offsetInSpan))
 							 << raid->stripeShift;
 						*span_blk = blk;
@@ -518,6 +655,7 @@ static u64  get_row_from_strip(struct megasas_instance *instance,
 	struct MR_LD_RAID	*raid = MR_LdRaidGet(ld, map);
 	LD_SPAN_SET	*span_set;
 	PLD_SPAN_INFO	ldSpanInfo = fusion->log_to_span;
+	struct LD_FAST_DIV *fdiv = &fusion->ld_fast_div[ld];
 	u32		info, strip_offset, span, span_offset;
 	u64		span_set_Strip, span_set_Row, retval;
 
@@ -530,10 +668,10 @@ static u64  get_row_from_strip(struct megasas_instance *instance,
 			continue;
 
 		span_set_Strip = strip - span_set->data_strip_start;
-		strip_offset = mega_mod64(span_set_Strip,
-				span_set->span_row_data_width);
-		span_set_Row = mega_div64_32(span_set_Strip,
-				span_set->span_row_data_width) * span_set->diff;
+		span_set_Row = mr_div_rem(span_set_Strip,
+				span_set->span_row_data_width,
+				&fdiv->set_width[info], &strip_offset) *
+				span_set->diff;
 		for (span = 0, span_offset = 0; span < raid->spanDepth; span++)
 			if (le32_to_cpu(map->raidMap.ldSpanMap[ld].spanBlock[span].
 				block_span_info.noElements) >= info+1) {
@@ -588,6 +726,7 @@ static u64 get_strip_from_row(struct megasas_instance *instance,
 	LD_SPAN_SET *span_set;
 	struct MR_QUAD_ELEMENT    *quad;
 	PLD_SPAN_INFO ldSpanInfo = fusion->log_to_span;
+	struct LD_FAST_DIV *fdiv = &fusion->ld_fast_div[ld];
 	u32    span, info;
 	u64  strip;
 
@@ -606,12 +745,16 @@ static u64 get_strip_from_row(struct megasas_instance *instance,
 					spanBlock[span].block_span_info.quad[info];
 				if (le64_to_cpu(quad->logStart) <= row  &&
 					row <= le64_to_cpu(quad->logEnd)  &&
-					mega_mod64((row - le64_to_cpu(quad->logStart)),
-					le32_to_cpu(quad->diff)) == 0) {
-					strip = mega_div64_32
+					mr_mod((row - le64_to_cpu(quad->logStart)),
+					le32_to_cpu(quad->diff),
+					&fdiv->quad_diff[info]) == 0) {
+					u32 rem;
+
+					strip = mr_div_rem
 						(((row - span_set->data_row_start)
 							- le64_to_cpu(quad->logStart)),
-							le32_to_cpu(quad->diff));
+							le32_to_cpu(quad->diff),
+							&fdiv->quad_diff[info], &rem);
 					strip *= span_set->span_row_data_width;
 					strip += span_set->data_strip_start;
 					strip += span_set->strip_offset[span];
@@ -648,6 +791,7 @@ static u32 get_arm_from_strip(struct megasas_instance *instance,
 	struct MR_LD_RAID         *raid = MR_LdRaidGet(ld, map);
 	LD_SPAN_SET *span_set;
 	PLD_SPAN_INFO ldSpanInfo = fusion->log_to_span;
+	struct LD_FAST_DIV *fdiv = &fusion->ld_fast_div[ld];
 	u32    info, strip_offset, span, span_offset, retval;
 
 	for (info = 0 ; info < MAX_QUAD_DEPTH; info++) {
@@ -658,9 +802,9 @@ static u32 get_arm_from_strip(struct megasas_instance *instance,
 		if (strip > span_set->data_strip_end)
 			continue;
 
-		strip_offset = (uint)mega_mod64
-				((strip - span_set->data_strip_start),
-				span_set->span_row_data_width);
+		strip_offset = mr_mod((strip - span_set->data_strip_start),
+				span_set->span_row_data_width,
+				&fdiv->set_width[info]);
 
 		for (span = 0, span_offset = 0; span < raid->spanDepth; span++)
 			if (le32_to_cpu(map->raidMap.ldSpanMap[ld].spanBlock[span].
@@ -692,6 +836,7 @@ static u32 get_arm_from_strip(struct megasas_instance *instance,
 u8 get_arm(struct megasas_instance *instance, u32 ld, u8 span, u64 stripe,
 		struct MR_DRV_RAID_MAP_ALL *map)
 {
+	struct fusion_context *fusion = instance->ctrl_context;
 	struct MR_LD_RAID  *raid = MR_LdRaidGet(ld, map);
 	/* Need to check correct default value */
 	u32    arm = 0;
@@ -700,7 +845,8 @@ u8 get_arm(struct megasas_instance *instance, u32 ld, u8 span, u64 stripe,
 	case 0:
 	case 5:
 	case 6:
-		arm = mega_mod64(stripe, SPAN_ROW_SIZE(map, ld, span));
+		arm = mr_mod(stripe, SPAN_ROW_SIZE(map, ld, span),
+			&fusion->ld_fast_div[ld].span_row_size[span]);
 		break;
 	case 1:
 		/* start with logical arm */
@@ -757,7 +903,8 @@ static u8 mr_spanset_get_phy_params(struct megasas_instance *instance, u32 ld,
 		logArm = get_arm_from_strip(instance, ld, stripRow, map);
 		if (logArm == -1U)
 			return FALSE;
-		rowMod = mega_mod64(row, SPAN_ROW_SIZE(map, ld, span));
+		rowMod = mr_mod(row, SPAN_ROW_SIZE(map, ld, span),
+			&fusion->ld_fast_div[ld].span_row_size[span]);
 		armQ = SPAN_ROW_SIZE(map, ld, span) - 1 - rowMod;
 		arm = armQ + 1 + logArm;
 		if (arm >= SPAN_ROW_SIZE(map, ld, span))
@@ -825,21 +972,23 @@ u8 MR_GetPhyParams(struct megasas_instance *instance, u32 ld, u64 stripRow,
 	u64	    *pdBlock = &io_info->pdBlock;
 	__le16	    *pDevHandle = &io_info->devHandle;
 	struct fusion_context *fusion;
+	struct LD_FAST_DIV *fdiv;
+	u32	    logArm;
 
 	fusion = instance->ctrl_context;
+	fdiv = &fusion->ld_fast_div[ld];
 
-
-	row =  mega_div64_32(stripRow, raid->rowDataSize);
+	row = mr_div_rem(stripRow, raid->rowDataSize, &fdiv->row_data_size,
+			 &logArm);
 
 	if (raid->level == 6) {
-		/* logical arm within row */
-		u32 logArm =  mega_mod64(stripRow, raid->rowDataSize);
+		/* logArm is the logical arm within row */
 		u32 rowMod, armQ, arm;
 
 		if (raid->rowSize == 0)
 			return FALSE;
 		/* get logical row mod */
-		rowMod = mega_mod64(row, raid->rowSize);
+		rowMod = mr_mod(row, raid->rowSize, &fdiv->row_size);
 		armQ = raid->rowSize-1-rowMod; /* index of Q drive */
 		arm = armQ+1+logArm; /* data always logically follows Q */
 		if (arm >= raid->rowSize) /* handle wrap condition */
@@ -848,8 +997,9 @@ u8 MR_GetPhyParams(struct megasas_instance *instance, u32 ld, u64 stripRow,
 	} else  {
 		if (raid->modFactor == 0)
 			return FALSE;
-		physArm = MR_LdDataArmGet(ld,  mega_mod64(stripRow,
-							  raid->modFactor),
+		physArm = MR_LdDataArmGet(ld, mr_mod(stripRow,
+							raid->modFactor,
+							&fdiv->mod_factor),
 					  map);
 	}
 
@@ -857,7 +1007,7 @@ u8 MR_GetPhyParams(struct megasas_instance *instance, u32 ld, u64 stripRow,
 		span = 0;
 		*pdBlock = row << raid->stripeShift;
 	} else {
-		span = (u8)MR_GetSpanBlock(ld, row, pdBlock, map);
+		span = (u8)MR_GetSpanBlock(instance, ld, row, pdBlock, map);
 		if (span == SPAN_INVALID)
 			return FALSE;
 	}
@@ -933,6 +1083,7 @@ MR_BuildRaidContext(struct megasas_instance *instance,
 
 	ld = MR_TargetIdToLdGet(ldTgtId, map);
 	raid = MR_LdRaidGet(ld, map);
+	io_info->raid_level = raid->level;
 
 	/*
 	 * if rowDataSize @RAID map and spanRowDataSize @SPAN INFO are zero
@@ -1006,8 +1157,12 @@ MR_BuildRaidContext(struct megasas_instance *instance,
 			(unsigned long long)endRow, startlba_span);
 #endif
 	} else {
-		start_row = mega_div64_32(start_strip, raid->rowDataSize);
-		endRow    = mega_div64_32(endStrip, raid->rowDataSize);
+		struct MR_FAST_DIV *fd =
+			&fusion->ld_fast_div[ld].row_data_size;
+		u32 rem;
+
+		start_row = mr_div_rem(start_strip, raid->rowDataSize, fd, &rem);
+		endRow    = mr_div_rem(endStrip, raid->rowDataSize, fd, &rem);
 	}
 	numRows = (u8)(endRow - start_row + 1);
 
@@ -1261,6 +1416,65 @@ void mr_update_span_set(struct MR_DRV_RAID_MAP_ALL *map,
 
 }
 
+/*
+******************************************************************************
+*
+* This routine refreshes the per-LD divisor table used by the IO path, so
+* that mapping an LBA to arm, span and row needs no 64-bit division.
+*
+* Inputs :
+* map    - LD map
+* ldSpanInfo - ldSpanInfo per HBA instance, already updated for map
+* ldFastDiv - divisor table per HBA instance
+*
+*/
+static void mr_update_fast_div(struct MR_DRV_RAID_MAP_ALL *map,
+	PLD_SPAN_INFO ldSpanInfo, struct LD_FAST_DIV *ldFastDiv)
+{
+	struct MR_LD_RAID *raid;
+	struct LD_FAST_DIV *fdiv;
+	u32 element, span, diff;
+	int ldCount;
+	u16 ld;
+
+	for (ldCount = 0; ldCount < MAX_LOGICAL_DRIVES_EXT; ldCount++) {
+		ld = MR_TargetIdToLdGet(ldCount, map);
+		if (ld >= (MAX_LOGICAL_DRIVES_EXT - 1))
+			continue;
+		raid = MR_LdRaidGet(ld, map);
+		fdiv = &ldFastDiv[ld];
+
+		mr_fast_div_set(&fdiv->row_data_size, raid->rowDataSize);
+		mr_fast_div_set(&fdiv->row_size, raid->rowSize);
+		mr_fast_div_set(&fdiv->mod_factor, raid->modFactor);
+		for (span = 0; span < raid->spanDepth; span++)
+			mr_fast_div_set(&fdiv->span_row_size[span],
+				SPAN_ROW_SIZE(map, ld, span));
+
+		for (element = 0; element < MAX_QUAD_DEPTH; element++) {
+			/*
+			 * The quads of one span set share a diff in practice;
+			 * an entry that disagrees with a quad is simply not
+			 * used for it (see mr_div_rem()).
+			 */
+			diff = 0;
+			for (span = 0; span < raid->spanDepth; span++)
+				if (le32_to_cpu(map->raidMap.ldSpanMap[ld].
+					spanBlock[span].block_span_info.
+					noElements) >= element + 1) {
+					diff = le32_to_cpu(map->raidMap.
+						ldSpanMap[ld].spanBlock[span].
+						block_span_info.quad[element].diff);
+					break;
+				}
+			mr_fast_div_set(&fdiv->quad_diff[element], diff);
+			mr_fast_div_set(&fdiv->set_width[element],
+				ldSpanInfo[ld].span_set[element].
+				span_row_data_width);
+		}
+	}
+}
+
 void mr_update_load_balance_params(struct MR_DRV_RAID_MAP_ALL *drv_map,
 	struct LD_LOAD_BALANCE_INFO *lbInfo)
 {
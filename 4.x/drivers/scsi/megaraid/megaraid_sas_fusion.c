@@ -47,6 +47,8 @@
 #include <linux/blkdev.h>
 #include <linux/mutex.h>
 #include <linux/poll.h>
+#include <linux/blk-iopoll.h>
+#include <linux/reciprocal_div.h>
 
 #include <scsi/scsi.h>
 #include <scsi/scsi_cmnd.h>
@@ -1184,6 +1186,11 @@ megasas_init_adapter_fusion(struct megasas_instance *instance)
 	instance->flag_ieee = 1;
 	fusion->fast_path_io = 0;
 
+	for (i = 0; i < MAX_LOGICAL_DRIVES_EXT; i++) {
+		spin_lock_init(&fusion->stream_detect_by_ld[i].lock);
+		fusion->stream_detect_by_ld[i].mru_bit_map = MR_STREAM_BITMAP;
+	}
+
 	fusion->drv_map_pages = get_order(fusion->drv_map_sz);
 	for (i = 0; i < 2; i++) {
 		fusion->ld_map[i] = NULL;
@@ -1538,6 +1545,65 @@ megasas_set_pd_lba(struct MPI2_RAID_SCSI_IO_REQUEST *io_request, u8 cdb_len,
 	}
 }
 
+/**
+ * megasas_stream_detect -	Matches an IO against the LD's recent streams
+ * @sd:			Stream detect state of the target LD, lock held
+ * @io_info:		IO being built
+ *
+ * A write continues a stream only if it starts exactly where the stream
+ * left off; a read may also skip ahead by up to MR_STREAM_READ_GAP blocks.
+ * A hit moves the stream to the front of the MRU map and sets
+ * io_info->stream_detected.  A miss recycles the least recently used slot.
+ */
+static void
+megasas_stream_detect(struct LD_STREAM_DETECT *sd,
+		      struct IO_REQUEST_INFO *io_info)
+{
+	u32 *track_stream = &sd->mru_bit_map, stream_num;
+	u32 shifted_values, unshifted_values;
+	u32 index_value_mask, shifted_values_mask;
+	struct STREAM_DETECT *current_sd;
+	u64 start = io_info->ldStartBlock;
+	int i;
+
+	for (i = 0; i < MAX_STREAMS_TRACKED; i++) {
+		stream_num = (*track_stream >> (i * BITS_PER_INDEX_STREAM)) &
+			STREAM_MASK;
+		current_sd = &sd->stream_track[stream_num];
+
+		if (!current_sd->next_seq_lba ||
+		    current_sd->is_read != io_info->isRead ||
+		    start < current_sd->next_seq_lba ||
+		    start > current_sd->next_seq_lba + MR_STREAM_READ_GAP)
+			continue;
+		if (!io_info->isRead && start != current_sd->next_seq_lba)
+			continue;
+
+		io_info->stream_detected = 1;
+		sd->stream_hits++;
+		current_sd->next_seq_lba = start + io_info->numBlocks;
+
+		/* Move stream_num to the MRU slot, shifting the ones ahead */
+		shifted_values_mask = (1 << i * BITS_PER_INDEX_STREAM) - 1;
+		shifted_values = (*track_stream & shifted_values_mask)
+			<< BITS_PER_INDEX_STREAM;
+		index_value_mask = STREAM_MASK << i * BITS_PER_INDEX_STREAM;
+		unshifted_values = *track_stream &
+			~(shifted_values_mask | index_value_mask);
+		*track_stream = unshifted_values | shifted_values | stream_num;
+		return;
+	}
+
+	stream_num = (*track_stream >>
+		((MAX_STREAMS_TRACKED - 1) * BITS_PER_INDEX_STREAM)) &
+		STREAM_MASK;
+	current_sd = &sd->stream_track[stream_num];
+	current_sd->is_read = io_info->isRead;
+	current_sd->next_seq_lba = start + io_info->numBlocks;
+	*track_stream = ((*track_stream & ZERO_LAST_STREAM) <<
+			 BITS_PER_INDEX_STREAM) | stream_num;
+}
+
 /**
  * megasas_build_ldio_fusion -	Prepares IOs to devices
  * @instance:		Adapter soft state
@@ -1560,6 +1626,8 @@ megasas_build_ldio_fusion(struct megasas_instance *instance,
 	struct fusion_context *fusion;
 	struct MR_DRV_RAID_MAP_ALL *local_map_ptr;
 	u8 *raidLUN;
+	struct LD_STREAM_DETECT *sd;
+	unsigned long flags;
 
 	device_id = MEGASAS_DEV_INDEX(scp);
 
@@ -1648,11 +1716,26 @@ megasas_build_ldio_fusion(struct megasas_instance *instance,
 			fp_possible = io_info.fpOkForIo;
 	}
 
-	/* Use raw_smp_processor_id() for now until cmd->request->cpu is CPU
-	   id by default, not CPU group id, otherwise all MSI-X queues won't
-	   be utilized */
+	sd = &fusion->stream_detect_by_ld[device_id];
+	spin_lock_irqsave(&sd->lock, flags);
+	megasas_stream_detect(sd, &io_info);
+	/*
+	 * Sequential writes to parity RAID go through firmware, which can
+	 * coalesce them into full-stripe writes; fast path IOs are written
+	 * to the arms one strip at a time and force read-modify-write.
+	 */
+	if (io_info.stream_detected && !io_info.isRead &&
+	    (io_info.raid_level == 5 || io_info.raid_level == 6))
+		fp_possible = 0;
+	if (fp_possible)
+		sd->fp_ios++;
+	else
+		sd->ld_ios++;
+	spin_unlock_irqrestore(&sd->lock, flags);
+
+	/* Complete on the reply queue whose vector is closest to this CPU */
 	cmd->request_desc->SCSIIO.MSIxIndex = instance->msix_vectors ?
-		raw_smp_processor_id() % instance->msix_vectors : 0;
+		instance->reply_map[raw_smp_processor_id()] : 0;
 
 	if (fp_possible) {
 		megasas_set_pd_lba(io_request, scp->cmd_len, &io_info, scp,
@@ -1874,7 +1957,7 @@ megasas_build_syspd_fusion(struct megasas_instance *instance,
 	cmd->request_desc->SCSIIO.DevHandle = io_request->DevHandle;
 	cmd->request_desc->SCSIIO.MSIxIndex =
 		instance->msix_vectors ?
-		(raw_smp_processor_id() % instance->msix_vectors) : 0;
+		instance->reply_map[raw_smp_processor_id()] : 0;
 
 
 	if (!fp_possible) {
@@ -2078,10 +2161,20 @@ megasas_build_and_issue_cmd_fusion(struct megasas_instance *instance,
 /**
  * complete_cmd_fusion -	Completes command
  * @instance:			Adapter soft state
- * Completes all commands that is in reply descriptor queue
+ * @MSIxIndex:			Reply queue to drain
+ * @irq_context:		Set when called from the MSI-x handler or iopoll
+ *
+ * Completes all commands that is in reply descriptor queue.  With an
+ * @irq_context, at most THRESHOLD_REPLY_COUNT replies are completed in
+ * this context; if more are pending the vector is masked and the rest is
+ * left to megasas_iopoll() in softirq context, so one busy reply queue
+ * cannot pin its CPU in hard-IRQ context.
+ *
+ * Returns the number of replies completed.
  */
 int
-complete_cmd_fusion(struct megasas_instance *instance, u32 MSIxIndex)
+complete_cmd_fusion(struct megasas_instance *instance, u32 MSIxIndex,
+		    struct megasas_irq_context *irq_context)
 {
 	union MPI2_REPLY_DESCRIPTORS_UNION *desc;
 	struct MPI2_SCSI_IO_SUCCESS_REPLY_DESCRIPTOR *reply_desc;
@@ -2096,12 +2189,18 @@ complete_cmd_fusion(struct megasas_instance *instance, u32 MSIxIndex)
 	struct LD_LOAD_BALANCE_INFO *lbinfo;
 	int threshold_reply_count = 0;
 	struct scsi_cmnd *scmd_local = NULL;
+	struct megasas_irq_context *queue_ctx;
 
 	fusion = instance->ctrl_context;
 
 	if (instance->adprecovery == MEGASAS_HW_CRITICAL_ERROR)
 		return IRQ_HANDLED;
 
+	/* Someone else (ISR, iopoll or the reset tasklet) is on this queue */
+	queue_ctx = &instance->irq_context[MSIxIndex];
+	if (!atomic_add_unless(&queue_ctx->in_used, 1, 1))
+		return 0;
+
 	desc = fusion->reply_frames_desc;
 	desc += ((MSIxIndex * fusion->reply_alloc_sz)/
 		 sizeof(union MPI2_REPLY_DESCRIPTORS_UNION)) +
@@ -2114,8 +2213,10 @@ complete_cmd_fusion(struct megasas_instance *instance, u32 MSIxIndex)
 	reply_descript_type = reply_desc->ReplyFlags &
 		MPI2_RPY_DESCRIPT_FLAGS_TYPE_MASK;
 
-	if (reply_descript_type == MPI2_RPY_DESCRIPT_FLAGS_UNUSED)
-		return IRQ_NONE;
+	if (reply_descript_type == MPI2_RPY_DESCRIPT_FLAGS_UNUSED) {
+		atomic_dec(&queue_ctx->in_used);
+		return 0;
+	}
 
 	num_completed = 0;
 
@@ -2221,11 +2322,22 @@ complete_cmd_fusion(struct megasas_instance *instance, u32 MSIxIndex)
 					fusion->last_reply_idx[MSIxIndex],
 					instance->reply_post_host_index_addr[0]);
 			threshold_reply_count = 0;
+			if (irq_context && instance->msix_vectors) {
+				if (!blk_iopoll_sched_prep(&irq_context->iopoll)) {
+					irq_context->iopoll_scheduled = true;
+					disable_irq_nosync(irq_context->os_irq);
+					blk_iopoll_sched(&irq_context->iopoll);
+				}
+				atomic_dec(&queue_ctx->in_used);
+				return num_completed;
+			}
 		}
 	}
 
-	if (!num_completed)
-		return IRQ_NONE;
+	if (!num_completed) {
+		atomic_dec(&queue_ctx->in_used);
+		return 0;
+	}
 
 	wmb();
 	if (fusion->adapter_type == INVADER_SERIES)
@@ -2237,7 +2349,36 @@ complete_cmd_fusion(struct megasas_instance *instance, u32 MSIxIndex)
 			fusion->last_reply_idx[MSIxIndex],
 			instance->reply_post_host_index_addr[0]);
 	megasas_check_and_restore_queue_depth(instance);
-	return IRQ_HANDLED;
+	atomic_dec(&queue_ctx->in_used);
+	return num_completed;
+}
+
+/**
+ * megasas_iopoll -	Deferred reply processing for one MSI-x vector
+ * @iop:		iopoll instance of the reply queue
+ * @budget:		Replies we may complete in this pass
+ *
+ * Runs in softirq context while the vector is masked.  Once the queue is
+ * drained, the vector is unmasked and the queue checked once more for
+ * replies that were posted while it was masked.
+ */
+int megasas_iopoll(struct blk_iopoll *iop, int budget)
+{
+	struct megasas_irq_context *irq_ctx =
+		container_of(iop, struct megasas_irq_context, iopoll);
+	struct megasas_instance *instance = irq_ctx->instance;
+	int num_entries;
+
+	num_entries = complete_cmd_fusion(instance, irq_ctx->MSIxIndex,
+					  irq_ctx);
+	if (num_entries < budget) {
+		blk_iopoll_complete(iop);
+		irq_ctx->iopoll_scheduled = false;
+		enable_irq(irq_ctx->os_irq);
+		complete_cmd_fusion(instance, irq_ctx->MSIxIndex, irq_ctx);
+	}
+
+	return num_entries;
 }
 
 /**
@@ -2265,7 +2406,7 @@ megasas_complete_cmd_dpc_fusion(unsigned long instance_addr)
 	spin_unlock_irqrestore(&instance->hba_lock, flags);
 
 	for (MSIxIndex = 0 ; MSIxIndex < count; MSIxIndex++)
-		complete_cmd_fusion(instance, MSIxIndex);
+		complete_cmd_fusion(instance, MSIxIndex, NULL);
 }
 
 /**
@@ -2292,7 +2433,7 @@ irqreturn_t megasas_isr_fusion(int irq, void *devp)
 		return IRQ_HANDLED;
 	}
 
-	if (!complete_cmd_fusion(instance, irq_context->MSIxIndex)) {
+	if (!complete_cmd_fusion(instance, irq_context->MSIxIndex, irq_context)) {
 		instance->instancet->clear_intr(instance->reg_set);
 		/* If we didn't complete any commands, check for FW fault */
 		fw_state = instance->instancet->read_fw_status_reg(
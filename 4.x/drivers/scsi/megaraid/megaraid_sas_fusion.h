@@ -643,6 +643,8 @@ struct IO_REQUEST_INFO {
 	u64 start_row;
 	u8  span_arm;	/* span[7:5], arm[4:0] */
 	u8  pd_after_lb;
+	u8  raid_level;
+	u8  stream_detected;
 };
 
 struct MR_LD_TARGET_SYNC {
@@ -703,6 +705,33 @@ struct LD_LOAD_BALANCE_INFO {
 	u64     last_accessed_block[MAX_PHYSICAL_DEVICES];
 };
 
+/*
+ * Sequential stream detection per LD.  mru_bit_map holds the stream
+ * indices in most- to least-recently-used order, one nibble each.
+ */
+#define MAX_STREAMS_TRACKED	8
+#define BITS_PER_INDEX_STREAM	4
+#define STREAM_MASK		((1 << BITS_PER_INDEX_STREAM) - 1)
+#define ZERO_LAST_STREAM	0x0fffffff
+#define MR_STREAM_BITMAP	0x76543210
+/* Largest gap, in blocks, still treated as continuing a read stream */
+#define MR_STREAM_READ_GAP	32
+
+struct STREAM_DETECT {
+	u64	next_seq_lba;	/* next LBA expected in this stream */
+	u8	is_read;
+};
+
+struct LD_STREAM_DETECT {
+	spinlock_t	lock;
+	u32		mru_bit_map;
+	struct STREAM_DETECT stream_track[MAX_STREAMS_TRACKED];
+	/* Statistics, updated under lock */
+	u64		stream_hits;
+	u64		fp_ios;
+	u64		ld_ios;
+};
+
 /* SPAN_SET is info caclulated from span info from Raid map per LD */
 typedef struct _LD_SPAN_SET {
 	u64  log_start_lba;
@@ -723,6 +752,31 @@ typedef struct LOG_BLOCK_SPAN_INFO {
 	LD_SPAN_SET  span_set[MAX_SPAN_DEPTH];
 } LD_SPAN_INFO, *PLD_SPAN_INFO;
 
+/*
+ * Divisor of the per-IO strip/row arithmetic, precomputed when the RAID
+ * map is updated: a shift and mask for powers of two, otherwise a 32-bit
+ * reciprocal.  divisor is 0 until set up and is compared against the live
+ * map value on each use, so a stale entry falls back to do_div().  seq
+ * lets the lockless IO path detect an entry rewritten under it.
+ */
+struct MR_FAST_DIV {
+	seqcount_t seq;
+	struct reciprocal_value recip;
+	u32	divisor;
+	u8	shift;		/* log2(divisor), or MR_FAST_DIV_NOT_POW2 */
+};
+
+#define MR_FAST_DIV_NOT_POW2	0xff
+
+struct LD_FAST_DIV {
+	struct MR_FAST_DIV row_data_size;	/* ldRaid.rowDataSize */
+	struct MR_FAST_DIV row_size;		/* ldRaid.rowSize */
+	struct MR_FAST_DIV mod_factor;		/* ldRaid.modFactor */
+	struct MR_FAST_DIV span_row_size[MAX_SPAN_DEPTH];
+	struct MR_FAST_DIV quad_diff[MAX_QUAD_DEPTH];
+	struct MR_FAST_DIV set_width[MAX_QUAD_DEPTH]; /* span_row_data_width */
+};
+
 struct MR_FW_RAID_MAP_ALL {
 	struct MR_FW_RAID_MAP raidMap;
 	struct MR_LD_SPAN_MAP ldSpanMap[MAX_LOGICAL_DRIVES - 1];
@@ -862,6 +916,8 @@ struct fusion_context {
 	u8 fast_path_io;
 	struct LD_LOAD_BALANCE_INFO load_balance_info[MAX_LOGICAL_DRIVES_EXT];
 	LD_SPAN_INFO log_to_span[MAX_LOGICAL_DRIVES_EXT];
+	struct LD_FAST_DIV ld_fast_div[MAX_LOGICAL_DRIVES_EXT];
+	struct LD_STREAM_DETECT stream_detect_by_ld[MAX_LOGICAL_DRIVES_EXT];
 	u8 adapter_type;
 };
 
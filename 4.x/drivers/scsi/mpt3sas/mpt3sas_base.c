@@ -109,6 +109,12 @@ module_param(irqpoll_weight, int, 0444);
 MODULE_PARM_DESC(irqpoll_weight,
     "irq poll weight (default= one fourth of HBA queue depth)");
 
+static int io_stats_enable = 1;
+module_param(io_stats_enable, int, 0444);
+MODULE_PARM_DESC(io_stats_enable,
+    "record per queue and per target IO latency histograms in debugfs"
+    " (default=1)");
+
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(2,6,20))
 /* diag_buffer_enable is bitwise
  * bit 0 set = TRACE
@@ -2048,6 +2054,70 @@ union reply_descriptor {
 	} u;
 };
 
+/**
+ * _base_reply_q_stats - telemetry of a reply queue
+ * @reply_q: per IRQ's reply queue object
+ *
+ * Returns the per-CPU stats, or NULL when telemetry is disabled.
+ */
+static inline struct mpt3sas_reply_q_stats __percpu *
+_base_reply_q_stats(struct adapter_reply_queue *reply_q)
+{
+	struct MPT3SAS_ADAPTER *ioc = reply_q->ioc;
+
+	if (!ioc->io_stats || reply_q->msix_index >= ioc->io_stats_queues)
+		return NULL;
+	return ioc->io_stats + reply_q->msix_index;
+}
+
+static inline void
+_base_lat_hist_add(struct mpt3sas_lat_hist __percpu *hist, u64 delta_ns)
+{
+	unsigned int bucket = fls64(delta_ns >> 10);
+
+	if (bucket >= MPT3SAS_LAT_HIST_BUCKETS)
+		bucket = MPT3SAS_LAT_HIST_BUCKETS - 1;
+	this_cpu_inc(hist->bucket[bucket]);
+}
+
+/**
+ * _base_io_stats_complete - account the latency of a completed SCSI IO
+ * @ioc: per adapter object
+ * @reply_q: reply queue the reply was posted on
+ * @smid: system request message index
+ *
+ * Called before the completion callback, while the scmd is still owned
+ * by the driver.
+ */
+static void
+_base_io_stats_complete(struct MPT3SAS_ADAPTER *ioc,
+	struct adapter_reply_queue *reply_q, u16 smid)
+{
+	struct mpt3sas_reply_q_stats __percpu *stats;
+	struct MPT3SAS_DEVICE *sas_device_priv_data;
+	struct MPT3SAS_TARGET *sas_target_priv_data;
+	struct scsiio_tracker *st;
+	u64 delta;
+
+	stats = _base_reply_q_stats(reply_q);
+	if (!stats || !smid || smid >= ioc->hi_priority_smid)
+		return;
+	st = mpt3sas_get_st_from_smid(ioc, smid);
+	if (!st || !st->issue_ns || !st->scmd)
+		return;
+
+	delta = ktime_to_ns(ktime_get()) - st->issue_ns;
+	st->issue_ns = 0;
+	_base_lat_hist_add(&stats->lat, delta);
+
+	sas_device_priv_data = st->scmd->device->hostdata;
+	if (!sas_device_priv_data)
+		return;
+	sas_target_priv_data = sas_device_priv_data->sas_target;
+	if (sas_target_priv_data && sas_target_priv_data->lat_hist)
+		_base_lat_hist_add(sas_target_priv_data->lat_hist, delta);
+}
+
 /**
  * _base_process_reply_queue - process the reply descriptors from reply queue
  * @reply_q : per IRQ's reply queue object
@@ -2093,6 +2163,7 @@ _base_process_reply_queue(struct adapter_reply_queue *reply_q)
 		    MPI2_RPY_DESCRIPT_FLAGS_SCSI_IO_SUCCESS ||
 		    request_descript_type ==
 		    MPI26_RPY_DESCRIPT_FLAGS_PCIE_ENCAPSULATED_SUCCESS) {
+			_base_io_stats_complete(ioc, reply_q, smid);
 			cb_idx = _base_get_cb_idx(ioc, smid);
 			if ((likely(cb_idx < MPT_MAX_CALLBACKS)) &&
 			    (likely(mpt_callbacks[cb_idx] != NULL))) {
@@ -2109,6 +2180,7 @@ _base_process_reply_queue(struct adapter_reply_queue *reply_q)
 			    reply < ioc->reply_dma_min_address)
 				reply = 0;
 			if (smid) {
+				_base_io_stats_complete(ioc, reply_q, smid);
 				cb_idx = _base_get_cb_idx(ioc, smid);
 				if ((likely(cb_idx < MPT_MAX_CALLBACKS)) &&
 				    (likely(mpt_callbacks[cb_idx] != NULL))) {
@@ -2193,6 +2265,11 @@ _base_process_reply_queue(struct adapter_reply_queue *reply_q)
 #if defined(MPT3SAS_ENABLE_IRQ_POLL)
 			if (!reply_q->is_blk_mq_poll_q &&
 			    !reply_q->irq_poll_scheduled) {
+				struct mpt3sas_reply_q_stats __percpu *stats =
+				    _base_reply_q_stats(reply_q);
+
+				if (stats)
+					this_cpu_inc(stats->irqpoll_scheds);
 				reply_q->irq_poll_scheduled = true;
 				irq_poll_sched(&reply_q->irqpoll);
 			}
@@ -2258,6 +2335,13 @@ int mpt3sas_blk_mq_poll(struct Scsi_Host *shost, unsigned int queue_num)
 
 	num_entries = _base_process_reply_queue(reply_q);
 	atomic_dec(&ioc->blk_mq_poll_queues[qid].busy);
+	if (num_entries) {
+		struct mpt3sas_reply_q_stats __percpu *stats =
+		    _base_reply_q_stats(reply_q);
+
+		if (stats)
+			this_cpu_add(stats->mq_poll_replies, num_entries);
+	}
 
 	return num_entries;
 }
@@ -2280,6 +2364,8 @@ _base_interrupt(int irq, void *bus_id, struct pt_regs *r)
 {
 	struct adapter_reply_queue *reply_q = bus_id;
 	struct MPT3SAS_ADAPTER *ioc = reply_q->ioc;
+	struct mpt3sas_reply_q_stats __percpu *stats;
+	int num_entries;
 
 	if (ioc->mask_interrupts)
 		return IRQ_NONE;
@@ -2289,8 +2375,14 @@ _base_interrupt(int irq, void *bus_id, struct pt_regs *r)
 		return IRQ_HANDLED;
 #endif
 
-	return ((_base_process_reply_queue(reply_q) > 0) ?
-	    IRQ_HANDLED : IRQ_NONE); 
+	num_entries = _base_process_reply_queue(reply_q);
+	stats = _base_reply_q_stats(reply_q);
+	if (stats) {
+		this_cpu_inc(stats->isr_calls);
+		this_cpu_add(stats->isr_replies, num_entries);
+	}
+
+	return ((num_entries > 0) ? IRQ_HANDLED : IRQ_NONE);
 }
 
 #if defined(MPT3SAS_ENABLE_IRQ_POLL)
@@ -2314,6 +2406,13 @@ _base_irqpoll(struct irq_poll *irqpoll, int budget) {
 	}
 	
 	num_entries = _base_process_reply_queue(reply_q);
+	if (num_entries) {
+		struct mpt3sas_reply_q_stats __percpu *stats =
+		    _base_reply_q_stats(reply_q);
+
+		if (stats)
+			this_cpu_add(stats->irqpoll_replies, num_entries);
+	}
 	if (num_entries < budget) {
 		irq_poll_complete(irqpoll);
 		reply_q->irq_poll_scheduled = false;
@@ -2611,18 +2710,16 @@ static struct chain_tracker *
 _base_get_chain_buffer_tracker(struct MPT3SAS_ADAPTER *ioc,
 			      struct scsi_cmnd *scmd)
 {
-	struct chain_tracker *chain_req;
 	struct scsiio_tracker *st = mpt3sas_base_scsi_cmd_priv(scmd);
-	u16 smid = st->smid;
-	u8 chain_offset =
-	   atomic_read(&ioc->chain_lookup[smid - 1].chain_offset);
+	struct chain_lookup *lookup = &ioc->chain_lookup[st->smid - 1];
 
-	if (chain_offset == ioc->chains_needed_per_io)
+	if (unlikely(lookup->chain_offset >= ioc->chains_needed_per_io)) {
+		if (ioc->sgl_stats)
+			this_cpu_inc(ioc->sgl_stats->chain_exhausted);
 		return NULL;
+	}
 
-	chain_req = &ioc->chain_lookup[smid - 1].chains_per_smid[chain_offset];
-	atomic_inc(&ioc->chain_lookup[smid - 1].chain_offset);
-	return chain_req;
+	return &lookup->chains_per_smid[lookup->chain_offset++];
 }
 
 
@@ -3506,16 +3603,20 @@ _base_build_sg_scmd(struct MPT3SAS_ADAPTER *ioc,
  *
  * Return nothing.
  */
-static void
+static inline void
 _base_add_sg_single_ieee(void *paddr, u8 flags, u8 chain_offset, u32 length,
 	dma_addr_t dma_addr)
 {
 	Mpi25IeeeSgeChain64_t *sgel = paddr;
 
-	sgel->Flags = flags;
-	sgel->NextChainOffset = chain_offset;
-	sgel->Length = cpu_to_le32(length);
+	/*
+	 * Length, Reserved1, NextChainOffset and Flags make up the upper
+	 * little endian quadword; with the flags constant at every call site
+	 * this folds to two 64-bit stores per element.
+	 */
 	sgel->Address = cpu_to_le64(dma_addr);
+	*(__le64 *)&sgel->Length = cpu_to_le64((u64)flags << 56 |
+	    (u64)chain_offset << 48 | length);
 }
 
 /**
@@ -3573,6 +3674,7 @@ _base_build_sg_scmd_ieee(struct MPT3SAS_ADAPTER *ioc,
 	u8 simple_sgl_flags;
 	u8 simple_sgl_flags_last;
 	u8 chain_sgl_flags;
+	u8 dix;
 	struct chain_tracker *chain_req;
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,27))
 	struct scatterlist *sg_prot_scmd = NULL; /* s/g prot entry */
@@ -3656,21 +3758,16 @@ _base_build_sg_scmd_ieee(struct MPT3SAS_ADAPTER *ioc,
 #endif
 	sgl_zero_addr = sg_local = &mpi_request->SGL;
 
-	if (mpi_request->DMAFlags == MPI25_TA_DMAFLAGS_OP_D_H_D_D) {
-		/* reserve last SGE for SGL1 */ 
-		sges_in_request_frame = sges_in_segment =
-		    ((ioc->request_sz - ioc->sge_size_ieee) -
-		    offsetof(Mpi25SCSIIORequest_t, SGL))/ioc->sge_size_ieee;
-	} else {
-		sges_in_segment = (ioc->request_sz -
-		   offsetof(Mpi25SCSIIORequest_t, SGL))/ioc->sge_size_ieee;
-	}
+	/* frame layout is fixed per adapter, see _base_init_ieee_sgl_layout */
+	dix = (mpi_request->DMAFlags == MPI25_TA_DMAFLAGS_OP_D_H_D_D);
+	sges_in_segment = ioc->ieee_sges_in_main[dix];
+	if (dix) /* reserve last SGE for SGL1 */
+		sges_in_request_frame = sges_in_segment;
 
 	if (sges_left <= sges_in_segment)
 		goto fill_in_last_segment;
 
-	mpi_request->ChainOffset = (sges_in_segment - 1 /* chain element */) +
-	    (offsetof(Mpi25SCSIIORequest_t, SGL)/ioc->sge_size_ieee);
+	mpi_request->ChainOffset = ioc->ieee_main_chain_offset[dix];
 
 	/* fill in main message segment when there is a chain following */
 	while (sges_in_segment > 1) {
@@ -5903,6 +6000,20 @@ _base_recovery_check(struct MPT3SAS_ADAPTER *ioc)
 	}
 }
 
+/**
+ * _base_sgl_stats_complete - account the chain buffers used by a SCSI IO
+ * @ioc: per adapter object
+ * @chains: chain buffers taken from the smid's chain_lookup
+ */
+static inline void
+_base_sgl_stats_complete(struct MPT3SAS_ADAPTER *ioc, u16 chains)
+{
+	this_cpu_inc(ioc->sgl_stats->chains_hist[min_t(u16, chains,
+	    MPT3SAS_CHAIN_HIST_BUCKETS - 1)]);
+	if (chains)
+		this_cpu_add(ioc->sgl_stats->chains, chains);
+}
+
 void mpt3sas_base_clear_st(struct MPT3SAS_ADAPTER *ioc,
 			  struct scsiio_tracker *st)
 {
@@ -5910,10 +6021,13 @@ void mpt3sas_base_clear_st(struct MPT3SAS_ADAPTER *ioc,
 		return;
 	if (WARN_ON(st->smid == 0))
 		return;
+	if (st->scmd && ioc->sgl_stats)
+		_base_sgl_stats_complete(ioc,
+		    ioc->chain_lookup[st->smid - 1].chain_offset);
 	st->cb_idx = 0xFF;
 	st->direct_io = 0;
 	st->scmd = NULL;
-	atomic_set(&ioc->chain_lookup[st->smid - 1].chain_offset, 0);
+	ioc->chain_lookup[st->smid - 1].chain_offset = 0;
 }
 
 /**
@@ -6045,6 +6159,8 @@ _base_set_and_get_msix_index(struct MPT3SAS_ADAPTER *ioc, u16 smid)
 		return  _base_get_msix_index(ioc, NULL);
 
 	st->msix_io = ioc->get_msix_index_for_smlio(ioc, st->scmd);
+	if (ioc->io_stats)
+		st->issue_ns = ktime_to_ns(ktime_get());
 	return st->msix_io;
 }
 
@@ -8234,6 +8350,30 @@ _base_allocate_reply_pool(struct MPT3SAS_ADAPTER *ioc, int sz)
 	return 0;
 }
 
+/**
+ * _base_init_ieee_sgl_layout - precompute the IEEE SCSI IO frame layout
+ * @ioc: per adapter object
+ *
+ * The number of SGEs that fit in the request frame and the ChainOffset
+ * pointing at the last of them depend only on request_sz, so work them
+ * out once instead of per IO.  Index 1 is the DIX layout, where the last
+ * SGE of the frame is reserved for SGL1.
+ */
+static void
+_base_init_ieee_sgl_layout(struct MPT3SAS_ADAPTER *ioc)
+{
+	u16 sgl_start = offsetof(Mpi25SCSIIORequest_t, SGL);
+	int dix;
+
+	for (dix = 0; dix < 2; dix++) {
+		ioc->ieee_sges_in_main[dix] = (ioc->request_sz -
+		    dix * ioc->sge_size_ieee - sgl_start) / ioc->sge_size_ieee;
+		ioc->ieee_main_chain_offset[dix] =
+		    (ioc->ieee_sges_in_main[dix] - 1 /* chain element */) +
+		    sgl_start / ioc->sge_size_ieee;
+	}
+}
+
 /**
  * _base_allocate_memory_pools - allocate start of day memory pools
  * @ioc: per adapter object
@@ -8384,6 +8524,9 @@ retry:
 	max_sge_elements = ioc->chain_segment_sz - sge_size;
 	ioc->max_sges_in_chain_message = max_sge_elements/sge_size;
 
+	if (ioc->hba_mpi_version_belonged != MPI2_VERSION)
+		_base_init_ieee_sgl_layout(ioc);
+
 	/*
 	 *  MPT3SAS_SG_DEPTH = CONFIG_FUSION_MAX_SGE
 	 */
@@ -10068,6 +10211,19 @@ mpt3sas_base_attach(struct MPT3SAS_ADAPTER *ioc)
 #if defined(MPT3SAS_ENABLE_IRQ_POLL)
 	_base_init_irqpolls(ioc);
 #endif
+	if (io_stats_enable && !ioc->io_stats) {
+		ioc->io_stats = __alloc_percpu(ioc->reply_queue_count *
+		    sizeof(struct mpt3sas_reply_q_stats),
+		    __alignof__(struct mpt3sas_reply_q_stats));
+		if (ioc->io_stats)
+			ioc->io_stats_queues = ioc->reply_queue_count;
+		else
+			printk(MPT3SAS_INFO_FMT
+			    "IO statistics disabled, allocation failed\n",
+			    ioc->name);
+	}
+	if (ioc->io_stats && !ioc->sgl_stats)
+		ioc->sgl_stats = alloc_percpu(struct mpt3sas_sgl_stats);
 	init_waitqueue_head(&ioc->reset_wq);
 
 	/* allocate memory pd handle bitmask list */
@@ -10232,6 +10388,10 @@ mpt3sas_base_attach(struct MPT3SAS_ADAPTER *ioc)
 	kfree(ioc->ctl_cmds.sense);
 	kfree(ioc->ctl_diag_cmds.reply);
 	kfree(ioc->pfacts);
+	free_percpu(ioc->io_stats);
+	ioc->io_stats = NULL;
+	free_percpu(ioc->sgl_stats);
+	ioc->sgl_stats = NULL;
 	ioc->ctl_cmds.reply = NULL;
 	ioc->base_cmds.reply = NULL;
 	ioc->tm_cmds.reply = NULL;
@@ -10279,6 +10439,10 @@ mpt3sas_base_detach(struct MPT3SAS_ADAPTER *ioc)
 	kfree(ioc->transport_cmds.reply);
 	kfree(ioc->scsih_cmds.reply);
 	kfree(ioc->config_cmds.reply);
+	free_percpu(ioc->io_stats);
+	ioc->io_stats = NULL;
+	free_percpu(ioc->sgl_stats);
+	ioc->sgl_stats = NULL;
 }
 
 static void
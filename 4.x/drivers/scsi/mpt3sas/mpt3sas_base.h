@@ -719,6 +719,7 @@ struct MPT3SAS_TARGET {
 	struct hba_port *port;
 	struct	_sas_device *sas_dev;
 	struct	_pcie_device *pcie_dev;
+	struct mpt3sas_lat_hist __percpu *lat_hist;
 };
 
 /*
@@ -1203,9 +1204,18 @@ struct chain_tracker {
 	dma_addr_t chain_buffer_dma;
 };
 
+/**
+ * struct chain_lookup - chain buffers owned by one smid
+ * @chains_per_smid: chains_needed_per_io trackers, preallocated
+ * @chain_offset: next free entry in @chains_per_smid
+ *
+ * The smid is the blk-mq tag, so between get and free it is owned by the
+ * single context building or completing it, and @chain_offset needs no
+ * atomics.
+ */
 struct chain_lookup {
 	struct chain_tracker *chains_per_smid;
-	atomic_t	chain_offset;
+	u16		chain_offset;
 };
 
 /**
@@ -1226,6 +1236,7 @@ struct scsiio_tracker {
 	u8	direct_io;
 	struct list_head chain_list;
 	u16     msix_io;
+	u64	issue_ns;
 };
 
 /**
@@ -1310,6 +1321,54 @@ struct adapter_reply_queue {
 };
 
 
+/*
+ * Host side IO telemetry, see mpt3sas_debugfs.c.  Kept per CPU so that
+ * recording it never bounces a cache line.  Latency is submit to reply,
+ * bucketed by log2 in units of 1024ns: bucket 0 is below 1us, bucket n
+ * covers [2^(n-1), 2^n) and the last bucket everything above.
+ */
+#define MPT3SAS_LAT_HIST_BUCKETS	20
+
+struct mpt3sas_lat_hist {
+	u64	bucket[MPT3SAS_LAT_HIST_BUCKETS];
+};
+
+/**
+ * struct mpt3sas_reply_q_stats - per reply queue telemetry
+ * @lat: latency of the SCSI IOs completed on this queue
+ * @isr_calls: interrupts taken, including ones that found no reply
+ * @isr_replies: reply descriptors processed in interrupt context
+ * @irqpoll_scheds: times the ISR handed the queue to irq_poll
+ * @irqpoll_replies: reply descriptors processed by irq_poll
+ * @mq_poll_replies: reply descriptors processed by blk-mq polling
+ */
+struct mpt3sas_reply_q_stats {
+	struct mpt3sas_lat_hist lat;
+	u64	isr_calls;
+	u64	isr_replies;
+	u64	irqpoll_scheds;
+	u64	irqpoll_replies;
+	u64	mq_poll_replies;
+};
+
+/*
+ * Chain buffer usage of SCSI IO, per CPU.  chains_hist[n] counts IOs
+ * that used n chain buffers, the last bucket those that used more.
+ */
+#define MPT3SAS_CHAIN_HIST_BUCKETS	8
+
+/**
+ * struct mpt3sas_sgl_stats - scatter gather list telemetry
+ * @chains_hist: IOs by number of chain buffers used
+ * @chains: chain buffers used in total
+ * @chain_exhausted: SGL builds that ran out of chain buffers
+ */
+struct mpt3sas_sgl_stats {
+	u64	chains_hist[MPT3SAS_CHAIN_HIST_BUCKETS];
+	u64	chains;
+	u64	chain_exhausted;
+};
+
 struct blk_mq_poll_queue {
 	atomic_t	busy;
 	atomic_t	pause;
@@ -1622,6 +1681,9 @@ typedef void (*MPT3SAS_FLUSH_RUNNING_CMDS)(struct MPT3SAS_ADAPTER *ioc);
  * @chain_dma:
  * @max_sges_in_main_message: number sg elements in main message
  * @max_sges_in_chain_message: number sg elements per chain
+ * @ieee_sges_in_main: IEEE SGEs that fit in the SCSI IO frame, chain
+ *		      element included; [1] with SGL1 reserved for DIX
+ * @ieee_main_chain_offset: ChainOffset for a chain after ieee_sges_in_main
  * @chains_needed_per_io: max chains per io
  * @chain_segment_sz: givesthe max number of SGEs accomodate on single
  * 		      chain buffer
@@ -2067,6 +2129,11 @@ struct MPT3SAS_ADAPTER {
 	struct dentry *ioc_dump;
 #endif
 	struct list_head port_table_list;
+	struct mpt3sas_reply_q_stats __percpu *io_stats;
+	u16		io_stats_queues;
+	struct mpt3sas_sgl_stats __percpu *sgl_stats;
+	u16		ieee_sges_in_main[2];
+	u8		ieee_main_chain_offset[2];
 };
 
 struct mpt3sas_debugfs_buffer {
@@ -56,6 +56,7 @@
 
 #ifdef CONFIG_DEBUG_FS
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 struct dentry *mpt3sas_debugfs_root = NULL;
 
@@ -118,6 +119,163 @@ static const struct file_operations mpt3sas_debugfs_iocdump_fops = {
 	.release        = _debugfs_iocdump_release,
 };
 
+static void
+_debugfs_lat_hist_show(struct seq_file *m, struct mpt3sas_lat_hist __percpu *hist)
+{
+	u64 sum;
+	int cpu, i;
+
+	for (i = 0; i < MPT3SAS_LAT_HIST_BUCKETS; i++) {
+		sum = 0;
+		for_each_possible_cpu(cpu)
+			sum += per_cpu_ptr(hist, cpu)->bucket[i];
+		seq_printf(m, " %llu", (unsigned long long)sum);
+	}
+	seq_putc(m, '\n');
+}
+
+static void
+_debugfs_sgl_stats_show(struct seq_file *m, struct MPT3SAS_ADAPTER *ioc)
+{
+	struct mpt3sas_sgl_stats total, *s;
+	u64 ios = 0, per_io;
+	int cpu, i;
+
+	if (!ioc->sgl_stats)
+		return;
+
+	memset(&total, 0, sizeof(total));
+	for_each_possible_cpu(cpu) {
+		s = per_cpu_ptr(ioc->sgl_stats, cpu);
+		for (i = 0; i < MPT3SAS_CHAIN_HIST_BUCKETS; i++)
+			total.chains_hist[i] += s->chains_hist[i];
+		total.chains += s->chains;
+		total.chain_exhausted += s->chain_exhausted;
+	}
+	for (i = 0; i < MPT3SAS_CHAIN_HIST_BUCKETS; i++)
+		ios += total.chains_hist[i];
+	/* chain buffers per IO, in hundredths */
+	per_io = ios ? div64_u64(total.chains * 100, ios) : 0;
+
+	seq_printf(m, "\nscsi_ios %llu chains %llu chains_per_io %llu.%02llu"
+	    " chain_exhausted %llu\n", (unsigned long long)ios,
+	    (unsigned long long)total.chains,
+	    (unsigned long long)div64_u64(per_io, 100),
+	    (unsigned long long)(per_io - div64_u64(per_io, 100) * 100),
+	    (unsigned long long)total.chain_exhausted);
+	seq_printf(m, "ios by chains used (0..%d+):",
+	    MPT3SAS_CHAIN_HIST_BUCKETS - 1);
+	for (i = 0; i < MPT3SAS_CHAIN_HIST_BUCKETS; i++)
+		seq_printf(m, " %llu",
+		    (unsigned long long)total.chains_hist[i]);
+	seq_putc(m, '\n');
+}
+
+/*
+ * _debugfs_io_stats_show :	dump the host side IO telemetry
+ *
+ * Outstanding counts are sampled from the scsi lookup when read, so the
+ * IO path pays nothing for them.
+ */
+static int
+_debugfs_io_stats_show(struct seq_file *m, void *v)
+{
+	struct MPT3SAS_ADAPTER *ioc = m->private;
+	struct mpt3sas_reply_q_stats total, *s;
+	struct scsi_target *starget, *last = NULL;
+	struct MPT3SAS_TARGET *sas_target_priv_data;
+	struct scsiio_tracker *st;
+	struct scsi_device *sdev;
+	struct scsi_cmnd *scmd;
+	u32 *outstanding;
+	u64 per_isr;
+	u16 smid, q;
+	int cpu;
+
+	if (!ioc->io_stats) {
+		seq_puts(m, "disabled (io_stats_enable=0)\n");
+		return 0;
+	}
+
+	outstanding = kcalloc(ioc->io_stats_queues, sizeof(u32), GFP_KERNEL);
+	if (!outstanding)
+		return -ENOMEM;
+	for (smid = 1; smid <= ioc->shost->can_queue; smid++) {
+		scmd = mpt3sas_scsih_scsi_lookup_get(ioc, smid);
+		if (!scmd)
+			continue;
+		st = mpt3sas_base_scsi_cmd_priv(scmd);
+		if (st && st->smid && st->msix_io < ioc->io_stats_queues)
+			outstanding[st->msix_io]++;
+	}
+
+	seq_puts(m, "reply_q outstanding isr_calls isr_replies replies_per_isr"
+	    " irqpoll_scheds irqpoll_replies mq_poll_replies\n");
+	for (q = 0; q < ioc->io_stats_queues; q++) {
+		memset(&total, 0, sizeof(total));
+		for_each_possible_cpu(cpu) {
+			s = per_cpu_ptr(ioc->io_stats + q, cpu);
+			total.isr_calls += s->isr_calls;
+			total.isr_replies += s->isr_replies;
+			total.irqpoll_scheds += s->irqpoll_scheds;
+			total.irqpoll_replies += s->irqpoll_replies;
+			total.mq_poll_replies += s->mq_poll_replies;
+		}
+		/* interrupt coalescing effectiveness, in hundredths */
+		per_isr = total.isr_calls ?
+		    div64_u64(total.isr_replies * 100, total.isr_calls) : 0;
+		seq_printf(m, "%u %u %llu %llu %llu.%02llu %llu %llu %llu\n",
+		    q, outstanding[q],
+		    (unsigned long long)total.isr_calls,
+		    (unsigned long long)total.isr_replies,
+		    (unsigned long long)div64_u64(per_isr, 100),
+		    (unsigned long long)(per_isr - div64_u64(per_isr, 100) * 100),
+		    (unsigned long long)total.irqpoll_scheds,
+		    (unsigned long long)total.irqpoll_replies,
+		    (unsigned long long)total.mq_poll_replies);
+	}
+	kfree(outstanding);
+
+	_debugfs_sgl_stats_show(m, ioc);
+
+	seq_printf(m, "\nlatency histogram: %d log2 buckets of 1024ns,"
+	    " first < 1us\n", MPT3SAS_LAT_HIST_BUCKETS);
+	for (q = 0; q < ioc->io_stats_queues; q++) {
+		seq_printf(m, "reply_q %u:", q);
+		_debugfs_lat_hist_show(m, &(ioc->io_stats + q)->lat);
+	}
+
+	shost_for_each_device(sdev, ioc->shost) {
+		starget = scsi_target(sdev);
+		if (starget == last)
+			continue;
+		last = starget;
+		sas_target_priv_data = starget->hostdata;
+		if (!sas_target_priv_data || !sas_target_priv_data->lat_hist)
+			continue;
+		seq_printf(m, "target %d:%d 0x%016llx:", starget->channel,
+		    starget->id,
+		    (unsigned long long)sas_target_priv_data->sas_address);
+		_debugfs_lat_hist_show(m, sas_target_priv_data->lat_hist);
+	}
+
+	return 0;
+}
+
+static int
+_debugfs_io_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, _debugfs_io_stats_show, inode->i_private);
+}
+
+static const struct file_operations mpt3sas_debugfs_io_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= _debugfs_io_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 /*
  * mpt3sas_init_debugfs :	Create debugfs root for mpt3sas driver
  */
@@ -170,6 +328,10 @@ mpt3sas_setup_debugfs(struct MPT3SAS_ADAPTER *ioc)
 	snprintf(name, sizeof(name), "host_recovery");
 	debugfs_create_u8(name, S_IRUGO, ioc->debugfs_root, &ioc->shost_recovery);
 
+	snprintf(name, sizeof(name), "io_stats");
+	debugfs_create_file(name, S_IRUGO, ioc->debugfs_root, ioc,
+	    &mpt3sas_debugfs_io_stats_fops);
+
 }
 
 /*
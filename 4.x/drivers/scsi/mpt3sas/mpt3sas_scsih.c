@@ -2304,6 +2304,12 @@ _scsih_target_alloc(struct scsi_target *starget)
 	if (!sas_target_priv_data)
 		return -ENOMEM;
 
+	if (ioc->io_stats) {
+		/* Telemetry only; the target works without it */
+		sas_target_priv_data->lat_hist =
+		    alloc_percpu(struct mpt3sas_lat_hist);
+	}
+
 	starget->hostdata = sas_target_priv_data;
 	sas_target_priv_data->starget = starget;
 	sas_target_priv_data->handle = MPT3SAS_INVALID_DEVICE_HANDLE;
@@ -2447,6 +2453,7 @@ _scsih_target_destroy(struct scsi_target *starget)
 	spin_unlock_irqrestore(&ioc->sas_device_lock, flags);
 
  out:
+	free_percpu(sas_target_priv_data->lat_hist);
 	kfree(sas_target_priv_data);
 	starget->hostdata = NULL;
 }
@@ -343,7 +343,8 @@ scsi_get_host_cmd_pool(struct Scsi_Host *shost)
 {
 	struct scsi_host_template *hostt = shost->hostt;
 	struct scsi_host_cmd_pool *retval = NULL, *pool;
-	size_t cmd_size = sizeof(struct scsi_cmnd) + hostt->cmd_size;
+	size_t cmd_size = scsi_cmd_acct_offset(hostt) +
+			  sizeof(struct scsi_cmd_acct);
 
 	/*
 	 * Select a command slab for this host and create it if not
@@ -122,6 +122,7 @@ static void scsi_mq_requeue_cmd(struct scsi_cmnd *cmd)
 	struct scsi_device *sdev = cmd->device;
 	struct request_queue *q = cmd->request->q;
 
+	scsi_sdev_stats_inc(sdev, requeue_cnt);
 	blk_mq_requeue_request(cmd->request);
 	blk_mq_kick_requeue_list(q);
 	put_device(&sdev->sdev_gendev);
@@ -168,6 +169,7 @@ static void __scsi_queue_insert(struct scsi_cmnd *cmd, int reason, int unbusy)
 		scsi_mq_requeue_cmd(cmd);
 		return;
 	}
+	scsi_sdev_stats_inc(device, requeue_cnt);
 	spin_lock_irqsave(q->queue_lock, flags);
 	blk_requeue_request(q, cmd->request);
 	kblockd_schedule_work(&device->requeue_work);
@@ -532,6 +534,7 @@ static void scsi_requeue_command(struct request_queue *q, struct scsi_cmnd *cmd)
 	struct request *req = cmd->request;
 	unsigned long flags;
 
+	scsi_sdev_stats_inc(sdev, requeue_cnt);
 	spin_lock_irqsave(q->queue_lock, flags);
 	blk_unprep_request(req);
 	req->special = NULL;
@@ -1436,6 +1439,7 @@ static inline int scsi_dev_queue_ready(struct request_queue *q,
 	return 1;
 out_dec:
 	atomic_dec(&sdev->device_busy);
+	scsi_sdev_stats_inc(sdev, dev_busy);
 	return 0;
 }
 
@@ -1454,6 +1458,7 @@ static inline int scsi_target_queue_ready(struct Scsi_Host *shost,
 		if (starget->starget_sdev_user &&
 		    starget->starget_sdev_user != sdev) {
 			spin_unlock_irq(shost->host_lock);
+			scsi_sdev_stats_inc(sdev, target_busy);
 			return 0;
 		}
 		starget->starget_sdev_user = sdev;
@@ -1490,6 +1495,7 @@ starved:
 out_dec:
 	if (starget->can_queue > 0)
 		atomic_dec(&starget->target_busy);
+	scsi_sdev_stats_inc(sdev, target_busy);
 	return 0;
 }
 
@@ -1504,8 +1510,10 @@ static inline int scsi_host_queue_ready(struct request_queue *q,
 {
 	unsigned int busy;
 
-	if (scsi_host_in_recovery(shost))
+	if (scsi_host_in_recovery(shost)) {
+		scsi_sdev_stats_inc(sdev, host_busy);
 		return 0;
+	}
 
 	busy = atomic_inc_return(&shost->host_busy) - 1;
 	if (atomic_read(&shost->host_blocked) > 0) {
@@ -1545,6 +1553,7 @@ starved:
 	spin_unlock_irq(shost->host_lock);
 out_dec:
 	atomic_dec(&shost->host_busy);
+	scsi_sdev_stats_inc(sdev, host_busy);
 	return 0;
 }
 
@@ -1668,6 +1677,9 @@ static int scsi_dispatch_cmd(struct scsi_cmnd *cmd)
 	int rtn = 0;
 
 	atomic_inc(&cmd->device->iorequest_cnt);
+	/* latency is only timed while the queue's iostats are enabled */
+	scsi_cmd_acct(cmd)->dispatch_ns =
+		blk_queue_io_stat(cmd->request->q) ? ktime_get_ns() : 0;
 
 	/* check if the device is still usable */
 	if (unlikely(cmd->device->sdev_state == SDEV_DEL)) {
@@ -1722,6 +1734,7 @@ static int scsi_dispatch_cmd(struct scsi_cmnd *cmd)
 	rtn = host->hostt->queuecommand(host, cmd);
 	if (rtn) {
 		trace_scsi_dispatch_cmd_error(cmd, rtn);
+		scsi_sdev_stats_inc(cmd->device, lld_busy);
 		if (rtn != SCSI_MLQUEUE_DEVICE_BUSY &&
 		    rtn != SCSI_MLQUEUE_TARGET_BUSY)
 			rtn = SCSI_MLQUEUE_HOST_BUSY;
@@ -1736,6 +1749,50 @@ static int scsi_dispatch_cmd(struct scsi_cmnd *cmd)
 	return 0;
 }
 
+/*
+ * Account the dispatch-to-completion latency of a command the LLD has
+ * just handed back, if it was timestamped in scsi_dispatch_cmd().
+ */
+static inline void scsi_io_stats_done(struct scsi_cmnd *cmd)
+{
+	struct scsi_io_stats __percpu *stats = scsi_sdev_stats(cmd->device);
+	u64 dispatch_ns = scsi_cmd_acct(cmd)->dispatch_ns;
+	u64 ns;
+	unsigned int bucket;
+
+	if (!dispatch_ns)
+		return;
+	ns = ktime_get_ns() - dispatch_ns;
+	bucket = min_t(unsigned int, fls64(ns >> SCSI_IOLAT_SHIFT),
+		       SCSI_IOLAT_BUCKETS - 1);
+	this_cpu_inc(stats->lat_hist[bucket]);
+	this_cpu_add(stats->lat_ns, ns);
+}
+
+/**
+ * scsi_io_stats_sum - fold a device's per-CPU IO accounting
+ * @sdev:	device to report on
+ * @sum:	accumulated into, so it can be used to total a whole host
+ */
+void scsi_io_stats_sum(struct scsi_device *sdev, struct scsi_io_stats *sum)
+{
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		struct scsi_io_stats *s = per_cpu_ptr(scsi_sdev_stats(sdev), cpu);
+
+		for (i = 0; i < SCSI_IOLAT_BUCKETS; i++)
+			sum->lat_hist[i] += s->lat_hist[i];
+		sum->lat_ns += s->lat_ns;
+		sum->requeue_cnt += s->requeue_cnt;
+		sum->eh_cnt += s->eh_cnt;
+		sum->dev_busy += s->dev_busy;
+		sum->target_busy += s->target_busy;
+		sum->host_busy += s->host_busy;
+		sum->lld_busy += s->lld_busy;
+	}
+}
+
 /**
  * scsi_done - Invoke completion on finished SCSI command.
  * @cmd: The SCSI Command for which a low-level device driver (LLDD) gives
@@ -1750,6 +1807,7 @@ static int scsi_dispatch_cmd(struct scsi_cmnd *cmd)
 static void scsi_done(struct scsi_cmnd *cmd)
 {
 	trace_scsi_dispatch_cmd_done(cmd);
+	scsi_io_stats_done(cmd);
 	blk_complete_request(cmd->request);
 }
 
@@ -1928,7 +1986,8 @@ static int scsi_mq_prep_fn(struct request *req)
 		spin_unlock_irq(&sdev->list_lock);
 	}
 
-	sg = (void *)cmd + sizeof(struct scsi_cmnd) + shost->hostt->cmd_size;
+	sg = (void *)cmd + scsi_cmd_acct_offset(shost->hostt) +
+		sizeof(struct scsi_cmd_acct);
 	cmd->sdb.table.sgl = sg;
 
 	if (scsi_host_get_prot(shost)) {
@@ -1961,6 +2020,7 @@ static int scsi_mq_prep_fn(struct request *req)
 static void scsi_mq_done(struct scsi_cmnd *cmd)
 {
 	trace_scsi_dispatch_cmd_done(cmd);
+	scsi_io_stats_done(cmd);
 	blk_mq_complete_request(cmd->request, cmd->request->errors);
 }
 
@@ -2192,7 +2252,8 @@ int scsi_mq_setup_tags(struct Scsi_Host *shost)
 	if (tbl_size > SCSI_MAX_SG_SEGMENTS)
 		tbl_size = SCSI_MAX_SG_SEGMENTS;
 	sgl_size = tbl_size * sizeof(struct scatterlist);
-	cmd_size = sizeof(struct scsi_cmnd) + shost->hostt->cmd_size + sgl_size;
+	cmd_size = scsi_cmd_acct_offset(shost->hostt) +
+		sizeof(struct scsi_cmd_acct) + sgl_size;
 	if (scsi_host_get_prot(shost))
 		cmd_size += sizeof(struct scsi_data_buffer) + sgl_size;
 
@@ -3,7 +3,11 @@
 
 #include <linux/device.h>
 #include <linux/async.h>
+#include <linux/percpu.h>
+#include <scsi/scsi_cmnd.h>
 #include <scsi/scsi_device.h>
+#include <scsi/scsi_host.h>
+#include <scsi/scsi_transport.h>
 
 struct request_queue;
 struct request;
@@ -95,6 +99,75 @@ struct request_queue;
 struct request;
 extern struct kmem_cache *scsi_sdb_cache;
 
+/*
+ * IO accounting.
+ *
+ * Every scsi_device carries a per-CPU struct scsi_io_stats, reachable
+ * through a pointer stored behind the transport's device_size bytes.
+ * Host-wide numbers are summed over the host's devices when read.
+ *
+ * Dispatch-to-completion latency goes into log2 buckets; bucket 0 holds
+ * everything below 2^SCSI_IOLAT_SHIFT ns (~16us), each following bucket
+ * covers twice the range of the previous one, the last is open ended.
+ * Like the disk's own time accounting it is only collected while the
+ * request queue's iostats attribute is set.
+ */
+#define SCSI_IOLAT_SHIFT	14
+#define SCSI_IOLAT_BUCKETS	16
+
+struct scsi_io_stats {
+	u64	lat_hist[SCSI_IOLAT_BUCKETS];
+	u64	lat_ns;		/* sum of all latencies in lat_hist */
+	u64	requeue_cnt;	/* commands put back on the request queue */
+	u64	eh_cnt;		/* commands handed to the error handler */
+	u64	dev_busy;	/* dispatch refused: device queue full/blocked */
+	u64	target_busy;	/* ... target queue full/blocked */
+	u64	host_busy;	/* ... host queue full/blocked/in recovery */
+	u64	lld_busy;	/* queuecommand() returned SCSI_MLQUEUE_* */
+};
+
+/*
+ * Core-private part of every scsi_cmnd, placed after the LLD's cmd_size
+ * bytes (and before the blk-mq scatterlists).
+ */
+struct scsi_cmd_acct {
+	u64	dispatch_ns;
+};
+
+static inline size_t scsi_cmd_acct_offset(struct scsi_host_template *hostt)
+{
+	return sizeof(struct scsi_cmnd) + ALIGN(hostt->cmd_size, sizeof(u64));
+}
+
+static inline struct scsi_cmd_acct *scsi_cmd_acct(struct scsi_cmnd *cmd)
+{
+	return (void *)cmd + scsi_cmd_acct_offset(cmd->device->host->hostt);
+}
+
+static inline size_t scsi_sdev_stats_offset(struct Scsi_Host *shost)
+{
+	return sizeof(struct scsi_device) +
+		ALIGN(shost->transportt->device_size, sizeof(void *));
+}
+
+static inline struct scsi_io_stats __percpu **
+scsi_sdev_stats_slot(struct scsi_device *sdev)
+{
+	return (void *)sdev + scsi_sdev_stats_offset(sdev->host);
+}
+
+static inline struct scsi_io_stats __percpu *
+scsi_sdev_stats(struct scsi_device *sdev)
+{
+	return *scsi_sdev_stats_slot(sdev);
+}
+
+#define scsi_sdev_stats_inc(sdev, field) \
+	this_cpu_inc(scsi_sdev_stats(sdev)->field)
+
+extern void scsi_io_stats_sum(struct scsi_device *sdev,
+			      struct scsi_io_stats *sum);
+
 /* scsi_proc.c */
 #ifdef CONFIG_SCSI_PROC_FS
 extern void scsi_proc_hostdir_add(struct scsi_host_template *);
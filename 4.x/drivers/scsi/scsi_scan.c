@@ -216,15 +216,21 @@ static struct scsi_device *scsi_alloc_sdev(struct scsi_target *starget,
 	extern void scsi_evt_thread(struct work_struct *work);
 	extern void scsi_requeue_run_queue(struct work_struct *work);
 
-	sdev = kzalloc(sizeof(*sdev) + shost->transportt->device_size,
-		       GFP_KERNEL);
+	sdev = kzalloc(scsi_sdev_stats_offset(shost) +
+		       sizeof(struct scsi_io_stats __percpu *), GFP_KERNEL);
 	if (!sdev)
 		goto out;
 
+	sdev->host = shost;
+	*scsi_sdev_stats_slot(sdev) = alloc_percpu(struct scsi_io_stats);
+	if (!scsi_sdev_stats(sdev)) {
+		kfree(sdev);
+		goto out;
+	}
+
 	sdev->vendor = scsi_null_device_strs;
 	sdev->model = scsi_null_device_strs;
 	sdev->rev = scsi_null_device_strs;
-	sdev->host = shost;
 	sdev->queue_ramp_up_period = SCSI_DEFAULT_RAMP_UP_PERIOD;
 	sdev->id = starget->id;
 	sdev->lun = lun;
@@ -269,6 +275,7 @@ static struct scsi_device *scsi_alloc_sdev(struct scsi_target *starget,
 		/* release fn is set up in scsi_sysfs_device_initialise, so
 		 * have to free and put manually here */
 		put_device(&starget->dev);
+		free_percpu(scsi_sdev_stats(sdev));
 		kfree(sdev);
 		goto out;
 	}
@@ -352,6 +352,70 @@ show_host_busy(struct device *dev, struct device_attribute *attr, char *buf)
 }
 static DEVICE_ATTR(host_busy, S_IRUGO, show_host_busy, NULL);
 
+/*
+ * IO accounting, see struct scsi_io_stats.  The same files exist for
+ * every scsi_device and for the Scsi_Host, where they add up the
+ * host's current devices.
+ */
+enum scsi_io_stat {
+	SCSI_IOSTAT_LATENCY_HIST,
+	SCSI_IOSTAT_LATENCY_NS,
+	SCSI_IOSTAT_REQUEUE,
+	SCSI_IOSTAT_EH,
+	SCSI_IOSTAT_BUSY,
+};
+
+static ssize_t
+scsi_io_stat_print(const struct scsi_io_stats *st, enum scsi_io_stat stat,
+		   char *buf)
+{
+	ssize_t len = 0;
+	int i;
+
+	switch (stat) {
+	case SCSI_IOSTAT_LATENCY_HIST:
+		for (i = 0; i < SCSI_IOLAT_BUCKETS; i++)
+			len += snprintf(buf + len, PAGE_SIZE - len,
+					"0x%llx%c", st->lat_hist[i],
+					i == SCSI_IOLAT_BUCKETS - 1 ? '\n' : ' ');
+		return len;
+	case SCSI_IOSTAT_LATENCY_NS:
+		return snprintf(buf, 20, "0x%llx\n", st->lat_ns);
+	case SCSI_IOSTAT_REQUEUE:
+		return snprintf(buf, 20, "0x%llx\n", st->requeue_cnt);
+	case SCSI_IOSTAT_EH:
+		return snprintf(buf, 20, "0x%llx\n", st->eh_cnt);
+	case SCSI_IOSTAT_BUSY:
+		/* device target host lld */
+		return snprintf(buf, PAGE_SIZE, "0x%llx 0x%llx 0x%llx 0x%llx\n",
+				st->dev_busy, st->target_busy,
+				st->host_busy, st->lld_busy);
+	}
+	return -EINVAL;
+}
+
+#define shost_io_stat_attr(name, stat)					\
+static ssize_t								\
+show_shost_##name(struct device *dev, struct device_attribute *attr,	\
+		  char *buf)						\
+{									\
+	struct Scsi_Host *shost = class_to_shost(dev);			\
+	struct scsi_io_stats st = { };					\
+	struct scsi_device *sdev;					\
+									\
+	shost_for_each_device(sdev, shost)				\
+		scsi_io_stats_sum(sdev, &st);				\
+	return scsi_io_stat_print(&st, stat, buf);			\
+}									\
+static struct device_attribute dev_attr_shost_##name =			\
+	__ATTR(name, S_IRUGO, show_shost_##name, NULL)
+
+shost_io_stat_attr(iolatency_hist, SCSI_IOSTAT_LATENCY_HIST);
+shost_io_stat_attr(iolatency_ns, SCSI_IOSTAT_LATENCY_NS);
+shost_io_stat_attr(iorequeue_cnt, SCSI_IOSTAT_REQUEUE);
+shost_io_stat_attr(ioeh_cnt, SCSI_IOSTAT_EH);
+shost_io_stat_attr(iobusy_cnt, SCSI_IOSTAT_BUSY);
+
 static struct attribute *scsi_sysfs_shost_attrs[] = {
 	&dev_attr_use_blk_mq.attr,
 	&dev_attr_unique_id.attr,
@@ -370,6 +434,11 @@ static struct attribute *scsi_sysfs_shost_attrs[] = {
 	&dev_attr_prot_guard_type.attr,
 	&dev_attr_host_reset.attr,
 	&dev_attr_eh_deadline.attr,
+	&dev_attr_shost_iolatency_hist.attr,
+	&dev_attr_shost_iolatency_ns.attr,
+	&dev_attr_shost_iorequeue_cnt.attr,
+	&dev_attr_shost_ioeh_cnt.attr,
+	&dev_attr_shost_iobusy_cnt.attr,
 	NULL
 };
 
@@ -426,6 +495,7 @@ static void scsi_device_dev_release_usercontext(struct work_struct *work)
 	kfree(sdev->vpd_pg83);
 	kfree(sdev->vpd_pg80);
 	kfree(sdev->inquiry);
+	free_percpu(scsi_sdev_stats(sdev));
 	kfree(sdev);
 
 	if (parent)
@@ -838,6 +908,24 @@ show_sdev_iostat(iorequest_cnt);
 show_sdev_iostat(iodone_cnt);
 show_sdev_iostat(ioerr_cnt);
 
+#define sdev_io_stat_attr(name, stat)					\
+static ssize_t								\
+sdev_show_##name(struct device *dev, struct device_attribute *attr,	\
+		 char *buf)						\
+{									\
+	struct scsi_io_stats st = { };					\
+									\
+	scsi_io_stats_sum(to_scsi_device(dev), &st);			\
+	return scsi_io_stat_print(&st, stat, buf);			\
+}									\
+static DEVICE_ATTR(name, S_IRUGO, sdev_show_##name, NULL)
+
+sdev_io_stat_attr(iolatency_hist, SCSI_IOSTAT_LATENCY_HIST);
+sdev_io_stat_attr(iolatency_ns, SCSI_IOSTAT_LATENCY_NS);
+sdev_io_stat_attr(iorequeue_cnt, SCSI_IOSTAT_REQUEUE);
+sdev_io_stat_attr(ioeh_cnt, SCSI_IOSTAT_EH);
+sdev_io_stat_attr(iobusy_cnt, SCSI_IOSTAT_BUSY);
+
 static ssize_t
 sdev_show_modalias(struct device *dev, struct device_attribute *attr, char *buf)
 {
@@ -982,6 +1070,11 @@ static struct attribute *scsi_sdev_attrs[] = {
 	&dev_attr_iorequest_cnt.attr,
 	&dev_attr_iodone_cnt.attr,
 	&dev_attr_ioerr_cnt.attr,
+	&dev_attr_iolatency_hist.attr,
+	&dev_attr_iolatency_ns.attr,
+	&dev_attr_iorequeue_cnt.attr,
+	&dev_attr_ioeh_cnt.attr,
+	&dev_attr_iobusy_cnt.attr,
 	&dev_attr_modalias.attr,
 	&dev_attr_queue_depth.attr,
 	&dev_attr_queue_type.attr,
@@ -578,6 +578,11 @@ static int sr_block_ioctl(struct block_device *bdev, fmode_t mode, unsigned cmd,
 	case SCSI_IOCTL_GET_BUS_NUMBER:
 		ret = scsi_ioctl(sdev, cmd, argp);
 		goto put;
+	case CDROMREADAUDIO:
+		ret = sr_read_audio(cd, argp);
+		if (ret != -ENOSYS)
+			goto put;
+		break;
 	}
 
 	ret = cdrom_ioctl(&cd->cdi, bdev, mode, cmd, arg);
@@ -607,6 +612,9 @@ static unsigned int sr_block_check_events(struct gendisk *disk,
 	if (!atomic_read(&cd->device->disk_events_disable_depth))
 		ret = cdrom_check_events(&cd->cdi, clearing);
 
+	if (ret & DISK_EVENT_MEDIA_CHANGE)
+		cd->cdda_ra_stale = true;
+
 	scsi_cd_put(cd);
 	return ret;
 }
@@ -672,6 +680,9 @@ static void sr_release(struct cdrom_device_info *cdi)
 	if (cd->device->sector_size > 2048)
 		sr_set_blocklength(cd, 2048);
 
+	/* cdrom_release() calls us on every close, not just the last */
+	if (!cdi->use_count)
+		sr_cdda_ra_drop(cd);
 }
 
 static int sr_probe(struct device *dev)
@@ -1002,6 +1013,8 @@ static void sr_kref_release(struct kref *kref)
 
 	unregister_cdrom(&cd->cdi);
 
+	sr_cdda_ra_free(cd);
+
 	disk->private_data = NULL;
 
 	put_disk(disk);
@@ -24,6 +24,7 @@
 #define SR_TIMEOUT	(30 * HZ)
 
 struct scsi_device;
+struct sr_cdda_ra;
 
 /* The CDROM is fairly slow, so we need a little extra time */
 /* In fact, it is very slow if it has to spin up first */
@@ -49,6 +50,10 @@ typedef struct scsi_cd {
 	bool get_event_changed:1;	/* changed according to GET_EVENT */
 	bool ignore_get_event:1;	/* GET_EVENT is unreliable, use TUR */
 
+	/* CDDA readahead, see sr_read_audio(); serialized by sr_mutex */
+	struct sr_cdda_ra *cdda_ra;
+	bool cdda_ra_stale;		/* media changed, drop readahead */
+
 	struct cdrom_device_info cdi;
 	/* We hold gendisk and scsi_device references on probe and use
 	 * the refs on this kref to decide when to release them */
@@ -70,6 +75,9 @@ int sr_get_mcn(struct cdrom_device_info *, struct cdrom_mcn *);
 int sr_reset(struct cdrom_device_info *);
 int sr_select_speed(struct cdrom_device_info *cdi, int speed);
 int sr_audio_ioctl(struct cdrom_device_info *, unsigned int, void *);
+int sr_read_audio(Scsi_CD *, void __user *);
+void sr_cdda_ra_drop(Scsi_CD *);
+void sr_cdda_ra_free(Scsi_CD *);
 
 int sr_is_xa(Scsi_CD *);
 
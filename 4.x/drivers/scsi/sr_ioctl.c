@@ -32,6 +32,11 @@ static int xa_test = 0;
 
 module_param(xa_test, int, S_IRUGO | S_IWUSR);
 
+/* Read ahead of sequential CDROMREADAUDIO calls, see sr_read_audio() */
+static bool cdda_readahead = 1;
+
+module_param(cdda_readahead, bool, S_IRUGO | S_IWUSR);
+
 /* primitive to determine whether we need to have GFP_DMA set based on
  * the status of the unchecked_isa_dma flag in the host structure */
 #define SR_GFP_DMA(cd) (((cd)->device->host->unchecked_isa_dma) ? GFP_DMA : 0)
@@ -458,6 +463,264 @@ int sr_audio_ioctl(struct cdrom_device_info *cdi, unsigned int cmd, void *arg)
 	}
 }
 
+/* -----------------------------------------------------------------------
+ * CDDA readahead.
+ *
+ * Rippers read audio with back to back CDROMREADAUDIO calls for
+ * consecutive frames, and between two calls the drive has nothing to do
+ * while userspace deals with the previous chunk.  We keep two windows:
+ * a call is served out of the window holding its frames, and the first
+ * call landing in a window queues the next one behind it, so the drive
+ * is streaming the following frames while the current ones are being
+ * copied out.  The window size starts at the request size and doubles
+ * on every sequential hit up to SR_CDDA_RA_FRAMES.  It is kept a whole
+ * number of requests, so that a steady stream of equal sized calls never
+ * straddles two windows.
+ *
+ * Anything this doesn't handle (non-sequential or oversized reads, media
+ * errors, single frame fallback) returns -ENOSYS and is left to the
+ * generic cdrom driver, which owns the CDDA fallback logic.
+ */
+
+#define SR_CDDA_RA_FRAMES	CD_FRAMES
+
+struct sr_cdda_win {
+	unsigned char *buffer;
+	struct request *rq;		/* in flight, NULL once reaped */
+	struct completion wait;
+	int lba;
+	int nr;				/* frames held, 0 if empty */
+	int error;
+	unsigned char sense[SCSI_SENSE_BUFFERSIZE];
+};
+
+struct sr_cdda_ra {
+	struct sr_cdda_win win[2];
+	int frames;			/* capacity of each window */
+	int ra_frames;			/* current readahead size */
+};
+
+static void sr_cdda_end_io(struct request *rq, int error)
+{
+	struct sr_cdda_win *win = rq->end_io_data;
+
+	win->error = rq->errors ? -EIO : error;
+	complete(&win->wait);
+}
+
+static int sr_cdda_win_start(Scsi_CD *cd, struct sr_cdda_win *win,
+			     int lba, int nr, bool quiet)
+{
+	struct request_queue *q = cd->device->request_queue;
+	struct request *rq;
+	int ret;
+
+	rq = blk_get_request(q, READ, GFP_KERNEL);
+	if (IS_ERR(rq))
+		return PTR_ERR(rq);
+	blk_rq_set_block_pc(rq);
+
+	ret = blk_rq_map_kern(q, rq, win->buffer, nr * CD_FRAMESIZE_RAW,
+			      GFP_KERNEL);
+	if (ret) {
+		blk_put_request(rq);
+		return ret;
+	}
+
+	rq->cmd[0] = GPCMD_READ_CD;
+	rq->cmd[1] = 1 << 2;
+	rq->cmd[2] = (lba >> 24) & 0xff;
+	rq->cmd[3] = (lba >> 16) & 0xff;
+	rq->cmd[4] = (lba >>  8) & 0xff;
+	rq->cmd[5] = lba & 0xff;
+	rq->cmd[6] = (nr >> 16) & 0xff;
+	rq->cmd[7] = (nr >>  8) & 0xff;
+	rq->cmd[8] = nr & 0xff;
+	rq->cmd[9] = 0xf8;
+
+	rq->cmd_len = 12;
+	rq->timeout = 60 * HZ;
+	/* readahead running off the end of the disc is not worth a log line */
+	if (quiet)
+		rq->cmd_flags |= REQ_QUIET;
+	memset(win->sense, 0, sizeof(win->sense));
+	rq->sense = win->sense;
+	rq->sense_len = 0;
+	rq->end_io_data = win;
+
+	win->rq = rq;
+	win->lba = lba;
+	win->nr = nr;
+	win->error = 0;
+	reinit_completion(&win->wait);
+
+	blk_execute_rq_nowait(q, cd->disk, rq, 0, sr_cdda_end_io);
+	return 0;
+}
+
+static int sr_cdda_win_wait(struct sr_cdda_win *win)
+{
+	if (win->rq) {
+		wait_for_completion_io(&win->wait);
+		blk_put_request(win->rq);
+		win->rq = NULL;
+		if (win->error)
+			win->nr = 0;
+	}
+	return win->error;
+}
+
+void sr_cdda_ra_drop(Scsi_CD *cd)
+{
+	struct sr_cdda_ra *ra = cd->cdda_ra;
+	int i;
+
+	if (!ra)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(ra->win); i++) {
+		sr_cdda_win_wait(&ra->win[i]);
+		ra->win[i].nr = 0;
+	}
+}
+
+void sr_cdda_ra_free(Scsi_CD *cd)
+{
+	struct sr_cdda_ra *ra = cd->cdda_ra;
+	int i;
+
+	if (!ra)
+		return;
+
+	sr_cdda_ra_drop(cd);
+	for (i = 0; i < ARRAY_SIZE(ra->win); i++)
+		kfree(ra->win[i].buffer);
+	kfree(ra);
+	cd->cdda_ra = NULL;
+}
+
+static struct sr_cdda_ra *sr_cdda_ra_get(Scsi_CD *cd, int nframes)
+{
+	struct request_queue *q = cd->device->request_queue;
+	struct sr_cdda_ra *ra = cd->cdda_ra;
+	int i, frames;
+
+	if (ra)
+		return nframes <= ra->frames ? ra : NULL;
+
+	frames = min_t(int, SR_CDDA_RA_FRAMES,
+		       (queue_max_sectors(q) << 9) / CD_FRAMESIZE_RAW);
+	if (nframes > frames)
+		return NULL;
+
+	ra = kzalloc(sizeof(*ra), GFP_KERNEL);
+	if (!ra)
+		return NULL;
+
+	for (i = 0; i < ARRAY_SIZE(ra->win); i++) {
+		ra->win[i].buffer = kmalloc(frames * CD_FRAMESIZE_RAW,
+					    GFP_KERNEL | __GFP_NOWARN |
+					    SR_GFP_DMA(cd));
+		if (!ra->win[i].buffer)
+			goto fail;
+		init_completion(&ra->win[i].wait);
+	}
+	ra->frames = frames;
+	cd->cdda_ra = ra;
+	return ra;
+
+fail:
+	while (i--)
+		kfree(ra->win[i].buffer);
+	kfree(ra);
+	return NULL;
+}
+
+static struct sr_cdda_win *sr_cdda_ra_find(struct sr_cdda_ra *ra,
+					   int lba, int nframes)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ra->win); i++) {
+		struct sr_cdda_win *win = &ra->win[i];
+
+		if (win->nr && lba >= win->lba &&
+		    lba + nframes <= win->lba + win->nr)
+			return win;
+	}
+	return NULL;
+}
+
+/*
+ * CDROMREADAUDIO, called by sr_block_ioctl() ahead of the generic cdrom
+ * driver.  Returns -ENOSYS for anything it wants the latter to handle.
+ */
+int sr_read_audio(Scsi_CD *cd, void __user *arg)
+{
+	struct cdrom_read_audio rda;
+	struct sr_cdda_win *win, *next;
+	struct sr_cdda_ra *ra;
+	int lba;
+
+	if (!cdda_readahead || cd->cdi.cdda_method != CDDA_BPC_FULL)
+		return -ENOSYS;
+
+	if (copy_from_user(&rda, arg, sizeof(rda)))
+		return -EFAULT;
+
+	if (rda.addr_format == CDROM_MSF)
+		lba = msf_to_lba(rda.addr.msf.minute,
+				 rda.addr.msf.second,
+				 rda.addr.msf.frame);
+	else if (rda.addr_format == CDROM_LBA)
+		lba = rda.addr.lba;
+	else
+		return -ENOSYS;
+
+	if (lba < 0 || rda.nframes <= 0 || rda.nframes > CD_FRAMES)
+		return -ENOSYS;
+
+	ra = sr_cdda_ra_get(cd, rda.nframes);
+	if (!ra)
+		return -ENOSYS;
+
+	if (cd->cdda_ra_stale) {
+		cd->cdda_ra_stale = false;
+		sr_cdda_ra_drop(cd);
+	}
+
+	win = sr_cdda_ra_find(ra, lba, rda.nframes);
+	if (!win) {
+		sr_cdda_ra_drop(cd);
+		win = &ra->win[0];
+		ra->ra_frames = rda.nframes;
+		if (sr_cdda_win_start(cd, win, lba, rda.nframes, false))
+			return -ENOSYS;
+	} else {
+		ra->ra_frames = max_t(int, rda.nframes,
+				      rounddown(min(ra->ra_frames * 2, ra->frames),
+						rda.nframes));
+	}
+
+	if (sr_cdda_win_wait(win)) {
+		sr_cdda_ra_drop(cd);
+		return -ENOSYS;
+	}
+
+	if (copy_to_user(rda.buf,
+			 win->buffer + (lba - win->lba) * CD_FRAMESIZE_RAW,
+			 rda.nframes * CD_FRAMESIZE_RAW))
+		return -EFAULT;
+
+	/* first hit in this window, get the one after it going */
+	next = &ra->win[win == &ra->win[0]];
+	if (!next->nr || next->lba < win->lba)
+		sr_cdda_win_start(cd, next, win->lba + win->nr,
+				  ra->ra_frames, true);
+
+	return 0;
+}
+
 /* -----------------------------------------------------------------------
  * a function to read all sorts of funny cdrom sectors using the READ_CD
  * scsi-3 mmc command
@@ -5,6 +5,8 @@
 #include <linux/idr.h>
 #include <uapi/linux/virtio_ids.h>
 
+#include "virtio_ring_packed.h"
+
 /* Unique numbering for virtio devices. */
 static DEFINE_IDA(virtio_index_ida);
 
@@ -224,7 +226,7 @@ static int virtio_dev_probe(struct device *_d)
 		dev->features = driver_features_legacy & device_features;
 
 	/* Transport features always preserved to pass to finalize_features. */
-	for (i = VIRTIO_TRANSPORT_F_START; i < VIRTIO_TRANSPORT_F_END; i++)
+	for (i = VIRTIO_TRANSPORT_F_START; i < VIRTIO_RING_TRANSPORT_F_END; i++)
 		if (device_features & (1ULL << i))
 			__virtio_set_bit(dev, i);
 
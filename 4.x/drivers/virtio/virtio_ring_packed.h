@@ -0,0 +1,86 @@
+#ifndef _VIRTIO_RING_PACKED_H
+#define _VIRTIO_RING_PACKED_H
+/*
+ * Packed virtqueue layout (virtio 1.1), for kernels whose uapi headers
+ * predate it.  Definitions mirror include/uapi/linux/virtio_ring.h and
+ * include/uapi/linux/virtio_config.h of later kernels.
+ */
+#include <linux/types.h>
+#include <linux/virtio_config.h>
+
+#ifndef VIRTIO_F_RING_PACKED
+/* This feature indicates support for the packed virtqueue layout. */
+#define VIRTIO_F_RING_PACKED		34
+#endif
+
+#ifndef VIRTIO_F_IN_ORDER
+/*
+ * Device uses buffers in the same order in which they have been
+ * made available.
+ */
+#define VIRTIO_F_IN_ORDER		35
+#endif
+
+/*
+ * One past the last transport feature bit we understand.  The stock
+ * VIRTIO_TRANSPORT_F_END stops short of the packed ring bits.
+ */
+#define VIRTIO_RING_TRANSPORT_F_END	(VIRTIO_F_IN_ORDER + 1)
+
+#ifndef VRING_PACKED_DESC_F_AVAIL
+/*
+ * Mark a descriptor as available or used in packed ring.
+ * Notice: they are defined as shifts instead of shifted values.
+ */
+#define VRING_PACKED_DESC_F_AVAIL	7
+#define VRING_PACKED_DESC_F_USED	15
+
+/* Enable events in packed ring. */
+#define VRING_PACKED_EVENT_FLAG_ENABLE	0x0
+/* Disable events in packed ring. */
+#define VRING_PACKED_EVENT_FLAG_DISABLE	0x1
+/*
+ * Enable events for a specific descriptor in packed ring.
+ * (as specified by Descriptor Ring Change Event Offset/Wrap Counter).
+ * Only valid if VIRTIO_RING_F_EVENT_IDX has been negotiated.
+ */
+#define VRING_PACKED_EVENT_FLAG_DESC	0x2
+
+/*
+ * Wrap counter bit shift in event suppression structure
+ * of packed ring.
+ */
+#define VRING_PACKED_EVENT_F_WRAP_CTR	15
+
+struct vring_packed_desc_event {
+	/* Descriptor Ring Change Event Offset/Wrap Counter. */
+	__le16 off_wrap;
+	/* Descriptor Ring Change Event Flags. */
+	__le16 flags;
+};
+
+struct vring_packed_desc {
+	/* Buffer Address. */
+	__le64 addr;
+	/* Buffer Length. */
+	__le32 len;
+	/* Buffer ID. */
+	__le16 id;
+	/* The flags depending on descriptor type. */
+	__le16 flags;
+};
+#endif
+
+/*
+ * Bytes needed for a packed ring of @num descriptors: the descriptor
+ * ring followed by the driver and device event suppression areas.
+ * Always smaller than vring_size() for the same @num, so transports
+ * can keep allocating split-sized queue memory.
+ */
+static inline unsigned vring_packed_size(unsigned int num)
+{
+	return num * sizeof(struct vring_packed_desc) +
+		2 * sizeof(struct vring_packed_desc_event);
+}
+
+#endif /* _VIRTIO_RING_PACKED_H */
@@ -87,6 +87,7 @@
 	E1000_RXDEXT_STATERR_CXE |	\
 	E1000_RXDEXT_STATERR_RXE)
 
+#define E1000_MRQC_ENABLE_RSS_2Q               0x00000001
 #define E1000_MRQC_RSS_FIELD_MASK              0xFFFF0000
 #define E1000_MRQC_RSS_FIELD_IPV4_TCP          0x00010000
 #define E1000_MRQC_RSS_FIELD_IPV4              0x00020000
@@ -96,6 +97,9 @@
 
 #define E1000_RXDPS_HDRSTAT_HDRSP              0x00008000
 
+/* 82574 RSS redirection table entry: bit 7 selects the Rx queue */
+#define E1000_RETA_QUEUE_SHIFT                 7
+
 /* Management Control */
 #define E1000_MANC_SMBUS_EN      0x00000001 /* SMBus Enabled - RO */
 #define E1000_MANC_ASF_EN        0x00000002 /* ASF Enabled - RO */
@@ -292,6 +296,9 @@
 #define E1000_TCTL_RTLC   0x01000000    /* Re-transmit on late collision */
 #define E1000_TCTL_MULR   0x10000000    /* Multiple request support */
 
+/* Transmit Arbitration Count */
+#define E1000_TARC_ENABLE 0x00000400    /* Enable Tx queue */
+
 /* SerDes Control */
 #define E1000_SCTL_DISABLE_SERDES_LOOPBACK 0x0400
 #define E1000_SCTL_ENABLE_SERDES_LOOPBACK	0x0410
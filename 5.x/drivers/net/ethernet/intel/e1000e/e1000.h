@@ -22,6 +22,8 @@
 #include <linux/mii.h>
 #include <linux/mdio.h>
 #include <linux/pm_qos.h>
+#include <linux/u64_stats_sync.h>
+#include <linux/dim.h>
 #include "hw.h"
 
 struct e1000_info;
@@ -56,6 +58,15 @@ struct e1000_info;
 
 #define E1000_FC_PAUSE_TIME		0x0680 /* 858 usec */
 
+/* Queues: 82574 has two Rx and two Tx queues, used only in MSI-X mode */
+#define E1000E_MAX_QUEUES		2
+#define E1000E_RETA_SIZE		128
+#define E1000E_RSS_KEY_SIZE		40
+
+/* Rx moderation levels net DIM chooses between */
+#define E1000E_DIM_PROFILES		5
+#define E1000E_DIM_DEFAULT_PROFILE	2 /* 20000 ints/sec */
+
 /* How many Tx Descriptors do we need to call netif_wake_queue ? */
 /* How many Rx Buffers do we bundle into one write to the hardware ? */
 #define E1000_RX_BUFFER_WRITE		16 /* Must be power of 2 */
@@ -155,6 +166,7 @@ struct e1000_ring {
 
 	u16 next_to_use;
 	u16 next_to_clean;
+	u16 queue_index;		/* Tx/Rx queue number      */
 
 	void __iomem *head;
 	void __iomem *tail;
@@ -168,7 +180,18 @@ struct e1000_ring {
 	void __iomem *itr_register;
 	int set_itr;
 
+	struct napi_struct *napi;	/* Rx only */
 	struct sk_buff *rx_skb_top;
+
+	/* net DIM state, Rx only */
+	struct dim dim;
+	u16 dim_events;			/* interrupts sampled by dim */
+
+	/* per-queue statistics, reported through ethtool -S */
+	struct u64_stats_sync syncp;
+	u64 packets;
+	u64 bytes;
+	u64 dim_level[E1000E_DIM_PROFILES]; /* interrupts at each DIM level */
 };
 
 /* PHY register snapshot values */
@@ -215,7 +238,7 @@ struct e1000_adapter {
 	struct e1000_ring *tx_ring ____cacheline_aligned_in_smp;
 	u32 tx_fifo_limit;
 
-	struct napi_struct napi;
+	struct napi_struct napi[E1000E_MAX_QUEUES];
 
 	unsigned int uncorr_errors;	/* uncorrectable ECC errors */
 	unsigned int corr_errors;	/* correctable ECC errors */
@@ -253,6 +276,11 @@ struct e1000_adapter {
 	void (*alloc_rx_buf)(struct e1000_ring *ring, int cleaned_count,
 			     gfp_t gfp);
 	struct e1000_ring *rx_ring;
+	unsigned int num_queues;
+
+	/* RSS indirection table and hash key, as set by ethtool -X */
+	u8 rss_indir[E1000E_RETA_SIZE];
+	u32 rss_key[E1000E_RSS_KEY_SIZE / 4];
 
 	u32 rx_int_delay;
 	u32 rx_abs_int_delay;
@@ -437,6 +465,7 @@ s32 e1000e_get_base_timinca(struct e1000_adapter *adapter, u32 *timinca);
 #define FLAG2_CHECK_RX_HWTSTAMP           BIT(13)
 #define FLAG2_CHECK_SYSTIM_OVERFLOW       BIT(14)
 #define FLAG2_ENABLE_S0IX_FLOWS           BIT(15)
+#define FLAG2_DIM                         BIT(16)
 
 #define E1000_RX_DESC_PS(R, i)	    \
 	(&(((union e1000_rx_desc_packet_split *)((R).desc))[i]))
@@ -483,6 +512,8 @@ void e1000e_reset_interrupt_capability(struct e1000_adapter *adapter);
 void e1000e_get_hw_control(struct e1000_adapter *adapter);
 void e1000e_release_hw_control(struct e1000_adapter *adapter);
 void e1000e_write_itr(struct e1000_adapter *adapter, u32 itr);
+void e1000e_rx_dim_reset(struct e1000_adapter *adapter);
+void e1000e_setup_rss_hash(struct e1000_adapter *adapter);
 
 extern unsigned int copybreak;
 
@@ -98,7 +98,10 @@ static const struct e1000_stats e1000_gstrings_stats[] = {
 };
 
 #define E1000_GLOBAL_STATS_LEN	ARRAY_SIZE(e1000_gstrings_stats)
-#define E1000_STATS_LEN (E1000_GLOBAL_STATS_LEN)
+/* packets and bytes for each Tx and Rx queue, plus each Rx DIM level */
+#define E1000_QUEUE_STATS_LEN(a) \
+	((a)->num_queues * (4 + E1000E_DIM_PROFILES))
+#define E1000_STATS_LEN(a) (E1000_GLOBAL_STATS_LEN + E1000_QUEUE_STATS_LEN(a))
 static const char e1000_gstrings_test[][ETH_GSTRING_LEN] = {
 	"Register test  (offline)", "Eeprom test    (offline)",
 	"Interrupt test (offline)", "Loopback test  (offline)",
@@ -673,6 +676,7 @@ static int e1000_set_ringparam(struct net_device *netdev,
 	int err = 0, size = sizeof(struct e1000_ring);
 	bool set_tx = false, set_rx = false;
 	u16 new_rx_count, new_tx_count;
+	int i, j = 0;
 
 	if ((ring->rx_mini_pending) || (ring->rx_jumbo_pending))
 		return -EINVAL;
@@ -695,8 +699,10 @@ static int e1000_set_ringparam(struct net_device *netdev,
 
 	if (!netif_running(adapter->netdev)) {
 		/* Set counts now and allocate resources during open() */
-		adapter->tx_ring->count = new_tx_count;
-		adapter->rx_ring->count = new_rx_count;
+		for (i = 0; i < adapter->num_queues; i++) {
+			adapter->tx_ring[i].count = new_tx_count;
+			adapter->rx_ring[i].count = new_rx_count;
+		}
 		adapter->tx_ring_count = new_tx_count;
 		adapter->rx_ring_count = new_rx_count;
 		goto clear_reset;
@@ -707,14 +713,14 @@ static int e1000_set_ringparam(struct net_device *netdev,
 
 	/* Allocate temporary storage for ring updates */
 	if (set_tx) {
-		temp_tx = vmalloc(size);
+		temp_tx = vmalloc(array_size(adapter->num_queues, size));
 		if (!temp_tx) {
 			err = -ENOMEM;
 			goto free_temp;
 		}
 	}
 	if (set_rx) {
-		temp_rx = vmalloc(size);
+		temp_rx = vmalloc(array_size(adapter->num_queues, size));
 		if (!temp_rx) {
 			err = -ENOMEM;
 			goto free_temp;
@@ -729,37 +735,52 @@ static int e1000_set_ringparam(struct net_device *netdev,
 	 * ISRs in MSI-X mode get passed pointers to the Tx and Rx ring
 	 * structs.  First, attempt to allocate new resources...
 	 */
+	i = 0;
 	if (set_tx) {
-		memcpy(temp_tx, adapter->tx_ring, size);
-		temp_tx->count = new_tx_count;
-		err = e1000e_setup_tx_resources(temp_tx);
-		if (err)
-			goto err_setup;
+		for (; i < adapter->num_queues; i++) {
+			memcpy(&temp_tx[i], &adapter->tx_ring[i], size);
+			temp_tx[i].count = new_tx_count;
+			err = e1000e_setup_tx_resources(&temp_tx[i]);
+			if (err)
+				goto err_setup;
+		}
 	}
 	if (set_rx) {
-		memcpy(temp_rx, adapter->rx_ring, size);
-		temp_rx->count = new_rx_count;
-		err = e1000e_setup_rx_resources(temp_rx);
-		if (err)
-			goto err_setup_rx;
+		for (; j < adapter->num_queues; j++) {
+			memcpy(&temp_rx[j], &adapter->rx_ring[j], size);
+			temp_rx[j].count = new_rx_count;
+			err = e1000e_setup_rx_resources(&temp_rx[j]);
+			if (err)
+				goto err_setup_rx;
+		}
 	}
 
 	/* ...then free the old resources and copy back any new ring data */
 	if (set_tx) {
-		e1000e_free_tx_resources(adapter->tx_ring);
-		memcpy(adapter->tx_ring, temp_tx, size);
+		for (i = 0; i < adapter->num_queues; i++) {
+			e1000e_free_tx_resources(&adapter->tx_ring[i]);
+			memcpy(&adapter->tx_ring[i], &temp_tx[i], size);
+		}
 		adapter->tx_ring_count = new_tx_count;
 	}
 	if (set_rx) {
-		e1000e_free_rx_resources(adapter->rx_ring);
-		memcpy(adapter->rx_ring, temp_rx, size);
+		for (j = 0; j < adapter->num_queues; j++) {
+			e1000e_free_rx_resources(&adapter->rx_ring[j]);
+			memcpy(&adapter->rx_ring[j], &temp_rx[j], size);
+		}
 		adapter->rx_ring_count = new_rx_count;
 	}
 
 err_setup_rx:
-	if (err && set_tx)
-		e1000e_free_tx_resources(temp_tx);
+	if (err) {
+		while (j--)
+			e1000e_free_rx_resources(&temp_rx[j]);
+	}
 err_setup:
+	if (err && set_tx) {
+		while (i--)
+			e1000e_free_tx_resources(&temp_tx[i]);
+	}
 	e1000e_up(adapter);
 	pm_runtime_put_sync(netdev->dev.parent);
 free_temp:
@@ -1775,14 +1796,15 @@ static int e1000_link_test(struct e1000_adapter *adapter, u64 *data)
 	return *data;
 }
 
-static int e1000e_get_sset_count(struct net_device __always_unused *netdev,
-				 int sset)
+static int e1000e_get_sset_count(struct net_device *netdev, int sset)
 {
+	struct e1000_adapter *adapter = netdev_priv(netdev);
+
 	switch (sset) {
 	case ETH_SS_TEST:
 		return E1000_TEST_LEN;
 	case ETH_SS_STATS:
-		return E1000_STATS_LEN;
+		return E1000_STATS_LEN(adapter);
 	case ETH_SS_PRIV_FLAGS:
 		return E1000E_PRIV_FLAGS_STR_LEN;
 	default:
@@ -1995,6 +2017,8 @@ static int e1000_get_coalesce(struct net_device *netdev,
 {
 	struct e1000_adapter *adapter = netdev_priv(netdev);
 
+	ec->use_adaptive_rx_coalesce = !!(adapter->flags2 & FLAG2_DIM);
+
 	if (adapter->itr_setting <= 4)
 		ec->rx_coalesce_usecs = adapter->itr_setting;
 	else
@@ -2014,6 +2038,10 @@ static int e1000_set_coalesce(struct net_device *netdev,
 	    (ec->rx_coalesce_usecs == 2))
 		return -EINVAL;
 
+	/* adaptive-rx is net DIM, which the kernel may be built without */
+	if (ec->use_adaptive_rx_coalesce && !IS_REACHABLE(CONFIG_DIMLIB))
+		return -EOPNOTSUPP;
+
 	if (ec->rx_coalesce_usecs == 4) {
 		adapter->itr_setting = 4;
 		adapter->itr = adapter->itr_setting;
@@ -2025,12 +2053,26 @@ static int e1000_set_coalesce(struct net_device *netdev,
 		adapter->itr_setting = adapter->itr & ~3;
 	}
 
+	/* net DIM owns the Rx rate while adaptive-rx is on and starts from
+	 * its default level, rx-usecs takes effect again once it is off
+	 */
+	if (ec->use_adaptive_rx_coalesce) {
+		adapter->flags2 |= FLAG2_DIM;
+		adapter->itr = 20000;
+	} else {
+		adapter->flags2 &= ~FLAG2_DIM;
+	}
+
 	pm_runtime_get_sync(netdev->dev.parent);
 
-	if (adapter->itr_setting != 0)
+	if (adapter->flags2 & FLAG2_DIM) {
+		e1000e_rx_dim_reset(adapter);
 		e1000e_write_itr(adapter, adapter->itr);
-	else
+	} else if (adapter->itr_setting != 0) {
+		e1000e_write_itr(adapter, adapter->itr);
+	} else {
 		e1000e_write_itr(adapter, 0);
+	}
 
 	pm_runtime_put_sync(netdev->dev.parent);
 
@@ -2060,7 +2102,8 @@ static void e1000_get_ethtool_stats(struct net_device *netdev,
 {
 	struct e1000_adapter *adapter = netdev_priv(netdev);
 	struct rtnl_link_stats64 net_stats;
-	int i;
+	unsigned int start;
+	int i, j, k;
 	char *p = NULL;
 
 	pm_runtime_get_sync(netdev->dev.parent);
@@ -2087,13 +2130,37 @@ static void e1000_get_ethtool_stats(struct net_device *netdev,
 		data[i] = (e1000_gstrings_stats[i].sizeof_stat ==
 			   sizeof(u64)) ? *(u64 *)p : *(u32 *)p;
 	}
+
+	for (j = 0; j < adapter->num_queues; j++) {
+		struct e1000_ring *ring = &adapter->tx_ring[j];
+
+		do {
+			start = u64_stats_fetch_begin_irq(&ring->syncp);
+			data[i] = ring->packets;
+			data[i + 1] = ring->bytes;
+		} while (u64_stats_fetch_retry_irq(&ring->syncp, start));
+		i += 2;
+	}
+	for (j = 0; j < adapter->num_queues; j++) {
+		struct e1000_ring *ring = &adapter->rx_ring[j];
+
+		do {
+			start = u64_stats_fetch_begin_irq(&ring->syncp);
+			data[i] = ring->packets;
+			data[i + 1] = ring->bytes;
+			for (k = 0; k < E1000E_DIM_PROFILES; k++)
+				data[i + 2 + k] = ring->dim_level[k];
+		} while (u64_stats_fetch_retry_irq(&ring->syncp, start));
+		i += 2 + E1000E_DIM_PROFILES;
+	}
 }
 
-static void e1000_get_strings(struct net_device __always_unused *netdev,
+static void e1000_get_strings(struct net_device *netdev,
 			      u32 stringset, u8 *data)
 {
+	struct e1000_adapter *adapter = netdev_priv(netdev);
 	u8 *p = data;
-	int i;
+	int i, j;
 
 	switch (stringset) {
 	case ETH_SS_TEST:
@@ -2105,6 +2172,22 @@ static void e1000_get_strings(struct net_device __always_unused *netdev,
 			       ETH_GSTRING_LEN);
 			p += ETH_GSTRING_LEN;
 		}
+		for (i = 0; i < adapter->num_queues; i++) {
+			sprintf(p, "tx_queue_%u_packets", i);
+			p += ETH_GSTRING_LEN;
+			sprintf(p, "tx_queue_%u_bytes", i);
+			p += ETH_GSTRING_LEN;
+		}
+		for (i = 0; i < adapter->num_queues; i++) {
+			sprintf(p, "rx_queue_%u_packets", i);
+			p += ETH_GSTRING_LEN;
+			sprintf(p, "rx_queue_%u_bytes", i);
+			p += ETH_GSTRING_LEN;
+			for (j = 0; j < E1000E_DIM_PROFILES; j++) {
+				sprintf(p, "rx_queue_%u_dim_level%u", i, j);
+				p += ETH_GSTRING_LEN;
+			}
+		}
 		break;
 	case ETH_SS_PRIV_FLAGS:
 		memcpy(data, e1000e_priv_flags_strings,
@@ -2117,11 +2200,15 @@ static int e1000_get_rxnfc(struct net_device *netdev,
 			   struct ethtool_rxnfc *info,
 			   u32 __always_unused *rule_locs)
 {
+	struct e1000_adapter *adapter = netdev_priv(netdev);
+
 	info->data = 0;
 
 	switch (info->cmd) {
+	case ETHTOOL_GRXRINGS:
+		info->data = adapter->num_queues;
+		return 0;
 	case ETHTOOL_GRXFH: {
-		struct e1000_adapter *adapter = netdev_priv(netdev);
 		struct e1000_hw *hw = &adapter->hw;
 		u32 mrqc;
 
@@ -2165,6 +2252,77 @@ static int e1000_get_rxnfc(struct net_device *netdev,
 	}
 }
 
+static u32
+e1000e_get_rxfh_indir_size(struct net_device __always_unused *netdev)
+{
+	return E1000E_RETA_SIZE;
+}
+
+static u32
+e1000e_get_rxfh_key_size(struct net_device __always_unused *netdev)
+{
+	return E1000E_RSS_KEY_SIZE;
+}
+
+static int e1000e_get_rxfh(struct net_device *netdev, u32 *indir, u8 *key,
+			   u8 *hfunc)
+{
+	struct e1000_adapter *adapter = netdev_priv(netdev);
+	int i;
+
+	if (hfunc)
+		*hfunc = ETH_RSS_HASH_TOP;
+	if (indir)
+		for (i = 0; i < E1000E_RETA_SIZE; i++)
+			indir[i] = adapter->rss_indir[i];
+	if (key)
+		memcpy(key, adapter->rss_key, E1000E_RSS_KEY_SIZE);
+
+	return 0;
+}
+
+static int e1000e_set_rxfh(struct net_device *netdev, const u32 *indir,
+			   const u8 *key, const u8 hfunc)
+{
+	struct e1000_adapter *adapter = netdev_priv(netdev);
+	int i;
+
+	if (hfunc != ETH_RSS_HASH_NO_CHANGE && hfunc != ETH_RSS_HASH_TOP)
+		return -EOPNOTSUPP;
+
+	if (indir) {
+		for (i = 0; i < E1000E_RETA_SIZE; i++)
+			if (indir[i] >= adapter->num_queues)
+				return -EINVAL;
+		for (i = 0; i < E1000E_RETA_SIZE; i++)
+			adapter->rss_indir[i] = indir[i];
+	}
+	if (key)
+		memcpy(adapter->rss_key, key, E1000E_RSS_KEY_SIZE);
+
+	/* the hardware table is (re)programmed on every configure */
+	if (netif_running(netdev) &&
+	    ((netdev->features & NETIF_F_RXHASH) || adapter->num_queues > 1)) {
+		pm_runtime_get_sync(netdev->dev.parent);
+		e1000e_setup_rss_hash(adapter);
+		pm_runtime_put_sync(netdev->dev.parent);
+	}
+
+	return 0;
+}
+
+static void e1000e_get_channels(struct net_device *netdev,
+				struct ethtool_channels *ch)
+{
+	struct e1000_adapter *adapter = netdev_priv(netdev);
+
+	/* the queue count is fixed at probe by the MSI-X vectors granted */
+	ch->max_combined = adapter->num_queues;
+	ch->combined_count = adapter->num_queues;
+	ch->max_other = adapter->msix_entries ? 1 : 0;
+	ch->other_count = ch->max_other;
+}
+
 static int e1000e_get_eee(struct net_device *netdev, struct ethtool_eee *edata)
 {
 	struct e1000_adapter *adapter = netdev_priv(netdev);
@@ -2350,7 +2508,8 @@ static int e1000e_set_priv_flags(struct net_device *netdev, u32 priv_flags)
 }
 
 static const struct ethtool_ops e1000_ethtool_ops = {
-	.supported_coalesce_params = ETHTOOL_COALESCE_RX_USECS,
+	.supported_coalesce_params = ETHTOOL_COALESCE_RX_USECS |
+				     ETHTOOL_COALESCE_USE_ADAPTIVE_RX,
 	.get_drvinfo		= e1000_get_drvinfo,
 	.get_regs_len		= e1000_get_regs_len,
 	.get_regs		= e1000_get_regs,
@@ -2375,6 +2534,11 @@ static const struct ethtool_ops e1000_ethtool_ops = {
 	.get_coalesce		= e1000_get_coalesce,
 	.set_coalesce		= e1000_set_coalesce,
 	.get_rxnfc		= e1000_get_rxnfc,
+	.get_rxfh_indir_size	= e1000e_get_rxfh_indir_size,
+	.get_rxfh_key_size	= e1000e_get_rxfh_key_size,
+	.get_rxfh		= e1000e_get_rxfh,
+	.set_rxfh		= e1000e_set_rxfh,
+	.get_channels		= e1000e_get_channels,
 	.get_ts_info		= e1000e_get_ts_info,
 	.get_eee		= e1000e_get_eee,
 	.set_eee		= e1000e_set_eee,
@@ -538,26 +538,27 @@ static void e1000e_rx_hwtstamp(struct e1000_adapter *adapter, u32 status,
 
 /**
  * e1000_receive_skb - helper function to handle Rx indications
- * @adapter: board private structure
+ * @rx_ring: Rx descriptor ring the packet was received on
  * @netdev: pointer to netdev struct
  * @staterr: descriptor extended error and status field as written by hardware
  * @vlan: descriptor vlan field as written by hardware (no le/be conversion)
  * @skb: pointer to sk_buff to be indicated to stack
  **/
-static void e1000_receive_skb(struct e1000_adapter *adapter,
+static void e1000_receive_skb(struct e1000_ring *rx_ring,
 			      struct net_device *netdev, struct sk_buff *skb,
 			      u32 staterr, __le16 vlan)
 {
 	u16 tag = le16_to_cpu(vlan);
 
-	e1000e_rx_hwtstamp(adapter, staterr, skb);
+	e1000e_rx_hwtstamp(rx_ring->adapter, staterr, skb);
 
 	skb->protocol = eth_type_trans(skb, netdev);
 
 	if (staterr & E1000_RXD_STAT_VP)
 		__vlan_hwaccel_put_tag(skb, htons(ETH_P_8021Q), tag);
 
-	napi_gro_receive(&adapter->napi, skb);
+	skb_record_rx_queue(skb, rx_ring->queue_index);
+	napi_gro_receive(rx_ring->napi, skb);
 }
 
 /**
@@ -1002,7 +1003,7 @@ static bool e1000_clean_rx_irq(struct e1000_ring *rx_ring, int *work_done,
 		 */
 		if (length < copybreak) {
 			struct sk_buff *new_skb =
-				napi_alloc_skb(&adapter->napi, length);
+				napi_alloc_skb(rx_ring->napi, length);
 			if (new_skb) {
 				skb_copy_to_linear_data_offset(new_skb,
 							       -NET_IP_ALIGN,
@@ -1024,7 +1025,7 @@ static bool e1000_clean_rx_irq(struct e1000_ring *rx_ring, int *work_done,
 
 		e1000_rx_hash(netdev, rx_desc->wb.lower.hi_dword.rss, skb);
 
-		e1000_receive_skb(adapter, netdev, skb, staterr,
+		e1000_receive_skb(rx_ring, netdev, skb, staterr,
 				  rx_desc->wb.upper.vlan);
 
 next_desc:
@@ -1049,6 +1050,10 @@ next_desc:
 	if (cleaned_count)
 		adapter->alloc_rx_buf(rx_ring, cleaned_count, GFP_ATOMIC);
 
+	u64_stats_update_begin(&rx_ring->syncp);
+	rx_ring->packets += total_rx_packets;
+	rx_ring->bytes += total_rx_bytes;
+	u64_stats_update_end(&rx_ring->syncp);
 	adapter->total_rx_bytes += total_rx_bytes;
 	adapter->total_rx_packets += total_rx_packets;
 	return cleaned;
@@ -1258,7 +1263,9 @@ static bool e1000_clean_tx_irq(struct e1000_ring *tx_ring)
 
 	tx_ring->next_to_clean = i;
 
-	netdev_completed_queue(netdev, pkts_compl, bytes_compl);
+	netdev_tx_completed_queue(netdev_get_tx_queue(netdev,
+						      tx_ring->queue_index),
+				  pkts_compl, bytes_compl);
 
 #define TX_WAKE_THRESHOLD 32
 	if (count && netif_carrier_ok(netdev) &&
@@ -1268,14 +1275,15 @@ static bool e1000_clean_tx_irq(struct e1000_ring *tx_ring)
 		 */
 		smp_mb();
 
-		if (netif_queue_stopped(netdev) &&
+		if (__netif_subqueue_stopped(netdev, tx_ring->queue_index) &&
 		    !(test_bit(__E1000_DOWN, &adapter->state))) {
-			netif_wake_queue(netdev);
+			netif_wake_subqueue(netdev, tx_ring->queue_index);
 			++adapter->restart_queue;
 		}
 	}
 
-	if (adapter->detect_tx_hung) {
+	/* hang detection and reporting only look at queue 0 */
+	if (adapter->detect_tx_hung && !tx_ring->queue_index) {
 		/* Detect a transmit hang in hardware, this serializes the
 		 * check with the clearing of time_stamp and movement of i
 		 */
@@ -1288,6 +1296,10 @@ static bool e1000_clean_tx_irq(struct e1000_ring *tx_ring)
 		else
 			adapter->tx_hang_recheck = false;
 	}
+	u64_stats_update_begin(&tx_ring->syncp);
+	tx_ring->packets += total_tx_packets;
+	tx_ring->bytes += total_tx_bytes;
+	u64_stats_update_end(&tx_ring->syncp);
 	adapter->total_tx_bytes += total_tx_bytes;
 	adapter->total_tx_packets += total_tx_packets;
 	return count < tx_ring->count;
@@ -1457,7 +1469,7 @@ copydone:
 		    cpu_to_le16(E1000_RXDPS_HDRSTAT_HDRSP))
 			adapter->rx_hdr_split++;
 
-		e1000_receive_skb(adapter, netdev, skb, staterr,
+		e1000_receive_skb(rx_ring, netdev, skb, staterr,
 				  rx_desc->wb.middle.vlan);
 
 next_desc:
@@ -1483,6 +1495,10 @@ next_desc:
 	if (cleaned_count)
 		adapter->alloc_rx_buf(rx_ring, cleaned_count, GFP_ATOMIC);
 
+	u64_stats_update_begin(&rx_ring->syncp);
+	rx_ring->packets += total_rx_packets;
+	rx_ring->bytes += total_rx_bytes;
+	u64_stats_update_end(&rx_ring->syncp);
 	adapter->total_rx_bytes += total_rx_bytes;
 	adapter->total_rx_packets += total_rx_packets;
 	return cleaned;
@@ -1639,7 +1655,7 @@ static bool e1000_clean_jumbo_rx_irq(struct e1000_ring *rx_ring, int *work_done,
 			goto next_desc;
 		}
 
-		e1000_receive_skb(adapter, netdev, skb, staterr,
+		e1000_receive_skb(rx_ring, netdev, skb, staterr,
 				  rx_desc->wb.upper.vlan);
 
 next_desc:
@@ -1664,6 +1680,10 @@ next_desc:
 	if (cleaned_count)
 		adapter->alloc_rx_buf(rx_ring, cleaned_count, GFP_ATOMIC);
 
+	u64_stats_update_begin(&rx_ring->syncp);
+	rx_ring->packets += total_rx_packets;
+	rx_ring->bytes += total_rx_bytes;
+	u64_stats_update_end(&rx_ring->syncp);
 	adapter->total_rx_bytes += total_rx_bytes;
 	adapter->total_rx_packets += total_rx_packets;
 	return cleaned;
@@ -1803,12 +1823,12 @@ static irqreturn_t e1000_intr_msi(int __always_unused irq, void *data)
 		return IRQ_HANDLED;
 	}
 
-	if (napi_schedule_prep(&adapter->napi)) {
+	if (napi_schedule_prep(&adapter->napi[0])) {
 		adapter->total_tx_bytes = 0;
 		adapter->total_tx_packets = 0;
 		adapter->total_rx_bytes = 0;
 		adapter->total_rx_packets = 0;
-		__napi_schedule(&adapter->napi);
+		__napi_schedule(&adapter->napi[0]);
 	}
 
 	return IRQ_HANDLED;
@@ -1883,12 +1903,12 @@ static irqreturn_t e1000_intr(int __always_unused irq, void *data)
 		return IRQ_HANDLED;
 	}
 
-	if (napi_schedule_prep(&adapter->napi)) {
+	if (napi_schedule_prep(&adapter->napi[0])) {
 		adapter->total_tx_bytes = 0;
 		adapter->total_tx_packets = 0;
 		adapter->total_rx_bytes = 0;
 		adapter->total_rx_packets = 0;
-		__napi_schedule(&adapter->napi);
+		__napi_schedule(&adapter->napi[0]);
 	}
 
 	return IRQ_HANDLED;
@@ -1919,10 +1939,9 @@ static irqreturn_t e1000_msix_other(int __always_unused irq, void *data)
 
 static irqreturn_t e1000_intr_msix_tx(int __always_unused irq, void *data)
 {
-	struct net_device *netdev = data;
-	struct e1000_adapter *adapter = netdev_priv(netdev);
+	struct e1000_ring *tx_ring = data;
+	struct e1000_adapter *adapter = tx_ring->adapter;
 	struct e1000_hw *hw = &adapter->hw;
-	struct e1000_ring *tx_ring = adapter->tx_ring;
 
 	adapter->total_tx_bytes = 0;
 	adapter->total_tx_packets = 0;
@@ -1932,16 +1951,15 @@ static irqreturn_t e1000_intr_msix_tx(int __always_unused irq, void *data)
 		ew32(ICS, tx_ring->ims_val);
 
 	if (!test_bit(__E1000_DOWN, &adapter->state))
-		ew32(IMS, adapter->tx_ring->ims_val);
+		ew32(IMS, tx_ring->ims_val);
 
 	return IRQ_HANDLED;
 }
 
 static irqreturn_t e1000_intr_msix_rx(int __always_unused irq, void *data)
 {
-	struct net_device *netdev = data;
-	struct e1000_adapter *adapter = netdev_priv(netdev);
-	struct e1000_ring *rx_ring = adapter->rx_ring;
+	struct e1000_ring *rx_ring = data;
+	struct e1000_adapter *adapter = rx_ring->adapter;
 
 	/* Write the ITR value calculated at the end of the
 	 * previous interrupt.
@@ -1954,10 +1972,10 @@ static irqreturn_t e1000_intr_msix_rx(int __always_unused irq, void *data)
 		rx_ring->set_itr = 0;
 	}
 
-	if (napi_schedule_prep(&adapter->napi)) {
+	if (napi_schedule_prep(rx_ring->napi)) {
 		adapter->total_rx_bytes = 0;
 		adapter->total_rx_packets = 0;
-		__napi_schedule(&adapter->napi);
+		__napi_schedule(rx_ring->napi);
 	}
 	return IRQ_HANDLED;
 }
@@ -1973,8 +1991,8 @@ static void e1000_configure_msix(struct e1000_adapter *adapter)
 {
 	struct e1000_hw *hw = &adapter->hw;
 	struct e1000_ring *rx_ring = adapter->rx_ring;
-	struct e1000_ring *tx_ring = adapter->tx_ring;
-	int vector = 0;
+	struct e1000_ring *ring;
+	int i, vector = 0;
 	u32 ctrl_ext, ivar = 0;
 
 	adapter->eiac_mask = 0;
@@ -1987,29 +2005,33 @@ static void e1000_configure_msix(struct e1000_adapter *adapter)
 		ew32(RFCTL, rfctl);
 	}
 
-	/* Configure Rx vector */
-	rx_ring->ims_val = E1000_IMS_RXQ0;
-	adapter->eiac_mask |= rx_ring->ims_val;
-	if (rx_ring->itr_val)
-		writel(1000000000 / (rx_ring->itr_val * 256),
-		       rx_ring->itr_register);
-	else
-		writel(1, rx_ring->itr_register);
-	ivar = E1000_IVAR_INT_ALLOC_VALID | vector;
-
-	/* Configure Tx vector */
-	tx_ring->ims_val = E1000_IMS_TXQ0;
-	vector++;
-	if (tx_ring->itr_val)
-		writel(1000000000 / (tx_ring->itr_val * 256),
-		       tx_ring->itr_register);
-	else
-		writel(1, tx_ring->itr_register);
-	adapter->eiac_mask |= tx_ring->ims_val;
-	ivar |= ((E1000_IVAR_INT_ALLOC_VALID | vector) << 8);
+	/* Configure Rx vectors; IVAR holds RxQ0/RxQ1 in bits 7:0 */
+	for (i = 0; i < adapter->num_queues; i++, vector++) {
+		ring = &adapter->rx_ring[i];
+		ring->ims_val = E1000_IMS_RXQ0 << i;
+		adapter->eiac_mask |= ring->ims_val;
+		if (ring->itr_val)
+			writel(1000000000 / (ring->itr_val * 256),
+			       ring->itr_register);
+		else
+			writel(1, ring->itr_register);
+		ivar |= (E1000_IVAR_INT_ALLOC_VALID | vector) << (i * 4);
+	}
+
+	/* Configure Tx vectors; IVAR holds TxQ0/TxQ1 in bits 15:8 */
+	for (i = 0; i < adapter->num_queues; i++, vector++) {
+		ring = &adapter->tx_ring[i];
+		ring->ims_val = E1000_IMS_TXQ0 << i;
+		if (ring->itr_val)
+			writel(1000000000 / (ring->itr_val * 256),
+			       ring->itr_register);
+		else
+			writel(1, ring->itr_register);
+		adapter->eiac_mask |= ring->ims_val;
+		ivar |= (E1000_IVAR_INT_ALLOC_VALID | vector) << (8 + i * 4);
+	}
 
 	/* set vector for Other Causes, e.g. link changes */
-	vector++;
 	ivar |= ((E1000_IVAR_INT_ALLOC_VALID | vector) << 16);
 	if (rx_ring->itr_val)
 		writel(1000000000 / (rx_ring->itr_val * 256),
@@ -2050,13 +2072,22 @@ void e1000e_reset_interrupt_capability(struct e1000_adapter *adapter)
  **/
 void e1000e_set_interrupt_capability(struct e1000_adapter *adapter)
 {
-	int err;
+	int err, min_vectors;
 	int i;
 
 	switch (adapter->int_mode) {
 	case E1000E_INT_MODE_MSIX:
 		if (adapter->flags & FLAG_HAS_MSIX) {
-			adapter->num_vectors = 3; /* RxQ0, TxQ0 and other */
+			/* RxQn and TxQn per queue plus other.  The first call
+			 * (from probe) settles for one queue if it cannot get
+			 * vectors for all of them; later calls must match.
+			 */
+			min_vectors = 3;
+			if (adapter->num_queues)
+				min_vectors = 2 * adapter->num_queues + 1;
+			adapter->num_vectors = adapter->num_queues ?
+					       min_vectors :
+					       2 * E1000E_MAX_QUEUES + 1;
 			adapter->msix_entries = kcalloc(adapter->num_vectors,
 							sizeof(struct
 							       msix_entry),
@@ -2069,10 +2100,12 @@ void e1000e_set_interrupt_capability(struct e1000_adapter *adapter)
 
 				err = pci_enable_msix_range(a->pdev,
 							    a->msix_entries,
-							    a->num_vectors,
+							    min_vectors,
 							    a->num_vectors);
-				if (err > 0)
+				if (err > 0) {
+					a->num_vectors = err;
 					return;
+				}
 			}
 			/* MSI-X failed, so fall through and try MSI */
 			e_err("Failed to initialize MSI-X interrupts.  Falling back to MSI interrupts.\n");
@@ -2107,48 +2140,60 @@ void e1000e_set_interrupt_capability(struct e1000_adapter *adapter)
 static int e1000_request_msix(struct e1000_adapter *adapter)
 {
 	struct net_device *netdev = adapter->netdev;
+	struct e1000_ring *ring;
 	int err = 0, vector = 0;
+	int i;
 
-	if (strlen(netdev->name) < (IFNAMSIZ - 5))
-		snprintf(adapter->rx_ring->name,
-			 sizeof(adapter->rx_ring->name) - 1,
-			 "%.14s-rx-0", netdev->name);
-	else
-		memcpy(adapter->rx_ring->name, netdev->name, IFNAMSIZ);
-	err = request_irq(adapter->msix_entries[vector].vector,
-			  e1000_intr_msix_rx, 0, adapter->rx_ring->name,
-			  netdev);
-	if (err)
-		return err;
-	adapter->rx_ring->itr_register = adapter->hw.hw_addr +
-	    E1000_EITR_82574(vector);
-	adapter->rx_ring->itr_val = adapter->itr;
-	vector++;
-
-	if (strlen(netdev->name) < (IFNAMSIZ - 5))
-		snprintf(adapter->tx_ring->name,
-			 sizeof(adapter->tx_ring->name) - 1,
-			 "%.14s-tx-0", netdev->name);
-	else
-		memcpy(adapter->tx_ring->name, netdev->name, IFNAMSIZ);
-	err = request_irq(adapter->msix_entries[vector].vector,
-			  e1000_intr_msix_tx, 0, adapter->tx_ring->name,
-			  netdev);
-	if (err)
-		return err;
-	adapter->tx_ring->itr_register = adapter->hw.hw_addr +
-	    E1000_EITR_82574(vector);
-	adapter->tx_ring->itr_val = adapter->itr;
-	vector++;
+	for (i = 0; i < adapter->num_queues; i++, vector++) {
+		ring = &adapter->rx_ring[i];
+		if (strlen(netdev->name) < (IFNAMSIZ - 5))
+			snprintf(ring->name, sizeof(ring->name) - 1,
+				 "%.14s-rx-%d", netdev->name, i);
+		else
+			memcpy(ring->name, netdev->name, IFNAMSIZ);
+		err = request_irq(adapter->msix_entries[vector].vector,
+				  e1000_intr_msix_rx, 0, ring->name, ring);
+		if (err)
+			goto err_free;
+		ring->itr_register = adapter->hw.hw_addr +
+		    E1000_EITR_82574(vector);
+		ring->itr_val = adapter->itr;
+	}
+
+	for (i = 0; i < adapter->num_queues; i++, vector++) {
+		ring = &adapter->tx_ring[i];
+		if (strlen(netdev->name) < (IFNAMSIZ - 5))
+			snprintf(ring->name, sizeof(ring->name) - 1,
+				 "%.14s-tx-%d", netdev->name, i);
+		else
+			memcpy(ring->name, netdev->name, IFNAMSIZ);
+		err = request_irq(adapter->msix_entries[vector].vector,
+				  e1000_intr_msix_tx, 0, ring->name, ring);
+		if (err)
+			goto err_free;
+		ring->itr_register = adapter->hw.hw_addr +
+		    E1000_EITR_82574(vector);
+		ring->itr_val = adapter->itr;
+	}
 
 	err = request_irq(adapter->msix_entries[vector].vector,
 			  e1000_msix_other, 0, netdev->name, netdev);
 	if (err)
-		return err;
+		goto err_free;
 
 	e1000_configure_msix(adapter);
 
 	return 0;
+
+err_free:
+	while (vector--) {
+		if (vector >= adapter->num_queues)
+			ring = &adapter->tx_ring[vector - adapter->num_queues];
+		else
+			ring = &adapter->rx_ring[vector];
+		free_irq(adapter->msix_entries[vector].vector, ring);
+	}
+	return err;
 }
 
 /**
@@ -2196,13 +2241,15 @@ static void e1000_free_irq(struct e1000_adapter *adapter)
 	struct net_device *netdev = adapter->netdev;
 
 	if (adapter->msix_entries) {
-		int vector = 0;
+		int i, vector = 0;
 
-		free_irq(adapter->msix_entries[vector].vector, netdev);
-		vector++;
+		for (i = 0; i < adapter->num_queues; i++, vector++)
+			free_irq(adapter->msix_entries[vector].vector,
+				 &adapter->rx_ring[i]);
 
-		free_irq(adapter->msix_entries[vector].vector, netdev);
-		vector++;
+		for (i = 0; i < adapter->num_queues; i++, vector++)
+			free_irq(adapter->msix_entries[vector].vector,
+				 &adapter->tx_ring[i]);
 
 		/* Other Causes interrupt vector */
 		free_irq(adapter->msix_entries[vector].vector, netdev);
@@ -2427,7 +2474,8 @@ static void e1000_clean_tx_ring(struct e1000_ring *tx_ring)
 		e1000_put_txbuf(tx_ring, buffer_info, false);
 	}
 
-	netdev_reset_queue(adapter->netdev);
+	netdev_tx_reset_queue(netdev_get_tx_queue(adapter->netdev,
+						  tx_ring->queue_index));
 	size = sizeof(struct e1000_buffer) * tx_ring->count;
 	memset(tx_ring->buffer_info, 0, size);
 
@@ -2598,11 +2646,17 @@ set_itr_now:
 		new_itr = new_itr > adapter->itr ?
 		    min(adapter->itr + (new_itr >> 2), new_itr) : new_itr;
 		adapter->itr = new_itr;
-		adapter->rx_ring->itr_val = new_itr;
-		if (adapter->msix_entries)
-			adapter->rx_ring->set_itr = 1;
-		else
+		if (adapter->msix_entries) {
+			int i;
+
+			for (i = 0; i < adapter->num_queues; i++) {
+				adapter->rx_ring[i].itr_val = new_itr;
+				adapter->rx_ring[i].set_itr = 1;
+			}
+		} else {
+			adapter->rx_ring->itr_val = new_itr;
 			e1000e_write_itr(adapter, new_itr);
+		}
 	}
 }
 
@@ -2630,6 +2684,98 @@ void e1000e_write_itr(struct e1000_adapter *adapter, u32 itr)
 	}
 }
 
+/* Rx moderation levels for net DIM, in interrupts per second.  The ends
+ * match the lowest_latency and bulk_latency rates of e1000_set_itr(), so
+ * DIM only moves within the range the legacy heuristic already used.
+ */
+static const u32 e1000e_rx_dim_itr[E1000E_DIM_PROFILES] = {
+	70000, 35000, 20000, 8000, 4000
+};
+
+static void e1000e_rx_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct e1000_ring *rx_ring = container_of(dim, struct e1000_ring, dim);
+	struct e1000_adapter *adapter = rx_ring->adapter;
+	u32 new_itr = e1000e_rx_dim_itr[dim->profile_ix];
+
+	/* same limits as e1000_set_itr() */
+	if (adapter->link_speed != SPEED_1000)
+		new_itr = 4000;
+	else if (adapter->flags2 & FLAG2_DISABLE_AIM)
+		new_itr = 0;
+
+	if (new_itr != rx_ring->itr_val) {
+		rx_ring->itr_val = new_itr;
+		rx_ring->set_itr = 1;
+	}
+
+	dim->state = DIM_START_MEASURE;
+}
+
+/**
+ * e1000e_rx_dim_reset - restart net DIM on every Rx ring
+ * @adapter: board private structure
+ *
+ * Each ring starts again from the default level, which is also what
+ * adapter->itr holds while DIM is enabled, so the rate programmed on the
+ * next e1000e_up() matches the level DIM believes is in effect.
+ **/
+void e1000e_rx_dim_reset(struct e1000_adapter *adapter)
+{
+	int i;
+
+	for (i = 0; i < adapter->num_queues; i++) {
+		struct e1000_ring *rx_ring = &adapter->rx_ring[i];
+
+		rx_ring->dim.profile_ix = E1000E_DIM_DEFAULT_PROFILE;
+		rx_ring->dim.state = DIM_START_MEASURE;
+		rx_ring->itr_val = adapter->itr;
+		rx_ring->set_itr = 0;
+	}
+}
+
+/**
+ * e1000e_rx_dim_sample - feed a completed NAPI poll to net DIM
+ * @adapter: board private structure
+ * @rx_ring: ring whose NAPI context completed
+ *
+ * Without MSI-X queue 0's context cleans every ring behind the single ITR
+ * register, so its DIM instance samples the sum of all Rx rings and the
+ * new rate is written here rather than from the MSI-X Rx handler.
+ **/
+static void e1000e_rx_dim_sample(struct e1000_adapter *adapter,
+				 struct e1000_ring *rx_ring)
+{
+	struct dim_sample sample = {};
+	u64 packets = 0, bytes = 0;
+	int i;
+
+	if (adapter->msix_entries) {
+		packets = rx_ring->packets;
+		bytes = rx_ring->bytes;
+	} else {
+		for (i = 0; i < adapter->num_queues; i++) {
+			packets += adapter->rx_ring[i].packets;
+			bytes += adapter->rx_ring[i].bytes;
+		}
+	}
+
+	u64_stats_update_begin(&rx_ring->syncp);
+	rx_ring->dim_level[rx_ring->dim.profile_ix]++;
+	u64_stats_update_end(&rx_ring->syncp);
+
+	dim_update_sample(rx_ring->dim_events++, packets, bytes, &sample);
+#if IS_REACHABLE(CONFIG_DIMLIB)
+	net_dim(&rx_ring->dim, sample);
+#endif
+
+	if (!adapter->msix_entries && rx_ring->set_itr) {
+		e1000e_write_itr(adapter, rx_ring->itr_val);
+		rx_ring->set_itr = 0;
+	}
+}
+
 /**
  * e1000_alloc_queues - Allocate memory for all rings
  * @adapter: board private structure to initialize
@@ -2637,18 +2783,35 @@ void e1000e_write_itr(struct e1000_adapter *adapter, u32 itr)
 static int e1000_alloc_queues(struct e1000_adapter *adapter)
 {
 	int size = sizeof(struct e1000_ring);
+	int i;
 
-	adapter->tx_ring = kzalloc(size, GFP_KERNEL);
+	adapter->tx_ring = kcalloc(adapter->num_queues, size, GFP_KERNEL);
 	if (!adapter->tx_ring)
 		goto err;
-	adapter->tx_ring->count = adapter->tx_ring_count;
-	adapter->tx_ring->adapter = adapter;
 
-	adapter->rx_ring = kzalloc(size, GFP_KERNEL);
+	adapter->rx_ring = kcalloc(adapter->num_queues, size, GFP_KERNEL);
 	if (!adapter->rx_ring)
 		goto err;
-	adapter->rx_ring->count = adapter->rx_ring_count;
-	adapter->rx_ring->adapter = adapter;
+
+	for (i = 0; i < adapter->num_queues; i++) {
+		struct e1000_ring *tx_ring = &adapter->tx_ring[i];
+		struct e1000_ring *rx_ring = &adapter->rx_ring[i];
+
+		tx_ring->count = adapter->tx_ring_count;
+		tx_ring->adapter = adapter;
+		tx_ring->queue_index = i;
+		u64_stats_init(&tx_ring->syncp);
+
+		rx_ring->count = adapter->rx_ring_count;
+		rx_ring->adapter = adapter;
+		rx_ring->queue_index = i;
+		rx_ring->napi = &adapter->napi[i];
+		u64_stats_init(&rx_ring->syncp);
+
+		INIT_WORK(&rx_ring->dim.work, e1000e_rx_dim_work);
+		rx_ring->dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
+		rx_ring->dim.profile_ix = E1000E_DIM_DEFAULT_PROFILE;
+	}
 
 	return 0;
 err:
@@ -2662,22 +2825,31 @@ err:
  * e1000e_poll - NAPI Rx polling callback
  * @napi: struct associated with this polling callback
  * @budget: number of packets driver is allowed to process this poll
+ *
+ * In MSI-X mode each Rx queue has its own NAPI context and Tx is cleaned
+ * from the Tx vectors.  Otherwise everything is funnelled through queue 0's
+ * context, which then cleans every ring.
  **/
 static int e1000e_poll(struct napi_struct *napi, int budget)
 {
-	struct e1000_adapter *adapter = container_of(napi, struct e1000_adapter,
-						     napi);
+	struct net_device *poll_dev = napi->dev;
+	struct e1000_adapter *adapter = netdev_priv(poll_dev);
+	struct e1000_ring *rx_ring = &adapter->rx_ring[napi - adapter->napi];
 	struct e1000_hw *hw = &adapter->hw;
-	struct net_device *poll_dev = adapter->netdev;
 	int tx_cleaned = 1, work_done = 0;
+	int i;
 
-	adapter = netdev_priv(poll_dev);
-
-	if (!adapter->msix_entries ||
-	    (adapter->rx_ring->ims_val & adapter->tx_ring->ims_val))
-		tx_cleaned = e1000_clean_tx_irq(adapter->tx_ring);
+	if (!adapter->msix_entries) {
+		for (i = 0; i < adapter->num_queues; i++)
+			if (!e1000_clean_tx_irq(&adapter->tx_ring[i]))
+				tx_cleaned = 0;
 
-	adapter->clean_rx(adapter->rx_ring, &work_done, budget);
+		for (i = 0; i < adapter->num_queues; i++)
+			adapter->clean_rx(&adapter->rx_ring[i], &work_done,
+					  budget);
+	} else {
+		adapter->clean_rx(rx_ring, &work_done, budget);
+	}
 
 	if (!tx_cleaned || work_done == budget)
 		return budget;
@@ -2686,11 +2858,13 @@ static int e1000e_poll(struct napi_struct *napi, int budget)
 	 * poll us due to busy-polling
 	 */
 	if (likely(napi_complete_done(napi, work_done))) {
-		if (adapter->itr_setting & 3)
+		if (adapter->flags2 & FLAG2_DIM)
+			e1000e_rx_dim_sample(adapter, rx_ring);
+		else if (adapter->itr_setting & 3)
 			e1000_set_itr(adapter);
 		if (!test_bit(__E1000_DOWN, &adapter->state)) {
 			if (adapter->msix_entries)
-				ew32(IMS, adapter->rx_ring->ims_val);
+				ew32(IMS, rx_ring->ims_val);
 			else
 				e1000_irq_enable(adapter);
 		}
@@ -2921,26 +3095,30 @@ static void e1000_init_manageability_pt(struct e1000_adapter *adapter)
 static void e1000_configure_tx(struct e1000_adapter *adapter)
 {
 	struct e1000_hw *hw = &adapter->hw;
-	struct e1000_ring *tx_ring = adapter->tx_ring;
+	struct e1000_ring *tx_ring;
 	u64 tdba;
 	u32 tdlen, tctl, tarc;
+	int i;
 
 	/* Setup the HW Tx Head and Tail descriptor pointers */
-	tdba = tx_ring->dma;
-	tdlen = tx_ring->count * sizeof(struct e1000_tx_desc);
-	ew32(TDBAL(0), (tdba & DMA_BIT_MASK(32)));
-	ew32(TDBAH(0), (tdba >> 32));
-	ew32(TDLEN(0), tdlen);
-	ew32(TDH(0), 0);
-	ew32(TDT(0), 0);
-	tx_ring->head = adapter->hw.hw_addr + E1000_TDH(0);
-	tx_ring->tail = adapter->hw.hw_addr + E1000_TDT(0);
-
-	writel(0, tx_ring->head);
-	if (adapter->flags2 & FLAG2_PCIM2PCI_ARBITER_WA)
-		e1000e_update_tdt_wa(tx_ring, 0);
-	else
-		writel(0, tx_ring->tail);
+	for (i = 0; i < adapter->num_queues; i++) {
+		tx_ring = &adapter->tx_ring[i];
+		tdba = tx_ring->dma;
+		tdlen = tx_ring->count * sizeof(struct e1000_tx_desc);
+		ew32(TDBAL(i), (tdba & DMA_BIT_MASK(32)));
+		ew32(TDBAH(i), (tdba >> 32));
+		ew32(TDLEN(i), tdlen);
+		ew32(TDH(i), 0);
+		ew32(TDT(i), 0);
+		tx_ring->head = adapter->hw.hw_addr + E1000_TDH(i);
+		tx_ring->tail = adapter->hw.hw_addr + E1000_TDT(i);
+
+		writel(0, tx_ring->head);
+		if (adapter->flags2 & FLAG2_PCIM2PCI_ARBITER_WA)
+			e1000e_update_tdt_wa(tx_ring, 0);
+		else
+			writel(0, tx_ring->tail);
+	}
 
 	/* Set the Tx Interrupt Delay register */
 	ew32(TIDV, adapter->tx_int_delay);
@@ -2993,6 +3171,15 @@ static void e1000_configure_tx(struct e1000_adapter *adapter)
 		ew32(TARC(1), tarc);
 	}
 
+	/* let the arbiter service the second queue as well */
+	if (adapter->num_queues > 1) {
+		for (i = 0; i < adapter->num_queues; i++) {
+			tarc = er32(TARC(i));
+			tarc |= E1000_TARC_ENABLE;
+			ew32(TARC(i), tarc);
+		}
+	}
+
 	/* Setup Transmit Descriptor Settings for eop descriptor */
 	adapter->txd_cmd = E1000_TXD_CMD_EOP | E1000_TXD_CMD_IFCS;
 
@@ -3197,6 +3384,7 @@ static void e1000_configure_rx(struct e1000_adapter *adapter)
 	struct e1000_ring *rx_ring = adapter->rx_ring;
 	u64 rdba;
 	u32 rdlen, rctl, rxcsum, ctrl_ext;
+	int i;
 
 	if (adapter->rx_ps_pages) {
 		/* this is a 32 byte descriptor */
@@ -3239,7 +3427,8 @@ static void e1000_configure_rx(struct e1000_adapter *adapter)
 
 	/* irq moderation */
 	ew32(RADV, adapter->rx_abs_int_delay);
-	if ((adapter->itr_setting != 0) && (adapter->itr != 0))
+	if (((adapter->itr_setting != 0) || (adapter->flags2 & FLAG2_DIM)) &&
+	    (adapter->itr != 0))
 		e1000e_write_itr(adapter, adapter->itr);
 
 	ctrl_ext = er32(CTRL_EXT);
@@ -3252,20 +3441,23 @@ static void e1000_configure_rx(struct e1000_adapter *adapter)
 	/* Setup the HW Rx Head and Tail Descriptor Pointers and
 	 * the Base and Length of the Rx Descriptor Ring
 	 */
-	rdba = rx_ring->dma;
-	ew32(RDBAL(0), (rdba & DMA_BIT_MASK(32)));
-	ew32(RDBAH(0), (rdba >> 32));
-	ew32(RDLEN(0), rdlen);
-	ew32(RDH(0), 0);
-	ew32(RDT(0), 0);
-	rx_ring->head = adapter->hw.hw_addr + E1000_RDH(0);
-	rx_ring->tail = adapter->hw.hw_addr + E1000_RDT(0);
-
-	writel(0, rx_ring->head);
-	if (adapter->flags2 & FLAG2_PCIM2PCI_ARBITER_WA)
-		e1000e_update_rdt_wa(rx_ring, 0);
-	else
-		writel(0, rx_ring->tail);
+	for (i = 0; i < adapter->num_queues; i++) {
+		rx_ring = &adapter->rx_ring[i];
+		rdba = rx_ring->dma;
+		ew32(RDBAL(i), (rdba & DMA_BIT_MASK(32)));
+		ew32(RDBAH(i), (rdba >> 32));
+		ew32(RDLEN(i), rdlen);
+		ew32(RDH(i), 0);
+		ew32(RDT(i), 0);
+		rx_ring->head = adapter->hw.hw_addr + E1000_RDH(i);
+		rx_ring->tail = adapter->hw.hw_addr + E1000_RDT(i);
+
+		writel(0, rx_ring->head);
+		if (adapter->flags2 & FLAG2_PCIM2PCI_ARBITER_WA)
+			e1000e_update_rdt_wa(rx_ring, 0);
+		else
+			writel(0, rx_ring->tail);
+	}
 
 	/* Enable Receive Checksum Offload for TCP and UDP */
 	rxcsum = er32(RXCSUM);
@@ -3456,20 +3648,35 @@ static void e1000e_set_rx_mode(struct net_device *netdev)
 		e1000e_vlan_strip_disable(adapter);
 }
 
-static void e1000e_setup_rss_hash(struct e1000_adapter *adapter)
+/**
+ * e1000e_setup_rss_hash - program the RSS key, redirection table and MRQC
+ * @adapter: board private structure
+ *
+ * With more than one Rx queue the redirection table spreads flows across
+ * the queues; otherwise RSS only provides the hash for NETIF_F_RXHASH.
+ **/
+void e1000e_setup_rss_hash(struct e1000_adapter *adapter)
 {
 	struct e1000_hw *hw = &adapter->hw;
 	u32 mrqc, rxcsum;
-	u32 rss_key[10];
-	int i;
+	int i, j;
+
+	for (i = 0; i < E1000E_RSS_KEY_SIZE / 4; i++)
+		ew32(RSSRK(i), adapter->rss_key[i]);
 
-	netdev_rss_key_fill(rss_key, sizeof(rss_key));
-	for (i = 0; i < 10; i++)
-		ew32(RSSRK(i), rss_key[i]);
+	/* four one-byte entries per register */
+	for (i = 0; i < E1000E_RETA_SIZE / 4; i++) {
+		u32 reta = 0;
 
-	/* Direct all traffic to queue 0 */
-	for (i = 0; i < 32; i++)
-		ew32(RETA(i), 0);
+		for (j = 0; j < 4; j++) {
+			u8 queue = adapter->rss_indir[i * 4 + j];
+
+			if (queue >= adapter->num_queues)
+				queue = 0;
+			reta |= (u32)(queue << E1000_RETA_QUEUE_SHIFT) << (j * 8);
+		}
+		ew32(RETA(i), reta);
+	}
 
 	/* Disable raw packet checksumming so that RSS hash is placed in
 	 * descriptor on writeback.
@@ -3484,6 +3691,8 @@ static void e1000e_setup_rss_hash(struct e1000_adapter *adapter)
 		E1000_MRQC_RSS_FIELD_IPV6 |
 		E1000_MRQC_RSS_FIELD_IPV6_TCP |
 		E1000_MRQC_RSS_FIELD_IPV6_TCP_EX);
+	if (adapter->num_queues > 1)
+		mrqc |= E1000_MRQC_ENABLE_RSS_2Q;
 
 	ew32(MRQC, mrqc);
 }
@@ -3754,7 +3963,8 @@ static int e1000e_config_hwtstamp(struct e1000_adapter *adapter,
  **/
 static void e1000_configure(struct e1000_adapter *adapter)
 {
-	struct e1000_ring *rx_ring = adapter->rx_ring;
+	struct e1000_ring *rx_ring;
+	int i;
 
 	e1000e_set_rx_mode(adapter->netdev);
 
@@ -3763,11 +3973,16 @@ static void e1000_configure(struct e1000_adapter *adapter)
 
 	e1000_configure_tx(adapter);
 
-	if (adapter->netdev->features & NETIF_F_RXHASH)
+	if ((adapter->netdev->features & NETIF_F_RXHASH) ||
+	    adapter->num_queues > 1)
 		e1000e_setup_rss_hash(adapter);
 	e1000_setup_rctl(adapter);
 	e1000_configure_rx(adapter);
-	adapter->alloc_rx_buf(rx_ring, e1000_desc_unused(rx_ring), GFP_KERNEL);
+	for (i = 0; i < adapter->num_queues; i++) {
+		rx_ring = &adapter->rx_ring[i];
+		adapter->alloc_rx_buf(rx_ring, e1000_desc_unused(rx_ring),
+				      GFP_KERNEL);
+	}
 }
 
 /**
@@ -4094,7 +4309,7 @@ void e1000e_reset(struct e1000_adapter *adapter)
 	/* Disable Adaptive Interrupt Moderation if 2 full packets cannot
 	 * fit in receive buffer.
 	 */
-	if (adapter->itr_setting & 0x3) {
+	if ((adapter->itr_setting & 0x3) || (adapter->flags2 & FLAG2_DIM)) {
 		if ((adapter->max_frame_size * 2) > (pba << 10)) {
 			if (!(adapter->flags2 & FLAG2_DISABLE_AIM)) {
 				dev_info(&adapter->pdev->dev,
@@ -4270,6 +4485,7 @@ void e1000e_down(struct e1000_adapter *adapter, bool reset)
 	struct net_device *netdev = adapter->netdev;
 	struct e1000_hw *hw = &adapter->hw;
 	u32 tctl, rctl;
+	int i;
 
 	/* signal that we're down so the interrupt handler does not
 	 * reschedule our watchdog timer
@@ -4284,7 +4500,7 @@ void e1000e_down(struct e1000_adapter *adapter, bool reset)
 		ew32(RCTL, rctl & ~E1000_RCTL_EN);
 	/* flush and sleep below */
 
-	netif_stop_queue(netdev);
+	netif_tx_stop_all_queues(netdev);
 
 	/* disable transmits in the hardware */
 	tctl = er32(TCTL);
@@ -4297,7 +4513,12 @@ void e1000e_down(struct e1000_adapter *adapter, bool reset)
 
 	e1000_irq_disable(adapter);
 
-	napi_synchronize(&adapter->napi);
+	for (i = 0; i < adapter->num_queues; i++) {
+		napi_synchronize(&adapter->napi[i]);
+		cancel_work_sync(&adapter->rx_ring[i].dim.work);
+	}
+	if (adapter->flags2 & FLAG2_DIM)
+		e1000e_rx_dim_reset(adapter);
 
 	del_timer_sync(&adapter->watchdog_timer);
 	del_timer_sync(&adapter->phy_info_timer);
@@ -4323,8 +4544,10 @@ void e1000e_down(struct e1000_adapter *adapter, bool reset)
 		else if (hw->mac.type >= e1000_pch_spt)
 			e1000_flush_desc_rings(adapter);
 	}
-	e1000_clean_tx_ring(adapter->tx_ring);
-	e1000_clean_rx_ring(adapter->rx_ring);
+	for (i = 0; i < adapter->num_queues; i++) {
+		e1000_clean_tx_ring(&adapter->tx_ring[i]);
+		e1000_clean_rx_ring(&adapter->rx_ring[i]);
+	}
 }
 
 void e1000e_reinit_locked(struct e1000_adapter *adapter)
@@ -4445,6 +4668,7 @@ static u64 e1000e_cyclecounter_read(const struct cyclecounter *cc)
 static int e1000_sw_init(struct e1000_adapter *adapter)
 {
 	struct net_device *netdev = adapter->netdev;
+	int i;
 
 	adapter->rx_buffer_len = VLAN_ETH_FRAME_LEN + ETH_FCS_LEN;
 	adapter->rx_ps_bsize0 = 128;
@@ -4457,6 +4681,16 @@ static int e1000_sw_init(struct e1000_adapter *adapter)
 
 	e1000e_set_interrupt_capability(adapter);
 
+	/* a second queue pair needs its own Rx and Tx vectors */
+	adapter->num_queues = 1;
+	if (adapter->msix_entries)
+		adapter->num_queues = (adapter->num_vectors - 1) / 2;
+
+	netdev_rss_key_fill(adapter->rss_key, sizeof(adapter->rss_key));
+	for (i = 0; i < E1000E_RETA_SIZE; i++)
+		adapter->rss_indir[i] =
+			ethtool_rxfh_indir_default(i, adapter->num_queues);
+
 	if (e1000_alloc_queues(adapter))
 		return -ENOMEM;
 
@@ -4618,7 +4852,7 @@ int e1000e_open(struct net_device *netdev)
 	struct e1000_adapter *adapter = netdev_priv(netdev);
 	struct e1000_hw *hw = &adapter->hw;
 	struct pci_dev *pdev = adapter->pdev;
-	int err;
+	int err, i, j = 0;
 
 	/* disallow open during test */
 	if (test_bit(__E1000_TESTING, &adapter->state))
@@ -4627,17 +4861,21 @@ int e1000e_open(struct net_device *netdev)
 	pm_runtime_get_sync(&pdev->dev);
 
 	netif_carrier_off(netdev);
-	netif_stop_queue(netdev);
+	netif_tx_stop_all_queues(netdev);
 
 	/* allocate transmit descriptors */
-	err = e1000e_setup_tx_resources(adapter->tx_ring);
-	if (err)
-		goto err_setup_tx;
+	for (i = 0; i < adapter->num_queues; i++) {
+		err = e1000e_setup_tx_resources(&adapter->tx_ring[i]);
+		if (err)
+			goto err_setup_tx;
+	}
 
 	/* allocate receive descriptors */
-	err = e1000e_setup_rx_resources(adapter->rx_ring);
-	if (err)
-		goto err_setup_rx;
+	for (j = 0; j < adapter->num_queues; j++) {
+		err = e1000e_setup_rx_resources(&adapter->rx_ring[j]);
+		if (err)
+			goto err_setup_rx;
+	}
 
 	/* If AMT is enabled, let the firmware know that the network
 	 * interface is now open and reset the part to a known state.
@@ -4682,7 +4920,8 @@ int e1000e_open(struct net_device *netdev)
 	/* From here on the code is the same as e1000e_up() */
 	clear_bit(__E1000_DOWN, &adapter->state);
 
-	napi_enable(&adapter->napi);
+	for (i = 0; i < adapter->num_queues; i++)
+		napi_enable(&adapter->napi[i]);
 
 	e1000_irq_enable(adapter);
 
@@ -4699,10 +4938,13 @@ err_req_irq:
 	cpu_latency_qos_remove_request(&adapter->pm_qos_req);
 	e1000e_release_hw_control(adapter);
 	e1000_power_down_phy(adapter);
-	e1000e_free_rx_resources(adapter->rx_ring);
 err_setup_rx:
-	e1000e_free_tx_resources(adapter->tx_ring);
+	while (j--)
+		e1000e_free_rx_resources(&adapter->rx_ring[j]);
+	i = adapter->num_queues;
 err_setup_tx:
+	while (i--)
+		e1000e_free_tx_resources(&adapter->tx_ring[i]);
 	e1000e_reset(adapter);
 	pm_runtime_put_sync(&pdev->dev);
 
@@ -4725,6 +4967,7 @@ int e1000e_close(struct net_device *netdev)
 	struct e1000_adapter *adapter = netdev_priv(netdev);
 	struct pci_dev *pdev = adapter->pdev;
 	int count = E1000_CHECK_RESET_COUNT;
+	int i;
 
 	while (test_bit(__E1000_RESETTING, &adapter->state) && count--)
 		usleep_range(10000, 11000);
@@ -4741,10 +4984,12 @@ int e1000e_close(struct net_device *netdev)
 		netdev_info(netdev, "NIC Link is Down\n");
 	}
 
-	napi_disable(&adapter->napi);
+	for (i = 0; i < adapter->num_queues; i++) {
+		napi_disable(&adapter->napi[i]);
 
-	e1000e_free_tx_resources(adapter->tx_ring);
-	e1000e_free_rx_resources(adapter->rx_ring);
+		e1000e_free_tx_resources(&adapter->tx_ring[i]);
+		e1000e_free_rx_resources(&adapter->rx_ring[i]);
+	}
 
 	/* kill manageability vlan ID if supported, but not if a vlan with
 	 * the same ID is registered on the host OS (let 8021q kill it)
@@ -5193,10 +5438,11 @@ static void e1000_watchdog_task(struct work_struct *work)
 	struct net_device *netdev = adapter->netdev;
 	struct e1000_mac_info *mac = &adapter->hw.mac;
 	struct e1000_phy_info *phy = &adapter->hw.phy;
-	struct e1000_ring *tx_ring = adapter->tx_ring;
+	struct e1000_ring *tx_ring;
 	u32 dmoff_exit_timeout = 100, tries = 0;
 	struct e1000_hw *hw = &adapter->hw;
 	u32 link, tctl, pcim_state;
+	int i;
 
 	if (test_bit(__E1000_DOWN, &adapter->state))
 		return;
@@ -5331,7 +5577,7 @@ static void e1000_watchdog_task(struct work_struct *work)
 			if (phy->ops.cfg_on_link_up)
 				phy->ops.cfg_on_link_up(hw);
 
-			netif_wake_queue(netdev);
+			netif_tx_wake_all_queues(netdev);
 			netif_carrier_on(netdev);
 
 			if (!test_bit(__E1000_DOWN, &adapter->state))
@@ -5345,7 +5591,7 @@ static void e1000_watchdog_task(struct work_struct *work)
 			/* Link status message must follow this format */
 			netdev_info(netdev, "NIC Link is Down\n");
 			netif_carrier_off(netdev);
-			netif_stop_queue(netdev);
+			netif_tx_stop_all_queues(netdev);
 			if (!test_bit(__E1000_DOWN, &adapter->state))
 				mod_timer(&adapter->phy_info_timer,
 					  round_jiffies(jiffies + 2 * HZ));
@@ -5381,9 +5627,13 @@ link_up:
 	 * if there is queued Tx work it cannot be done.  So
 	 * reset the controller to flush the Tx packet buffers.
 	 */
-	if (!netif_carrier_ok(netdev) &&
-	    (e1000_desc_unused(tx_ring) + 1 < tx_ring->count))
-		adapter->flags |= FLAG_RESTART_NOW;
+	if (!netif_carrier_ok(netdev)) {
+		for (i = 0; i < adapter->num_queues; i++) {
+			tx_ring = &adapter->tx_ring[i];
+			if (e1000_desc_unused(tx_ring) + 1 < tx_ring->count)
+				adapter->flags |= FLAG_RESTART_NOW;
+		}
+	}
 
 	/* If reset is necessary, do it outside of interrupt context. */
 	if (adapter->flags & FLAG_RESTART_NOW) {
@@ -5395,7 +5645,7 @@ link_up:
 	e1000e_update_adaptive(&adapter->hw);
 
 	/* Simple mode for Interrupt Throttle Rate (ITR) */
-	if (adapter->itr_setting == 4) {
+	if (adapter->itr_setting == 4 && !(adapter->flags2 & FLAG2_DIM)) {
 		/* Symmetric Tx/Rx gets a reduced ITR=2000;
 		 * Total asymmetrical Tx or Rx gets ITR=8000;
 		 * everyone else is between 2000-8000.
@@ -5409,10 +5659,14 @@ link_up:
 		e1000e_write_itr(adapter, itr);
 	}
 
-	/* Cause software interrupt to ensure Rx ring is cleaned */
-	if (adapter->msix_entries)
-		ew32(ICS, adapter->rx_ring->ims_val);
-	else
+	/* Cause software interrupt to ensure Rx rings are cleaned */
+	if (adapter->msix_entries) {
+		u32 ics = 0;
+
+		for (i = 0; i < adapter->num_queues; i++)
+			ics |= adapter->rx_ring[i].ims_val;
+		ew32(ICS, ics);
+	} else
 		ew32(ICS, E1000_ICS_RXDMT0);
 
 	/* flush pending descriptors to memory before detecting Tx hang */
@@ -5779,7 +6033,7 @@ static int __e1000_maybe_stop_tx(struct e1000_ring *tx_ring, int size)
 {
 	struct e1000_adapter *adapter = tx_ring->adapter;
 
-	netif_stop_queue(adapter->netdev);
+	netif_stop_subqueue(adapter->netdev, tx_ring->queue_index);
 	/* Herbert's original patch had:
 	 *  smp_mb__after_netif_stop_queue();
 	 * but since that doesn't exist yet, just open code it.
@@ -5793,7 +6047,7 @@ static int __e1000_maybe_stop_tx(struct e1000_ring *tx_ring, int size)
 		return -EBUSY;
 
 	/* A reprieve! */
-	netif_start_queue(adapter->netdev);
+	netif_start_subqueue(adapter->netdev, tx_ring->queue_index);
 	++adapter->restart_queue;
 	return 0;
 }
@@ -5807,11 +6061,33 @@ static int e1000_maybe_stop_tx(struct e1000_ring *tx_ring, int size)
 	return __e1000_maybe_stop_tx(tx_ring, size);
 }
 
+/**
+ * e1000_select_queue - pick the Tx queue for a packet
+ * @netdev: network interface device structure
+ * @skb: packet to transmit
+ * @sb_dev: subordinate device, if any
+ *
+ * The Tx timestamp slot and the manageability DHCP snooping state are per
+ * adapter, so packets that may touch them stay on queue 0.
+ **/
+static u16 e1000_select_queue(struct net_device *netdev, struct sk_buff *skb,
+			      struct net_device *sb_dev)
+{
+	struct e1000_adapter *adapter = netdev_priv(netdev);
+
+	if (unlikely(skb_shinfo(skb)->tx_flags & SKBTX_HW_TSTAMP) ||
+	    adapter->hw.mac.tx_pkt_filtering)
+		return 0;
+
+	return netdev_pick_tx(netdev, skb, sb_dev);
+}
+
 static netdev_tx_t e1000_xmit_frame(struct sk_buff *skb,
 				    struct net_device *netdev)
 {
 	struct e1000_adapter *adapter = netdev_priv(netdev);
-	struct e1000_ring *tx_ring = adapter->tx_ring;
+	struct e1000_ring *tx_ring;
+	struct netdev_queue *txq;
 	unsigned int first;
 	unsigned int tx_flags = 0;
 	unsigned int len = skb_headlen(skb);
@@ -5827,6 +6103,9 @@ static netdev_tx_t e1000_xmit_frame(struct sk_buff *skb,
 		return NETDEV_TX_OK;
 	}
 
+	tx_ring = &adapter->tx_ring[skb_get_queue_mapping(skb)];
+	txq = netdev_get_tx_queue(netdev, tx_ring->queue_index);
+
 	if (skb->len <= 0) {
 		dev_kfree_skb_any(skb);
 		return NETDEV_TX_OK;
@@ -5917,8 +6196,10 @@ static netdev_tx_t e1000_xmit_frame(struct sk_buff *skb,
 	count = e1000_tx_map(tx_ring, skb, first, adapter->tx_fifo_limit,
 			     nr_frags);
 	if (count) {
+		/* only queue 0 may own the single Tx timestamp slot */
 		if (unlikely(skb_shinfo(skb)->tx_flags & SKBTX_HW_TSTAMP) &&
-		    (adapter->flags & FLAG_HAS_HW_TIMESTAMP)) {
+		    (adapter->flags & FLAG_HAS_HW_TIMESTAMP) &&
+		    !tx_ring->queue_index) {
 			if (!adapter->tx_hwtstamp_skb) {
 				skb_shinfo(skb)->tx_flags |= SKBTX_IN_PROGRESS;
 				tx_flags |= E1000_TX_FLAGS_HWTSTAMP;
@@ -5932,7 +6213,7 @@ static netdev_tx_t e1000_xmit_frame(struct sk_buff *skb,
 
 		skb_tx_timestamp(skb);
 
-		netdev_sent_queue(netdev, skb->len);
+		netdev_tx_sent_queue(txq, skb->len);
 		e1000_tx_queue(tx_ring, tx_flags, count);
 		/* Make sure there is space in the ring for the next send. */
 		e1000_maybe_stop_tx(tx_ring,
@@ -5940,8 +6221,7 @@ static netdev_tx_t e1000_xmit_frame(struct sk_buff *skb,
 				     DIV_ROUND_UP(PAGE_SIZE,
 						  adapter->tx_fifo_limit) + 2));
 
-		if (!netdev_xmit_more() ||
-		    netif_xmit_stopped(netdev_get_tx_queue(netdev, 0))) {
+		if (!netdev_xmit_more() || netif_xmit_stopped(txq)) {
 			if (adapter->flags2 & FLAG2_PCIM2PCI_ARBITER_WA)
 				e1000e_update_tdt_wa(tx_ring,
 						     tx_ring->next_to_use);
@@ -7041,21 +7321,24 @@ static irqreturn_t e1000_intr_msix(int __always_unused irq, void *data)
 	struct e1000_adapter *adapter = netdev_priv(netdev);
 
 	if (adapter->msix_entries) {
-		int vector, msix_irq;
-
-		vector = 0;
-		msix_irq = adapter->msix_entries[vector].vector;
-		if (disable_hardirq(msix_irq))
-			e1000_intr_msix_rx(msix_irq, netdev);
-		enable_irq(msix_irq);
+		int i, vector = 0, msix_irq;
+
+		for (i = 0; i < adapter->num_queues; i++, vector++) {
+			msix_irq = adapter->msix_entries[vector].vector;
+			if (disable_hardirq(msix_irq))
+				e1000_intr_msix_rx(msix_irq,
+						   &adapter->rx_ring[i]);
+			enable_irq(msix_irq);
+		}
 
-		vector++;
-		msix_irq = adapter->msix_entries[vector].vector;
-		if (disable_hardirq(msix_irq))
-			e1000_intr_msix_tx(msix_irq, netdev);
-		enable_irq(msix_irq);
+		for (i = 0; i < adapter->num_queues; i++, vector++) {
+			msix_irq = adapter->msix_entries[vector].vector;
+			if (disable_hardirq(msix_irq))
+				e1000_intr_msix_tx(msix_irq,
+						   &adapter->tx_ring[i]);
+			enable_irq(msix_irq);
+		}
 
-		vector++;
 		msix_irq = adapter->msix_entries[vector].vector;
 		if (disable_hardirq(msix_irq))
 			e1000_msix_other(msix_irq, netdev);
@@ -7291,6 +7574,7 @@ static const struct net_device_ops e1000e_netdev_ops = {
 	.ndo_open		= e1000e_open,
 	.ndo_stop		= e1000e_close,
 	.ndo_start_xmit		= e1000_xmit_frame,
+	.ndo_select_queue	= e1000_select_queue,
 	.ndo_get_stats64	= e1000e_get_stats64,
 	.ndo_set_rx_mode	= e1000e_set_rx_mode,
 	.ndo_set_mac_address	= e1000_set_mac,
@@ -7375,7 +7659,8 @@ static int e1000_probe(struct pci_dev *pdev, const struct pci_device_id *ent)
 		goto err_alloc_etherdev;
 
 	err = -ENOMEM;
-	netdev = alloc_etherdev(sizeof(struct e1000_adapter));
+	netdev = alloc_etherdev_mq(sizeof(struct e1000_adapter),
+				   E1000E_MAX_QUEUES);
 	if (!netdev)
 		goto err_alloc_etherdev;
 
@@ -7423,7 +7708,6 @@ static int e1000_probe(struct pci_dev *pdev, const struct pci_device_id *ent)
 	netdev->netdev_ops = &e1000e_netdev_ops;
 	e1000e_set_ethtool_ops(netdev);
 	netdev->watchdog_timeo = 5 * HZ;
-	netif_napi_add(netdev, &adapter->napi, e1000e_poll, 64);
 	strlcpy(netdev->name, pci_name(pdev), sizeof(netdev->name));
 
 	netdev->mem_start = mmio_start;
@@ -7438,6 +7722,11 @@ static int e1000_probe(struct pci_dev *pdev, const struct pci_device_id *ent)
 	if (err)
 		goto err_sw_init;
 
+	for (i = 0; i < adapter->num_queues; i++)
+		netif_napi_add(netdev, &adapter->napi[i], e1000e_poll, 64);
+	netif_set_real_num_tx_queues(netdev, adapter->num_queues);
+	netif_set_real_num_rx_queues(netdev, adapter->num_queues);
+
 	memcpy(&hw->mac.ops, ei->mac_ops, sizeof(hw->mac.ops));
 	memcpy(&hw->nvm.ops, ei->nvm_ops, sizeof(hw->nvm.ops));
 	memcpy(&hw->phy.ops, ei->phy_ops, sizeof(hw->phy.ops));
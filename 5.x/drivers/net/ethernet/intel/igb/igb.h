@@ -31,6 +31,12 @@ struct igb_adapter;
 
 #include "kcompat.h"
 
+#ifdef HAVE_CONFIG_DIMLIB
+#include <linux/dim.h>
+#else
+#include "kcompat_dim.h"
+#endif
+
 #ifdef HAVE_SCTP
 #include <linux/sctp.h>
 #endif
@@ -69,6 +75,10 @@ struct igb_adapter;
 #define IGB_20K_ITR                      196
 #define IGB_70K_ITR                       56
 
+/* Rx moderation levels net DIM chooses between */
+#define IGB_DIM_PROFILES                   5
+#define IGB_DIM_DEFAULT_PROFILE            2 /* IGB_20K_ITR */
+
 /* Interrupt modes, as used by the IntMode paramter */
 #define IGB_INT_MODE_LEGACY                0
 #define IGB_INT_MODE_MSI                   1
@@ -324,6 +334,7 @@ struct igb_rx_queue_stats {
 	u64 drops;
 	u64 csum_err;
 	u64 alloc_failed;
+	u64 dim_level[IGB_DIM_PROFILES]; /* interrupts at each DIM level */
 };
 
 struct igb_rx_packet_stats {
@@ -403,6 +414,9 @@ struct igb_q_vector {
 
 	struct igb_ring_container rx, tx;
 
+	struct dim rx_dim;		/* Rx moderation with IGB_FLAG_DIM */
+	u16 dim_events;			/* interrupts sampled by rx_dim */
+
 	struct napi_struct napi;
 #ifndef IGB_NO_LRO
 	struct igb_lro_list lrolist;   /* LRO list for queue vector*/
@@ -737,6 +751,7 @@ struct igb_vmdq_adapter {
 #define IGB_FLAG_MEDIA_RESET		BIT(14)
 #define IGB_FLAG_VLAN_PROMISC		BIT(15)
 #define IGB_FLAG_MAS_ENABLE		BIT(16)
+#define IGB_FLAG_DIM			BIT(17)
 
 /* Media Auto Sense */
 #define IGB_MAS_ENABLE_0		0X0001
@@ -827,6 +842,7 @@ int igb_close(struct net_device *netdev);
 void igb_up(struct igb_adapter *adapter);
 void igb_down(struct igb_adapter *adapter);
 void igb_reinit_locked(struct igb_adapter *adapter);
+void igb_rx_dim_reset(struct igb_q_vector *q_vector);
 void igb_reset(struct igb_adapter *adapter);
 int igb_reinit_queues(struct igb_adapter *adapter);
 #ifdef ETHTOOL_SRXFHINDIR
@@ -2388,7 +2388,6 @@ static int igb_set_coalesce(struct net_device *netdev,
 	    ec->tx_max_coalesced_frames ||
 	    ec->tx_coalesce_usecs_irq ||
 	    ec->stats_block_coalesce_usecs ||
-	    ec->use_adaptive_rx_coalesce ||
 	    ec->use_adaptive_tx_coalesce ||
 	    ec->pkt_rate_low ||
 	    ec->rx_coalesce_usecs_low ||
@@ -2425,6 +2424,14 @@ static int igb_set_coalesce(struct net_device *netdev,
 	if (ec->tx_max_coalesced_frames_irq)
 		adapter->tx_work_limit = ec->tx_max_coalesced_frames_irq;
 
+	/* net DIM owns the Rx moderation of every vector serving an Rx ring,
+	 * rx-usecs only takes effect again once adaptive-rx is turned off
+	 */
+	if (ec->use_adaptive_rx_coalesce)
+		adapter->flags |= IGB_FLAG_DIM;
+	else
+		adapter->flags &= ~IGB_FLAG_DIM;
+
 	/* If ITR is disabled, disable DMAC */
 	if (ec->rx_coalesce_usecs == 0)
 		adapter->dmac = IGB_DMAC_DISABLE;
@@ -2446,6 +2453,10 @@ static int igb_set_coalesce(struct net_device *netdev,
 	for (i = 0; i < adapter->num_q_vectors; i++) {
 		struct igb_q_vector *q_vector = adapter->q_vector[i];
 		q_vector->tx.work_limit = adapter->tx_work_limit;
+		if (q_vector->rx.ring && (adapter->flags & IGB_FLAG_DIM)) {
+			igb_rx_dim_reset(q_vector);
+			continue;
+		}
 		if (q_vector->rx.ring)
 			q_vector->itr_val = adapter->rx_itr_setting;
 		else
@@ -2469,6 +2480,8 @@ static int igb_get_coalesce(struct net_device *netdev,
 {
 	struct igb_adapter *adapter = netdev_priv(netdev);
 
+	ec->use_adaptive_rx_coalesce = !!(adapter->flags & IGB_FLAG_DIM);
+
 	if (adapter->rx_itr_setting <= 3)
 		ec->rx_coalesce_usecs = adapter->rx_itr_setting;
 	else
@@ -2559,7 +2572,7 @@ static void igb_get_strings(struct net_device *netdev, u32 stringset, u8 *data)
 {
 	struct igb_adapter *adapter = netdev_priv(netdev);
 	u8 *p = data;
-	int i;
+	int i, j;
 
 	switch (stringset) {
 	case ETH_SS_TEST:
@@ -2596,6 +2609,10 @@ static void igb_get_strings(struct net_device *netdev, u32 stringset, u8 *data)
 			p += ETH_GSTRING_LEN;
 			sprintf(p, "rx_queue_%u_alloc_failed", i);
 			p += ETH_GSTRING_LEN;
+			for (j = 0; j < IGB_DIM_PROFILES; j++) {
+				sprintf(p, "rx_queue_%u_dim_level%u", i, j);
+				p += ETH_GSTRING_LEN;
+			}
 		}
 /*		BUG_ON(p - data != IGB_STATS_LEN * ETH_GSTRING_LEN); */
 		break;
@@ -3787,7 +3804,8 @@ static const struct ethtool_ops igb_ethtool_ops = {
 	.set_settings           = igb_set_settings,
 #endif
 #ifdef HAVE_ETHTOOL_COALESCE_PARAMS_SUPPORT
-	.supported_coalesce_params = ETHTOOL_COALESCE_USECS,
+	.supported_coalesce_params = ETHTOOL_COALESCE_USECS |
+				     ETHTOOL_COALESCE_USE_ADAPTIVE_RX,
 #endif
 	.get_drvinfo            = igb_get_drvinfo,
 	.get_regs_len           = igb_get_regs_len,
@@ -125,6 +125,7 @@ static void igb_update_dca(struct igb_q_vector *);
 static void igb_setup_dca(struct igb_adapter *);
 #endif /* IGB_DCA */
 static int igb_poll(struct napi_struct *, int);
+static void igb_rx_dim_work(struct work_struct *);
 static bool igb_clean_tx_irq(struct igb_q_vector *);
 static bool igb_clean_rx_irq(struct igb_q_vector *, int);
 static int igb_ioctl(struct net_device *, struct ifreq *, int cmd);
@@ -753,6 +754,7 @@ static void igb_reset_q_vector(struct igb_adapter *adapter, int v_idx)
 	if (q_vector->rx.ring)
 		adapter->rx_ring[q_vector->rx.ring->queue_index] = NULL;
 
+	cancel_work_sync(&q_vector->rx_dim.work);
 	netif_napi_del(&q_vector->napi);
 
 }
@@ -1158,10 +1160,19 @@ static int igb_alloc_q_vector(struct igb_adapter *adapter,
 	/* initialize pointer to rings */
 	ring = q_vector->ring;
 
+	/* initialize Rx DIM */
+	INIT_WORK(&q_vector->rx_dim.work, igb_rx_dim_work);
+	q_vector->rx_dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
+	q_vector->rx_dim.profile_ix = IGB_DIM_DEFAULT_PROFILE;
+	q_vector->rx_dim.priv = q_vector;
+
 	/* intialize ITR */
 	if (rxr_count) {
 		/* rx or rx/tx vector */
-		if (!adapter->rx_itr_setting || adapter->rx_itr_setting > 3)
+		if (adapter->flags & IGB_FLAG_DIM)
+			igb_rx_dim_reset(q_vector);
+		else if (!adapter->rx_itr_setting ||
+			 adapter->rx_itr_setting > 3)
 			q_vector->itr_val = adapter->rx_itr_setting;
 	} else {
 		/* tx only vector */
@@ -1866,8 +1877,10 @@ void igb_down(struct igb_adapter *adapter)
 			 "The number of queue vectors (%d) is higher than max allowed (%d)\n",
 			 adapter->num_q_vectors, MAX_Q_VECTORS);
 	}
-	for (i = 0; i < num_q_vectors; i++)
+	for (i = 0; i < num_q_vectors; i++) {
 		napi_disable(&(adapter->q_vector[i]->napi));
+		cancel_work_sync(&adapter->q_vector[i]->rx_dim.work);
+	}
 
 	igb_irq_disable(adapter);
 
@@ -7354,13 +7367,84 @@ static irqreturn_t igb_intr(int irq, void *data)
 	return IRQ_HANDLED;
 }
 
+/* Rx moderation levels for net DIM, in EITR units (usecs << 2).  The ends
+ * match the lowest_latency and bulk_latency settings of igb_update_itr(),
+ * so DIM only moves within the range the legacy heuristic already used.
+ */
+static const u16 igb_rx_dim_itr[IGB_DIM_PROFILES] = {
+	IGB_70K_ITR,
+	112,		/* ~35000 ints/sec */
+	IGB_20K_ITR,
+	500,		/* 8000 ints/sec */
+	IGB_4K_ITR,
+};
+
+static void igb_rx_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct igb_q_vector *q_vector = dim->priv;
+	u16 new_itr = igb_rx_dim_itr[dim->profile_ix];
+
+	/* for non-gigabit speeds, just fix the interrupt rate at 4000 */
+	switch (q_vector->adapter->link_speed) {
+	case SPEED_10:
+	case SPEED_100:
+		new_itr = IGB_4K_ITR;
+		break;
+	default:
+		break;
+	}
+
+	if (new_itr != q_vector->itr_val) {
+		q_vector->itr_val = new_itr;
+		q_vector->set_itr = 1;
+	}
+
+	dim->state = DIM_START_MEASURE;
+}
+
+/**
+ * igb_rx_dim_reset - Restart net DIM on a vector from its default level
+ * @q_vector: vector serving an Rx ring
+ **/
+void igb_rx_dim_reset(struct igb_q_vector *q_vector)
+{
+	q_vector->rx_dim.profile_ix = IGB_DIM_DEFAULT_PROFILE;
+	q_vector->rx_dim.state = DIM_START_MEASURE;
+	q_vector->itr_val = igb_rx_dim_itr[IGB_DIM_DEFAULT_PROFILE];
+	q_vector->set_itr = 1;
+}
+
+/* Feed the Rx ring counters of a vector to net DIM; called once per NAPI
+ * completion, which is what DIM counts as an event.
+ */
+static void igb_rx_dim_sample(struct igb_q_vector *q_vector)
+{
+	struct igb_ring *ring = q_vector->rx.ring;
+	struct dim_sample sample = {};
+
+	ring->rx_stats.dim_level[q_vector->rx_dim.profile_ix]++;
+
+	dim_update_sample(q_vector->dim_events++, ring->rx_stats.packets,
+			  ring->rx_stats.bytes, &sample);
+	net_dim(&q_vector->rx_dim, sample);
+
+	/* the legacy heuristic is idle, don't let its counters grow stale */
+	q_vector->rx.total_bytes = 0;
+	q_vector->rx.total_packets = 0;
+	q_vector->tx.total_bytes = 0;
+	q_vector->tx.total_packets = 0;
+}
+
 static void igb_ring_irq_enable(struct igb_q_vector *q_vector)
 {
 	struct igb_adapter *adapter = q_vector->adapter;
 	struct e1000_hw *hw = &adapter->hw;
 
-	if ((q_vector->rx.ring && (adapter->rx_itr_setting & 3)) ||
-	    (!q_vector->rx.ring && (adapter->tx_itr_setting & 3))) {
+	if ((adapter->flags & IGB_FLAG_DIM) && q_vector->rx.ring) {
+		igb_rx_dim_sample(q_vector);
+	} else if ((q_vector->rx.ring && (adapter->rx_itr_setting & 3)) ||
+		   (!q_vector->rx.ring && (adapter->tx_itr_setting & 3))) {
 		if ((adapter->num_q_vectors == 1) && !adapter->vf_data)
 			igb_set_itr(q_vector);
 		else
@@ -739,7 +739,7 @@ static void igc_ethtool_get_strings(struct net_device *netdev, u32 stringset,
 {
 	struct igc_adapter *adapter = netdev_priv(netdev);
 	u8 *p = data;
-	int i;
+	int i, j;
 
 	switch (stringset) {
 	case ETH_SS_TEST:
@@ -776,6 +776,10 @@ static void igc_ethtool_get_strings(struct net_device *netdev, u32 stringset,
 			p += ETH_GSTRING_LEN;
 			sprintf(p, "rx_queue_%u_alloc_failed", i);
 			p += ETH_GSTRING_LEN;
+			for (j = 0; j < IGC_DIM_PROFILES; j++) {
+				sprintf(p, "rx_queue_%u_dim_level%u", i, j);
+				p += ETH_GSTRING_LEN;
+			}
 		}
 		/* BUG_ON(p - data != IGC_STATS_LEN * ETH_GSTRING_LEN); */
 		break;
@@ -807,7 +811,7 @@ static void igc_ethtool_get_stats(struct net_device *netdev,
 	struct rtnl_link_stats64 *net_stats = &adapter->stats64;
 	unsigned int start;
 	struct igc_ring *ring;
-	int i, j;
+	int i, j, k;
 	char *p;
 
 	spin_lock(&adapter->stats64_lock);
@@ -850,6 +854,8 @@ static void igc_ethtool_get_stats(struct net_device *netdev,
 			data[i + 2] = ring->rx_stats.drops;
 			data[i + 3] = ring->rx_stats.csum_err;
 			data[i + 4] = ring->rx_stats.alloc_failed;
+			for (k = 0; k < IGC_DIM_PROFILES; k++)
+				data[i + 5 + k] = ring->rx_stats.dim_level[k];
 		} while (u64_stats_fetch_retry_irq(&ring->rx_syncp, start));
 		i += IGC_RX_QUEUE_STATS_LEN;
 	}
@@ -861,6 +867,8 @@ static int igc_ethtool_get_coalesce(struct net_device *netdev,
 {
 	struct igc_adapter *adapter = netdev_priv(netdev);
 
+	ec->use_adaptive_rx_coalesce = !!(adapter->flags & IGC_FLAG_DIM);
+
 	if (adapter->rx_itr_setting <= 3)
 		ec->rx_coalesce_usecs = adapter->rx_itr_setting;
 	else
@@ -897,6 +905,18 @@ static int igc_ethtool_set_coalesce(struct net_device *netdev,
 	if ((adapter->flags & IGC_FLAG_QUEUE_PAIRS) && ec->tx_coalesce_usecs)
 		return -EINVAL;
 
+	/* adaptive-rx is net DIM, which the kernel may be built without */
+	if (ec->use_adaptive_rx_coalesce && !IS_REACHABLE(CONFIG_DIMLIB))
+		return -EOPNOTSUPP;
+
+	/* net DIM owns the Rx moderation of every vector serving an Rx ring,
+	 * rx-usecs only takes effect again once adaptive-rx is turned off
+	 */
+	if (ec->use_adaptive_rx_coalesce)
+		adapter->flags |= IGC_FLAG_DIM;
+	else
+		adapter->flags &= ~IGC_FLAG_DIM;
+
 	/* If ITR is disabled, disable DMAC */
 	if (ec->rx_coalesce_usecs == 0) {
 		if (adapter->flags & IGC_FLAG_DMAC)
@@ -921,6 +941,10 @@ static int igc_ethtool_set_coalesce(struct net_device *netdev,
 		struct igc_q_vector *q_vector = adapter->q_vector[i];
 
 		q_vector->tx.work_limit = adapter->tx_work_limit;
+		if (q_vector->rx.ring && (adapter->flags & IGC_FLAG_DIM)) {
+			igc_rx_dim_reset(q_vector);
+			continue;
+		}
 		if (q_vector->rx.ring)
 			q_vector->itr_val = adapter->rx_itr_setting;
 		else
@@ -1899,7 +1923,8 @@ static void igc_ethtool_diag_test(struct net_device *netdev,
 }
 
 static const struct ethtool_ops igc_ethtool_ops = {
-	.supported_coalesce_params = ETHTOOL_COALESCE_USECS,
+	.supported_coalesce_params = ETHTOOL_COALESCE_USECS |
+				     ETHTOOL_COALESCE_USE_ADAPTIVE_RX,
 	.get_drvinfo		= igc_ethtool_get_drvinfo,
 	.get_regs_len		= igc_ethtool_get_regs_len,
 	.get_regs		= igc_ethtool_get_regs,
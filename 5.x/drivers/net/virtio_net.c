@@ -17,8 +17,11 @@
 #include <linux/slab.h>
 #include <linux/cpu.h>
 #include <linux/average.h>
+#include <linux/dim.h>
 #include <linux/filter.h>
 #include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/netpoll.h>
 #include <net/route.h>
 #include <net/xdp.h>
 #include <net/net_failover.h>
@@ -55,6 +58,43 @@ DECLARE_EWMA(pkt_len, 0, 64)
 
 #define VIRTNET_DRIVER_VERSION "1.0.0"
 
+/* Notification coalescing, from virtio 1.2; not yet in our uapi headers. */
+#ifndef VIRTIO_NET_F_NOTF_COAL
+#define VIRTIO_NET_F_VQ_NOTF_COAL	52	/* Per-virtqueue coalescing */
+#define VIRTIO_NET_F_NOTF_COAL		53	/* Device-wide coalescing */
+
+#define VIRTIO_NET_CTRL_NOTF_COAL		6
+#define VIRTIO_NET_CTRL_NOTF_COAL_TX_SET	0
+#define VIRTIO_NET_CTRL_NOTF_COAL_RX_SET	1
+#define VIRTIO_NET_CTRL_NOTF_COAL_VQ_SET	2
+#define VIRTIO_NET_CTRL_NOTF_COAL_VQ_GET	3
+
+struct virtio_net_ctrl_coal_tx {
+	/* Maximum number of packets to send before a TX notification */
+	__le32 tx_max_packets;
+	/* Maximum number of usecs to delay a TX notification */
+	__le32 tx_usecs;
+};
+
+struct virtio_net_ctrl_coal_rx {
+	/* Maximum number of packets to receive before a RX notification */
+	__le32 rx_max_packets;
+	/* Maximum number of usecs to delay a RX notification */
+	__le32 rx_usecs;
+};
+
+struct virtio_net_ctrl_coal {
+	__le32 max_packets;
+	__le32 max_usecs;
+};
+
+struct virtio_net_ctrl_coal_vq {
+	__le16 vqn;
+	__le16 reserved;
+	struct virtio_net_ctrl_coal coal;
+};
+#endif
+
 static const unsigned long guest_offloads[] = {
 	VIRTIO_NET_F_GUEST_TSO4,
 	VIRTIO_NET_F_GUEST_TSO6,
@@ -92,6 +132,8 @@ struct virtnet_rq_stats {
 	u64 xdp_redirects;
 	u64 xdp_drops;
 	u64 kicks;
+	u64 recycle_hits;
+	u64 recycle_misses;
 };
 
 #define VIRTNET_SQ_STAT(m)	offsetof(struct virtnet_sq_stats, m)
@@ -114,11 +156,24 @@ static const struct virtnet_stat_desc virtnet_rq_stats_desc[] = {
 	{ "xdp_redirects",	VIRTNET_RQ_STAT(xdp_redirects) },
 	{ "xdp_drops",		VIRTNET_RQ_STAT(xdp_drops) },
 	{ "kicks",		VIRTNET_RQ_STAT(kicks) },
+	{ "recycle_hits",	VIRTNET_RQ_STAT(recycle_hits) },
+	{ "recycle_misses",	VIRTNET_RQ_STAT(recycle_misses) },
 };
 
 #define VIRTNET_SQ_STATS_LEN	ARRAY_SIZE(virtnet_sq_stats_desc)
 #define VIRTNET_RQ_STATS_LEN	ARRAY_SIZE(virtnet_rq_stats_desc)
 
+static const char virtnet_priv_flags[][ETH_GSTRING_LEN] = {
+	"napi-threaded",
+};
+
+#define VIRTNET_PRIV_FLAG_NAPI_THREADED	BIT(0)
+
+struct virtnet_interrupt_coalesce {
+	u32 max_packets;
+	u32 max_usecs;
+};
+
 /* Internal representation of a send virtqueue */
 struct send_queue {
 	/* Virtqueue associated with this send _queue */
@@ -132,9 +187,29 @@ struct send_queue {
 
 	struct virtnet_sq_stats stats;
 
+	/* Notification coalescing currently programmed for this queue */
+	struct virtnet_interrupt_coalesce intr_coal;
+
 	struct napi_struct napi;
 };
 
+#define VIRTNET_RX_POOL_SIZE	256
+
+/* Receive pages lent to the device or the stack, oldest first.  Each
+ * entry holds one page reference; once that is the last one, every
+ * buffer carved from the page has been freed and the page can be handed
+ * out again without going through the page allocator.
+ */
+struct virtnet_rx_pool {
+	struct page *ring[VIRTNET_RX_POOL_SIZE];
+	u16 head;
+	u16 count;
+
+	/* Folded into rq->stats by try_fill_recv() */
+	u32 hits;
+	u32 misses;
+};
+
 /* Internal representation of a receive virtqueue */
 struct receive_queue {
 	/* Virtqueue associated with this receive_queue */
@@ -146,6 +221,14 @@ struct receive_queue {
 
 	struct virtnet_rq_stats stats;
 
+	/* Notification coalescing currently programmed for this queue */
+	struct virtnet_interrupt_coalesce intr_coal;
+
+	/* Adaptive moderation: interrupts seen, and the DIM state machine */
+	u16 calls;
+	bool dim_enabled;
+	struct dim dim;
+
 	/* Chain pages by the private ptr. */
 	struct page *pages;
 
@@ -155,6 +238,9 @@ struct receive_queue {
 	/* Page frag for packet buffer allocation. */
 	struct page_frag alloc_frag;
 
+	/* Recycled pages for alloc_frag and big packets */
+	struct virtnet_rx_pool pool;
+
 	/* RX: fragments + linear part + virtio header */
 	struct scatterlist sg[MAX_SKB_FRAGS + 2];
 
@@ -165,6 +251,28 @@ struct receive_queue {
 	char name[40];
 
 	struct xdp_rxq_info xdp_rxq;
+
+	/* Threaded NAPI poller, NULL when polled from softirq */
+	struct task_struct *napi_thread;
+	unsigned long napi_thread_kick;
+};
+
+/* Device-side limits are larger, but this covers every device we know of. */
+#define VIRTIO_NET_RSS_MAX_KEY_SIZE	40
+#define VIRTIO_NET_RSS_MAX_TABLE_LEN	128
+
+/* Same layout as struct virtio_net_rss_config, with a fixed-size table.
+ * With only VIRTIO_NET_F_HASH_REPORT it is sent as a one-entry table,
+ * which then lines up with struct virtio_net_hash_config.
+ */
+struct virtio_net_ctrl_rss {
+	__le32 hash_types;
+	__le16 indirection_table_mask;
+	__le16 unclassified_queue;
+	__le16 indirection_table[VIRTIO_NET_RSS_MAX_TABLE_LEN];
+	__le16 max_tx_vq;
+	u8 hash_key_length;
+	u8 key[VIRTIO_NET_RSS_MAX_KEY_SIZE];
 };
 
 /* Control VQ buffers: protected by the rtnl lock */
@@ -176,6 +284,10 @@ struct control_buf {
 	u8 allmulti;
 	__virtio16 vid;
 	__virtio64 offloads;
+	struct virtio_net_ctrl_coal_tx coal_tx;
+	struct virtio_net_ctrl_coal_rx coal_rx;
+	struct virtio_net_ctrl_coal_vq coal_vq;
+	struct virtio_net_ctrl_rss rss;
 };
 
 struct virtnet_info {
@@ -207,6 +319,14 @@ struct virtnet_info {
 	/* Host can handle any s/g split between our header and packet data */
 	bool any_header_sg;
 
+	/* Host steers rx by RSS and/or reports the packet hash */
+	bool has_rss;
+	bool has_rss_hash_report;
+	u8 rss_key_size;
+	u16 rss_indir_table_size;
+	u32 rss_hash_types_supported;
+	u32 rss_hash_types_saved;
+
 	/* Packet virtio header size */
 	u8 hdr_len;
 
@@ -232,18 +352,26 @@ struct virtnet_info {
 	unsigned long guest_offloads;
 	unsigned long guest_offloads_capable;
 
+	/* Device-wide notification coalescing (VIRTIO_NET_F_NOTF_COAL) */
+	struct virtnet_interrupt_coalesce intr_coal_tx;
+	struct virtnet_interrupt_coalesce intr_coal_rx;
+	bool rx_dim_enabled;
+
+	/* Poll receive queues from per-queue kthreads */
+	bool napi_threaded;
+
 	/* failover when STANDBY feature enabled */
 	struct failover *failover;
 };
 
 struct padded_vnet_hdr {
-	struct virtio_net_hdr_mrg_rxbuf hdr;
+	struct virtio_net_hdr_v1_hash hdr;
 	/*
 	 * hdr is in a separate sg buffer, and data sg buffer shares same page
 	 * with this header sg. This padding makes next sg 16 byte aligned
 	 * after the header.
 	 */
-	char padding[4];
+	char padding[12];
 };
 
 static bool is_xdp_frame(void *ptr)
@@ -303,6 +431,103 @@ static void give_pages(struct receive_queue *rq, struct page *page)
 	rq->pages = page;
 }
 
+/* Returns the oldest pooled page if nobody else holds it any more. */
+static struct page *virtnet_rx_pool_get(struct receive_queue *rq)
+{
+	struct virtnet_rx_pool *pool = &rq->pool;
+	struct page *page;
+
+	if (!pool->count)
+		return NULL;
+
+	page = pool->ring[pool->head];
+	pool->head = (pool->head + 1) % VIRTNET_RX_POOL_SIZE;
+	if (page_ref_count(page) == 1) {
+		pool->count--;
+		return page;
+	}
+
+	/* Still in flight: requeue it so it doesn't hold up the rest. */
+	pool->ring[(pool->head + pool->count - 1) % VIRTNET_RX_POOL_SIZE] = page;
+	return NULL;
+}
+
+/* Takes over one reference to @page. */
+static void virtnet_rx_pool_put(struct receive_queue *rq, struct page *page)
+{
+	struct virtnet_rx_pool *pool = &rq->pool;
+
+	if (unlikely(page_is_pfmemalloc(page) ||
+		     page_to_nid(page) != numa_mem_id())) {
+		put_page(page);
+		return;
+	}
+
+	/* Evict the oldest entry: if it is still busy it is the least
+	 * likely to come back soon.
+	 */
+	if (pool->count == VIRTNET_RX_POOL_SIZE) {
+		put_page(pool->ring[pool->head]);
+		pool->head = (pool->head + 1) % VIRTNET_RX_POOL_SIZE;
+		pool->count--;
+	}
+
+	pool->ring[(pool->head + pool->count) % VIRTNET_RX_POOL_SIZE] = page;
+	pool->count++;
+}
+
+static void virtnet_rx_pool_drain(struct receive_queue *rq)
+{
+	struct virtnet_rx_pool *pool = &rq->pool;
+
+	while (pool->count) {
+		put_page(pool->ring[pool->head]);
+		pool->head = (pool->head + 1) % VIRTNET_RX_POOL_SIZE;
+		pool->count--;
+	}
+}
+
+/* Like skb_page_frag_refill(), but exhausted pages are parked in the
+ * pool rather than released, and refills are served from it first.
+ */
+static bool virtnet_rx_frag_refill(struct receive_queue *rq, unsigned int sz,
+				   gfp_t gfp)
+{
+	struct page_frag *pfrag = &rq->alloc_frag;
+	struct page *page;
+
+	if (pfrag->page) {
+		if (page_ref_count(pfrag->page) == 1) {
+			pfrag->offset = 0;
+			return true;
+		}
+		if (pfrag->offset + sz <= pfrag->size)
+			return true;
+		virtnet_rx_pool_put(rq, pfrag->page);
+		pfrag->page = NULL;
+	}
+
+	page = virtnet_rx_pool_get(rq);
+	if (page) {
+		rq->pool.hits++;
+	} else {
+		rq->pool.misses++;
+		/* Avoid direct reclaim but allow kswapd to wake */
+		page = alloc_pages((gfp & ~__GFP_DIRECT_RECLAIM) | __GFP_COMP |
+				   __GFP_NOWARN | __GFP_NORETRY,
+				   SKB_FRAG_PAGE_ORDER);
+		if (unlikely(!page))
+			page = alloc_page(gfp);
+		if (unlikely(!page))
+			return false;
+	}
+
+	pfrag->page = page;
+	pfrag->offset = 0;
+	pfrag->size = page_size(page);
+	return true;
+}
+
 static struct page *get_a_page(struct receive_queue *rq, gfp_t gfp_mask)
 {
 	struct page *p = rq->pages;
@@ -311,8 +536,22 @@ static struct page *get_a_page(struct receive_queue *rq, gfp_t gfp_mask)
 		rq->pages = (struct page *)p->private;
 		/* clear private here, it is used to chain pages */
 		p->private = 0;
-	} else
+		return p;
+	}
+
+	p = virtnet_rx_pool_get(rq);
+	if (p) {
+		rq->pool.hits++;
+	} else {
+		rq->pool.misses++;
 		p = alloc_page(gfp_mask);
+		if (!p)
+			return NULL;
+	}
+
+	/* The pool keeps a reference until the stack frees the skb. */
+	get_page(p);
+	virtnet_rx_pool_put(rq, p);
 	return p;
 }
 
@@ -394,7 +633,7 @@ static struct sk_buff *page_to_skb(struct virtnet_info *vi,
 
 	hdr_len = vi->hdr_len;
 	if (vi->mergeable_rx_bufs)
-		hdr_padded_len = sizeof(*hdr);
+		hdr_padded_len = hdr_len;
 	else
 		hdr_padded_len = sizeof(struct padded_vnet_hdr);
 
@@ -1043,6 +1282,32 @@ xdp_xmit:
 	return NULL;
 }
 
+static void virtio_skb_set_hash(const struct virtio_net_hdr_v1_hash *hdr_hash,
+				struct sk_buff *skb)
+{
+	enum pkt_hash_types rss_hash_type;
+
+	switch (__le16_to_cpu(hdr_hash->hash_report)) {
+	case VIRTIO_NET_HASH_REPORT_TCPv4:
+	case VIRTIO_NET_HASH_REPORT_UDPv4:
+	case VIRTIO_NET_HASH_REPORT_TCPv6:
+	case VIRTIO_NET_HASH_REPORT_UDPv6:
+	case VIRTIO_NET_HASH_REPORT_TCPv6_EX:
+	case VIRTIO_NET_HASH_REPORT_UDPv6_EX:
+		rss_hash_type = PKT_HASH_TYPE_L4;
+		break;
+	case VIRTIO_NET_HASH_REPORT_IPv4:
+	case VIRTIO_NET_HASH_REPORT_IPv6:
+	case VIRTIO_NET_HASH_REPORT_IPv6_EX:
+		rss_hash_type = PKT_HASH_TYPE_L3;
+		break;
+	case VIRTIO_NET_HASH_REPORT_NONE:
+	default:
+		return;
+	}
+	skb_set_hash(skb, __le32_to_cpu(hdr_hash->hash_value), rss_hash_type);
+}
+
 static void receive_buf(struct virtnet_info *vi, struct receive_queue *rq,
 			void *buf, unsigned int len, void **ctx,
 			unsigned int *xdp_xmit,
@@ -1077,6 +1342,9 @@ static void receive_buf(struct virtnet_info *vi, struct receive_queue *rq,
 		return;
 
 	hdr = skb_vnet_hdr(skb);
+	if (vi->has_rss_hash_report && (dev->features & NETIF_F_RXHASH))
+		virtio_skb_set_hash((const struct virtio_net_hdr_v1_hash *)hdr,
+				    skb);
 
 	if (hdr->hdr.flags & VIRTIO_NET_HDR_F_DATA_VALID)
 		skb->ip_summed = CHECKSUM_UNNECESSARY;
@@ -1119,7 +1387,7 @@ static int add_recvbuf_small(struct virtnet_info *vi, struct receive_queue *rq,
 
 	len = SKB_DATA_ALIGN(len) +
 	      SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
-	if (unlikely(!skb_page_frag_refill(len, alloc_frag, gfp)))
+	if (unlikely(!virtnet_rx_frag_refill(rq, len, gfp)))
 		return -ENOMEM;
 
 	buf = (char *)page_address(alloc_frag->page) + alloc_frag->offset;
@@ -1186,7 +1454,8 @@ static unsigned int get_mergeable_buf_len(struct receive_queue *rq,
 					  struct ewma_pkt_len *avg_pkt_len,
 					  unsigned int room)
 {
-	const size_t hdr_len = sizeof(struct virtio_net_hdr_mrg_rxbuf);
+	struct virtnet_info *vi = rq->vq->vdev->priv;
+	const size_t hdr_len = vi->hdr_len;
 	unsigned int len;
 
 	if (room)
@@ -1215,7 +1484,7 @@ static int add_recvbuf_mergeable(struct virtnet_info *vi,
 	 * disabled GSO for XDP, it won't be a big issue.
 	 */
 	len = get_mergeable_buf_len(rq, &rq->mrg_avg_pkt_len, room);
-	if (unlikely(!skb_page_frag_refill(len + room, alloc_frag, gfp)))
+	if (unlikely(!virtnet_rx_frag_refill(rq, len + room, gfp)))
 		return -ENOMEM;
 
 	buf = (char *)page_address(alloc_frag->page) + alloc_frag->offset;
@@ -1251,7 +1520,8 @@ static int add_recvbuf_mergeable(struct virtnet_info *vi,
 static bool try_fill_recv(struct virtnet_info *vi, struct receive_queue *rq,
 			  gfp_t gfp)
 {
-	int err;
+	unsigned long flags;
+	int err, kicks = 0;
 	bool oom;
 
 	do {
@@ -1266,23 +1536,134 @@ static bool try_fill_recv(struct virtnet_info *vi, struct receive_queue *rq,
 		if (err)
 			break;
 	} while (rq->vq->num_free);
-	if (virtqueue_kick_prepare(rq->vq) && virtqueue_notify(rq->vq)) {
-		unsigned long flags;
+	if (virtqueue_kick_prepare(rq->vq) && virtqueue_notify(rq->vq))
+		kicks = 1;
 
-		flags = u64_stats_update_begin_irqsave(&rq->stats.syncp);
-		rq->stats.kicks++;
-		u64_stats_update_end_irqrestore(&rq->stats.syncp, flags);
-	}
+	flags = u64_stats_update_begin_irqsave(&rq->stats.syncp);
+	rq->stats.kicks += kicks;
+	rq->stats.recycle_hits += rq->pool.hits;
+	rq->stats.recycle_misses += rq->pool.misses;
+	u64_stats_update_end_irqrestore(&rq->stats.syncp, flags);
+	rq->pool.hits = 0;
+	rq->pool.misses = 0;
 
 	return !oom;
 }
 
+/* Threaded NAPI: with the "napi-threaded" private flag set, each receive
+ * queue is polled from its own kthread (napi/<dev>-<queue>) instead of the
+ * NET_RX softirq, so the poll loop can be pinned and prioritized like any
+ * other task. The kernel only grew this natively in 5.12.
+ *
+ * Interrupts still claim the NAPI instance with napi_schedule_prep(), and
+ * the thread owns it until virtnet_poll() completes it. The rare
+ * reschedules from virtqueue_napi_complete() and virtnet_napi_enable()
+ * still go through the softirq; that is harmless, only less isolated.
+ */
+static int virtnet_napi_thread(void *data)
+{
+	struct receive_queue *rq = data;
+	struct napi_struct *napi = &rq->napi;
+
+	for (;;) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (kthread_should_stop())
+			break;
+		if (!test_and_clear_bit(0, &rq->napi_thread_kick)) {
+			schedule();
+			continue;
+		}
+		__set_current_state(TASK_RUNNING);
+
+		for (;;) {
+			void *have;
+			bool done;
+
+			local_bh_disable();
+			have = netpoll_poll_lock(napi);
+			done = napi->poll(napi, napi->weight) < napi->weight;
+			if (!done && unlikely(napi_disable_pending(napi))) {
+				napi_complete(napi);
+				done = true;
+			} else if (!done && napi->gro_bitmask) {
+				napi_gro_flush(napi, HZ >= 1000);
+			}
+			netpoll_poll_unlock(have);
+			local_bh_enable();
+
+			if (done)
+				break;
+			cond_resched();
+		}
+	}
+	__set_current_state(TASK_RUNNING);
+
+	return 0;
+}
+
+static void virtnet_rq_napi_schedule(struct receive_queue *rq)
+{
+	struct task_struct *thread = READ_ONCE(rq->napi_thread);
+
+	if (!thread) {
+		virtqueue_napi_schedule(&rq->napi, rq->vq);
+		return;
+	}
+
+	if (napi_schedule_prep(&rq->napi)) {
+		virtqueue_disable_cb(rq->vq);
+		set_bit(0, &rq->napi_thread_kick);
+		wake_up_process(thread);
+	}
+}
+
+/* A queue whose thread fails to start keeps using the softirq. */
+static void virtnet_napi_threads_start(struct virtnet_info *vi)
+{
+	int i;
+
+	if (!vi->napi_threaded)
+		return;
+
+	for (i = 0; i < vi->max_queue_pairs; i++) {
+		struct receive_queue *rq = &vi->rq[i];
+		struct task_struct *thread;
+
+		thread = kthread_run(virtnet_napi_thread, rq, "napi/%s-%d",
+				     vi->dev->name, i);
+		if (IS_ERR(thread)) {
+			netdev_warn(vi->dev,
+				    "failed to start NAPI thread for rx queue %d\n",
+				    i);
+			continue;
+		}
+		WRITE_ONCE(rq->napi_thread, thread);
+	}
+}
+
+/* NAPI must be disabled already, so nothing can kick the threads. */
+static void virtnet_napi_threads_stop(struct virtnet_info *vi)
+{
+	int i;
+
+	for (i = 0; i < vi->max_queue_pairs; i++) {
+		struct receive_queue *rq = &vi->rq[i];
+
+		if (!rq->napi_thread)
+			continue;
+		kthread_stop(rq->napi_thread);
+		WRITE_ONCE(rq->napi_thread, NULL);
+		clear_bit(0, &rq->napi_thread_kick);
+	}
+}
+
 static void skb_recv_done(struct virtqueue *rvq)
 {
 	struct virtnet_info *vi = rvq->vdev->priv;
 	struct receive_queue *rq = &vi->rq[vq2rxq(rvq)];
 
-	virtqueue_napi_schedule(&rq->napi, rvq);
+	rq->calls++;
+	virtnet_rq_napi_schedule(rq);
 }
 
 static void virtnet_napi_enable(struct virtqueue *vq, struct napi_struct *napi)
@@ -1452,6 +1833,15 @@ static void virtnet_poll_cleantx(struct receive_queue *rq)
 		netif_tx_wake_queue(txq);
 }
 
+static void virtnet_rx_dim_update(struct receive_queue *rq)
+{
+	struct dim_sample cur_sample = {};
+
+	dim_update_sample(rq->calls, rq->stats.packets, rq->stats.bytes,
+			  &cur_sample);
+	net_dim(&rq->dim, cur_sample);
+}
+
 static int virtnet_poll(struct napi_struct *napi, int budget)
 {
 	struct receive_queue *rq =
@@ -1466,8 +1856,11 @@ static int virtnet_poll(struct napi_struct *napi, int budget)
 	received = virtnet_receive(rq, budget, &xdp_xmit);
 
 	/* Out of packets? */
-	if (received < budget)
+	if (received < budget) {
 		virtqueue_napi_complete(napi, rq->vq, received);
+		if (rq->dim_enabled)
+			virtnet_rx_dim_update(rq);
+	}
 
 	if (xdp_xmit & VIRTIO_XDP_REDIR)
 		xdp_do_flush();
@@ -1510,6 +1903,8 @@ static int virtnet_open(struct net_device *dev)
 		virtnet_napi_tx_enable(vi, vi->sq[i].vq, &vi->sq[i].napi);
 	}
 
+	virtnet_napi_threads_start(vi);
+
 	return 0;
 }
 
@@ -1818,19 +2213,93 @@ static void virtnet_ack_link_announce(struct virtnet_info *vi)
 	rtnl_unlock();
 }
 
+static bool virtnet_commit_rss_command(struct virtnet_info *vi)
+{
+	struct virtio_net_ctrl_rss *rss = &vi->ctrl->rss;
+	struct scatterlist sgs[4];
+
+	/* The table and key are sent at their negotiated sizes. */
+	sg_init_table(sgs, 4);
+	sg_set_buf(&sgs[0], rss,
+		   offsetof(struct virtio_net_ctrl_rss, indirection_table));
+	sg_set_buf(&sgs[1], rss->indirection_table,
+		   sizeof(rss->indirection_table[0]) *
+		   vi->rss_indir_table_size);
+	sg_set_buf(&sgs[2], &rss->max_tx_vq,
+		   offsetof(struct virtio_net_ctrl_rss, key) -
+		   offsetof(struct virtio_net_ctrl_rss, max_tx_vq));
+	sg_set_buf(&sgs[3], rss->key, vi->rss_key_size);
+
+	if (!virtnet_send_command(vi, VIRTIO_NET_CTRL_MQ,
+				  vi->has_rss ? VIRTIO_NET_CTRL_MQ_RSS_CONFIG
+					      : VIRTIO_NET_CTRL_MQ_HASH_CONFIG,
+				  sgs)) {
+		dev_warn(&vi->dev->dev, "Fail to set RSS configuration\n");
+		return false;
+	}
+
+	return true;
+}
+
+static void virtnet_rss_fill_indir(struct virtnet_info *vi, u16 queue_pairs)
+{
+	u16 i;
+
+	for (i = 0; i < vi->rss_indir_table_size; i++)
+		vi->ctrl->rss.indirection_table[i] =
+			cpu_to_le16(ethtool_rxfh_indir_default(i, queue_pairs));
+}
+
+static void virtnet_init_default_rss(struct virtnet_info *vi)
+{
+	struct virtio_net_ctrl_rss *rss = &vi->ctrl->rss;
+
+	rss->hash_types = cpu_to_le32(vi->rss_hash_types_supported);
+	vi->rss_hash_types_saved = vi->rss_hash_types_supported;
+	rss->indirection_table_mask =
+		cpu_to_le16(vi->rss_indir_table_size - 1);
+	rss->unclassified_queue = 0;
+	virtnet_rss_fill_indir(vi, vi->curr_queue_pairs);
+	rss->max_tx_vq = cpu_to_le16(vi->curr_queue_pairs);
+	rss->hash_key_length = vi->rss_key_size;
+	netdev_rss_key_fill(rss->key, vi->rss_key_size);
+}
+
 static int _virtnet_set_queues(struct virtnet_info *vi, u16 queue_pairs)
 {
 	struct scatterlist sg;
 	struct net_device *dev = vi->dev;
+	bool ok;
 
-	if (!vi->has_cvq || !virtio_has_feature(vi->vdev, VIRTIO_NET_F_MQ))
+	if (!vi->has_cvq || (!vi->has_rss && !vi->has_rss_hash_report &&
+			     !virtio_has_feature(vi->vdev, VIRTIO_NET_F_MQ)))
 		return 0;
 
-	vi->ctrl->mq.virtqueue_pairs = cpu_to_virtio16(vi->vdev, queue_pairs);
-	sg_init_one(&sg, &vi->ctrl->mq, sizeof(vi->ctrl->mq));
+	if (vi->has_rss) {
+		/* The RSS configuration carries the queue count itself;
+		 * keep spreading over all queues unless the user pinned
+		 * the table with ethtool -X.
+		 */
+		if (!netif_is_rxfh_configured(dev))
+			virtnet_rss_fill_indir(vi, queue_pairs);
+		vi->ctrl->rss.max_tx_vq = cpu_to_le16(queue_pairs);
+		ok = virtnet_commit_rss_command(vi);
+	} else {
+		ok = true;
+		if (virtio_has_feature(vi->vdev, VIRTIO_NET_F_MQ)) {
+			vi->ctrl->mq.virtqueue_pairs =
+				cpu_to_virtio16(vi->vdev, queue_pairs);
+			sg_init_one(&sg, &vi->ctrl->mq, sizeof(vi->ctrl->mq));
+			ok = virtnet_send_command(vi, VIRTIO_NET_CTRL_MQ,
+						  VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET,
+						  &sg);
+		}
+		/* Hash reporting without RSS is a separate command */
+		if (ok && vi->has_rss_hash_report)
+			ok = virtnet_commit_rss_command(vi);
+	}
 
-	if (!virtnet_send_command(vi, VIRTIO_NET_CTRL_MQ,
-				  VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET, &sg)) {
+	if (!ok) {
 		dev_warn(&dev->dev, "Fail to set num of queue pairs to %d\n",
 			 queue_pairs);
 		return -EINVAL;
@@ -1866,8 +2335,11 @@ static int virtnet_close(struct net_device *dev)
 		xdp_rxq_info_unreg(&vi->rq[i].xdp_rxq);
 		napi_disable(&vi->rq[i].napi);
 		virtnet_napi_tx_disable(&vi->sq[i].napi);
+		cancel_work_sync(&vi->rq[i].dim.work);
 	}
 
+	virtnet_napi_threads_stop(vi);
+
 	return 0;
 }
 
@@ -2160,6 +2632,9 @@ static void virtnet_get_strings(struct net_device *dev, u32 stringset, u8 *data)
 			}
 		}
 		break;
+	case ETH_SS_PRIV_FLAGS:
+		memcpy(p, virtnet_priv_flags, sizeof(virtnet_priv_flags));
+		break;
 	}
 }
 
@@ -2171,6 +2646,8 @@ static int virtnet_get_sset_count(struct net_device *dev, int sset)
 	case ETH_SS_STATS:
 		return vi->curr_queue_pairs * (VIRTNET_RQ_STATS_LEN +
 					       VIRTNET_SQ_STATS_LEN);
+	case ETH_SS_PRIV_FLAGS:
+		return ARRAY_SIZE(virtnet_priv_flags);
 	default:
 		return -EOPNOTSUPP;
 	}
@@ -2247,20 +2724,246 @@ static int virtnet_get_link_ksettings(struct net_device *dev,
 	return 0;
 }
 
-static int virtnet_set_coalesce(struct net_device *dev,
-				struct ethtool_coalesce *ec)
+static int virtnet_send_ctrl_coal_vq_cmd(struct virtnet_info *vi, u16 vqn,
+					 u32 max_usecs, u32 max_packets)
 {
-	struct virtnet_info *vi = netdev_priv(dev);
-	int i, napi_weight;
+	struct scatterlist sgs;
+
+	vi->ctrl->coal_vq.vqn = cpu_to_le16(vqn);
+	vi->ctrl->coal_vq.coal.max_usecs = cpu_to_le32(max_usecs);
+	vi->ctrl->coal_vq.coal.max_packets = cpu_to_le32(max_packets);
+	sg_init_one(&sgs, &vi->ctrl->coal_vq, sizeof(vi->ctrl->coal_vq));
+
+	if (!virtnet_send_command(vi, VIRTIO_NET_CTRL_NOTF_COAL,
+				  VIRTIO_NET_CTRL_NOTF_COAL_VQ_SET, &sgs))
+		return -EINVAL;
+
+	return 0;
+}
+
+static int virtnet_send_rx_ctrl_coal_vq_cmd(struct virtnet_info *vi,
+					    u16 queue, u32 max_usecs,
+					    u32 max_packets)
+{
+	int err;
+
+	err = virtnet_send_ctrl_coal_vq_cmd(vi, rxq2vq(queue),
+					    max_usecs, max_packets);
+	if (err)
+		return err;
+
+	vi->rq[queue].intr_coal.max_usecs = max_usecs;
+	vi->rq[queue].intr_coal.max_packets = max_packets;
+
+	return 0;
+}
+
+static int virtnet_send_tx_ctrl_coal_vq_cmd(struct virtnet_info *vi,
+					    u16 queue, u32 max_usecs,
+					    u32 max_packets)
+{
+	int err;
+
+	err = virtnet_send_ctrl_coal_vq_cmd(vi, txq2vq(queue),
+					    max_usecs, max_packets);
+	if (err)
+		return err;
+
+	vi->sq[queue].intr_coal.max_usecs = max_usecs;
+	vi->sq[queue].intr_coal.max_packets = max_packets;
+
+	return 0;
+}
+
+static void virtnet_rx_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct receive_queue *rq = container_of(dim, struct receive_queue, dim);
+	struct virtnet_info *vi = rq->vq->vdev->priv;
+	int qnum = rq - vi->rq;
+	struct dim_cq_moder moder;
+
+	/* The control vq is serialized by rtnl; don't sleep on it here, as
+	 * virtnet_close() cancels this work with rtnl held.
+	 */
+	if (!rtnl_trylock()) {
+		schedule_work(&dim->work);
+		return;
+	}
+
+	/* Adaptive mode may have been turned off while we were queued. */
+	if (rq->dim_enabled && qnum < vi->curr_queue_pairs) {
+		moder = net_dim_get_rx_moderation(dim->mode, dim->profile_ix);
+		if ((moder.usec != rq->intr_coal.max_usecs ||
+		     moder.pkts != rq->intr_coal.max_packets) &&
+		    virtnet_send_rx_ctrl_coal_vq_cmd(vi, qnum, moder.usec,
+						     moder.pkts))
+			dev_dbg(&vi->dev->dev,
+				"Failed to set coalescing for %s\n", rq->name);
+	}
+
+	dim->state = DIM_START_MEASURE;
+	rtnl_unlock();
+}
+
+static int virtnet_send_tx_notf_coal_cmds(struct virtnet_info *vi,
+					  struct ethtool_coalesce *ec)
+{
+	struct scatterlist sgs_tx;
+	int i;
+
+	vi->ctrl->coal_tx.tx_usecs = cpu_to_le32(ec->tx_coalesce_usecs);
+	vi->ctrl->coal_tx.tx_max_packets =
+		cpu_to_le32(ec->tx_max_coalesced_frames);
+	sg_init_one(&sgs_tx, &vi->ctrl->coal_tx, sizeof(vi->ctrl->coal_tx));
+
+	if (!virtnet_send_command(vi, VIRTIO_NET_CTRL_NOTF_COAL,
+				  VIRTIO_NET_CTRL_NOTF_COAL_TX_SET, &sgs_tx))
+		return -EINVAL;
+
+	vi->intr_coal_tx.max_usecs = ec->tx_coalesce_usecs;
+	vi->intr_coal_tx.max_packets = ec->tx_max_coalesced_frames;
+	for (i = 0; i < vi->max_queue_pairs; i++)
+		vi->sq[i].intr_coal = vi->intr_coal_tx;
+
+	return 0;
+}
+
+static int virtnet_send_rx_notf_coal_cmds(struct virtnet_info *vi,
+					  struct ethtool_coalesce *ec)
+{
+	bool dim_on = !!ec->use_adaptive_rx_coalesce;
+	struct scatterlist sgs_rx;
+	int i;
+
+	/* DIM moderates each queue on its own, which needs per-vq commands. */
+	if (dim_on && !virtio_has_feature(vi->vdev, VIRTIO_NET_F_VQ_NOTF_COAL))
+		return -EOPNOTSUPP;
+
+	if (dim_on) {
+		/* Fixed values can't be set while DIM owns them. */
+		if (ec->rx_coalesce_usecs != vi->intr_coal_rx.max_usecs ||
+		    ec->rx_max_coalesced_frames != vi->intr_coal_rx.max_packets)
+			return -EINVAL;
+
+		vi->rx_dim_enabled = true;
+		for (i = 0; i < vi->max_queue_pairs; i++)
+			vi->rq[i].dim_enabled = true;
+		return 0;
+	}
+
+	/* Turning DIM off falls through and restores the fixed values on
+	 * every queue.  Pending DIM work rechecks dim_enabled under rtnl.
+	 */
+	vi->rx_dim_enabled = false;
+	for (i = 0; i < vi->max_queue_pairs; i++)
+		vi->rq[i].dim_enabled = false;
+
+	vi->ctrl->coal_rx.rx_usecs = cpu_to_le32(ec->rx_coalesce_usecs);
+	vi->ctrl->coal_rx.rx_max_packets =
+		cpu_to_le32(ec->rx_max_coalesced_frames);
+	sg_init_one(&sgs_rx, &vi->ctrl->coal_rx, sizeof(vi->ctrl->coal_rx));
+
+	if (!virtnet_send_command(vi, VIRTIO_NET_CTRL_NOTF_COAL,
+				  VIRTIO_NET_CTRL_NOTF_COAL_RX_SET, &sgs_rx))
+		return -EINVAL;
+
+	vi->intr_coal_rx.max_usecs = ec->rx_coalesce_usecs;
+	vi->intr_coal_rx.max_packets = ec->rx_max_coalesced_frames;
+	for (i = 0; i < vi->max_queue_pairs; i++)
+		vi->rq[i].intr_coal = vi->intr_coal_rx;
+
+	return 0;
+}
+
+static int virtnet_send_notf_coal_cmds(struct virtnet_info *vi,
+				       struct ethtool_coalesce *ec)
+{
+	int err;
+
+	err = virtnet_send_tx_notf_coal_cmds(vi, ec);
+	if (err)
+		return err;
+
+	return virtnet_send_rx_notf_coal_cmds(vi, ec);
+}
+
+static int virtnet_send_notf_coal_vq_cmds(struct virtnet_info *vi,
+					  struct ethtool_coalesce *ec,
+					  u16 queue)
+{
+	struct receive_queue *rq = &vi->rq[queue];
+	int err;
+
+	if (ec->use_adaptive_rx_coalesce) {
+		if (!rq->dim_enabled &&
+		    (ec->rx_coalesce_usecs != rq->intr_coal.max_usecs ||
+		     ec->rx_max_coalesced_frames != rq->intr_coal.max_packets))
+			return -EINVAL;
+		rq->dim_enabled = true;
+	} else {
+		err = virtnet_send_rx_ctrl_coal_vq_cmd(vi, queue,
+						       ec->rx_coalesce_usecs,
+						       ec->rx_max_coalesced_frames);
+		if (err)
+			return err;
+		rq->dim_enabled = false;
+	}
+
+	return virtnet_send_tx_ctrl_coal_vq_cmd(vi, queue,
+						ec->tx_coalesce_usecs,
+						ec->tx_max_coalesced_frames);
+}
+
+static int virtnet_coal_params_supported(struct ethtool_coalesce *ec)
+{
+	/* Without notification coalescing only the napi_tx toggle exists. */
+	if (ec->rx_coalesce_usecs || ec->tx_coalesce_usecs ||
+	    ec->use_adaptive_rx_coalesce)
+		return -EOPNOTSUPP;
 
 	if (ec->tx_max_coalesced_frames > 1 ||
 	    ec->rx_max_coalesced_frames != 1)
 		return -EINVAL;
 
-	napi_weight = ec->tx_max_coalesced_frames ? NAPI_POLL_WEIGHT : 0;
-	if (napi_weight ^ vi->sq[0].napi.weight) {
-		if (dev->flags & IFF_UP)
+	return 0;
+}
+
+static int virtnet_should_update_vq_weight(int dev_flags, int weight,
+					   int vq_weight, bool *should_update)
+{
+	if (weight ^ vq_weight) {
+		if (dev_flags & IFF_UP)
 			return -EBUSY;
+		*should_update = true;
+	}
+
+	return 0;
+}
+
+static int virtnet_set_coalesce(struct net_device *dev,
+				struct ethtool_coalesce *ec)
+{
+	struct virtnet_info *vi = netdev_priv(dev);
+	bool update_napi = false;
+	int i, napi_weight, err;
+
+	/* Can't change NAPI weight if the link is up */
+	napi_weight = ec->tx_max_coalesced_frames ? NAPI_POLL_WEIGHT : 0;
+	err = virtnet_should_update_vq_weight(dev->flags, napi_weight,
+					      vi->sq[0].napi.weight,
+					      &update_napi);
+	if (err)
+		return err;
+
+	if (virtio_has_feature(vi->vdev, VIRTIO_NET_F_NOTF_COAL))
+		err = virtnet_send_notf_coal_cmds(vi, ec);
+	else
+		err = virtnet_coal_params_supported(ec);
+	if (err)
+		return err;
+
+	if (update_napi) {
 		for (i = 0; i < vi->max_queue_pairs; i++)
 			vi->sq[i].napi.weight = napi_weight;
 	}
@@ -2271,20 +2974,291 @@ static int virtnet_set_coalesce(struct net_device *dev,
 static int virtnet_get_coalesce(struct net_device *dev,
 				struct ethtool_coalesce *ec)
 {
-	struct ethtool_coalesce ec_default = {
-		.cmd = ETHTOOL_GCOALESCE,
-		.rx_max_coalesced_frames = 1,
-	};
 	struct virtnet_info *vi = netdev_priv(dev);
 
-	memcpy(ec, &ec_default, sizeof(ec_default));
+	memset(ec, 0, sizeof(*ec));
+	ec->cmd = ETHTOOL_GCOALESCE;
+
+	if (virtio_has_feature(vi->vdev, VIRTIO_NET_F_NOTF_COAL)) {
+		ec->rx_coalesce_usecs = vi->intr_coal_rx.max_usecs;
+		ec->tx_coalesce_usecs = vi->intr_coal_tx.max_usecs;
+		ec->rx_max_coalesced_frames = vi->intr_coal_rx.max_packets;
+		ec->tx_max_coalesced_frames = vi->intr_coal_tx.max_packets;
+		ec->use_adaptive_rx_coalesce = vi->rx_dim_enabled;
+	} else {
+		ec->rx_max_coalesced_frames = 1;
+		if (vi->sq[0].napi.weight)
+			ec->tx_max_coalesced_frames = 1;
+	}
+
+	return 0;
+}
+
+static int virtnet_set_per_queue_coalesce(struct net_device *dev,
+					  u32 queue,
+					  struct ethtool_coalesce *ec)
+{
+	struct virtnet_info *vi = netdev_priv(dev);
+	bool update_napi = false;
+	int err, napi_weight;
+
+	if (queue >= vi->max_queue_pairs)
+		return -EINVAL;
+
+	/* Can't change NAPI weight if the link is up */
+	napi_weight = ec->tx_max_coalesced_frames ? NAPI_POLL_WEIGHT : 0;
+	err = virtnet_should_update_vq_weight(dev->flags, napi_weight,
+					      vi->sq[queue].napi.weight,
+					      &update_napi);
+	if (err)
+		return err;
+
+	if (virtio_has_feature(vi->vdev, VIRTIO_NET_F_VQ_NOTF_COAL))
+		err = virtnet_send_notf_coal_vq_cmds(vi, ec, queue);
+	else
+		err = virtnet_coal_params_supported(ec);
+	if (err)
+		return err;
+
+	if (update_napi)
+		vi->sq[queue].napi.weight = napi_weight;
+
+	return 0;
+}
+
+static int virtnet_get_per_queue_coalesce(struct net_device *dev,
+					  u32 queue,
+					  struct ethtool_coalesce *ec)
+{
+	struct virtnet_info *vi = netdev_priv(dev);
+
+	if (queue >= vi->max_queue_pairs)
+		return -EINVAL;
 
-	if (vi->sq[0].napi.weight)
-		ec->tx_max_coalesced_frames = 1;
+	memset(ec, 0, sizeof(*ec));
+	ec->cmd = ETHTOOL_GCOALESCE;
+
+	if (virtio_has_feature(vi->vdev, VIRTIO_NET_F_VQ_NOTF_COAL)) {
+		ec->rx_coalesce_usecs = vi->rq[queue].intr_coal.max_usecs;
+		ec->tx_coalesce_usecs = vi->sq[queue].intr_coal.max_usecs;
+		ec->rx_max_coalesced_frames =
+			vi->rq[queue].intr_coal.max_packets;
+		ec->tx_max_coalesced_frames =
+			vi->sq[queue].intr_coal.max_packets;
+		ec->use_adaptive_rx_coalesce = vi->rq[queue].dim_enabled;
+	} else {
+		ec->rx_max_coalesced_frames = 1;
+		if (vi->sq[queue].napi.weight)
+			ec->tx_max_coalesced_frames = 1;
+	}
 
 	return 0;
 }
 
+static u32 virtnet_get_rxfh_key_size(struct net_device *dev)
+{
+	struct virtnet_info *vi = netdev_priv(dev);
+
+	return vi->has_rss ? vi->rss_key_size : 0;
+}
+
+static u32 virtnet_get_rxfh_indir_size(struct net_device *dev)
+{
+	struct virtnet_info *vi = netdev_priv(dev);
+
+	return vi->has_rss ? vi->rss_indir_table_size : 0;
+}
+
+static int virtnet_get_rxfh(struct net_device *dev, u32 *indir, u8 *key,
+			    u8 *hfunc)
+{
+	struct virtnet_info *vi = netdev_priv(dev);
+	int i;
+
+	if (indir) {
+		for (i = 0; i < vi->rss_indir_table_size; i++)
+			indir[i] = le16_to_cpu(vi->ctrl->rss.indirection_table[i]);
+	}
+
+	if (key)
+		memcpy(key, vi->ctrl->rss.key, vi->rss_key_size);
+
+	if (hfunc)
+		*hfunc = ETH_RSS_HASH_TOP;
+
+	return 0;
+}
+
+static int virtnet_set_rxfh(struct net_device *dev, const u32 *indir,
+			    const u8 *key, const u8 hfunc)
+{
+	struct virtnet_info *vi = netdev_priv(dev);
+	int i;
+
+	if (!vi->has_rss)
+		return -EOPNOTSUPP;
+
+	if (hfunc != ETH_RSS_HASH_NO_CHANGE && hfunc != ETH_RSS_HASH_TOP)
+		return -EOPNOTSUPP;
+
+	if (indir) {
+		for (i = 0; i < vi->rss_indir_table_size; i++)
+			vi->ctrl->rss.indirection_table[i] = cpu_to_le16(indir[i]);
+	}
+
+	if (key)
+		memcpy(vi->ctrl->rss.key, key, vi->rss_key_size);
+
+	if (!virtnet_commit_rss_command(vi))
+		return -EINVAL;
+
+	return 0;
+}
+
+static void virtnet_get_hashflow(const struct virtnet_info *vi,
+				 struct ethtool_rxnfc *info)
+{
+	u32 l3, l4;
+
+	switch (info->flow_type) {
+	case TCP_V4_FLOW:
+		l3 = VIRTIO_NET_RSS_HASH_TYPE_IPv4;
+		l4 = VIRTIO_NET_RSS_HASH_TYPE_TCPv4;
+		break;
+	case UDP_V4_FLOW:
+		l3 = VIRTIO_NET_RSS_HASH_TYPE_IPv4;
+		l4 = VIRTIO_NET_RSS_HASH_TYPE_UDPv4;
+		break;
+	case TCP_V6_FLOW:
+		l3 = VIRTIO_NET_RSS_HASH_TYPE_IPv6;
+		l4 = VIRTIO_NET_RSS_HASH_TYPE_TCPv6;
+		break;
+	case UDP_V6_FLOW:
+		l3 = VIRTIO_NET_RSS_HASH_TYPE_IPv6;
+		l4 = VIRTIO_NET_RSS_HASH_TYPE_UDPv6;
+		break;
+	case IPV4_FLOW:
+		l3 = VIRTIO_NET_RSS_HASH_TYPE_IPv4;
+		l4 = 0;
+		break;
+	case IPV6_FLOW:
+		l3 = VIRTIO_NET_RSS_HASH_TYPE_IPv6;
+		l4 = 0;
+		break;
+	default:
+		info->data = 0;
+		return;
+	}
+
+	if (vi->rss_hash_types_saved & l4)
+		info->data = RXH_IP_SRC | RXH_IP_DST |
+			     RXH_L4_B_0_1 | RXH_L4_B_2_3;
+	else if (vi->rss_hash_types_saved & l3)
+		info->data = RXH_IP_SRC | RXH_IP_DST;
+	else
+		info->data = 0;
+}
+
+static bool virtnet_set_hashflow(struct virtnet_info *vi,
+				 struct ethtool_rxnfc *info)
+{
+	u32 new_hashtypes = vi->rss_hash_types_saved;
+	bool is_disable = info->data & RXH_DISCARD;
+	bool is_l4 = info->data == (RXH_IP_SRC | RXH_IP_DST |
+				    RXH_L4_B_0_1 | RXH_L4_B_2_3);
+	u32 l3, l4;
+
+	/* The device hashes on full tuples only: 'sd', 'sdfn' or 'r'. */
+	if (!is_disable && !is_l4 && info->data != (RXH_IP_SRC | RXH_IP_DST))
+		return false;
+
+	switch (info->flow_type) {
+	case TCP_V4_FLOW:
+		l3 = VIRTIO_NET_RSS_HASH_TYPE_IPv4;
+		l4 = VIRTIO_NET_RSS_HASH_TYPE_TCPv4;
+		break;
+	case UDP_V4_FLOW:
+		l3 = VIRTIO_NET_RSS_HASH_TYPE_IPv4;
+		l4 = VIRTIO_NET_RSS_HASH_TYPE_UDPv4;
+		break;
+	case TCP_V6_FLOW:
+		l3 = VIRTIO_NET_RSS_HASH_TYPE_IPv6;
+		l4 = VIRTIO_NET_RSS_HASH_TYPE_TCPv6;
+		break;
+	case UDP_V6_FLOW:
+		l3 = VIRTIO_NET_RSS_HASH_TYPE_IPv6;
+		l4 = VIRTIO_NET_RSS_HASH_TYPE_UDPv6;
+		break;
+	case IPV4_FLOW:
+		l3 = VIRTIO_NET_RSS_HASH_TYPE_IPv4;
+		l4 = 0;
+		break;
+	case IPV6_FLOW:
+		l3 = VIRTIO_NET_RSS_HASH_TYPE_IPv6;
+		l4 = 0;
+		break;
+	default:
+		return false;
+	}
+
+	/* The L3 hash type is shared by every flow of that family, so it
+	 * is only ever added here, never dropped.
+	 */
+	new_hashtypes &= ~l4;
+	if (is_disable && !l4)
+		new_hashtypes &= ~l3;
+	if (!is_disable)
+		new_hashtypes |= l3 | (is_l4 ? l4 : 0);
+
+	if (new_hashtypes & ~vi->rss_hash_types_supported)
+		return false;
+
+	if (new_hashtypes != vi->rss_hash_types_saved) {
+		vi->rss_hash_types_saved = new_hashtypes;
+		vi->ctrl->rss.hash_types = cpu_to_le32(new_hashtypes);
+		if (vi->dev->features & NETIF_F_RXHASH)
+			return virtnet_commit_rss_command(vi);
+	}
+
+	return true;
+}
+
+static int virtnet_get_rxnfc(struct net_device *dev,
+			     struct ethtool_rxnfc *info, u32 *rule_locs)
+{
+	struct virtnet_info *vi = netdev_priv(dev);
+
+	switch (info->cmd) {
+	case ETHTOOL_GRXRINGS:
+		info->data = vi->curr_queue_pairs;
+		return 0;
+	case ETHTOOL_GRXFH:
+		if (!vi->has_rss && !vi->has_rss_hash_report)
+			return -EOPNOTSUPP;
+		virtnet_get_hashflow(vi, info);
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static int virtnet_set_rxnfc(struct net_device *dev,
+			     struct ethtool_rxnfc *info)
+{
+	struct virtnet_info *vi = netdev_priv(dev);
+
+	switch (info->cmd) {
+	case ETHTOOL_SRXFH:
+		if (!vi->has_rss && !vi->has_rss_hash_report)
+			return -EOPNOTSUPP;
+		if (!virtnet_set_hashflow(vi, info))
+			return -EINVAL;
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
 static void virtnet_init_settings(struct net_device *dev)
 {
 	struct virtnet_info *vi = netdev_priv(dev);
@@ -2312,13 +3286,40 @@ static void virtnet_update_settings(struct virtnet_info *vi)
 		vi->duplex = duplex;
 }
 
+static u32 virtnet_get_priv_flags(struct net_device *dev)
+{
+	struct virtnet_info *vi = netdev_priv(dev);
+
+	return vi->napi_threaded ? VIRTNET_PRIV_FLAG_NAPI_THREADED : 0;
+}
+
+static int virtnet_set_priv_flags(struct net_device *dev, u32 flags)
+{
+	struct virtnet_info *vi = netdev_priv(dev);
+	bool threaded = !!(flags & VIRTNET_PRIV_FLAG_NAPI_THREADED);
+
+	if (threaded == vi->napi_threaded)
+		return 0;
+
+	/* The poll threads come and go with the interface */
+	if (dev->flags & IFF_UP)
+		return -EBUSY;
+
+	vi->napi_threaded = threaded;
+	return 0;
+}
+
 static const struct ethtool_ops virtnet_ethtool_ops = {
-	.supported_coalesce_params = ETHTOOL_COALESCE_MAX_FRAMES,
+	.supported_coalesce_params = ETHTOOL_COALESCE_USECS |
+				     ETHTOOL_COALESCE_MAX_FRAMES |
+				     ETHTOOL_COALESCE_USE_ADAPTIVE_RX,
 	.get_drvinfo = virtnet_get_drvinfo,
 	.get_link = ethtool_op_get_link,
 	.get_ringparam = virtnet_get_ringparam,
 	.get_strings = virtnet_get_strings,
 	.get_sset_count = virtnet_get_sset_count,
+	.get_priv_flags = virtnet_get_priv_flags,
+	.set_priv_flags = virtnet_set_priv_flags,
 	.get_ethtool_stats = virtnet_get_ethtool_stats,
 	.set_channels = virtnet_set_channels,
 	.get_channels = virtnet_get_channels,
@@ -2327,6 +3328,14 @@ static const struct ethtool_ops virtnet_ethtool_ops = {
 	.set_link_ksettings = virtnet_set_link_ksettings,
 	.set_coalesce = virtnet_set_coalesce,
 	.get_coalesce = virtnet_get_coalesce,
+	.set_per_queue_coalesce = virtnet_set_per_queue_coalesce,
+	.get_per_queue_coalesce = virtnet_get_per_queue_coalesce,
+	.get_rxfh_key_size = virtnet_get_rxfh_key_size,
+	.get_rxfh_indir_size = virtnet_get_rxfh_indir_size,
+	.get_rxfh = virtnet_get_rxfh,
+	.set_rxfh = virtnet_set_rxfh,
+	.get_rxnfc = virtnet_get_rxnfc,
+	.set_rxnfc = virtnet_set_rxnfc,
 };
 
 static void virtnet_freeze_down(struct virtio_device *vdev)
@@ -2577,6 +3586,18 @@ static int virtnet_set_features(struct net_device *dev,
 		vi->guest_offloads = offloads;
 	}
 
+	if ((dev->features ^ features) & NETIF_F_RXHASH) {
+		if (features & NETIF_F_RXHASH)
+			vi->ctrl->rss.hash_types =
+				cpu_to_le32(vi->rss_hash_types_saved);
+		else
+			vi->ctrl->rss.hash_types =
+				cpu_to_le32(VIRTIO_NET_HASH_REPORT_NONE);
+
+		if (!virtnet_commit_rss_command(vi))
+			return -EINVAL;
+	}
+
 	return 0;
 }
 
@@ -2682,9 +3703,11 @@ static void free_receive_bufs(struct virtnet_info *vi)
 static void free_receive_page_frags(struct virtnet_info *vi)
 {
 	int i;
-	for (i = 0; i < vi->max_queue_pairs; i++)
+	for (i = 0; i < vi->max_queue_pairs; i++) {
 		if (vi->rq[i].alloc_frag.page)
 			put_page(vi->rq[i].alloc_frag.page);
+		virtnet_rx_pool_drain(&vi->rq[i]);
+	}
 }
 
 static void free_unused_bufs(struct virtnet_info *vi)
@@ -2734,7 +3757,7 @@ static void virtnet_del_vqs(struct virtnet_info *vi)
  */
 static unsigned int mergeable_min_buf_len(struct virtnet_info *vi, struct virtqueue *vq)
 {
-	const unsigned int hdr_len = sizeof(struct virtio_net_hdr_mrg_rxbuf);
+	const unsigned int hdr_len = vi->hdr_len;
 	unsigned int rq_size = virtqueue_get_vring_size(vq);
 	unsigned int packet_len = vi->big_packets ? IP_MAX_MTU : vi->dev->max_mtu;
 	unsigned int buf_len = hdr_len + ETH_HLEN + VLAN_HLEN + packet_len;
@@ -2852,6 +3875,8 @@ static int virtnet_alloc_queues(struct virtnet_info *vi)
 
 		sg_init_table(vi->rq[i].sg, ARRAY_SIZE(vi->rq[i].sg));
 		ewma_pkt_len_init(&vi->rq[i].mrg_avg_pkt_len);
+		INIT_WORK(&vi->rq[i].dim.work, virtnet_rx_dim_work);
+		vi->rq[i].dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
 		sg_init_table(vi->sq[i].sg, ARRAY_SIZE(vi->sq[i].sg));
 
 		u64_stats_init(&vi->rq[i].stats.syncp);
@@ -2951,6 +3976,14 @@ static bool virtnet_validate_features(struct virtio_device *vdev)
 			     "VIRTIO_NET_F_CTRL_VQ") ||
 	     VIRTNET_FAIL_ON(vdev, VIRTIO_NET_F_MQ, "VIRTIO_NET_F_CTRL_VQ") ||
 	     VIRTNET_FAIL_ON(vdev, VIRTIO_NET_F_CTRL_MAC_ADDR,
+			     "VIRTIO_NET_F_CTRL_VQ") ||
+	     VIRTNET_FAIL_ON(vdev, VIRTIO_NET_F_NOTF_COAL,
+			     "VIRTIO_NET_F_CTRL_VQ") ||
+	     VIRTNET_FAIL_ON(vdev, VIRTIO_NET_F_VQ_NOTF_COAL,
+			     "VIRTIO_NET_F_CTRL_VQ") ||
+	     VIRTNET_FAIL_ON(vdev, VIRTIO_NET_F_RSS,
+			     "VIRTIO_NET_F_CTRL_VQ") ||
+	     VIRTNET_FAIL_ON(vdev, VIRTIO_NET_F_HASH_REPORT,
 			     "VIRTIO_NET_F_CTRL_VQ"))) {
 		return false;
 	}
@@ -2995,6 +4028,12 @@ static int virtnet_probe(struct virtio_device *vdev)
 	err = virtio_cread_feature(vdev, VIRTIO_NET_F_MQ,
 				   struct virtio_net_config,
 				   max_virtqueue_pairs, &max_queue_pairs);
+	/* RSS alone also provides max_virtqueue_pairs */
+	if (err)
+		err = virtio_cread_feature(vdev, VIRTIO_NET_F_RSS,
+					   struct virtio_net_config,
+					   max_virtqueue_pairs,
+					   &max_queue_pairs);
 
 	/* We need at least 2 queue's */
 	if (err || max_queue_pairs < VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MIN ||
@@ -3080,8 +4119,49 @@ static int virtnet_probe(struct virtio_device *vdev)
 	if (virtio_has_feature(vdev, VIRTIO_NET_F_MRG_RXBUF))
 		vi->mergeable_rx_bufs = true;
 
-	if (virtio_has_feature(vdev, VIRTIO_NET_F_MRG_RXBUF) ||
-	    virtio_has_feature(vdev, VIRTIO_F_VERSION_1))
+	if (virtio_has_feature(vdev, VIRTIO_NET_F_RSS))
+		vi->has_rss = true;
+
+	if (virtio_has_feature(vdev, VIRTIO_NET_F_HASH_REPORT))
+		vi->has_rss_hash_report = true;
+
+	if (vi->has_rss || vi->has_rss_hash_report) {
+		vi->rss_key_size =
+			virtio_cread8(vdev, offsetof(struct virtio_net_config,
+						     rss_max_key_size));
+		vi->rss_key_size = min_t(u8, vi->rss_key_size,
+					 VIRTIO_NET_RSS_MAX_KEY_SIZE);
+
+		/* Hash reporting alone has no table: send a single entry. */
+		if (vi->has_rss) {
+			u16 size = virtio_cread16(vdev,
+				offsetof(struct virtio_net_config,
+					 rss_max_indirection_table_length));
+
+			size = clamp_t(u16, size, 1,
+				       VIRTIO_NET_RSS_MAX_TABLE_LEN);
+			vi->rss_indir_table_size = rounddown_pow_of_two(size);
+		} else {
+			vi->rss_indir_table_size = 1;
+		}
+
+		/* Hashing over IPv6 extension headers has no ethtool knob. */
+		vi->rss_hash_types_supported =
+			virtio_cread32(vdev, offsetof(struct virtio_net_config,
+						      supported_hash_types));
+		vi->rss_hash_types_supported &=
+			~(VIRTIO_NET_RSS_HASH_TYPE_IP_EX |
+			  VIRTIO_NET_RSS_HASH_TYPE_TCP_EX |
+			  VIRTIO_NET_RSS_HASH_TYPE_UDP_EX);
+
+		dev->hw_features |= NETIF_F_RXHASH;
+		dev->features |= NETIF_F_RXHASH;
+	}
+
+	if (vi->has_rss_hash_report)
+		vi->hdr_len = sizeof(struct virtio_net_hdr_v1_hash);
+	else if (virtio_has_feature(vdev, VIRTIO_NET_F_MRG_RXBUF) ||
+		 virtio_has_feature(vdev, VIRTIO_F_VERSION_1))
 		vi->hdr_len = sizeof(struct virtio_net_hdr_mrg_rxbuf);
 	else
 		vi->hdr_len = sizeof(struct virtio_net_hdr);
@@ -3138,8 +4218,27 @@ static int virtnet_probe(struct virtio_device *vdev)
 	netif_set_real_num_tx_queues(dev, vi->curr_queue_pairs);
 	netif_set_real_num_rx_queues(dev, vi->curr_queue_pairs);
 
+	/* Committed by virtnet_set_queues() once the device is registered */
+	if (vi->has_rss || vi->has_rss_hash_report)
+		virtnet_init_default_rss(vi);
+
 	virtnet_init_settings(dev);
 
+	/* The device starts out notifying on every packet.  Report TX
+	 * max-frames in line with napi_tx, as ethtool uses it as the toggle.
+	 */
+	if (virtio_has_feature(vdev, VIRTIO_NET_F_NOTF_COAL)) {
+		vi->intr_coal_rx.max_packets = 1;
+		vi->intr_coal_tx.max_packets = vi->sq[0].napi.weight ? 1 : 0;
+	}
+	if (virtio_has_feature(vdev, VIRTIO_NET_F_VQ_NOTF_COAL)) {
+		for (i = 0; i < vi->max_queue_pairs; i++) {
+			vi->rq[i].intr_coal.max_packets = 1;
+			if (vi->sq[i].napi.weight)
+				vi->sq[i].intr_coal.max_packets = 1;
+		}
+	}
+
 	if (virtio_has_feature(vdev, VIRTIO_NET_F_STANDBY)) {
 		vi->failover = net_failover_create(vi->dev);
 		if (IS_ERR(vi->failover)) {
@@ -3279,7 +4378,9 @@ static struct virtio_device_id id_table[] = {
 	VIRTIO_NET_F_GUEST_ANNOUNCE, VIRTIO_NET_F_MQ, \
 	VIRTIO_NET_F_CTRL_MAC_ADDR, \
 	VIRTIO_NET_F_MTU, VIRTIO_NET_F_CTRL_GUEST_OFFLOADS, \
-	VIRTIO_NET_F_SPEED_DUPLEX, VIRTIO_NET_F_STANDBY
+	VIRTIO_NET_F_SPEED_DUPLEX, VIRTIO_NET_F_STANDBY, \
+	VIRTIO_NET_F_NOTF_COAL, VIRTIO_NET_F_VQ_NOTF_COAL, \
+	VIRTIO_NET_F_RSS, VIRTIO_NET_F_HASH_REPORT
 
 static unsigned int features[] = {
 	VIRTNET_FEATURES,
@@ -25,9 +25,13 @@
  */
 
 #include <linux/module.h>
+#include <linux/kthread.h>
+#include <linux/netpoll.h>
+#include <net/busy_poll.h>
 #include <net/ip6_checksum.h>
 
 #include "vmxnet3_int.h"
+#include "vmxnet3_xdp.h"
 
 char vmxnet3_driver_name[] = "vmxnet3";
 #define VMXNET3_DRIVER_DESC "VMware vmxnet3 virtual NIC driver"
@@ -75,7 +79,11 @@ vmxnet3_enable_all_intrs(struct vmxnet3_adapter *adapter)
 
 	for (i = 0; i < adapter->intr.num_intrs; i++)
 		vmxnet3_enable_intr(adapter, i);
-	adapter->shared->devRead.intrConf.intrCtrl &=
+	if (!adapter->queuesExtEnabled)
+		adapter->shared->devRead.intrConf.intrCtrl &=
+					cpu_to_le32(~VMXNET3_IC_DISABLE_ALL);
+	else
+		adapter->shared->devReadExt.intrConfExt.intrCtrl &=
 					cpu_to_le32(~VMXNET3_IC_DISABLE_ALL);
 }
 
@@ -85,7 +93,11 @@ vmxnet3_disable_all_intrs(struct vmxnet3_adapter *adapter)
 {
 	int i;
 
-	adapter->shared->devRead.intrConf.intrCtrl |=
+	if (!adapter->queuesExtEnabled)
+		adapter->shared->devRead.intrConf.intrCtrl |=
+					cpu_to_le32(VMXNET3_IC_DISABLE_ALL);
+	else
+		adapter->shared->devReadExt.intrConfExt.intrCtrl |=
 					cpu_to_le32(VMXNET3_IC_DISABLE_ALL);
 	for (i = 0; i < adapter->intr.num_intrs; i++)
 		vmxnet3_disable_intr(adapter, i);
@@ -312,7 +324,8 @@ static void
 vmxnet3_unmap_tx_buf(struct vmxnet3_tx_buf_info *tbi,
 		     struct pci_dev *pdev)
 {
-	if (tbi->map_type == VMXNET3_MAP_SINGLE)
+	if (tbi->map_type == VMXNET3_MAP_SINGLE ||
+	    tbi->map_type == VMXNET3_MAP_XDP)
 		dma_unmap_single(&pdev->dev, tbi->dma_addr, tbi->len,
 				 PCI_DMA_TODEVICE);
 	else if (tbi->map_type == VMXNET3_MAP_PAGE)
@@ -330,6 +343,7 @@ vmxnet3_unmap_pkt(u32 eop_idx, struct vmxnet3_tx_queue *tq,
 		  struct pci_dev *pdev,	struct vmxnet3_adapter *adapter)
 {
 	struct sk_buff *skb;
+	struct xdp_frame *xdpf = NULL;
 	int entries = 0;
 
 	/* no out of order completion */
@@ -338,6 +352,8 @@ vmxnet3_unmap_pkt(u32 eop_idx, struct vmxnet3_tx_queue *tq,
 
 	skb = tq->buf_info[eop_idx].skb;
 	BUG_ON(skb == NULL);
+	if (tq->buf_info[eop_idx].map_type == VMXNET3_MAP_XDP)
+		xdpf = tq->buf_info[eop_idx].xdpf;
 	tq->buf_info[eop_idx].skb = NULL;
 
 	VMXNET3_INC_RING_IDX_ONLY(eop_idx, tq->tx_ring.size);
@@ -355,7 +371,10 @@ vmxnet3_unmap_pkt(u32 eop_idx, struct vmxnet3_tx_queue *tq,
 		entries++;
 	}
 
-	dev_kfree_skb_any(skb);
+	if (xdpf)
+		xdp_return_frame(xdpf);
+	else
+		dev_kfree_skb_any(skb);
 	return entries;
 }
 
@@ -404,12 +423,17 @@ vmxnet3_tq_cleanup(struct vmxnet3_tx_queue *tq,
 
 	while (tq->tx_ring.next2comp != tq->tx_ring.next2fill) {
 		struct vmxnet3_tx_buf_info *tbi;
+		bool xdp;
 
 		tbi = tq->buf_info + tq->tx_ring.next2comp;
+		xdp = tbi->map_type == VMXNET3_MAP_XDP;
 
 		vmxnet3_unmap_tx_buf(tbi, adapter->pdev);
 		if (tbi->skb) {
-			dev_kfree_skb_any(tbi->skb);
+			if (xdp)
+				xdp_return_frame(tbi->xdpf);
+			else
+				dev_kfree_skb_any(tbi->skb);
 			tbi->skb = NULL;
 		}
 		vmxnet3_cmd_ring_adv_next2comp(&tq->tx_ring);
@@ -602,6 +626,20 @@ vmxnet3_rq_alloc_rx_buf(struct vmxnet3_rx_queue *rq, u32 ring_idx,
 				/* rx buffer skipped by the device */
 			}
 			val = VMXNET3_RXD_BTYPE_HEAD << VMXNET3_RXD_BTYPE_SHIFT;
+		} else if (rbi->buf_type == VMXNET3_RX_BUF_XDP) {
+			if (rbi->page == NULL) {
+				rbi->page = vmxnet3_xdp_alloc_page(adapter,
+							rbi->len,
+							&rbi->dma_addr,
+							GFP_KERNEL);
+				if (unlikely(rbi->page == NULL)) {
+					rq->stats.rx_buf_alloc_failure++;
+					break;
+				}
+			} else {
+				/* rx buffer skipped by the device */
+			}
+			val = VMXNET3_RXD_BTYPE_HEAD << VMXNET3_RXD_BTYPE_SHIFT;
 		} else {
 			BUG_ON(rbi->buf_type != VMXNET3_RX_BUF_PAGE ||
 			       rbi->len  != PAGE_SIZE);
@@ -1353,6 +1391,7 @@ vmxnet3_rq_rx_complete(struct vmxnet3_rx_queue *rq,
 		VMXNET3_REG_RXPROD, VMXNET3_REG_RXPROD2
 	};
 	u32 num_pkts = 0;
+	int xdp_res = 0;
 	bool skip_page_frags = false;
 	struct Vmxnet3_RxCompDesc *rcd;
 	struct vmxnet3_rx_ctx *ctx = &rq->rx_ctx;
@@ -1409,7 +1448,8 @@ vmxnet3_rq_rx_complete(struct vmxnet3_rx_queue *rq,
 			       (rcd->rqID != rq->qid &&
 				rcd->rqID != rq->dataRingQid));
 
-			BUG_ON(rbi->buf_type != VMXNET3_RX_BUF_SKB);
+			BUG_ON(rbi->buf_type != VMXNET3_RX_BUF_SKB &&
+			       rbi->buf_type != VMXNET3_RX_BUF_XDP);
 			BUG_ON(ctx->skb != NULL || rbi->skb == NULL);
 
 			if (unlikely(rcd->len == 0)) {
@@ -1422,10 +1462,44 @@ vmxnet3_rq_rx_complete(struct vmxnet3_rx_queue *rq,
 			}
 
 			skip_page_frags = false;
-			ctx->skb = rbi->skb;
-
 			rxDataRingUsed =
 				VMXNET3_RX_DATA_RING(adapter, rcd->rqID);
+
+			if (rbi->buf_type == VMXNET3_RX_BUF_XDP) {
+				int res;
+
+				/* With XDP a pkt must fit in one buffer, see
+				 * VMXNET3_XDP_MAX_MTU. Drop anything else.
+				 */
+				if (unlikely(!rcd->eop)) {
+					rq->stats.drop_total++;
+					skip_page_frags = true;
+					goto rcd_done;
+				}
+
+				if (rxDataRingUsed) {
+					size_t sz;
+
+					BUG_ON(rcd->len > rq->data_ring.desc_size);
+
+					sz = rcd->rxdIdx * rq->data_ring.desc_size;
+					res = vmxnet3_process_xdp_small(adapter,
+						rq, &rq->data_ring.base[sz],
+						rcd->len, &ctx->skb);
+				} else {
+					res = vmxnet3_process_xdp(adapter, rq,
+						rcd, rbi, rxd, &ctx->skb);
+				}
+
+				if (res != VMXNET3_XDP_PASS) {
+					xdp_res |= res;
+					num_pkts++;
+					goto rcd_done;
+				}
+				goto sop_done;
+			}
+
+			ctx->skb = rbi->skb;
 			len = rxDataRingUsed ? rcd->len : rbi->len;
 			new_skb = netdev_alloc_skb_ip_align(adapter->netdev,
 							    len);
@@ -1482,6 +1556,8 @@ vmxnet3_rq_rx_complete(struct vmxnet3_rx_queue *rq,
 				rxd->len = rbi->len;
 			}
 
+			skb_put(ctx->skb, rcd->len);
+sop_done:
 #ifdef VMXNET3_RSS
 			if (rcd->rssType != VMXNET3_RCD_RSS_TYPE_NONE &&
 			    (adapter->netdev->features & NETIF_F_RXHASH))
@@ -1489,7 +1565,6 @@ vmxnet3_rq_rx_complete(struct vmxnet3_rx_queue *rq,
 					     le32_to_cpu(rcd->rssHash),
 					     PKT_HASH_TYPE_L3);
 #endif
-			skb_put(ctx->skb, rcd->len);
 
 			if (VMXNET3_VERSION_GE_2(adapter) &&
 			    rcd->type == VMXNET3_CDTYPE_RXCOMP_LRO) {
@@ -1600,9 +1675,10 @@ not_lro:
 			if (unlikely(rcd->ts))
 				__vlan_hwaccel_put_tag(skb, htons(ETH_P_8021Q), rcd->tci);
 
-			if (adapter->netdev->features & NETIF_F_LRO)
+			if (adapter->netdev->features & NETIF_F_LRO) {
+				skb_mark_napi_id(skb, &rq->napi);
 				netif_receive_skb(skb);
-			else
+			} else
 				napi_gro_receive(&rq->napi, skb);
 
 			ctx->skb = NULL;
@@ -1643,6 +1719,9 @@ rcd_done:
 				  &rq->comp_ring.base[rq->comp_ring.next2proc].rcd, &rxComp);
 	}
 
+	if (xdp_res)
+		vmxnet3_xdp_finalize(adapter, xdp_res);
+
 	return num_pkts;
 }
 
@@ -1662,7 +1741,14 @@ vmxnet3_rq_cleanup(struct vmxnet3_rx_queue *rq,
 			vmxnet3_getRxDesc(rxd,
 				&rq->rx_ring[ring_idx].base[i].rxd, &rxDesc);
 
-			if (rxd->btype == VMXNET3_RXD_BTYPE_HEAD &&
+			if (rq->buf_info[ring_idx][i].buf_type ==
+					VMXNET3_RX_BUF_XDP &&
+					rq->buf_info[ring_idx][i].page) {
+				dma_unmap_page(&adapter->pdev->dev, rxd->addr,
+					       rxd->len, PCI_DMA_FROMDEVICE);
+				put_page(rq->buf_info[ring_idx][i].page);
+				rq->buf_info[ring_idx][i].page = NULL;
+			} else if (rxd->btype == VMXNET3_RXD_BTYPE_HEAD &&
 					rq->buf_info[ring_idx][i].skb) {
 				dma_unmap_single(&adapter->pdev->dev, rxd->addr,
 						 rxd->len, PCI_DMA_FROMDEVICE);
@@ -1684,6 +1770,11 @@ vmxnet3_rq_cleanup(struct vmxnet3_rx_queue *rq,
 
 	rq->comp_ring.gen = VMXNET3_INIT_GEN;
 	rq->comp_ring.next2proc = 0;
+
+	if (rq->xdp_page) {
+		put_page(rq->xdp_page);
+		rq->xdp_page = NULL;
+	}
 }
 
 
@@ -1711,6 +1802,8 @@ static void vmxnet3_rq_destroy(struct vmxnet3_rx_queue *rq,
 		}
 	}
 
+	if (xdp_rxq_info_is_reg(&rq->xdp_rxq))
+		xdp_rxq_info_unreg(&rq->xdp_rxq);
 
 	for (i = 0; i < 2; i++) {
 		if (rq->rx_ring[i].base) {
@@ -1775,9 +1868,11 @@ vmxnet3_rq_init(struct vmxnet3_rx_queue *rq,
 	/* initialize buf_info */
 	for (i = 0; i < rq->rx_ring[0].size; i++) {
 
-		/* 1st buf for a pkt is skbuff */
+		/* 1st buf for a pkt is skbuff, or a page with XDP */
 		if (i % adapter->rx_buf_per_pkt == 0) {
-			rq->buf_info[0][i].buf_type = VMXNET3_RX_BUF_SKB;
+			rq->buf_info[0][i].buf_type =
+				vmxnet3_xdp_enabled(adapter) ?
+				VMXNET3_RX_BUF_XDP : VMXNET3_RX_BUF_SKB;
 			rq->buf_info[0][i].len = adapter->skb_buf_size;
 		} else { /* subsequent bufs for a pkt is frag */
 			rq->buf_info[0][i].buf_type = VMXNET3_RX_BUF_PAGE;
@@ -1893,6 +1988,14 @@ vmxnet3_rq_create(struct vmxnet3_rx_queue *rq, struct vmxnet3_adapter *adapter)
 	rq->buf_info[0] = bi;
 	rq->buf_info[1] = bi + rq->rx_ring[0].size;
 
+	if (xdp_rxq_info_reg(&rq->xdp_rxq, adapter->netdev,
+			     rq - adapter->rx_queue) ||
+	    xdp_rxq_info_reg_mem_model(&rq->xdp_rxq, MEM_TYPE_PAGE_SHARED,
+				       NULL)) {
+		netdev_err(adapter->netdev, "failed to register xdp rxq\n");
+		goto err;
+	}
+
 	return 0;
 
 err:
@@ -1901,7 +2004,7 @@ err:
 }
 
 
-static int
+int
 vmxnet3_rq_create_all(struct vmxnet3_adapter *adapter)
 {
 	int i, err = 0;
@@ -2026,6 +2129,121 @@ vmxnet3_msix_tx(int irq, void *data)
 }
 
 
+/*
+ * One run of a napi/<dev>-<queue> kthread ("napi-threaded" private flag).
+ * vmxnet3_napi_schedule() has already claimed rq->napi and the vector is
+ * masked; keep calling the regular poll routine, which unmasks the vector
+ * once it completes NAPI, for as long as it uses its whole budget.
+ */
+static void
+vmxnet3_napi_thread_poll(struct vmxnet3_rx_queue *rq)
+{
+	struct napi_struct *napi = &rq->napi;
+	int rxd_done;
+	void *have;
+
+	do {
+		local_bh_disable();
+		have = netpoll_poll_lock(napi);
+		rxd_done = napi->poll(napi, napi->weight);
+		if (rxd_done == napi->weight) {
+			if (unlikely(napi_disable_pending(napi))) {
+				/* vmxnet3_quiesce_dev() waits for NAPI */
+				napi_complete(napi);
+				rxd_done = 0;
+			} else {
+				/* LRO and GRO packets must not wait on us */
+				napi_gro_flush(napi, HZ >= 1000);
+			}
+		}
+		netpoll_poll_unlock(have);
+		local_bh_enable();
+		cond_resched();
+	} while (rxd_done == napi->weight);
+}
+
+
+static int
+vmxnet3_napi_thread(void *data)
+{
+	struct vmxnet3_rx_queue *rq = data;
+
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (test_and_clear_bit(0, &rq->napi_thread_kick)) {
+			__set_current_state(TASK_RUNNING);
+			vmxnet3_napi_thread_poll(rq);
+		} else if (!kthread_should_stop()) {
+			schedule();
+		}
+	}
+	__set_current_state(TASK_RUNNING);
+
+	return 0;
+}
+
+
+static void
+vmxnet3_napi_schedule(struct vmxnet3_rx_queue *rq)
+{
+	struct task_struct *thread = READ_ONCE(rq->napi_thread);
+
+	if (!thread) {
+		napi_schedule(&rq->napi);
+		return;
+	}
+
+	if (napi_schedule_prep(&rq->napi)) {
+		set_bit(0, &rq->napi_thread_kick);
+		wake_up_process(thread);
+	}
+}
+
+
+/* A queue whose thread fails to start keeps using the softirq. */
+static void
+vmxnet3_napi_threads_start(struct vmxnet3_adapter *adapter)
+{
+	int i;
+
+	if (!adapter->napi_threaded)
+		return;
+
+	for (i = 0; i < adapter->num_rx_queues; i++) {
+		struct vmxnet3_rx_queue *rq = &adapter->rx_queue[i];
+		struct task_struct *thread;
+
+		thread = kthread_run(vmxnet3_napi_thread, rq, "napi/%s-%d",
+				     adapter->netdev->name, i);
+		if (IS_ERR(thread)) {
+			netdev_warn(adapter->netdev,
+				    "Failed to start NAPI thread for rx queue %d\n",
+				    i);
+			continue;
+		}
+		WRITE_ONCE(rq->napi_thread, thread);
+	}
+}
+
+
+/* NAPI must be disabled already, so nothing can kick the threads. */
+static void
+vmxnet3_napi_threads_stop(struct vmxnet3_adapter *adapter)
+{
+	int i;
+
+	for (i = 0; i < VMXNET3_DEVICE_MAX_RX_QUEUES; i++) {
+		struct vmxnet3_rx_queue *rq = &adapter->rx_queue[i];
+
+		if (!rq->napi_thread)
+			continue;
+		kthread_stop(rq->napi_thread);
+		WRITE_ONCE(rq->napi_thread, NULL);
+		clear_bit(0, &rq->napi_thread_kick);
+	}
+}
+
+
 /*
  * Handle completion interrupts on rx queues. Returns whether or not the
  * intr is handled
@@ -2040,7 +2258,7 @@ vmxnet3_msix_rx(int irq, void *data)
 	/* disable intr if needed */
 	if (adapter->intr.mask_mode == VMXNET3_IMM_ACTIVE)
 		vmxnet3_disable_intr(adapter, rq->comp_ring.intr_idx);
-	napi_schedule(&rq->napi);
+	vmxnet3_napi_schedule(rq);
 
 	return IRQ_HANDLED;
 }
@@ -2098,7 +2316,7 @@ vmxnet3_intr(int irq, void *dev_id)
 	if (adapter->intr.mask_mode == VMXNET3_IMM_ACTIVE)
 		vmxnet3_disable_all_intrs(adapter);
 
-	napi_schedule(&adapter->rx_queue[0].napi);
+	vmxnet3_napi_schedule(&adapter->rx_queue[0]);
 
 	return IRQ_HANDLED;
 }
@@ -2231,9 +2449,6 @@ vmxnet3_request_irqs(struct vmxnet3_adapter *adapter)
 			rq->dataRingQid = i + 2 * adapter->num_rx_queues;
 		}
 
-		/* init our intr settings */
-		for (i = 0; i < intr->num_intrs; i++)
-			intr->mod_levels[i] = UPT1_IML_ADAPTIVE;
 		if (adapter->intr.type != VMXNET3_IT_MSIX) {
 			adapter->intr.event_intr_idx = 0;
 			for (i = 0; i < adapter->num_tx_queues; i++)
@@ -2587,15 +2802,43 @@ vmxnet3_setup_driver_shared(struct vmxnet3_adapter *adapter)
 
 #endif /* VMXNET3_RSS */
 
-	/* intr settings */
-	devRead->intrConf.autoMask = adapter->intr.mask_mode ==
-				     VMXNET3_IMM_AUTO;
-	devRead->intrConf.numIntrs = adapter->intr.num_intrs;
+	/* intr settings; the rx queues' vectors are only known once the irqs
+	 * have been requested, so their per-queue levels are mapped here
+	 */
 	for (i = 0; i < adapter->intr.num_intrs; i++)
-		devRead->intrConf.modLevels[i] = adapter->intr.mod_levels[i];
+		adapter->intr.mod_levels[i] = UPT1_IML_ADAPTIVE;
+	for (i = 0; i < adapter->num_rx_queues; i++) {
+		struct vmxnet3_rx_queue *rq = &adapter->rx_queue[i];
+
+		adapter->intr.mod_levels[rq->comp_ring.intr_idx] =
+			rq->mod_level;
+	}
 
-	devRead->intrConf.eventIntrIdx = adapter->intr.event_intr_idx;
-	devRead->intrConf.intrCtrl |= cpu_to_le32(VMXNET3_IC_DISABLE_ALL);
+	if (!adapter->queuesExtEnabled) {
+		devRead->intrConf.autoMask = adapter->intr.mask_mode ==
+					     VMXNET3_IMM_AUTO;
+		devRead->intrConf.numIntrs = adapter->intr.num_intrs;
+		for (i = 0; i < adapter->intr.num_intrs; i++)
+			devRead->intrConf.modLevels[i] =
+				adapter->intr.mod_levels[i];
+
+		devRead->intrConf.eventIntrIdx = adapter->intr.event_intr_idx;
+		devRead->intrConf.intrCtrl |=
+			cpu_to_le32(VMXNET3_IC_DISABLE_ALL);
+	} else {
+		struct Vmxnet3_IntrConfExt *intrConfExt =
+			&shared->devReadExt.intrConfExt;
+
+		intrConfExt->autoMask = adapter->intr.mask_mode ==
+					VMXNET3_IMM_AUTO;
+		intrConfExt->numIntrs = adapter->intr.num_intrs;
+		for (i = 0; i < adapter->intr.num_intrs; i++)
+			intrConfExt->modLevels[i] =
+				adapter->intr.mod_levels[i];
+
+		intrConfExt->eventIntrIdx = adapter->intr.event_intr_idx;
+		intrConfExt->intrCtrl |= cpu_to_le32(VMXNET3_IC_DISABLE_ALL);
+	}
 
 	/* rx filter settings */
 	devRead->rxFilterConf.rxMode = 0;
@@ -2605,6 +2848,31 @@ vmxnet3_setup_driver_shared(struct vmxnet3_adapter *adapter)
 	/* the rest are already zeroed */
 }
 
+/*
+ * Push intr.mod_levels to the device. Used when the per-vector
+ * moderation levels change while the device is active.
+ */
+void
+vmxnet3_update_iml(struct vmxnet3_adapter *adapter)
+{
+	struct Vmxnet3_DriverShared *shared = adapter->shared;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&adapter->cmd_lock, flags);
+	for (i = 0; i < adapter->intr.num_intrs; i++) {
+		if (!adapter->queuesExtEnabled)
+			shared->devRead.intrConf.modLevels[i] =
+				adapter->intr.mod_levels[i];
+		else
+			shared->devReadExt.intrConfExt.modLevels[i] =
+				adapter->intr.mod_levels[i];
+	}
+	VMXNET3_WRITE_BAR1_REG(adapter, VMXNET3_REG_CMD,
+			       VMXNET3_CMD_UPDATE_IML);
+	spin_unlock_irqrestore(&adapter->cmd_lock, flags);
+}
+
 static void
 vmxnet3_init_coalesce(struct vmxnet3_adapter *adapter)
 {
@@ -2881,7 +3149,7 @@ vmxnet3_free_pci_resources(struct vmxnet3_adapter *adapter)
 }
 
 
-static void
+void
 vmxnet3_adjust_rx_ring_size(struct vmxnet3_adapter *adapter)
 {
 	size_t sz, i, ring0_size, ring1_size, comp_size;
@@ -3037,6 +3305,7 @@ vmxnet3_open(struct net_device *netdev)
 	if (err)
 		goto activate_err;
 
+	vmxnet3_napi_threads_start(adapter);
 	return 0;
 
 activate_err:
@@ -3060,6 +3329,7 @@ vmxnet3_close(struct net_device *netdev)
 		usleep_range(1000, 2000);
 
 	vmxnet3_quiesce_dev(adapter);
+	vmxnet3_napi_threads_stop(adapter);
 
 	vmxnet3_rq_destroy_all(adapter);
 	vmxnet3_tq_destroy_all(adapter);
@@ -3100,6 +3370,12 @@ vmxnet3_change_mtu(struct net_device *netdev, int new_mtu)
 	struct vmxnet3_adapter *adapter = netdev_priv(netdev);
 	int err = 0;
 
+	if (vmxnet3_xdp_enabled(adapter) && new_mtu > VMXNET3_XDP_MAX_MTU) {
+		netdev_err(netdev, "MTU %d too large for XDP, max %d\n",
+			   new_mtu, VMXNET3_XDP_MAX_MTU);
+		return -EINVAL;
+	}
+
 	netdev->mtu = new_mtu;
 
 	/*
@@ -3375,6 +3651,8 @@ vmxnet3_probe_device(struct pci_dev *pdev,
 		.ndo_set_rx_mode = vmxnet3_set_mc,
 		.ndo_vlan_rx_add_vid = vmxnet3_vlan_rx_add_vid,
 		.ndo_vlan_rx_kill_vid = vmxnet3_vlan_rx_kill_vid,
+		.ndo_bpf = vmxnet3_xdp,
+		.ndo_xdp_xmit = vmxnet3_xdp_xmit,
 #ifdef CONFIG_NET_POLL_CONTROLLER
 		.ndo_poll_controller = vmxnet3_netpoll,
 #endif
@@ -3388,10 +3666,16 @@ vmxnet3_probe_device(struct pci_dev *pdev,
 	int size;
 	int num_tx_queues;
 	int num_rx_queues;
+	unsigned long flags;
+	u32 queues;
+	int i;
 
 	if (!pci_msi_enabled())
 		enable_mq = 0;
 
+	/* Upper bounds only; trimmed to what the device supports once the
+	 * revision is known.
+	 */
 #ifdef VMXNET3_RSS
 	if (enable_mq)
 		num_rx_queues = min(VMXNET3_DEVICE_MAX_RX_QUEUES,
@@ -3399,7 +3683,6 @@ vmxnet3_probe_device(struct pci_dev *pdev,
 	else
 #endif
 		num_rx_queues = 1;
-	num_rx_queues = rounddown_pow_of_two(num_rx_queues);
 
 	if (enable_mq)
 		num_tx_queues = min(VMXNET3_DEVICE_MAX_TX_QUEUES,
@@ -3407,13 +3690,8 @@ vmxnet3_probe_device(struct pci_dev *pdev,
 	else
 		num_tx_queues = 1;
 
-	num_tx_queues = rounddown_pow_of_two(num_tx_queues);
 	netdev = alloc_etherdev_mq(sizeof(struct vmxnet3_adapter),
 				   max(num_tx_queues, num_rx_queues));
-	dev_info(&pdev->dev,
-		 "# of Tx queues : %d, # of Rx queues : %d\n",
-		 num_tx_queues, num_rx_queues);
-
 	if (!netdev)
 		return -ENOMEM;
 
@@ -3463,24 +3741,6 @@ vmxnet3_probe_device(struct pci_dev *pdev,
 		goto err_alloc_shared;
 	}
 
-	adapter->num_rx_queues = num_rx_queues;
-	adapter->num_tx_queues = num_tx_queues;
-	adapter->rx_buf_per_pkt = 1;
-
-	size = sizeof(struct Vmxnet3_TxQueueDesc) * adapter->num_tx_queues;
-	size += sizeof(struct Vmxnet3_RxQueueDesc) * adapter->num_rx_queues;
-	adapter->tqd_start = dma_alloc_coherent(&adapter->pdev->dev, size,
-						&adapter->queue_desc_pa,
-						GFP_KERNEL);
-
-	if (!adapter->tqd_start) {
-		dev_err(&pdev->dev, "Failed to allocate memory\n");
-		err = -ENOMEM;
-		goto err_alloc_queue_desc;
-	}
-	adapter->rqd_start = (struct Vmxnet3_RxQueueDesc *)(adapter->tqd_start +
-							    adapter->num_tx_queues);
-
 	adapter->pm_conf = dma_alloc_coherent(&adapter->pdev->dev,
 					      sizeof(struct Vmxnet3_PMConf),
 					      &adapter->pm_conf_pa,
@@ -3507,7 +3767,17 @@ vmxnet3_probe_device(struct pci_dev *pdev,
 		goto err_alloc_pci;
 
 	ver = VMXNET3_READ_BAR1_REG(adapter, VMXNET3_REG_VRRS);
-	if (ver & (1 << VMXNET3_REV_4)) {
+	if (ver & (1 << VMXNET3_REV_6)) {
+		VMXNET3_WRITE_BAR1_REG(adapter,
+				       VMXNET3_REG_VRRS,
+				       1 << VMXNET3_REV_6);
+		adapter->version = VMXNET3_REV_6 + 1;
+	} else if (ver & (1 << VMXNET3_REV_5)) {
+		VMXNET3_WRITE_BAR1_REG(adapter,
+				       VMXNET3_REG_VRRS,
+				       1 << VMXNET3_REV_5);
+		adapter->version = VMXNET3_REV_5 + 1;
+	} else if (ver & (1 << VMXNET3_REV_4)) {
 		VMXNET3_WRITE_BAR1_REG(adapter,
 				       VMXNET3_REG_VRRS,
 				       1 << VMXNET3_REV_4);
@@ -3545,6 +3815,62 @@ vmxnet3_probe_device(struct pci_dev *pdev,
 		goto err_ver;
 	}
 
+	if (VMXNET3_VERSION_GE_6(adapter)) {
+		/* The device reports how many queues it can back; the counts
+		 * no longer need to be powers of 2.
+		 */
+		spin_lock_irqsave(&adapter->cmd_lock, flags);
+		VMXNET3_WRITE_BAR1_REG(adapter, VMXNET3_REG_CMD,
+				       VMXNET3_CMD_GET_MAX_QUEUES_CONF);
+		queues = VMXNET3_READ_BAR1_REG(adapter, VMXNET3_REG_CMD);
+		spin_unlock_irqrestore(&adapter->cmd_lock, flags);
+		if (queues > 0) {
+			num_rx_queues = min(num_rx_queues,
+					    (int)((queues >> 8) & 0xff));
+			num_tx_queues = min(num_tx_queues,
+					    (int)(queues & 0xff));
+		} else {
+			num_rx_queues = min(num_rx_queues,
+					    VMXNET3_DEVICE_DEFAULT_RX_QUEUES);
+			num_tx_queues = min(num_tx_queues,
+					    VMXNET3_DEVICE_DEFAULT_TX_QUEUES);
+		}
+		num_rx_queues = max(num_rx_queues, 1);
+		num_tx_queues = max(num_tx_queues, 1);
+		adapter->queuesExtEnabled =
+			num_rx_queues > VMXNET3_MAX_RX_QUEUES ||
+			num_tx_queues > VMXNET3_MAX_TX_QUEUES;
+	} else {
+		num_rx_queues = rounddown_pow_of_two(
+			min(num_rx_queues, VMXNET3_DEVICE_DEFAULT_RX_QUEUES));
+		num_tx_queues = rounddown_pow_of_two(
+			min(num_tx_queues, VMXNET3_DEVICE_DEFAULT_TX_QUEUES));
+		adapter->queuesExtEnabled = false;
+	}
+	dev_info(&pdev->dev,
+		 "# of Tx queues : %d, # of Rx queues : %d\n",
+		 num_tx_queues, num_rx_queues);
+
+	adapter->num_rx_queues = num_rx_queues;
+	adapter->num_tx_queues = num_tx_queues;
+	adapter->rx_buf_per_pkt = 1;
+
+	size = sizeof(struct Vmxnet3_TxQueueDesc) * adapter->num_tx_queues;
+	size += sizeof(struct Vmxnet3_RxQueueDesc) * adapter->num_rx_queues;
+	adapter->tqd_start = dma_alloc_coherent(&adapter->pdev->dev, size,
+						&adapter->queue_desc_pa,
+						GFP_KERNEL);
+
+	if (!adapter->tqd_start) {
+		dev_err(&pdev->dev, "Failed to allocate memory\n");
+		err = -ENOMEM;
+		goto err_ver;
+	}
+	/* num_rx_queues may shrink later on, remember what we allocated */
+	adapter->queue_desc_len = size;
+	adapter->rqd_start = (struct Vmxnet3_RxQueueDesc *)(adapter->tqd_start +
+							    adapter->num_tx_queues);
+
 	if (VMXNET3_VERSION_GE_3(adapter)) {
 		adapter->coal_conf =
 			dma_alloc_coherent(&adapter->pdev->dev,
@@ -3554,7 +3880,7 @@ vmxnet3_probe_device(struct pci_dev *pdev,
 					   GFP_KERNEL);
 		if (!adapter->coal_conf) {
 			err = -ENOMEM;
-			goto err_ver;
+			goto err_coal_conf;
 		}
 		adapter->coal_conf->coalMode = VMXNET3_COALESCE_DISABLED;
 		adapter->default_coal_mode = true;
@@ -3576,6 +3902,9 @@ vmxnet3_probe_device(struct pci_dev *pdev,
 	else
 		adapter->share_intr = VMXNET3_INTR_DONTSHARE;
 
+	for (i = 0; i < VMXNET3_DEVICE_MAX_RX_QUEUES; i++)
+		adapter->rx_queue[i].mod_level = UPT1_IML_ADAPTIVE;
+
 	vmxnet3_alloc_intr_resources(adapter);
 
 #ifdef VMXNET3_RSS
@@ -3597,9 +3926,12 @@ vmxnet3_probe_device(struct pci_dev *pdev,
 	vmxnet3_set_ethtool_ops(netdev);
 	netdev->watchdog_timeo = 5 * HZ;
 
-	/* MTU range: 60 - 9000 */
+	/* MTU range: 60 - 9000, 60 - 9190 from revision 6 on */
 	netdev->min_mtu = VMXNET3_MIN_MTU;
-	netdev->max_mtu = VMXNET3_MAX_MTU;
+	if (VMXNET3_VERSION_GE_6(adapter))
+		netdev->max_mtu = VMXNET3_V6_MAX_MTU;
+	else
+		netdev->max_mtu = VMXNET3_MAX_MTU;
 
 	INIT_WORK(&adapter->work, vmxnet3_reset_work);
 	set_bit(VMXNET3_STATE_BIT_QUIESCED, &adapter->state);
@@ -3637,6 +3969,9 @@ err_register:
 				  adapter->coal_conf, adapter->coal_conf_pa);
 	}
 	vmxnet3_free_intr_resources(adapter);
+err_coal_conf:
+	dma_free_coherent(&adapter->pdev->dev, adapter->queue_desc_len,
+			  adapter->tqd_start, adapter->queue_desc_pa);
 err_ver:
 	vmxnet3_free_pci_resources(adapter);
 err_alloc_pci:
@@ -3648,9 +3983,6 @@ err_alloc_rss:
 	dma_free_coherent(&adapter->pdev->dev, sizeof(struct Vmxnet3_PMConf),
 			  adapter->pm_conf, adapter->pm_conf_pa);
 err_alloc_pm:
-	dma_free_coherent(&adapter->pdev->dev, size, adapter->tqd_start,
-			  adapter->queue_desc_pa);
-err_alloc_queue_desc:
 	dma_free_coherent(&adapter->pdev->dev,
 			  sizeof(struct Vmxnet3_DriverShared),
 			  adapter->shared, adapter->shared_pa);
@@ -3668,17 +4000,6 @@ vmxnet3_remove_device(struct pci_dev *pdev)
 {
 	struct net_device *netdev = pci_get_drvdata(pdev);
 	struct vmxnet3_adapter *adapter = netdev_priv(netdev);
-	int size = 0;
-	int num_rx_queues;
-
-#ifdef VMXNET3_RSS
-	if (enable_mq)
-		num_rx_queues = min(VMXNET3_DEVICE_MAX_RX_QUEUES,
-				    (int)num_online_cpus());
-	else
-#endif
-		num_rx_queues = 1;
-	num_rx_queues = rounddown_pow_of_two(num_rx_queues);
 
 	cancel_work_sync(&adapter->work);
 
@@ -3698,10 +4019,8 @@ vmxnet3_remove_device(struct pci_dev *pdev)
 	dma_free_coherent(&adapter->pdev->dev, sizeof(struct Vmxnet3_PMConf),
 			  adapter->pm_conf, adapter->pm_conf_pa);
 
-	size = sizeof(struct Vmxnet3_TxQueueDesc) * adapter->num_tx_queues;
-	size += sizeof(struct Vmxnet3_RxQueueDesc) * num_rx_queues;
-	dma_free_coherent(&adapter->pdev->dev, size, adapter->tqd_start,
-			  adapter->queue_desc_pa);
+	dma_free_coherent(&adapter->pdev->dev, adapter->queue_desc_len,
+			  adapter->tqd_start, adapter->queue_desc_pa);
 	dma_free_coherent(&adapter->pdev->dev,
 			  sizeof(struct Vmxnet3_DriverShared),
 			  adapter->shared, adapter->shared_pa);
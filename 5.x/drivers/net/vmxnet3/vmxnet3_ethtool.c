@@ -26,6 +26,7 @@
 
 
 #include "vmxnet3_int.h"
+#include "vmxnet3_xdp.h"
 #include <net/vxlan.h>
 #include <net/geneve.h>
 
@@ -36,6 +37,12 @@ struct vmxnet3_stat_desc {
 	int  offset;
 };
 
+static const char vmxnet3_priv_flags[][ETH_GSTRING_LEN] = {
+	"napi-threaded",	/* poll rx queues from per-queue kthreads */
+};
+
+#define VMXNET3_PRIV_FLAG_NAPI_THREADED	BIT(0)
+
 
 /* per tq stats maintained by the device */
 static const struct vmxnet3_stat_desc
@@ -76,6 +83,10 @@ vmxnet3_tq_driver_stats[] = {
 					 copy_skb_header) },
 	{ "  giant hdr",	offsetof(struct vmxnet3_tq_driver_stats,
 					 oversized_hdr) },
+	{ "  xdp xmit",		offsetof(struct vmxnet3_tq_driver_stats,
+					 xdp_xmit) },
+	{ "  xdp xmit err",	offsetof(struct vmxnet3_tq_driver_stats,
+					 xdp_xmit_err) },
 };
 
 /* per rq stats maintained by the device */
@@ -106,6 +117,16 @@ vmxnet3_rq_driver_stats[] = {
 					 drop_fcs) },
 	{ "  rx buf alloc fail", offsetof(struct vmxnet3_rq_driver_stats,
 					  rx_buf_alloc_failure) },
+	{ "     xdp packets",	offsetof(struct vmxnet3_rq_driver_stats,
+					 xdp_packets) },
+	{ "     xdp tx",	offsetof(struct vmxnet3_rq_driver_stats,
+					 xdp_tx) },
+	{ "     xdp redirects",	offsetof(struct vmxnet3_rq_driver_stats,
+					 xdp_redirects) },
+	{ "     xdp drops",	offsetof(struct vmxnet3_rq_driver_stats,
+					 xdp_drops) },
+	{ "     xdp aborted",	offsetof(struct vmxnet3_rq_driver_stats,
+					 xdp_aborted) },
 };
 
 /* global stats maintained by the driver */
@@ -179,6 +200,8 @@ vmxnet3_get_sset_count(struct net_device *netdev, int sset)
 			ARRAY_SIZE(vmxnet3_rq_driver_stats)) *
 		       adapter->num_rx_queues +
 			ARRAY_SIZE(vmxnet3_global_stats);
+	case ETH_SS_PRIV_FLAGS:
+		return ARRAY_SIZE(vmxnet3_priv_flags);
 	default:
 		return -EOPNOTSUPP;
 	}
@@ -258,16 +281,49 @@ vmxnet3_get_strings(struct net_device *netdev, u32 stringset, u8 *buf)
 				ETH_GSTRING_LEN);
 			buf += ETH_GSTRING_LEN;
 		}
+	} else if (stringset == ETH_SS_PRIV_FLAGS) {
+		memcpy(buf, vmxnet3_priv_flags, sizeof(vmxnet3_priv_flags));
 	}
 }
 
+static u32
+vmxnet3_get_priv_flags(struct net_device *netdev)
+{
+	struct vmxnet3_adapter *adapter = netdev_priv(netdev);
+
+	return adapter->napi_threaded ? VMXNET3_PRIV_FLAG_NAPI_THREADED : 0;
+}
+
+static int
+vmxnet3_set_priv_flags(struct net_device *netdev, u32 flags)
+{
+	struct vmxnet3_adapter *adapter = netdev_priv(netdev);
+	bool threaded = !!(flags & VMXNET3_PRIV_FLAG_NAPI_THREADED);
+
+	if (threaded == adapter->napi_threaded)
+		return 0;
+
+	/* The poll threads come and go with the interface */
+	if (netif_running(netdev))
+		return -EBUSY;
+
+	adapter->napi_threaded = threaded;
+	return 0;
+}
+
 netdev_features_t vmxnet3_fix_features(struct net_device *netdev,
 				       netdev_features_t features)
 {
+	struct vmxnet3_adapter *adapter = netdev_priv(netdev);
+
 	/* If Rx checksum is disabled, then LRO should also be disabled */
 	if (!(features & NETIF_F_RXCSUM))
 		features &= ~NETIF_F_LRO;
 
+	/* XDP programs see one frame per buffer, never an LRO aggregate */
+	if (vmxnet3_xdp_enabled(adapter))
+		features &= ~NETIF_F_LRO;
+
 	return features;
 }
 
@@ -1183,6 +1239,58 @@ done:
 	return 0;
 }
 
+/*
+ * Per-queue coalescing drives the moderation level of the interrupt
+ * vector backing an rx queue: adaptive moderation or none at all.
+ * Queues sharing a vector share the setting.
+ */
+static int
+vmxnet3_get_per_queue_coalesce(struct net_device *netdev, u32 queue,
+			       struct ethtool_coalesce *ec)
+{
+	struct vmxnet3_adapter *adapter = netdev_priv(netdev);
+
+	if (queue >= adapter->num_rx_queues)
+		return -EINVAL;
+
+	ec->use_adaptive_rx_coalesce =
+		adapter->rx_queue[queue].mod_level == UPT1_IML_ADAPTIVE;
+
+	return 0;
+}
+
+static int
+vmxnet3_set_per_queue_coalesce(struct net_device *netdev, u32 queue,
+			       struct ethtool_coalesce *ec)
+{
+	struct vmxnet3_adapter *adapter = netdev_priv(netdev);
+	struct vmxnet3_rx_queue *rq;
+
+	if (queue >= adapter->num_rx_queues)
+		return -EINVAL;
+
+	/* Only the adaptive on/off knob exists per vector */
+	if ((ec->rx_coalesce_usecs != 0) ||
+	    (ec->tx_max_coalesced_frames != 0) ||
+	    (ec->rx_max_coalesced_frames != 0))
+		return -EINVAL;
+
+	rq = &adapter->rx_queue[queue];
+	rq->mod_level = ec->use_adaptive_rx_coalesce ?
+			UPT1_IML_ADAPTIVE : UPT1_IML_NONE;
+
+	/* the queue has no vector until the device is activated, which
+	 * then picks up rq->mod_level in vmxnet3_setup_driver_shared()
+	 */
+	if (netif_running(netdev)) {
+		adapter->intr.mod_levels[rq->comp_ring.intr_idx] =
+			rq->mod_level;
+		vmxnet3_update_iml(adapter);
+	}
+
+	return 0;
+}
+
 static const struct ethtool_ops vmxnet3_ethtool_ops = {
 	.supported_coalesce_params = ETHTOOL_COALESCE_RX_USECS |
 				     ETHTOOL_COALESCE_MAX_FRAMES |
@@ -1195,8 +1303,12 @@ static const struct ethtool_ops vmxnet3_ethtool_ops = {
 	.get_link          = ethtool_op_get_link,
 	.get_coalesce      = vmxnet3_get_coalesce,
 	.set_coalesce      = vmxnet3_set_coalesce,
+	.get_per_queue_coalesce = vmxnet3_get_per_queue_coalesce,
+	.set_per_queue_coalesce = vmxnet3_set_per_queue_coalesce,
 	.get_strings       = vmxnet3_get_strings,
 	.get_sset_count	   = vmxnet3_get_sset_count,
+	.get_priv_flags    = vmxnet3_get_priv_flags,
+	.set_priv_flags    = vmxnet3_set_priv_flags,
 	.get_ethtool_stats = vmxnet3_get_ethtool_stats,
 	.get_ringparam     = vmxnet3_get_ringparam,
 	.set_ringparam     = vmxnet3_set_ringparam,
@@ -56,6 +56,7 @@
 #include <linux/if_arp.h>
 #include <linux/inetdevice.h>
 #include <linux/log2.h>
+#include <net/xdp.h>
 
 #include "vmxnet3_defs.h"
 
@@ -81,6 +82,8 @@
 	#define VMXNET3_RSS
 #endif
 
+#define VMXNET3_REV_6		5	/* Vmxnet3 Rev. 6 */
+#define VMXNET3_REV_5		4	/* Vmxnet3 Rev. 5 */
 #define VMXNET3_REV_4		3	/* Vmxnet3 Rev. 4 */
 #define VMXNET3_REV_3		2	/* Vmxnet3 Rev. 3 */
 #define VMXNET3_REV_2		1	/* Vmxnet3 Rev. 2 */
@@ -189,6 +192,7 @@ enum vmxnet3_buf_map_type {
 	VMXNET3_MAP_NONE,
 	VMXNET3_MAP_SINGLE,
 	VMXNET3_MAP_PAGE,
+	VMXNET3_MAP_XDP,	/* single mapping of an xdp_frame */
 };
 
 struct vmxnet3_tx_buf_info {
@@ -196,7 +200,10 @@ struct vmxnet3_tx_buf_info {
 	u16      len;
 	u16      sop_idx;
 	dma_addr_t  dma_addr;
-	struct sk_buff *skb;
+	union {
+		struct sk_buff *skb;
+		struct xdp_frame *xdpf;	/* if map_type is VMXNET3_MAP_XDP */
+	};
 };
 
 struct vmxnet3_tq_driver_stats {
@@ -213,6 +220,9 @@ struct vmxnet3_tq_driver_stats {
 	u64 linearized;         /* # of pkts linearized */
 	u64 copy_skb_header;    /* # of times we have to copy skb header */
 	u64 oversized_hdr;
+
+	u64 xdp_xmit;		/* # of xdp frames queued */
+	u64 xdp_xmit_err;	/* # of xdp frames that could not be queued */
 };
 
 struct vmxnet3_tx_ctx {
@@ -255,7 +265,8 @@ struct vmxnet3_tx_queue {
 enum vmxnet3_rx_buf_type {
 	VMXNET3_RX_BUF_NONE = 0,
 	VMXNET3_RX_BUF_SKB = 1,
-	VMXNET3_RX_BUF_PAGE = 2
+	VMXNET3_RX_BUF_PAGE = 2,
+	VMXNET3_RX_BUF_XDP = 3		/* page with XDP headroom, 1st ring */
 };
 
 struct vmxnet3_rx_buf_info {
@@ -278,6 +289,12 @@ struct vmxnet3_rq_driver_stats {
 	u64 drop_err;
 	u64 drop_fcs;
 	u64 rx_buf_alloc_failure;
+
+	u64 xdp_packets;	/* # of pkts seen by the xdp program */
+	u64 xdp_tx;
+	u64 xdp_redirects;
+	u64 xdp_drops;
+	u64 xdp_aborted;
 };
 
 struct vmxnet3_rx_data_ring {
@@ -301,12 +318,22 @@ struct vmxnet3_rx_queue {
 	dma_addr_t                      buf_info_pa;
 	struct Vmxnet3_RxQueueCtrl            *shared;
 	struct vmxnet3_rq_driver_stats  stats;
+	struct xdp_rxq_info		xdp_rxq;
+	struct page			*xdp_page; /* spare page for data ring
+						    * pkts dropped by xdp */
+	struct task_struct		*napi_thread; /* threaded NAPI poller */
+	unsigned long			napi_thread_kick;
+	u8				mod_level; /* UPT1_IML_* for its vector */
 } __attribute__((__aligned__(SMP_CACHE_BYTES)));
 
-#define VMXNET3_DEVICE_MAX_TX_QUEUES 8
-#define VMXNET3_DEVICE_MAX_RX_QUEUES 8   /* Keep this value as a power of 2 */
+#define VMXNET3_DEVICE_MAX_TX_QUEUES 32
+#define VMXNET3_DEVICE_MAX_RX_QUEUES 32
+
+/* Before version 6 the queue counts must be powers of 2 */
+#define VMXNET3_DEVICE_DEFAULT_TX_QUEUES 8
+#define VMXNET3_DEVICE_DEFAULT_RX_QUEUES 8
 
-/* Should be less than UPT1_RSS_MAX_IND_TABLE_SIZE */
+/* Should be no more than UPT1_RSS_MAX_IND_TABLE_SIZE */
 #define VMXNET3_RSS_IND_TABLE_SIZE (VMXNET3_DEVICE_MAX_RX_QUEUES * 4)
 
 #define VMXNET3_LINUX_MAX_MSIX_VECT     (VMXNET3_DEVICE_MAX_TX_QUEUES + \
@@ -363,6 +390,7 @@ struct vmxnet3_adapter {
 	int		rx_buf_per_pkt;  /* only apply to the 1st ring */
 	dma_addr_t			shared_pa;
 	dma_addr_t queue_desc_pa;
+	u32 queue_desc_len;	/* bytes allocated at tqd_start */
 	dma_addr_t coal_conf_pa;
 
 	/* Wake-on-LAN */
@@ -383,6 +411,8 @@ struct vmxnet3_adapter {
 	u16 rxdata_desc_size;
 
 	bool rxdataring_enabled;
+	bool queuesExtEnabled;	/* intr conf lives in devReadExt */
+	bool napi_threaded;	/* poll rx queues from kthreads */
 	bool default_rss_fields;
 	enum Vmxnet3_RSSField rss_fields;
 
@@ -398,6 +428,8 @@ struct vmxnet3_adapter {
 	dma_addr_t adapter_pa;
 	dma_addr_t pm_conf_pa;
 	dma_addr_t rss_conf_pa;
+
+	struct bpf_prog __rcu *xdp_bpf_prog;
 };
 
 #define VMXNET3_WRITE_BAR0_REG(adapter, reg, val)  \
@@ -423,6 +455,10 @@ struct vmxnet3_adapter {
 	(adapter->version >= VMXNET3_REV_3 + 1)
 #define VMXNET3_VERSION_GE_4(adapter) \
 	(adapter->version >= VMXNET3_REV_4 + 1)
+#define VMXNET3_VERSION_GE_5(adapter) \
+	(adapter->version >= VMXNET3_REV_5 + 1)
+#define VMXNET3_VERSION_GE_6(adapter) \
+	(adapter->version >= VMXNET3_REV_6 + 1)
 
 /* must be a multiple of VMXNET3_RING_SIZE_ALIGN */
 #define VMXNET3_DEF_TX_RING_SIZE    512
@@ -467,6 +503,15 @@ vmxnet3_tq_destroy_all(struct vmxnet3_adapter *adapter);
 void
 vmxnet3_rq_destroy_all(struct vmxnet3_adapter *adapter);
 
+int
+vmxnet3_rq_create_all(struct vmxnet3_adapter *adapter);
+
+void
+vmxnet3_adjust_rx_ring_size(struct vmxnet3_adapter *adapter);
+
+void
+vmxnet3_update_iml(struct vmxnet3_adapter *adapter);
+
 netdev_features_t
 vmxnet3_fix_features(struct net_device *netdev, netdev_features_t features);
 
@@ -0,0 +1,477 @@
+/*
+ * Linux driver for VMware's vmxnet3 ethernet NIC.
+ *
+ * Copyright (C) 2008-2021, VMware, Inc. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; version 2 of the License and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, GOOD TITLE or
+ * NON INFRINGEMENT.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ * Maintained by: pv-drivers@vmware.com
+ *
+ */
+
+
+#include "vmxnet3_xdp.h"
+
+/*
+ * XDP frames share the stack's tx rings; the ring is picked by cpu and
+ * serialized against vmxnet3_tq_xmit() by tx_lock.
+ */
+static struct vmxnet3_tx_queue *
+vmxnet3_xdp_get_tq(struct vmxnet3_adapter *adapter)
+{
+	return &adapter->tx_queue[smp_processor_id() %
+				  adapter->num_tx_queues];
+}
+
+
+static void
+vmxnet3_xdp_tq_kick(struct vmxnet3_adapter *adapter,
+		    struct vmxnet3_tx_queue *tq)
+{
+	if (le32_to_cpu(tq->shared->txNumDeferred)) {
+		tq->shared->txNumDeferred = 0;
+		VMXNET3_WRITE_BAR0_REG(adapter,
+				       VMXNET3_REG_TXPROD + tq->qid * 8,
+				       tq->tx_ring.next2fill);
+	}
+}
+
+
+/*
+ * Queue a single-descriptor frame without any offload. The frame is
+ * handed back through xdp_return_frame() on tx completion.
+ */
+static int
+vmxnet3_xdp_xmit_frame(struct vmxnet3_adapter *adapter,
+		       struct xdp_frame *xdpf,
+		       struct vmxnet3_tx_queue *tq)
+{
+	struct vmxnet3_tx_buf_info *tbi;
+	union Vmxnet3_GenericDesc *gdesc;
+	int tx_num_deferred;
+	unsigned long flags;
+	dma_addr_t dma_addr;
+	u32 dw2;
+
+	/* TxDesc.len of 0 means 2^14 and would need a second desc */
+	if (unlikely(xdpf->len >= VMXNET3_MAX_TX_BUF_SIZE))
+		return -EINVAL;
+
+	dma_addr = dma_map_single(&adapter->pdev->dev, xdpf->data, xdpf->len,
+				  PCI_DMA_TODEVICE);
+	if (dma_mapping_error(&adapter->pdev->dev, dma_addr))
+		return -EFAULT;
+
+	spin_lock_irqsave(&tq->tx_lock, flags);
+
+	if (unlikely(vmxnet3_cmd_ring_desc_avail(&tq->tx_ring) == 0)) {
+		tq->stats.tx_ring_full++;
+		spin_unlock_irqrestore(&tq->tx_lock, flags);
+		dma_unmap_single(&adapter->pdev->dev, dma_addr, xdpf->len,
+				 PCI_DMA_TODEVICE);
+		return -ENOSPC;
+	}
+
+	tbi = tq->buf_info + tq->tx_ring.next2fill;
+	tbi->map_type = VMXNET3_MAP_XDP;
+	tbi->dma_addr = dma_addr;
+	tbi->len = xdpf->len;
+	tbi->xdpf = xdpf;
+	tbi->sop_idx = tq->tx_ring.next2fill;
+
+	/* use the previous gen bit until the desc is complete */
+	dw2 = (tq->tx_ring.gen ^ 0x1) << VMXNET3_TXD_GEN_SHIFT;
+	dw2 |= xdpf->len;
+
+	gdesc = tq->tx_ring.base + tq->tx_ring.next2fill;
+	gdesc->txd.addr = cpu_to_le64(dma_addr);
+	gdesc->dword[2] = cpu_to_le32(dw2);
+	gdesc->dword[3] = cpu_to_le32(VMXNET3_TXD_CQ | VMXNET3_TXD_EOP);
+	vmxnet3_cmd_ring_adv_next2fill(&tq->tx_ring);
+
+	tx_num_deferred = le32_to_cpu(tq->shared->txNumDeferred);
+	le32_add_cpu(&tq->shared->txNumDeferred, 1);
+	tx_num_deferred++;
+	tq->stats.xdp_xmit++;
+
+	/* Ensure that the write to (&gdesc->txd)->gen will be observed after
+	 * all other writes to &gdesc->txd.
+	 */
+	dma_wmb();
+	gdesc->dword[2] = cpu_to_le32(dw2 ^ VMXNET3_TXD_GEN);
+
+	spin_unlock_irqrestore(&tq->tx_lock, flags);
+
+	if (tx_num_deferred >= le32_to_cpu(tq->shared->txThreshold))
+		vmxnet3_xdp_tq_kick(adapter, tq);
+
+	return 0;
+}
+
+
+int
+vmxnet3_xdp_xmit(struct net_device *netdev, int n, struct xdp_frame **frames,
+		 u32 flags)
+{
+	struct vmxnet3_adapter *adapter = netdev_priv(netdev);
+	struct vmxnet3_tx_queue *tq;
+	int i, drops = 0;
+
+	if (unlikely(flags & ~XDP_XMIT_FLAGS_MASK))
+		return -EINVAL;
+
+	if (unlikely(test_bit(VMXNET3_STATE_BIT_QUIESCED, &adapter->state) ||
+		     !netif_carrier_ok(netdev)))
+		return -ENETDOWN;
+
+	tq = vmxnet3_xdp_get_tq(adapter);
+	for (i = 0; i < n; i++) {
+		if (vmxnet3_xdp_xmit_frame(adapter, frames[i], tq)) {
+			xdp_return_frame_rx_napi(frames[i]);
+			drops++;
+		}
+	}
+
+	tq->stats.xdp_xmit_err += drops;
+
+	if (flags & XDP_XMIT_FLUSH)
+		vmxnet3_xdp_tq_kick(adapter, tq);
+
+	return n - drops;
+}
+
+
+static int
+vmxnet3_xdp_set(struct net_device *netdev, struct netdev_bpf *bpf)
+{
+	struct vmxnet3_adapter *adapter = netdev_priv(netdev);
+	struct bpf_prog *new_prog = bpf->prog;
+	struct bpf_prog *old_prog;
+	bool need_reset;
+	int err = 0;
+
+	BUILD_BUG_ON(VMXNET3_XDP_HEADROOM + VMXNET3_MAX_SKB_BUF_SIZE +
+		     SKB_DATA_ALIGN(sizeof(struct skb_shared_info)) >
+		     PAGE_SIZE);
+
+	if (new_prog && netdev->mtu > VMXNET3_XDP_MAX_MTU) {
+		NL_SET_ERR_MSG_MOD(bpf->extack, "MTU too large for XDP");
+		return -EOPNOTSUPP;
+	}
+
+	old_prog = rtnl_dereference(adapter->xdp_bpf_prog);
+
+	/* the 1st ring only changes buffer type when XDP is toggled */
+	need_reset = netif_running(netdev) && (!old_prog != !new_prog);
+	if (need_reset) {
+		/*
+		 * Reset_work may be in the middle of resetting the device,
+		 * wait for its completion.
+		 */
+		while (test_and_set_bit(VMXNET3_STATE_BIT_RESETTING,
+					&adapter->state))
+			usleep_range(1000, 2000);
+
+		vmxnet3_quiesce_dev(adapter);
+		vmxnet3_reset_dev(adapter);
+	}
+
+	rcu_assign_pointer(adapter->xdp_bpf_prog, new_prog);
+	if (old_prog)
+		bpf_prog_put(old_prog);
+
+	/* LRO has to go while a program is attached */
+	netdev_update_features(netdev);
+
+	if (!need_reset)
+		return 0;
+
+	vmxnet3_rq_destroy_all(adapter);
+	vmxnet3_adjust_rx_ring_size(adapter);
+	err = vmxnet3_rq_create_all(adapter);
+	if (err) {
+		NL_SET_ERR_MSG_MOD(bpf->extack,
+				   "failed to re-create rx queues for XDP");
+		goto out;
+	}
+
+	err = vmxnet3_activate_dev(adapter);
+	if (err)
+		NL_SET_ERR_MSG_MOD(bpf->extack,
+				   "failed to re-activate device for XDP");
+
+out:
+	clear_bit(VMXNET3_STATE_BIT_RESETTING, &adapter->state);
+	if (err)
+		vmxnet3_force_close(adapter);
+
+	return err;
+}
+
+
+int
+vmxnet3_xdp(struct net_device *netdev, struct netdev_bpf *bpf)
+{
+	switch (bpf->command) {
+	case XDP_SETUP_PROG:
+		return vmxnet3_xdp_set(netdev, bpf);
+	default:
+		return -EINVAL;
+	}
+}
+
+
+/*
+ * Allocate and map a 1st ring buffer for XDP mode. The device writes
+ * behind VMXNET3_XDP_HEADROOM so the program can push headers.
+ */
+struct page *
+vmxnet3_xdp_alloc_page(struct vmxnet3_adapter *adapter, u16 len,
+		       dma_addr_t *dma_addr, gfp_t gfp)
+{
+	struct page *page;
+
+	page = alloc_page(gfp);
+	if (unlikely(!page))
+		return NULL;
+
+	*dma_addr = dma_map_page(&adapter->pdev->dev, page,
+				 VMXNET3_XDP_HEADROOM, len,
+				 PCI_DMA_FROMDEVICE);
+	if (dma_mapping_error(&adapter->pdev->dev, *dma_addr)) {
+		put_page(page);
+		return NULL;
+	}
+
+	return page;
+}
+
+
+static void
+vmxnet3_xdp_prepare_buff(struct xdp_buff *xdp, struct vmxnet3_rx_queue *rq,
+			 struct page *page, u16 len)
+{
+	xdp->data_hard_start = page_address(page);
+	xdp->data = xdp->data_hard_start + VMXNET3_XDP_HEADROOM;
+	xdp->data_end = xdp->data + len;
+	xdp_set_data_meta_invalid(xdp);
+	xdp->rxq = &rq->xdp_rxq;
+	xdp->frame_sz = PAGE_SIZE;
+}
+
+
+/*
+ * Run the program and account for its verdict. Anything other than
+ * XDP_PASS, XDP_TX or XDP_REDIRECT is reported as XDP_DROP, in which
+ * case the caller still owns the buffer and may reuse it right away.
+ */
+static u32
+vmxnet3_run_xdp(struct vmxnet3_rx_queue *rq, struct bpf_prog *prog,
+		struct xdp_buff *xdp)
+{
+	u32 act;
+
+	rq->stats.xdp_packets++;
+	act = bpf_prog_run_xdp(prog, xdp);
+	switch (act) {
+	case XDP_PASS:
+	case XDP_TX:
+	case XDP_REDIRECT:
+		return act;
+	default:
+		bpf_warn_invalid_xdp_action(act);
+		fallthrough;
+	case XDP_ABORTED:
+		trace_xdp_exception(rq->adapter->netdev, prog, act);
+		rq->stats.xdp_aborted++;
+		return XDP_DROP;
+	case XDP_DROP:
+		rq->stats.xdp_drops++;
+		return XDP_DROP;
+	}
+}
+
+
+/*
+ * Carry out a PASS, TX or REDIRECT verdict. The page behind @xdp is
+ * unmapped and owned by us; it is passed on or freed here.
+ */
+static int
+vmxnet3_xdp_finish(struct vmxnet3_rx_queue *rq, struct bpf_prog *prog,
+		   struct xdp_buff *xdp, u32 act, struct sk_buff **skb_out)
+{
+	struct vmxnet3_adapter *adapter = rq->adapter;
+	struct xdp_frame *xdpf;
+	struct sk_buff *skb;
+
+	switch (act) {
+	case XDP_PASS:
+		skb = build_skb(xdp->data_hard_start, xdp->frame_sz);
+		if (unlikely(!skb)) {
+			rq->stats.rx_buf_alloc_failure++;
+			rq->stats.drop_total++;
+			break;
+		}
+		/* the program may have moved data and data_end */
+		skb_reserve(skb, xdp->data - xdp->data_hard_start);
+		skb_put(skb, xdp->data_end - xdp->data);
+		*skb_out = skb;
+		return VMXNET3_XDP_PASS;
+	case XDP_TX:
+		xdpf = xdp_convert_buff_to_frame(xdp);
+		if (unlikely(!xdpf) ||
+		    vmxnet3_xdp_xmit_frame(adapter, xdpf,
+					   vmxnet3_xdp_get_tq(adapter))) {
+			rq->stats.xdp_drops++;
+			break;
+		}
+		rq->stats.xdp_tx++;
+		return VMXNET3_XDP_TX;
+	case XDP_REDIRECT:
+		if (xdp_do_redirect(adapter->netdev, xdp, prog)) {
+			rq->stats.xdp_drops++;
+			break;
+		}
+		rq->stats.xdp_redirects++;
+		return VMXNET3_XDP_REDIR;
+	}
+
+	put_page(virt_to_page(xdp->data_hard_start));
+	return VMXNET3_XDP_CONSUMED;
+}
+
+
+/*
+ * Handle a single-buffer pkt in a 1st ring XDP page. On anything but a
+ * drop the page leaves the ring and is replaced right away; if that is
+ * not possible the pkt is dropped and the page stays.
+ */
+int
+vmxnet3_process_xdp(struct vmxnet3_adapter *adapter,
+		    struct vmxnet3_rx_queue *rq,
+		    struct Vmxnet3_RxCompDesc *rcd,
+		    struct vmxnet3_rx_buf_info *rbi,
+		    struct Vmxnet3_RxDesc *rxd,
+		    struct sk_buff **skb_out)
+{
+	struct device *dev = &adapter->pdev->dev;
+	struct bpf_prog *prog;
+	dma_addr_t new_dma_addr;
+	struct page *new_page;
+	struct xdp_buff xdp;
+	u32 act = XDP_PASS;
+	int ret;
+
+	dma_sync_single_for_cpu(dev, rbi->dma_addr, rcd->len,
+				PCI_DMA_FROMDEVICE);
+	vmxnet3_xdp_prepare_buff(&xdp, rq, rbi->page, rcd->len);
+
+	rcu_read_lock();
+	prog = rcu_dereference(adapter->xdp_bpf_prog);
+	if (prog)
+		act = vmxnet3_run_xdp(rq, prog, &xdp);
+	if (act == XDP_DROP)
+		goto reuse;
+
+	new_page = vmxnet3_xdp_alloc_page(adapter, rbi->len, &new_dma_addr,
+					  GFP_ATOMIC);
+	if (unlikely(!new_page)) {
+		rq->stats.rx_buf_alloc_failure++;
+		rq->stats.drop_total++;
+		goto reuse;
+	}
+
+	/* already synced, the program's writes must not be overwritten */
+	dma_unmap_page_attrs(dev, rbi->dma_addr, rbi->len,
+			     PCI_DMA_FROMDEVICE, DMA_ATTR_SKIP_CPU_SYNC);
+
+	/* Immediate refill */
+	rbi->page = new_page;
+	rbi->dma_addr = new_dma_addr;
+	rxd->addr = cpu_to_le64(rbi->dma_addr);
+	rxd->len = rbi->len;
+
+	ret = vmxnet3_xdp_finish(rq, prog, &xdp, act, skb_out);
+	rcu_read_unlock();
+	return ret;
+
+reuse:
+	rcu_read_unlock();
+	dma_sync_single_for_device(dev, rbi->dma_addr, rbi->len,
+				   PCI_DMA_FROMDEVICE);
+	return VMXNET3_XDP_CONSUMED;
+}
+
+
+/*
+ * Handle a pkt the device placed in the rx data ring. The data ring slot
+ * is reused by the device, so the pkt is copied into a page first; pages
+ * of dropped pkts are kept for the next one.
+ */
+int
+vmxnet3_process_xdp_small(struct vmxnet3_adapter *adapter,
+			  struct vmxnet3_rx_queue *rq,
+			  void *data, u16 len,
+			  struct sk_buff **skb_out)
+{
+	struct bpf_prog *prog;
+	struct xdp_buff xdp;
+	struct page *page;
+	u32 act = XDP_PASS;
+	int ret;
+
+	page = rq->xdp_page;
+	rq->xdp_page = NULL;
+	if (!page) {
+		page = alloc_page(GFP_ATOMIC);
+		if (unlikely(!page)) {
+			rq->stats.rx_buf_alloc_failure++;
+			rq->stats.drop_total++;
+			return VMXNET3_XDP_CONSUMED;
+		}
+	}
+
+	vmxnet3_xdp_prepare_buff(&xdp, rq, page, len);
+	memcpy(xdp.data, data, len);
+
+	rcu_read_lock();
+	prog = rcu_dereference(adapter->xdp_bpf_prog);
+	if (prog)
+		act = vmxnet3_run_xdp(rq, prog, &xdp);
+	if (act == XDP_DROP) {
+		rq->xdp_page = page;
+		ret = VMXNET3_XDP_CONSUMED;
+	} else {
+		ret = vmxnet3_xdp_finish(rq, prog, &xdp, act, skb_out);
+	}
+	rcu_read_unlock();
+
+	return ret;
+}
+
+
+/* Flush what a round of vmxnet3_process_xdp*() has queued. */
+void
+vmxnet3_xdp_finalize(struct vmxnet3_adapter *adapter, int xdp_res)
+{
+	if (xdp_res & VMXNET3_XDP_REDIR)
+		xdp_do_flush();
+
+	if (xdp_res & VMXNET3_XDP_TX)
+		vmxnet3_xdp_tq_kick(adapter, vmxnet3_xdp_get_tq(adapter));
+}
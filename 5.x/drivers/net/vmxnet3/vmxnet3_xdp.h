@@ -0,0 +1,88 @@
+/*
+ * Linux driver for VMware's vmxnet3 ethernet NIC.
+ *
+ * Copyright (C) 2008-2021, VMware, Inc. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; version 2 of the License and no later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, GOOD TITLE or
+ * NON INFRINGEMENT.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ * Maintained by: pv-drivers@vmware.com
+ *
+ */
+
+#ifndef _VMXNET3_XDP_H
+#define _VMXNET3_XDP_H
+
+#include <linux/filter.h>
+#include <linux/bpf_trace.h>
+#include <net/xdp.h>
+
+#include "vmxnet3_int.h"
+
+#define VMXNET3_XDP_HEADROOM	(XDP_PACKET_HEADROOM + NET_IP_ALIGN)
+
+/*
+ * With a program attached every frame has to land in a single 1st ring
+ * buffer, i.e. rx_buf_per_pkt must stay 1 (see
+ * vmxnet3_adjust_rx_ring_size()).  That buffer lives in one page behind
+ * VMXNET3_XDP_HEADROOM and in front of the skb_shared_info that
+ * build_skb() puts at the end of it.
+ */
+#define VMXNET3_XDP_MAX_MTU	(VMXNET3_MAX_SKB_BUF_SIZE - \
+				 VMXNET3_MAX_ETH_HDR_SIZE)
+
+/* return values of vmxnet3_process_xdp*(), may be or'ed over a poll */
+#define VMXNET3_XDP_PASS	0
+#define VMXNET3_XDP_CONSUMED	BIT(0)
+#define VMXNET3_XDP_TX		BIT(1)
+#define VMXNET3_XDP_REDIR	BIT(2)
+
+static inline bool
+vmxnet3_xdp_enabled(struct vmxnet3_adapter *adapter)
+{
+	return !!rcu_access_pointer(adapter->xdp_bpf_prog);
+}
+
+int
+vmxnet3_xdp(struct net_device *netdev, struct netdev_bpf *bpf);
+
+int
+vmxnet3_xdp_xmit(struct net_device *netdev, int n, struct xdp_frame **frames,
+		 u32 flags);
+
+struct page *
+vmxnet3_xdp_alloc_page(struct vmxnet3_adapter *adapter, u16 len,
+		       dma_addr_t *dma_addr, gfp_t gfp);
+
+int
+vmxnet3_process_xdp(struct vmxnet3_adapter *adapter,
+		    struct vmxnet3_rx_queue *rq,
+		    struct Vmxnet3_RxCompDesc *rcd,
+		    struct vmxnet3_rx_buf_info *rbi,
+		    struct Vmxnet3_RxDesc *rxd,
+		    struct sk_buff **skb_out);
+
+int
+vmxnet3_process_xdp_small(struct vmxnet3_adapter *adapter,
+			  struct vmxnet3_rx_queue *rq,
+			  void *data, u16 len,
+			  struct sk_buff **skb_out);
+
+void
+vmxnet3_xdp_finalize(struct vmxnet3_adapter *adapter, int xdp_res);
+
+#endif
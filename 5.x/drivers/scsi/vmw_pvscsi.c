@@ -48,6 +48,10 @@ MODULE_VERSION(PVSCSI_DRIVER_VERSION_STRING);
 #define PVSCSI_DEFAULT_QUEUE_DEPTH		254
 #define SGL_SIZE				PAGE_SIZE
 
+/* Doorbells owed to the device, rung at the end of a dispatch batch. */
+#define PVSCSI_KICK_RW		0
+#define PVSCSI_KICK_NON_RW	1
+
 struct pvscsi_sg_list {
 	struct PVSCSISGElement sge[PVSCSI_MAX_NUM_SG_ENTRIES_PER_SEGMENT];
 };
@@ -55,11 +59,11 @@ struct pvscsi_sg_list {
 struct pvscsi_ctx {
 	/*
 	 * The index of the context in cmd_map serves as the context ID for a
-	 * 1-to-1 mapping completions back to requests.
+	 * 1-to-1 mapping completions back to requests.  It is the block layer
+	 * tag of the request, so no free list has to be maintained.
 	 */
 	struct scsi_cmnd	*cmd;
 	struct pvscsi_sg_list	*sgl;
-	struct list_head	list;
 	dma_addr_t		dataPA;
 	dma_addr_t		sensePA;
 	dma_addr_t		sglPA;
@@ -72,7 +76,9 @@ struct pvscsi_adapter {
 	bool				use_msg;
 	bool				use_req_threshold;
 
-	spinlock_t			hw_lock;
+	spinlock_t			hw_lock;	/* cmp ring, resets */
+	spinlock_t			req_lock;	/* req ring producer */
+	unsigned long			kick_pending;
 
 	struct workqueue_struct		*workqueue;
 	struct work_struct		work;
@@ -96,7 +102,6 @@ struct pvscsi_adapter {
 	struct pci_dev			*dev;
 	struct Scsi_Host		*host;
 
-	struct list_head		cmd_pool;
 	struct pvscsi_ctx		*cmd_map;
 };
 
@@ -156,27 +161,32 @@ pvscsi_dev(const struct pvscsi_adapter *adapter)
 static struct pvscsi_ctx *
 pvscsi_find_context(const struct pvscsi_adapter *adapter, struct scsi_cmnd *cmd)
 {
-	struct pvscsi_ctx *ctx, *end;
+	unsigned int tag = cmd->request->tag;
+	struct pvscsi_ctx *ctx;
 
-	end = &adapter->cmd_map[adapter->req_depth];
-	for (ctx = adapter->cmd_map; ctx < end; ctx++)
-		if (ctx->cmd == cmd)
-			return ctx;
+	if (tag >= adapter->req_depth)
+		return NULL;
 
-	return NULL;
+	ctx = &adapter->cmd_map[tag];
+	return ctx->cmd == cmd ? ctx : NULL;
 }
 
+/*
+ * can_queue equals the request ring depth and all hardware queues share
+ * one tag space, so the tag allocator (with its per-cpu caches) hands out
+ * contexts for us and two live commands can never share a slot.
+ */
 static struct pvscsi_ctx *
 pvscsi_acquire_context(struct pvscsi_adapter *adapter, struct scsi_cmnd *cmd)
 {
+	unsigned int tag = cmd->request->tag;
 	struct pvscsi_ctx *ctx;
 
-	if (list_empty(&adapter->cmd_pool))
+	if (WARN_ON_ONCE(tag >= adapter->req_depth))
 		return NULL;
 
-	ctx = list_first_entry(&adapter->cmd_pool, struct pvscsi_ctx, list);
+	ctx = &adapter->cmd_map[tag];
 	ctx->cmd = cmd;
-	list_del(&ctx->list);
 
 	return ctx;
 }
@@ -186,7 +196,6 @@ static void pvscsi_release_context(struct pvscsi_adapter *adapter,
 {
 	ctx->cmd = NULL;
 	ctx->abort_cmp = NULL;
-	list_add(&ctx->list, &adapter->cmd_pool);
 }
 
 /*
@@ -286,18 +295,24 @@ static int scsi_is_rw(unsigned char op)
 	       op == READ_16 || op == WRITE_16;
 }
 
-static void pvscsi_kick_io(const struct pvscsi_adapter *adapter,
-			   unsigned char op)
+/*
+ * Ring the doorbells owed for everything posted since the last kick.  The
+ * block layer tells us where a dispatch batch ends (SCMD_LAST or
+ * ->commit_rqs), so a burst of requests costs one register write per
+ * doorbell instead of one per command.
+ */
+static void pvscsi_kick_io(struct pvscsi_adapter *adapter)
 {
-	if (scsi_is_rw(op)) {
+	if (test_and_clear_bit(PVSCSI_KICK_RW, &adapter->kick_pending)) {
 		struct PVSCSIRingsState *s = adapter->rings_state;
 
 		if (!adapter->use_req_threshold ||
 		    s->reqProdIdx - s->reqConsIdx >= s->reqCallThreshold)
 			pvscsi_kick_rw_io(adapter);
-	} else {
-		pvscsi_process_request_ring(adapter);
 	}
+
+	if (test_and_clear_bit(PVSCSI_KICK_NON_RW, &adapter->kick_pending))
+		pvscsi_process_request_ring(adapter);
 }
 
 static void ll_adapter_reset(const struct pvscsi_adapter *adapter)
@@ -707,17 +722,13 @@ static int pvscsi_queue_ring(struct pvscsi_adapter *adapter,
 	/*
 	 * If this condition holds, we might have room on the request ring, but
 	 * we might not have room on the completion ring for the response.
-	 * However, we have already ruled out this possibility - we would not
-	 * have successfully allocated a context if it were true, since we only
-	 * have one context per request entry.  Check for it anyway, since it
-	 * would be a serious bug.
+	 * There is one context per request entry, but the completion path
+	 * hands a tag back to the block layer just before it advances
+	 * cmpConsIdx under its own lock, so a submitter that reuses the tag
+	 * can briefly see the ring as full.  Let the midlayer retry.
 	 */
-	if (s->reqProdIdx - s->cmpConsIdx >= 1 << req_entries) {
-		scmd_printk(KERN_ERR, cmd, "vmw_pvscsi: "
-			    "ring full: reqProdIdx=%d cmpConsIdx=%d\n",
-			    s->reqProdIdx, s->cmpConsIdx);
+	if (s->reqProdIdx - READ_ONCE(s->cmpConsIdx) >= 1 << req_entries)
 		return -1;
-	}
 
 	e = adapter->req_ring + (s->reqProdIdx & MASK(req_entries));
 
@@ -776,38 +787,47 @@ static int pvscsi_queue_ring(struct pvscsi_adapter *adapter,
 	return 0;
 }
 
-static int pvscsi_queue_lck(struct scsi_cmnd *cmd, void (*done)(struct scsi_cmnd *))
+/*
+ * Called without the host lock.  Only the request ring producer index
+ * needs serializing; completions are reaped under hw_lock in parallel.
+ */
+static int pvscsi_queue(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 {
-	struct Scsi_Host *host = cmd->device->host;
 	struct pvscsi_adapter *adapter = shost_priv(host);
 	struct pvscsi_ctx *ctx;
 	unsigned long flags;
 	unsigned char op;
 
-	spin_lock_irqsave(&adapter->hw_lock, flags);
+	spin_lock_irqsave(&adapter->req_lock, flags);
 
 	ctx = pvscsi_acquire_context(adapter, cmd);
 	if (!ctx || pvscsi_queue_ring(adapter, ctx, cmd) != 0) {
 		if (ctx)
 			pvscsi_release_context(adapter, ctx);
-		spin_unlock_irqrestore(&adapter->hw_lock, flags);
+		spin_unlock_irqrestore(&adapter->req_lock, flags);
+		/* Doorbells for earlier requests go out via ->commit_rqs. */
 		return SCSI_MLQUEUE_HOST_BUSY;
 	}
 
-	cmd->scsi_done = done;
 	op = cmd->cmnd[0];
+	set_bit(scsi_is_rw(op) ? PVSCSI_KICK_RW : PVSCSI_KICK_NON_RW,
+		&adapter->kick_pending);
 
 	dev_dbg(&cmd->device->sdev_gendev,
 		"queued cmd %p, ctx %p, op=%x\n", cmd, ctx, op);
 
-	spin_unlock_irqrestore(&adapter->hw_lock, flags);
+	spin_unlock_irqrestore(&adapter->req_lock, flags);
 
-	pvscsi_kick_io(adapter, op);
+	if (cmd->flags & SCMD_LAST)
+		pvscsi_kick_io(adapter);
 
 	return 0;
 }
 
-static DEF_SCSI_QCMD(pvscsi_queue)
+static void pvscsi_commit_rqs(struct Scsi_Host *host, u16 hwq)
+{
+	pvscsi_kick_io(shost_priv(host));
+}
 
 static int pvscsi_abort(struct scsi_cmnd *cmd)
 {
@@ -930,6 +950,7 @@ static int pvscsi_host_reset(struct scsi_cmnd *cmd)
 	 * up, so stalling new requests until all completions are flushed and
 	 * the rings are back in place.
 	 */
+	spin_lock(&adapter->req_lock);
 
 	pvscsi_process_request_ring(adapter);
 
@@ -949,6 +970,7 @@ static int pvscsi_host_reset(struct scsi_cmnd *cmd)
 	pvscsi_setup_all_rings(adapter);
 	pvscsi_unmask_intr(adapter);
 
+	spin_unlock(&adapter->req_lock);
 	spin_unlock_irqrestore(&adapter->hw_lock, flags);
 
 	return SUCCESS;
@@ -966,14 +988,16 @@ static int pvscsi_bus_reset(struct scsi_cmnd *cmd)
 	 * We don't want to queue new requests for this bus after
 	 * flushing all pending requests to emulation, since new
 	 * requests could then sneak in during this bus reset phase,
-	 * so take the lock now.
+	 * so take the locks now.
 	 */
 	spin_lock_irqsave(&adapter->hw_lock, flags);
+	spin_lock(&adapter->req_lock);
 
 	pvscsi_process_request_ring(adapter);
 	ll_bus_reset(adapter);
 	pvscsi_process_completion_ring(adapter);
 
+	spin_unlock(&adapter->req_lock);
 	spin_unlock_irqrestore(&adapter->hw_lock, flags);
 
 	return SUCCESS;
@@ -991,14 +1015,16 @@ static int pvscsi_device_reset(struct scsi_cmnd *cmd)
 	/*
 	 * We don't want to queue new requests for this device after flushing
 	 * all pending requests to emulation, since new requests could then
-	 * sneak in during this device reset phase, so take the lock now.
+	 * sneak in during this device reset phase, so take the locks now.
 	 */
 	spin_lock_irqsave(&adapter->hw_lock, flags);
+	spin_lock(&adapter->req_lock);
 
 	pvscsi_process_request_ring(adapter);
 	ll_device_reset(adapter, cmd->device->id);
 	pvscsi_process_completion_ring(adapter);
 
+	spin_unlock(&adapter->req_lock);
 	spin_unlock_irqrestore(&adapter->hw_lock, flags);
 
 	return SUCCESS;
@@ -1025,6 +1051,7 @@ static struct scsi_host_template pvscsi_template = {
 	.proc_name			= "vmw_pvscsi",
 	.info				= pvscsi_info,
 	.queuecommand			= pvscsi_queue,
+	.commit_rqs			= pvscsi_commit_rqs,
 	.this_id			= -1,
 	.sg_tablesize			= PVSCSI_MAX_NUM_SG_ENTRIES_PER_SEGMENT,
 	.dma_boundary			= UINT_MAX,
@@ -1461,6 +1488,7 @@ static int pvscsi_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 	adapter->mmioBase = adapter_temp.mmioBase;
 
 	spin_lock_init(&adapter->hw_lock);
+	spin_lock_init(&adapter->req_lock);
 	host->max_channel = 0;
 	host->max_lun     = 1;
 	host->max_cmd_len = 16;
@@ -1492,12 +1520,6 @@ static int pvscsi_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 		goto out_reset_adapter;
 	}
 
-	INIT_LIST_HEAD(&adapter->cmd_pool);
-	for (i = 0; i < adapter->req_depth; i++) {
-		struct pvscsi_ctx *ctx = adapter->cmd_map + i;
-		list_add(&ctx->list, &adapter->cmd_pool);
-	}
-
 	error = pvscsi_allocate_sg(adapter);
 	if (error) {
 		printk(KERN_ERR "vmw_pvscsi: unable to allocate s/g table\n");